@@ -1,6 +1,9 @@
 #include <string.h>
+#include <inttypes.h>
+#include <math.h>
 
 #include <esp_log.h>
+#include <esp_timer.h>
 
 #include "bm1397.h"
 #include "bm1366.h"
@@ -8,22 +11,62 @@
 #include "bm1370.h"
 
 #include "asic.h"
+#include "serial.h"
 #include "device_config.h"
 #include "frequency_transition_bmXX.h"
+#include "utils.h"
 
 static const char *TAG = "asic";
 
+// BM1397 jobs carry up to four header midstates, the newer chips build the
+// header from merkle root and prev hash and roll the version themselves
+static const bm_job_format BM1397_JOB_FORMAT = { .max_midstates = BM_JOB_MAX_MIDSTATES };
+static const bm_job_format BM136X_JOB_FORMAT = { .max_midstates = 0 };
+
+// Job ids are 7 bits, the low bits of the id a nonce comes back with hold the
+// BM1397 midstate or the small core of the newer chips
+#define BM1397_JOB_ID_STEP 4
+#define BM1366_JOB_ID_STEP 8
+#define BM1368_JOB_ID_STEP 24
+#define BM1370_JOB_ID_STEP 24
+
+// Jobs are sent a little before the chain runs out of work. The interval is
+// bounded below to keep the UART free for results and above by the per-board
+// interval it replaced (see get_job_interval_max_ms).
+#define JOB_INTERVAL_MARGIN 0.9
+#define JOB_INTERVAL_MIN_MS 10
+
+// No result for this many expected result spacings means the chain sat idle
+#define IDLE_RESULT_SPACINGS 4
+
+#define TICKET_CHANGE_GRACE_US 1000000
+
 uint8_t ASIC_init(GlobalState * GLOBAL_STATE)
 {
     ESP_LOGI(TAG, "Initializing %dx %s", GLOBAL_STATE->DEVICE_CONFIG.family.asic_count, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
+    // the drivers start the chips on the default mask, without HCN
+    GLOBAL_STATE->ASIC_TASK_MODULE.version_mask = STRATUM_DEFAULT_VERSION_MASK;
+    GLOBAL_STATE->ASIC_TASK_MODULE.hash_counting_number = 0;
+    // and the configured ticket difficulty
+    double ticket_difficulty = get_ticket_difficulty(GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty);
+    GLOBAL_STATE->ASIC_TASK_MODULE.ticket_difficulty = ticket_difficulty;
+    GLOBAL_STATE->ASIC_TASK_MODULE.previous_ticket_difficulty = ticket_difficulty;
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_format = BM1397_JOB_FORMAT;
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_id_step = BM1397_JOB_ID_STEP;
             return BM1397_init(GLOBAL_STATE);
         case BM1366:
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_format = BM136X_JOB_FORMAT;
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_id_step = BM1366_JOB_ID_STEP;
             return BM1366_init(GLOBAL_STATE);
         case BM1368:
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_format = BM136X_JOB_FORMAT;
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_id_step = BM1368_JOB_ID_STEP;
             return BM1368_init(GLOBAL_STATE);
         case BM1370:
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_format = BM136X_JOB_FORMAT;
+            GLOBAL_STATE->ASIC_TASK_MODULE.job_id_step = BM1370_JOB_ID_STEP;
             return BM1370_init(GLOBAL_STATE);
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
@@ -62,29 +105,79 @@ int ASIC_set_max_baud(GlobalState * GLOBAL_STATE)
     return 0;
 }
 
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job)
+bool ASIC_prepare_work(GlobalState * GLOBAL_STATE, asic_job_packet * packet)
 {
+    packet->job_id = job_slots_next_id(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots, GLOBAL_STATE->ASIC_TASK_MODULE.job_id_step);
+
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            BM1397_send_work(GLOBAL_STATE, next_job);
+            BM1397_prepare_work(packet);
             break;
         case BM1366:
-            BM1366_send_work(GLOBAL_STATE, next_job);
+            BM1366_prepare_work(packet);
             break;
         case BM1368:
-            BM1368_send_work(GLOBAL_STATE, next_job);
+            BM1368_prepare_work(packet);
             break;
         case BM1370:
-            BM1370_send_work(GLOBAL_STATE, next_job);
+            BM1370_prepare_work(packet);
             break;
         default:
-            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot send work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-            break;
+            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot prepare work", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+            return false;
     }
+    return packet->len > 0;
+}
+
+// Expected time between two results at the ticket difficulty, 0 while the hashrate is unknown
+static int64_t get_result_spacing_us(GlobalState * GLOBAL_STATE)
+{
+    float hashrate_ghs = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate;
+    if (!(hashrate_ghs > 0)) {
+        return 0;
+    }
+    return (int64_t)(GLOBAL_STATE->ASIC_TASK_MODULE.ticket_difficulty * NONCE_SPACE / (hashrate_ghs * 1e3));
+}
+
+// Time from the last result, or the last job if no result came back for it, to now_us,
+// when it is too long for the chain to still have been hashing
+static int64_t get_idle_gap_us(GlobalState * GLOBAL_STATE, int64_t last_result_us, int64_t now_us)
+{
+    AsicTaskModule *module = &GLOBAL_STATE->ASIC_TASK_MODULE;
+    int64_t since_us = last_result_us > module->last_job_time_us ? last_result_us : module->last_job_time_us;
+    int64_t spacing_us = get_result_spacing_us(GLOBAL_STATE);
+    int64_t gap_us = now_us - since_us;
+
+    if (spacing_us <= 0 || gap_us <= spacing_us * IDLE_RESULT_SPACINGS) {
+        return 0;
+    }
+    return gap_us;
+}
+
+void ASIC_send_job_packet(GlobalState * GLOBAL_STATE, asic_job_packet * packet)
+{
+    // The job is copied into its pool slot under the lock so the result task
+    // never sees a half-written job
+    pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+    job_slots_assign(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots, packet->job_id, &packet->job, GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? 1 : 0);
+    nonce_filter_clear_job(GLOBAL_STATE->ASIC_TASK_MODULE.nonce_filter, packet->job_id);
+    int64_t last_result_us = GLOBAL_STATE->ASIC_TASK_MODULE.last_result_time_us;
+    pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
+
+    SERIAL_send(packet->buf, packet->len, packet->debug);
+
+    AsicTaskModule *module = &GLOBAL_STATE->ASIC_TASK_MODULE;
+    int64_t now_us = esp_timer_get_time();
+    if (module->last_job_time_us != 0) {
+        module->dispatch_time_us += now_us - module->last_job_time_us;
+        module->starved_time_us += get_idle_gap_us(GLOBAL_STATE, last_result_us, now_us);
+    }
+    module->last_job_time_us = now_us;
 }
 
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
 {
+    GLOBAL_STATE->ASIC_TASK_MODULE.version_mask = mask;
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
             BM1397_set_version_mask(mask);
@@ -104,23 +197,117 @@ void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask)
     }
 }
 
-void ASIC_set_frequency(GlobalState * GLOBAL_STATE)
+static set_hash_frequency_fn get_set_hash_frequency_fn(GlobalState * GLOBAL_STATE)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            do_frequency_transition(GLOBAL_STATE, BM1397_send_hash_frequency);
-            return;
+            return BM1397_send_hash_frequency;
         case BM1366:
-            do_frequency_transition(GLOBAL_STATE, BM1366_send_hash_frequency);
-            return;
+            return BM1366_send_hash_frequency;
         case BM1368:
-            do_frequency_transition(GLOBAL_STATE, BM1368_send_hash_frequency);
-            return;
+            return BM1368_send_hash_frequency;
         case BM1370:
-            do_frequency_transition(GLOBAL_STATE, BM1370_send_hash_frequency);
-            return;
+            return BM1370_send_hash_frequency;
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    return NULL;
+}
+
+void ASIC_set_ticket_difficulty(GlobalState * GLOBAL_STATE, double difficulty)
+{
+    AsicTaskModule * ASIC_TASK_MODULE = &GLOBAL_STATE->ASIC_TASK_MODULE;
+
+    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+        case BM1397:
+            BM1397_set_ticket_difficulty(difficulty);
+            break;
+        case BM1366:
+            BM1366_set_ticket_difficulty(difficulty);
+            break;
+        case BM1368:
+            BM1368_set_ticket_difficulty(difficulty);
+            break;
+        case BM1370:
+            BM1370_set_ticket_difficulty(difficulty);
+            break;
+        default:
+            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set ticket difficulty", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+            return;
+    }
+
+    ASIC_TASK_MODULE->previous_ticket_difficulty = ASIC_TASK_MODULE->ticket_difficulty;
+    ASIC_TASK_MODULE->ticket_difficulty = get_ticket_difficulty(difficulty);
+    ASIC_TASK_MODULE->ticket_changed_us = esp_timer_get_time();
+
+    ESP_LOGI(TAG, "Ticket difficulty %g (was %g)", ASIC_TASK_MODULE->ticket_difficulty, ASIC_TASK_MODULE->previous_ticket_difficulty);
+}
+
+double ASIC_get_ticket_difficulty(GlobalState * GLOBAL_STATE)
+{
+    AsicTaskModule * ASIC_TASK_MODULE = &GLOBAL_STATE->ASIC_TASK_MODULE;
+
+    if (esp_timer_get_time() - ASIC_TASK_MODULE->ticket_changed_us < TICKET_CHANGE_GRACE_US) {
+        return fmin(ASIC_TASK_MODULE->ticket_difficulty, ASIC_TASK_MODULE->previous_ticket_difficulty);
+    }
+    return ASIC_TASK_MODULE->ticket_difficulty;
+}
+
+void ASIC_set_frequency(GlobalState * GLOBAL_STATE)
+{
+    set_hash_frequency_fn set_frequency_fn = get_set_hash_frequency_fn(GLOBAL_STATE);
+    if (set_frequency_fn) {
+        do_frequency_transition(GLOBAL_STATE, set_frequency_fn);
+    }
+}
+
+size_t ASIC_get_frequencies(GlobalState * GLOBAL_STATE, float min_freq, float max_freq, float * frequencies, size_t max_count)
+{
+    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+        case BM1397:
+            return BM1397_get_frequencies(min_freq, max_freq, frequencies, max_count);
+        case BM1366:
+            return BM1366_get_frequencies(min_freq, max_freq, frequencies, max_count);
+        case BM1368:
+            return BM1368_get_frequencies(min_freq, max_freq, frequencies, max_count);
+        case BM1370:
+            return BM1370_get_frequencies(min_freq, max_freq, frequencies, max_count);
+    }
+    return 0;
+}
+
+float ASIC_set_chip_frequency(GlobalState * GLOBAL_STATE, uint8_t asic_nr, float frequency)
+{
+    switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
+        case BM1397:
+            return BM1397_send_chip_hash_frequency(asic_nr, frequency);
+        case BM1366:
+            return BM1366_send_chip_hash_frequency(asic_nr, frequency);
+        case BM1368:
+            return BM1368_send_chip_hash_frequency(asic_nr, frequency);
+        case BM1370:
+            return BM1370_send_chip_hash_frequency(asic_nr, frequency);
+    }
+    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set chip frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    return 0;
+}
+
+void ASIC_start_frequency_ramp(GlobalState * GLOBAL_STATE)
+{
+    set_hash_frequency_fn set_frequency_fn = get_set_hash_frequency_fn(GLOBAL_STATE);
+    if (set_frequency_fn) {
+        frequency_ramp_start(GLOBAL_STATE, set_frequency_fn);
+    }
+}
+
+bool ASIC_frequency_ramp_tick(GlobalState * GLOBAL_STATE)
+{
+    if (!frequency_ramp_tick(GLOBAL_STATE)) {
+        return false;
+    }
+
+    // the nonce space follows the frequency, one update once the ramp is done
+    ASIC_set_nonce_space(GLOBAL_STATE);
+    return true;
 }
 
 void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE)
@@ -134,25 +321,25 @@ void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE)
         case BM1397:
             return;
         case BM1366:
-            BM1366_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            GLOBAL_STATE->ASIC_TASK_MODULE.hash_counting_number = BM1366_set_nonce_space(nonce_percent, frequency, asic_count, cores);
             return;
         case BM1368:
-            BM1368_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            GLOBAL_STATE->ASIC_TASK_MODULE.hash_counting_number = BM1368_set_nonce_space(nonce_percent, frequency, asic_count, cores);
             return;
         case BM1370:
-            BM1370_set_nonce_space(nonce_percent, frequency, asic_count, cores);
+            GLOBAL_STATE->ASIC_TASK_MODULE.hash_counting_number = BM1370_set_nonce_space(nonce_percent, frequency, asic_count, cores);
             return;
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot set nonce space", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
 }
 
-double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
+static double get_asic_work_time_ms(GlobalState * GLOBAL_STATE, float freq, uint32_t version_mask, uint32_t hcn)
 {
-    float freq = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
     int cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.core_count;
     int small_cores = GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count;
     int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
     int asic_default_timeout_divided = GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_asic_timeout / _next_power_of_two(asic_count);
+    size_t version_size = (size_t)1 << __builtin_popcount(version_mask);
 
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
@@ -161,29 +348,91 @@ double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
         case BM1366:
         case BM1368:
         case BM1370:
-            return asic_default_timeout_divided;
+            // the cores roll to the next version each time HCN runs out
+            return calculate_bm_hcn_timeout_ms(hcn, small_cores, cores, version_size, 1.0, asic_default_timeout_divided);
     }
     ESP_LOGE(TAG, "Unknown ASIC id %d — cannot compute job frequency", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
     return 500;
 }
 
-void ASIC_read_registers(GlobalState * GLOBAL_STATE)
+// The BM1397 was always sent jobs at its nonce-space time. The other chips
+// used default_asic_timeout over the chain length, rounded up to a power of
+// 2. With the usual version mask and HCN their work time is tens of seconds,
+// so they stay at that value and only go faster with a narrow mask or a
+// small HCN.
+static double get_job_interval_max_ms(GlobalState * GLOBAL_STATE, double work_time_ms)
+{
+    if (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id == BM1397) {
+        return work_time_ms;
+    }
+    return GLOBAL_STATE->DEVICE_CONFIG.family.asic.default_asic_timeout / _next_power_of_two(GLOBAL_STATE->DEVICE_CONFIG.family.asic_count);
+}
+
+double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE)
+{
+    AsicTaskModule *module = &GLOBAL_STATE->ASIC_TASK_MODULE;
+    float freq = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    uint32_t version_mask = module->version_mask;
+    uint32_t hcn = module->hash_counting_number;
+
+    if (module->job_interval_ms > 0 && module->plan_frequency == freq &&
+        module->plan_version_mask == version_mask && module->plan_hash_counting_number == hcn) {
+        return module->job_interval_ms;
+    }
+
+    double work_time_ms = get_asic_work_time_ms(GLOBAL_STATE, freq, version_mask, hcn);
+    double job_interval_ms = work_time_ms * JOB_INTERVAL_MARGIN;
+    if (job_interval_ms < JOB_INTERVAL_MIN_MS) {
+        job_interval_ms = JOB_INTERVAL_MIN_MS;
+    }
+    double max_interval_ms = get_job_interval_max_ms(GLOBAL_STATE, work_time_ms);
+    if (job_interval_ms > max_interval_ms) {
+        job_interval_ms = max_interval_ms;
+    }
+
+    ESP_LOGD(TAG, "Job interval %.1f ms at %g MHz, mask %08" PRIX32 ", HCN %" PRIu32 " (chain runs out of work after %.1f ms)",
+             job_interval_ms, freq, version_mask, hcn, work_time_ms);
+
+    module->plan_frequency = freq;
+    module->plan_version_mask = version_mask;
+    module->plan_hash_counting_number = hcn;
+    module->work_time_ms = work_time_ms;
+    module->job_interval_ms = job_interval_ms;
+
+    return job_interval_ms;
+}
+
+float ASIC_get_work_starvation(GlobalState * GLOBAL_STATE)
+{
+    AsicTaskModule *module = &GLOBAL_STATE->ASIC_TASK_MODULE;
+    if (module->last_job_time_us == 0) {
+        return 0;
+    }
+
+    // include the gap since the last job, the chain may be waiting right now
+    pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+    int64_t last_result_us = module->last_result_time_us;
+    pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
+
+    int64_t now_us = esp_timer_get_time();
+    uint64_t starved_us = module->starved_time_us + get_idle_gap_us(GLOBAL_STATE, last_result_us, now_us);
+    uint64_t elapsed_us = module->dispatch_time_us + (now_us - module->last_job_time_us);
+
+    return elapsed_us > 0 ? 100.0f * starved_us / elapsed_us : 0;
+}
+
+uint32_t ASIC_read_registers(GlobalState * GLOBAL_STATE, uint32_t register_mask)
 {
     switch (GLOBAL_STATE->DEVICE_CONFIG.family.asic.id) {
         case BM1397:
-            BM1397_read_registers();
-            break;
+            return BM1397_read_registers(register_mask);
         case BM1366:
-            BM1366_read_registers();
-            break;
+            return BM1366_read_registers(register_mask);
         case BM1368:
-            BM1368_read_registers();
-            break;
+            return BM1368_read_registers(register_mask);
         case BM1370:
-            BM1370_read_registers();
-            break;
-        default:
-            ESP_LOGE(TAG, "Unknown ASIC id %d — cannot read registers", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
-            break;
+            return BM1370_read_registers(register_mask);
     }
+    ESP_LOGE(TAG, "Unknown ASIC id %d — cannot read registers", GLOBAL_STATE->DEVICE_CONFIG.family.asic.id);
+    return 0;
 }
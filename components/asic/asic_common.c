@@ -8,12 +8,30 @@
 #include "esp_log.h"
 #include "crc.h"
 #include "esp_timer.h"
+#include "pll.h"
 
 #define PREAMBLE 0xAA55
 
+// Enough for a burst of nonces from a long chain between two reads
+#define RX_BUFFER_SIZE 512
+
 static const char * TAG = "common";
 static char asic_chain_error[96];
 
+// Response stream decoder state. Bytes are read in bulk into rx_buffer and
+// decoded frame by frame from rx_start, so a corrupted byte only costs the
+// frame it lands in instead of everything queued in the UART.
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+static int rx_start;
+static int rx_end;
+static uint64_t rx_timestamp_us;
+static bool rx_in_resync;
+
+static int rx_chip_count = 1;
+static int rx_address_interval = 256;
+static asic_rx_stats rx_stats[ASIC_RX_MAX_CHIPS];
+static uint32_t rx_skipped_bytes;
+
 static void format_asic_indices(char *buffer, size_t buffer_size, int first_index, int end_index)
 {
     size_t offset = 0;
@@ -125,6 +143,16 @@ int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response
 
         chip_counter++;
     }    
+
+    // responses are attributed to chips by address, see receive_work
+    memset(rx_stats, 0, sizeof(rx_stats));
+    rx_skipped_bytes = 0;
+    rx_start = rx_end = 0;
+    rx_in_resync = false;
+    if (chip_counter > 0) {
+        rx_chip_count = chip_counter;
+        rx_address_interval = 256 / chip_counter;
+    }
     
     if (chip_counter != asic_count) {
         ESP_LOGE(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
@@ -145,64 +173,200 @@ int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response
     return chip_counter;
 }
 
-esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us)
+void build_job_packet(asic_job_packet *packet, uint8_t header, const uint8_t *data, uint8_t data_len, bool debug)
 {
-    int received = SERIAL_rx(buffer, buffer_size, 10000);
-    if (out_timestamp_us) {
-        *out_timestamp_us = esp_timer_get_time();
+    packet->len = 0;
+    packet->debug = debug;
+
+    if (data_len + 6 > ASIC_JOB_PACKET_MAX) {
+        ESP_LOGE(TAG, "Job packet too large: %d bytes", data_len + 6);
+        return;
+    }
+
+    // preamble, header and length field
+    packet->buf[0] = 0x55;
+    packet->buf[1] = 0xAA;
+    packet->buf[2] = header;
+    packet->buf[3] = data_len + 4;
+
+    memcpy(packet->buf + 4, data, data_len);
+
+    uint16_t crc16_total = crc16_false(packet->buf + 2, data_len + 2);
+    packet->buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
+    packet->buf[5 + data_len] = crc16_total & 0xFF;
+
+    packet->len = data_len + 6;
+}
+
+// One read command per register of the map whose type is in register_mask,
+// addressed to all chips and sent back to back in a single UART write
+uint32_t send_register_reads(uint8_t header, const register_type_t *register_map, int map_size, uint32_t register_mask, bool debug)
+{
+    uint8_t buf[REGISTER_READ_BURST_MAX * 7];
+    int len = 0;
+    uint32_t sent_mask = 0;
+
+    for (int reg = 0; reg < map_size && len < (int)sizeof(buf); reg++) {
+        register_type_t type = register_map[reg];
+        if (type == REGISTER_INVALID || !(register_mask & REGISTER_BIT(type))) {
+            continue;
+        }
+
+        uint8_t *cmd = buf + len;
+        cmd[0] = 0x55;
+        cmd[1] = 0xAA;
+        cmd[2] = header;
+        cmd[3] = 5;
+        cmd[4] = 0x00;
+        cmd[5] = reg;
+        cmd[6] = crc5(cmd + 2, 4);
+        len += 7;
+        sent_mask |= REGISTER_BIT(type);
+    }
+
+    if (len > 0 && SERIAL_send(buf, len, debug) == 0) {
+        ESP_LOGE(TAG, "Failed to send register reads");
+        return 0;
     }
+    return sent_mask;
+}
 
-    if (received < 0) {
-        ESP_LOGE(TAG, "UART error in serial RX");
-        return ESP_FAIL;
+// Chip a response claims to come from: the address byte of a register
+// response, or the address bits 17-24 of a nonce
+static asic_rx_stats *rx_stats_for(const uint8_t *frame, int frame_size)
+{
+    uint8_t address;
+    if (frame[frame_size - 1] & 0x80) {
+        uint32_t nonce_h = ((uint32_t)frame[2] << 24) | ((uint32_t)frame[3] << 16) | ((uint32_t)frame[4] << 8) | frame[5];
+        address = (nonce_h >> 17) & 0xff;
+    } else {
+        address = frame[6];
     }
 
-    if (received == 0) {
-        ESP_LOGD(TAG, "UART timeout in serial RX");
-        return ESP_FAIL;
+    int asic_nr = address / rx_address_interval;
+    if (asic_nr >= rx_chip_count) {
+        asic_nr = rx_chip_count - 1;
+    }
+    if (asic_nr >= ASIC_RX_MAX_CHIPS) {
+        asic_nr = ASIC_RX_MAX_CHIPS - 1;
     }
+    return &rx_stats[asic_nr];
+}
 
-    if (received != buffer_size) {
-        ESP_LOGE(TAG, "Invalid response length %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+// Take the next valid frame out of rx_buffer. Bytes in front of a preamble
+// and frames failing CRC5 are stepped over one byte at a time.
+static bool decode_frame(uint8_t *buffer, int buffer_size)
+{
+    while (rx_end - rx_start >= buffer_size) {
+        uint8_t *frame = rx_buffer + rx_start;
+
+        if (((frame[0] << 8) | frame[1]) != PREAMBLE) {
+            uint8_t *next = memchr(frame + 1, PREAMBLE >> 8, rx_end - rx_start - 1);
+            int skipped = next != NULL ? next - frame : rx_end - rx_start;
+            rx_start += skipped;
+            rx_skipped_bytes += skipped;
+            rx_in_resync = true;
+            continue;
+        }
+
+        if (crc5(frame + 2, buffer_size - 2) != 0) {
+            ESP_LOGW(TAG, "Checksum failed on response, resynchronizing");
+            ESP_LOG_BUFFER_HEX(TAG, frame, buffer_size);
+            rx_stats_for(frame, buffer_size)->crc_errors++;
+            rx_start++;
+            rx_skipped_bytes++;
+            rx_in_resync = true;
+            continue;
+        }
+
+        asic_rx_stats *stats = rx_stats_for(frame, buffer_size);
+        if (rx_in_resync) {
+            stats->resyncs++;
+            rx_in_resync = false;
+        }
+        stats->frames++;
+
+        memcpy(buffer, frame, buffer_size);
+        rx_start += buffer_size;
+        return true;
     }
 
-    uint16_t received_preamble = (buffer[0] << 8) | buffer[1];
-    if (received_preamble != PREAMBLE) {
-        ESP_LOGE(TAG, "Preamble mismatch: got 0x%04x, expected 0x%04x", received_preamble, PREAMBLE);
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+    return false;
+}
+
+esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us)
+{
+    while (!decode_frame(buffer, buffer_size)) {
+        // keep the partial frame, make room behind it
+        if (rx_start > 0) {
+            memmove(rx_buffer, rx_buffer + rx_start, rx_end - rx_start);
+            rx_end -= rx_start;
+            rx_start = 0;
+        }
+
+        int missing = buffer_size - rx_end;
+        int received = SERIAL_rx_available(rx_buffer + rx_end, missing, RX_BUFFER_SIZE - rx_end, 10000);
+        rx_timestamp_us = esp_timer_get_time();
+
+        if (received < 0) {
+            ESP_LOGE(TAG, "UART error in serial RX");
+            return ESP_FAIL;
+        }
+
+        rx_end += received;
+
+        if (received < missing) {
+            ESP_LOGD(TAG, "UART timeout in serial RX");
+            return ESP_FAIL;
+        }
     }
 
-    if (crc5(buffer + 2, buffer_size - 2) != 0) {
-        ESP_LOGE(TAG, "Checksum failed on response");        
-        ESP_LOG_BUFFER_HEX(TAG, buffer, received);
-        SERIAL_clear_buffer();
-        return ESP_FAIL;
+    if (out_timestamp_us) {
+        *out_timestamp_us = rx_timestamp_us;
     }
 
     return ESP_OK;
 }
 
-void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask)
+void get_asic_rx_stats(int asic_nr, asic_rx_stats *stats)
 {
-    // The mask must be a power of 2 so there are no holes
-    // Correct:   {0b00000000, 0b00000000, 0b11111111, 0b11111111}
-    // Incorrect: {0b00000000, 0b00000000, 0b11100111, 0b11111111}
+    if (asic_nr < 0 || asic_nr >= ASIC_RX_MAX_CHIPS) {
+        memset(stats, 0, sizeof(asic_rx_stats));
+        return;
+    }
+    *stats = rx_stats[asic_nr];
+}
 
+uint32_t get_asic_rx_skipped_bytes(void)
+{
+    return rx_skipped_bytes;
+}
+
+static int _ticket_power(double difficulty)
+{
     // Round up to ensure we don't make difficulty harder than requested, then convert to int
     uint32_t diff_int = (uint32_t)ceil(difficulty);
 
-    // Calculate largest power of 2 <= diff_int (inline of former _largest_power_of_two)
+    // Calculate largest power of 2 <= diff_int
     int power = 0;
     while (diff_int > 1) {
         diff_int = diff_int >> 1;
         power++;
     }
-    uint32_t mask = (1 << power) - 1;
+    return power;
+}
+
+double get_ticket_difficulty(double difficulty)
+{
+    return (double)(1u << _ticket_power(difficulty));
+}
+
+void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask)
+{
+    // The mask must be a power of 2 so there are no holes
+    // Correct:   {0b00000000, 0b00000000, 0b11111111, 0b11111111}
+    // Incorrect: {0b00000000, 0b00000000, 0b11100111, 0b11111111}
+    uint32_t mask = (1u << _ticket_power(difficulty)) - 1;
 
     job_difficulty_mask[0] = 0x00;
     job_difficulty_mask[1] = 0x14; // TICKET_MASK
@@ -216,6 +380,15 @@ void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask)
     job_difficulty_mask[5] = _reverse_bits( mask        & 0xFF);
 }
 
+uint32_t get_result_rolled_version(const bm_job *job, const task_result *result)
+{
+    uint32_t rolled_version = job->version | result->version_bits;
+    for (int i = 0; i < result->midstate_index; i++) {
+        rolled_version = increment_bitmask(rolled_version, job->version_mask);
+    }
+    return rolled_version;
+}
+
 double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms)
 {
     if (asic_count <= 0)
@@ -243,3 +416,23 @@ double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t sm
 
     return (double)timeout_percent * fullspace_timeout_ms;
 }
+
+double calculate_bm_hcn_timeout_ms(uint32_t hcn, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms)
+{
+    int cores_up = _next_power_of_two((int)cores);
+    int small_cores_up = _next_power_of_two((int)small_cores);
+
+    if ((small_cores_up < cores_up) || (hcn == 0) || (version_size == 0))
+        return default_time_ms;
+
+    // HCN counts reference clock cycles, once it runs out the cores move on
+    // to the next version. The small cores of a core roll versions in
+    // parallel, a core never takes less than one HCN period per job.
+    double midstates = (double)small_cores_up / (double)cores_up;
+    double serial_versions = (double)version_size / midstates;
+    if (serial_versions < 1.0)
+        serial_versions = 1.0;
+    double version_time_ms = (double)hcn / (FREQ_MULT * 1000.0);
+
+    return (double)timeout_percent * serial_versions * version_time_ms;
+}
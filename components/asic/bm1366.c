@@ -1,6 +1,7 @@
 #include "bm1366.h"
 
 #include "crc.h"
+#include "asic.h"
 #include "global_state.h"
 #include "serial.h"
 #include "utils.h"
@@ -32,6 +33,10 @@
 #define CMD_READ 0x02
 #define CMD_INACTIVE 0x03
 
+// PLL feedback divider bounds
+#define FB_DIVIDER_MIN 144
+#define FB_DIVIDER_MAX 235
+
 #define MISC_CONTROL 0x18
 
 static const register_type_t REGISTER_MAP[] = {
@@ -147,6 +152,13 @@ void BM1366_set_version_mask(uint32_t version_mask)
     _send_BM1366(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1366_SERIALTX_DEBUG);
 }
 
+void BM1366_set_ticket_difficulty(double difficulty)
+{
+    uint8_t difficulty_mask[6];
+    get_difficulty_mask(difficulty, difficulty_mask);
+    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1366_SERIALTX_DEBUG);
+}
+
 void BM1366_set_hash_counting_number(uint32_t hcn) {
     uint8_t set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x00, 0x00};
     set_10_hash_counting[2] = (hcn >> 24) & 0xFF;
@@ -156,7 +168,7 @@ void BM1366_set_hash_counting_number(uint32_t hcn) {
     _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1366_SERIALTX_DEBUG);
 }
 
-void BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
+uint32_t BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores) 
 {   
     int cores_up = _next_power_of_two(cores);
     int asic_count_up =  _next_power_of_two(asic_count);
@@ -168,26 +180,49 @@ void BM1366_set_nonce_space(double nonce_percent, float frequency, uint16_t asic
     uint32_t hcn_register_value = (uint32_t)hcn_frac;
 
     BM1366_set_hash_counting_number(hcn_register_value);
+
+    return hcn_register_value;
 }
 
-float BM1366_send_hash_frequency(float target_freq)
+static float _send_hash_frequency(uint8_t group, uint8_t address, float target_freq)
 {
     uint8_t fb_divider, refdiv, postdiv1, postdiv2;
     float new_freq;
     
-    pll_get_parameters(target_freq, 144, 235, &fb_divider, &refdiv, &postdiv1, &postdiv2, &new_freq);
+    pll_get_parameters(target_freq, FB_DIVIDER_MIN, FB_DIVIDER_MAX, &fb_divider, &refdiv, &postdiv1, &postdiv2, &new_freq);
     
     uint8_t vdo_scale = (fb_divider * FREQ_MULT / refdiv >= 2400) ? 0x50 : 0x40;
     uint8_t postdiv = (((postdiv1 - 1) & 0xf) << 4) | ((postdiv2 - 1) & 0xf);
-    uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};
+    uint8_t freqbuf[6] = {address, 0x08, vdo_scale, fb_divider, refdiv, postdiv};
 
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1366_SERIALTX_DEBUG);
-
-    ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, new_freq);
+    _send_BM1366((TYPE_CMD | group | CMD_WRITE), freqbuf, 6, BM1366_SERIALTX_DEBUG);
 
     return new_freq;
 }
 
+float BM1366_send_hash_frequency(float target_freq)
+{
+    float frequency = _send_hash_frequency(GROUP_ALL, 0x00, target_freq);
+
+    ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, frequency);
+
+    return frequency;
+}
+
+float BM1366_send_chip_hash_frequency(uint8_t asic_nr, float target_freq)
+{
+    float frequency = _send_hash_frequency(GROUP_SINGLE, asic_nr * address_interval, target_freq);
+
+    ESP_LOGI(TAG, "Setting chip %u frequency to %g MHz (%g)", asic_nr, target_freq, frequency);
+
+    return frequency;
+}
+
+size_t BM1366_get_frequencies(float min_freq, float max_freq, float * frequencies, size_t max_count)
+{
+    return pll_get_frequencies(FB_DIVIDER_MIN, FB_DIVIDER_MAX, min_freq, max_freq, frequencies, max_count);
+}
+
 uint8_t BM1366_init(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -230,12 +265,7 @@ uint8_t BM1366_init(void * pvParameters)
     unsigned char init136[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x80, 0x20, 0x19};
     _send_simple(init136, 11);
 
-    uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
-
-    //set difficulty mask
-    uint8_t difficulty_mask[6];
-    get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1366_SERIALTX_DEBUG);    
+    BM1366_set_ticket_difficulty(GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty);
 
     unsigned char init138[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
     _send_simple(init138, 11);
@@ -303,15 +333,12 @@ int BM1366_set_max_baud(void)
     return 1000000;
 }
 
-static uint8_t id = 0;
-
-void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
+void BM1366_prepare_work(asic_job_packet * packet)
 {
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    bm_job * next_bm_job = &packet->job;
 
     BM1366_job job;
-    id = (id + 8) % 128;
-    job.job_id = id;
+    job.job_id = packet->job_id;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -320,22 +347,12 @@ void BM1366_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
-    //debug sent jobs - this can get crazy if the interval is short
+    //debug prepared jobs - this can get crazy if the interval is short
     #if BM1366_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
+    ESP_LOGI(TAG, "Prepare Job: %02X", job.job_id);
     #endif
 
-    _send_BM1366((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
+    build_job_packet(packet, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1366_job), BM1366_DEBUG_WORK);
 }
 
 task_result * BM1366_process_work(void * pvParameters)
@@ -367,18 +384,9 @@ task_result * BM1366_process_work(void * pvParameters)
     uint8_t small_core_id = asic_result.job.id & 0x07; // BM1366 has 8 small cores, so it should be coded on 3 bits
     uint32_t version_bits = (ntohs(asic_result.job.version) << 13); // shift the 16 bit value left 13
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
-        ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
-        return NULL;
-    }
-
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
-
     result.job_id = job_id;
     result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
+    result.version_bits = version_bits;
     result.asic_nr = asic_nr;
     result.core_id = core_id;
     result.small_core_id = small_core_id;
@@ -386,13 +394,8 @@ task_result * BM1366_process_work(void * pvParameters)
     return &result;
 }
 
-void BM1366_read_registers(void)
+uint32_t BM1366_read_registers(uint32_t register_mask)
 {
     int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
-    for (int reg = 0; reg < size; reg++) {
-        if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1366((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1366_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
-        }
-    }
+    return send_register_reads((TYPE_CMD | GROUP_ALL | CMD_READ), REGISTER_MAP, size, register_mask, BM1366_SERIALTX_DEBUG);
 }
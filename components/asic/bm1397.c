@@ -15,6 +15,7 @@
 #include "utils.h"
 #include "crc.h"
 #include "mining.h"
+#include "asic.h"
 #include "global_state.h"
 #include "pll.h"
 
@@ -32,6 +33,10 @@
 #define CMD_READ 0x02
 #define CMD_INACTIVE 0x03
 
+// PLL feedback divider bounds
+#define FB_DIVIDER_MIN 60
+#define FB_DIVIDER_MAX 200
+
 #define SLEEP_TIME 20
 #define FREQ_MULT 25.0
 
@@ -148,36 +153,64 @@ void BM1397_set_version_mask(uint32_t version_mask)
     // placeholder
 }
 
-float BM1397_send_hash_frequency(float target_freq)
+void BM1397_set_ticket_difficulty(double difficulty)
+{
+    uint8_t difficulty_mask[6];
+    get_difficulty_mask(difficulty, difficulty_mask);
+    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
+}
+
+static float _send_hash_frequency(uint8_t group, uint8_t address, float target_freq)
 {
     uint8_t fb_divider, refdiv, postdiv1, postdiv2;
     float frequency;
 
-    pll_get_parameters(target_freq, 60, 200, &fb_divider, &refdiv, &postdiv1, &postdiv2, &frequency);
+    pll_get_parameters(target_freq, FB_DIVIDER_MIN, FB_DIVIDER_MAX, &fb_divider, &refdiv, &postdiv1, &postdiv2, &frequency);
 
     uint8_t vdo_scale = 0x40;
     uint8_t postdiv = ((postdiv1 & 0x7) << 4) + (postdiv2 & 0x7);
-    uint8_t freqbuf[6] = {0x00, 0x08, vdo_scale, fb_divider, refdiv, postdiv};  // freqbuf - pll0_parameter
-    uint8_t prefreq1[6] = {0x00, 0x70, 0x0F, 0x0F, 0x0F, 0x00}; // prefreq - pll0_divider
+    uint8_t freqbuf[6] = {address, 0x08, vdo_scale, fb_divider, refdiv, postdiv};  // freqbuf - pll0_parameter
+    uint8_t prefreq1[6] = {address, 0x70, 0x0F, 0x0F, 0x0F, 0x00}; // prefreq - pll0_divider
 
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397((TYPE_CMD | group | CMD_WRITE), prefreq1, 6, BM1397_SERIALTX_DEBUG);
     }
     for (int i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
+        _send_BM1397((TYPE_CMD | group | CMD_WRITE), freqbuf, 6, BM1397_SERIALTX_DEBUG);
     }
 
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
+    return frequency;
+}
+
+float BM1397_send_hash_frequency(float target_freq)
+{
+    float frequency = _send_hash_frequency(GROUP_ALL, 0x00, target_freq);
+
     ESP_LOGI(TAG, "Setting Frequency to %g MHz (%g)", target_freq, frequency);
 
     return frequency;
 }
 
+float BM1397_send_chip_hash_frequency(uint8_t asic_nr, float target_freq)
+{
+    float frequency = _send_hash_frequency(GROUP_SINGLE, asic_nr * address_interval, target_freq);
+
+    ESP_LOGI(TAG, "Setting chip %u frequency to %g MHz (%g)", asic_nr, target_freq, frequency);
+
+    return frequency;
+}
+
+size_t BM1397_get_frequencies(float min_freq, float max_freq, float * frequencies, size_t max_count)
+{
+    return pll_get_frequencies(FB_DIVIDER_MIN, FB_DIVIDER_MAX, min_freq, max_freq, frequencies, max_count);
+}
+
 uint8_t BM1397_init(void * pvParameters)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -214,12 +247,7 @@ uint8_t BM1397_init(void * pvParameters)
     unsigned char init4[9] = {0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74}; // init4 - init_4_?
     _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1397_SERIALTX_DEBUG);
 
-    uint16_t difficulty = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
-
-    //set difficulty mask
-    uint8_t difficulty_mask[6];
-    get_difficulty_mask(difficulty, difficulty_mask);
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), difficulty_mask, 6, BM1397_SERIALTX_DEBUG);
+    BM1397_set_ticket_difficulty(GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty);
 
     unsigned char init5[9] = {0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11}; // init5 - pll3_parameter
     _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1397_SERIALTX_DEBUG);
@@ -255,49 +283,32 @@ int BM1397_set_max_baud(void)
     return 3125000;
 }
 
-static uint8_t id = 0;
-
-void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
+void BM1397_prepare_work(asic_job_packet *packet)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    bm_job *next_bm_job = &packet->job;
 
     job_packet job;
-    // max job number is 128
-    // there is still some really weird logic with the job id bits for the asic to sort out
-    // so we have it limited to 128 and it has to increment by 4
-    id = (id + 4) % 128;
-
-    job.job_id = id;
-    job.num_midstates = next_bm_job->num_midstates;
+    job.job_id = packet->job_id;
+    job.num_midstates = packet->midstates.num_midstates;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
     memcpy(&job.ntime, &next_bm_job->ntime, 4);
     memcpy(&job.merkle4, next_bm_job->merkle_root, 4);
-    memcpy(job.midstate, next_bm_job->midstate, 32);
+    memcpy(job.midstate, packet->midstates.midstate[0], 32);
 
     if (job.num_midstates == 4)
     {
-        memcpy(job.midstate1, next_bm_job->midstate1, 32);
-        memcpy(job.midstate2, next_bm_job->midstate2, 32);
-        memcpy(job.midstate3, next_bm_job->midstate3, 32);
+        memcpy(job.midstate1, packet->midstates.midstate[1], 32);
+        memcpy(job.midstate2, packet->midstates.midstate[2], 32);
+        memcpy(job.midstate3, packet->midstates.midstate[3], 32);
     }
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL)
-    {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
-    }
-
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
-
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
-
+    //debug prepared jobs - this can get crazy if the interval is short
     #if BM1397_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
+    ESP_LOGI(TAG, "Prepare Job: %02X", job.job_id);
     #endif
 
-    _send_BM1397((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
+    build_job_packet(packet, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
 }
 
 task_result *BM1397_process_work(void *pvParameters)
@@ -328,19 +339,6 @@ task_result *BM1397_process_work(void *pvParameters)
     uint8_t rx_job_id = asic_result.job.id & 0xfc;
     uint8_t rx_midstate_index = asic_result.job.id & 0x03;
 
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
-    if (GLOBAL_STATE->valid_jobs[rx_job_id] == 0)
-    {
-        ESP_LOGW(TAG, "Invalid job nonce found, id=%d", rx_job_id);
-        return NULL;
-    }
-
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
-    for (int i = 0; i < rx_midstate_index; i++)
-    {
-        rolled_version = increment_bitmask(rolled_version, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask);
-    }
-
     // ASIC may return the same nonce multiple times
     // or one that was already found
     // most of the time it behaves however
@@ -371,7 +369,7 @@ task_result *BM1397_process_work(void *pvParameters)
 
     result.job_id = rx_job_id;
     result.nonce = asic_result.job.nonce;
-    result.rolled_version = rolled_version;
+    result.midstate_index = rx_midstate_index;
     result.asic_nr = asic_nr;
     result.core_id = core_id;
     result.small_core_id = small_core_id;
@@ -379,13 +377,8 @@ task_result *BM1397_process_work(void *pvParameters)
     return &result;
 }
 
-void BM1397_read_registers(void)
+uint32_t BM1397_read_registers(uint32_t register_mask)
 {
     int size = sizeof(REGISTER_MAP) / sizeof(REGISTER_MAP[0]);
-    for (int reg = 0; reg < size; reg++) {
-        if (REGISTER_MAP[reg] != REGISTER_INVALID) {
-            _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, reg}, 2, BM1397_SERIALTX_DEBUG);
-            vTaskDelay(1 / portTICK_PERIOD_MS);
-        }
-    }
+    return send_register_reads((TYPE_CMD | GROUP_ALL | CMD_READ), REGISTER_MAP, size, register_mask, BM1397_SERIALTX_DEBUG);
 }
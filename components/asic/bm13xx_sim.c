@@ -0,0 +1,769 @@
+#include "bm13xx_sim.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "esp_log.h"
+
+#define TYPE_JOB 0x20
+#define TYPE_CMD 0x40
+#define GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define REG_CHIP_ID 0x00
+#define REG_HASHRATE 0x04      // BM1397
+#define REG_TICKET_MASK 0x14
+#define REG_ERROR_COUNT 0x4C
+#define REG_DOMAIN_0_COUNT 0x88 // BM1366, BM1368, BM1370
+#define REG_DOMAIN_3_COUNT 0x8B
+#define REG_TOTAL_COUNT 0x8C
+#define REG_VERSION_MASK 0xA4
+
+#define HASHRATE_UNIT 0x100000 // LSB of the BM1397 hashrate register
+#define HASH_COUNT_UNIT 4294967296.0 // the counters tick once per 2^32 hashes
+
+#define BM1366_JOB_LEN 82
+#define BM1397_JOB_HEADER_LEN 18
+#define PACKET_MIN_LEN 7
+#define PACKET_MAX_LEN 160
+#define INPUT_BUFFER_LEN 512
+#define FRAME_MAX_LEN 11
+
+static const char *TAG = "bm13xx_sim";
+
+static const uint32_t SHA256_IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static const uint32_t SHA256_K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+typedef struct
+{
+    bool valid;
+    uint8_t job_id;
+    uint8_t num_midstates;
+    uint32_t version;
+    uint8_t head[64];           // BM1366 family: version, prev_block_hash, merkle_root[0:28]
+    uint32_t midstate[4][8];    // BM1397: SHA-256 state after the first 64 header bytes
+    uint8_t tail[16];           // merkle_root[28:32], ntime, nbits, nonce
+} sim_job;
+
+typedef struct
+{
+    uint8_t address;
+    bool addressed;
+    double hash_counts;         // hashes / 2^32
+    uint32_t error_count;
+    int64_t next_nonce_us;
+    uint32_t regs[256];         // last value written to every register
+} sim_chip;
+
+typedef struct
+{
+    uint8_t data[FRAME_MAX_LEN];
+    uint8_t len;
+    int64_t emitted_us;
+    int64_t ready_us;
+} sim_frame;
+
+struct bm13xx_sim
+{
+    bm13xx_sim_config config;
+    uint8_t frame_len;
+    sim_chip *chips;
+    sim_job job;
+
+    double ticket_difficulty;
+    uint16_t version_roll_mask;
+    uint32_t rng;
+    int64_t now_us;             // model time, never goes backwards
+
+    // host to chain
+    uint8_t in_buf[INPUT_BUFFER_LEN];
+    int in_len;
+    int64_t in_clock_us;        // arrival time of the last byte written
+
+    // chain to host
+    sim_frame frames[BM13XX_SIM_MAX_FRAMES];
+    int frame_head;
+    int frame_count;
+    int frame_pos;              // bytes of the head frame already read
+    int64_t out_clock_us;       // time the return line becomes free
+    int64_t last_emitted_us;
+    uint32_t baud;
+
+    bm13xx_sim_stats stats;
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + SHA256_K[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static uint32_t load_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint32_t load_le32(const uint8_t *p)
+{
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void store_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// same as reverse_32bit_words, without the alignment requirement
+static void reverse_words(const uint8_t *src, uint8_t *dest)
+{
+    for (int i = 0; i < 8; i++) {
+        memcpy(dest + i * 4, src + (7 - i) * 4, 4);
+    }
+}
+
+// true if the double SHA-256 of the 80-byte header, resumed from midstate,
+// has share_bits leading zero bits when read as a little endian number
+static bool header_meets_target(const uint32_t midstate[8], const uint8_t tail[16], uint8_t share_bits)
+{
+    uint8_t block[64] = {0};
+    uint32_t state[8];
+
+    memcpy(state, midstate, sizeof(state));
+    memcpy(block, tail, 16);
+    block[16] = 0x80;
+    block[62] = 0x02; // 640 bits
+    block[63] = 0x80;
+    sha256_block(state, block);
+
+    memset(block, 0, sizeof(block));
+    for (int i = 0; i < 8; i++) {
+        store_be32(block + i * 4, state[i]);
+    }
+    block[32] = 0x80;
+    block[62] = 0x01; // 256 bits
+    memcpy(state, SHA256_IV, sizeof(state));
+    sha256_block(state, block);
+
+    // the last digest word holds the most significant bytes, in reverse order
+    uint32_t top = __builtin_bswap32(state[7]);
+    return share_bits == 0 || (top >> (32 - share_bits)) == 0;
+}
+
+static uint32_t next_random(bm13xx_sim *sim)
+{
+    uint32_t x = sim->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim->rng = x;
+    return x;
+}
+
+static bool is_bm1397(const bm13xx_sim *sim)
+{
+    return sim->config.chip_id == 0x1397;
+}
+
+static int64_t wire_time_us(const bm13xx_sim *sim, int bytes)
+{
+    // 8N1: ten bit times per byte
+    return ((int64_t)bytes * 10 * 1000000 + sim->baud - 1) / sim->baud;
+}
+
+static double chip_hashrate(const bm13xx_sim *sim)
+{
+    return sim->config.hashrate_ghs * 1e9 / sim->config.chip_count;
+}
+
+static int64_t next_nonce_delay_us(bm13xx_sim *sim)
+{
+    double nonces_per_s = chip_hashrate(sim) / (sim->ticket_difficulty * HASH_COUNT_UNIT);
+    if (!(nonces_per_s > 0.0)) {
+        return INT64_MAX / 2;
+    }
+
+    // exponential gap between tickets, u in (0, 1]
+    double u = ((double)next_random(sim) + 1.0) / 4294967296.0;
+    return (int64_t)(-log(u) / nonces_per_s * 1e6);
+}
+
+static void schedule_nonces(bm13xx_sim *sim)
+{
+    for (int i = 0; i < sim->config.chip_count; i++) {
+        sim->chips[i].next_nonce_us = sim->job.valid ? sim->now_us + next_nonce_delay_us(sim) : INT64_MAX;
+    }
+}
+
+static void push_frame(bm13xx_sim *sim, uint8_t *frame, bool is_job_response, int64_t emitted_us)
+{
+    // the last byte carries the response type in bit 7 and CRC5 in bits 0-4
+    // pick the CRC5 that makes the residue over the frame zero, as receive_work checks it
+    uint8_t flag = is_job_response ? 0x80 : 0x00;
+    for (uint8_t crc = 0; crc < 32; crc++) {
+        frame[sim->frame_len - 1] = flag | crc;
+        if (crc5(frame + 2, sim->frame_len - 2) == 0) {
+            break;
+        }
+    }
+
+    if (sim->frame_count == BM13XX_SIM_MAX_FRAMES) {
+        sim->stats.frames_dropped++;
+        return;
+    }
+
+    sim_frame *slot = &sim->frames[(sim->frame_head + sim->frame_count) % BM13XX_SIM_MAX_FRAMES];
+    memcpy(slot->data, frame, sim->frame_len);
+    slot->len = sim->frame_len;
+    slot->emitted_us = emitted_us;
+
+    int64_t start_us = sim->out_clock_us > emitted_us ? sim->out_clock_us : emitted_us;
+    sim->out_clock_us = start_us + wire_time_us(sim, sim->frame_len);
+    slot->ready_us = sim->out_clock_us;
+
+    sim->frame_count++;
+}
+
+static uint32_t read_register(const bm13xx_sim *sim, const sim_chip *chip, uint8_t reg)
+{
+    switch (reg) {
+        case REG_CHIP_ID:
+            return ((uint32_t)sim->config.chip_id << 16) | ((uint32_t)sim->config.core_count << 8) | chip->address;
+        case REG_HASHRATE:
+            if (is_bm1397(sim)) {
+                return sim->job.valid ? (uint32_t)(chip_hashrate(sim) / HASHRATE_UNIT) & 0x7FFFFFFF : 0;
+            }
+            break;
+        case REG_ERROR_COUNT:
+            return chip->error_count;
+        case REG_TOTAL_COUNT:
+            if (!is_bm1397(sim)) {
+                return (uint32_t)fmod(chip->hash_counts, 4294967296.0);
+            }
+            break;
+        default:
+            if (!is_bm1397(sim) && reg >= REG_DOMAIN_0_COUNT && reg <= REG_DOMAIN_3_COUNT) {
+                return (uint32_t)fmod(chip->hash_counts / 4, 4294967296.0);
+            }
+            break;
+    }
+    return chip->regs[reg];
+}
+
+static void emit_register(bm13xx_sim *sim, const sim_chip *chip, uint8_t reg)
+{
+    uint8_t frame[FRAME_MAX_LEN] = {0xAA, 0x55};
+    store_be32(frame + 2, read_register(sim, chip, reg));
+    frame[6] = chip->address;
+    frame[7] = reg;
+
+    push_frame(sim, frame, false, sim->now_us);
+    sim->stats.registers_returned++;
+}
+
+static void emit_nonce(bm13xx_sim *sim, sim_chip *chip)
+{
+    const sim_job *job = &sim->job;
+    uint32_t midstate[8];
+    uint16_t version_bits = 0;
+    uint8_t midstate_index = 0;
+
+    if (is_bm1397(sim)) {
+        midstate_index = next_random(sim) % job->num_midstates;
+        memcpy(midstate, job->midstate[midstate_index], sizeof(midstate));
+    } else {
+        uint8_t head[64];
+        memcpy(head, job->head, sizeof(head));
+        version_bits = next_random(sim) & sim->version_roll_mask;
+        uint32_t rolled_version = job->version | ((uint32_t)version_bits << 13);
+        memcpy(head, &rolled_version, 4);
+        memcpy(midstate, SHA256_IV, sizeof(midstate));
+        sha256_block(midstate, head);
+    }
+
+    // the chip address sits in bits 17-24 of the nonce and the core in bits 25-31
+    uint8_t tail[16];
+    memcpy(tail, job->tail, sizeof(tail));
+    uint32_t core = (next_random(sim) % (sim->config.core_count ? sim->config.core_count : 1)) & 0x7F;
+    uint32_t low = next_random(sim) & 0x1FFFF;
+    uint32_t tries = 1u << (sim->config.share_bits + 6 < 24 ? sim->config.share_bits + 6 : 24);
+    bool found = false;
+    uint32_t nonce = 0;
+
+    for (uint32_t i = 0; i < tries; i++) {
+        nonce = (core << 25) | ((uint32_t)chip->address << 17) | low;
+        store_be32(tail + 12, nonce);
+        if (header_meets_target(midstate, tail, sim->config.share_bits)) {
+            found = true;
+            break;
+        }
+        low = (low + 1) & 0x1FFFF;
+        if (low == 0) {
+            core = (core + 1) & 0x7F;
+        }
+    }
+
+    if (!found) {
+        sim->stats.search_misses++;
+        return;
+    }
+
+    uint8_t small_core = next_random(sim) & 0x0F;
+    uint8_t frame[FRAME_MAX_LEN] = {0xAA, 0x55};
+    store_be32(frame + 2, nonce);
+    if (is_bm1397(sim)) {
+        frame[6] = job->num_midstates;
+        frame[7] = job->job_id | midstate_index;
+    } else {
+        frame[6] = 0;
+        if (sim->config.chip_id == 0x1366) {
+            frame[7] = job->job_id | (small_core & 0x07);
+        } else {
+            frame[7] = ((job->job_id << 1) & 0xF0) | small_core;
+        }
+        frame[8] = version_bits >> 8;
+        frame[9] = version_bits & 0xFF;
+    }
+
+    push_frame(sim, frame, true, sim->now_us);
+    sim->stats.nonces_returned++;
+}
+
+// Run the chain forward to t_us, returning every ticket found on the way
+static void advance(bm13xx_sim *sim, int64_t t_us)
+{
+    while (sim->now_us < t_us) {
+        sim_chip *next = NULL;
+        for (int i = 0; i < sim->config.chip_count; i++) {
+            if (next == NULL || sim->chips[i].next_nonce_us < next->next_nonce_us) {
+                next = &sim->chips[i];
+            }
+        }
+
+        int64_t step_us = t_us;
+        if (next != NULL && sim->job.valid && next->next_nonce_us < t_us) {
+            step_us = next->next_nonce_us > sim->now_us ? next->next_nonce_us : sim->now_us;
+        }
+
+        if (sim->job.valid) {
+            double counts = chip_hashrate(sim) * (step_us - sim->now_us) / 1e6 / HASH_COUNT_UNIT;
+            for (int i = 0; i < sim->config.chip_count; i++) {
+                sim->chips[i].hash_counts += counts;
+            }
+        }
+        sim->now_us = step_us;
+
+        if (step_us == t_us) {
+            break;
+        }
+        emit_nonce(sim, next);
+        next->next_nonce_us = sim->now_us + next_nonce_delay_us(sim);
+    }
+}
+
+static void load_job(bm13xx_sim *sim, const uint8_t *data, int data_len)
+{
+    sim_job *job = &sim->job;
+    bool was_valid = job->valid;
+
+    if (is_bm1397(sim)) {
+        // job_id, num_midstates, starting_nonce, nbits, ntime, merkle4, midstates
+        uint8_t num_midstates = data[1];
+        if ((num_midstates != 1 && num_midstates != 4) || data_len != BM1397_JOB_HEADER_LEN + 32 * num_midstates) {
+            ESP_LOGW(TAG, "Malformed BM1397 job (%d bytes, %d midstates)", data_len, num_midstates);
+            return;
+        }
+        job->num_midstates = num_midstates;
+        for (int m = 0; m < num_midstates; m++) {
+            const uint8_t *packed = data + BM1397_JOB_HEADER_LEN + 32 * m;
+            // the driver sends the state words in reverse order
+            for (int i = 0; i < 8; i++) {
+                job->midstate[m][i] = load_le32(packed + (7 - i) * 4);
+            }
+        }
+        memcpy(job->tail, data + 14, 4);
+    } else {
+        // job_id, num_midstates, starting_nonce, nbits, ntime, merkle_root, prev_block_hash, version
+        if (data_len != BM1366_JOB_LEN) {
+            ESP_LOGW(TAG, "Malformed job (%d bytes)", data_len);
+            return;
+        }
+        uint8_t merkle_root[32];
+        reverse_words(data + 14, merkle_root);
+        job->version = load_le32(data + 78);
+        memcpy(job->head, data + 78, 4);
+        reverse_words(data + 46, job->head + 4);
+        memcpy(job->head + 36, merkle_root, 28);
+        memcpy(job->tail, data + 14, 4);
+    }
+
+    job->job_id = data[0];
+    memcpy(job->tail + 4, data + 10, 4); // ntime
+    memcpy(job->tail + 8, data + 6, 4);  // nbits
+    job->valid = true;
+    sim->stats.jobs_received++;
+
+    if (!was_valid) {
+        schedule_nonces(sim);
+    }
+}
+
+static void write_register(bm13xx_sim *sim, sim_chip *chip, uint8_t reg, uint32_t value)
+{
+    chip->regs[reg] = value;
+
+    switch (reg) {
+        case REG_TICKET_MASK:
+            if (sim->config.ticket_difficulty == 0) {
+                // the mask bytes are bit reversed, see get_difficulty_mask
+                uint32_t mask = 0;
+                for (int i = 0; i < 4; i++) {
+                    uint8_t b = (value >> (24 - i * 8)) & 0xFF;
+                    uint8_t reversed = 0;
+                    for (int bit = 0; bit < 8; bit++) {
+                        reversed = (reversed << 1) | ((b >> bit) & 1);
+                    }
+                    mask = (mask << 8) | reversed;
+                }
+                if (sim->ticket_difficulty != (double)mask + 1) {
+                    sim->ticket_difficulty = (double)mask + 1;
+                    schedule_nonces(sim);
+                }
+            }
+            break;
+        case REG_VERSION_MASK:
+            sim->version_roll_mask = value & 0xFFFF;
+            break;
+    }
+}
+
+static void handle_command(bm13xx_sim *sim, uint8_t header, const uint8_t *data, int data_len)
+{
+    bool all = header & GROUP_ALL;
+    sim->stats.commands_received++;
+
+    switch (header & 0x0F) {
+        case CMD_SETADDRESS:
+            // the first chip without an address takes it and stops forwarding
+            for (int i = 0; i < sim->config.chip_count && data_len >= 1; i++) {
+                if (!sim->chips[i].addressed) {
+                    sim->chips[i].address = data[0];
+                    sim->chips[i].addressed = true;
+                    break;
+                }
+            }
+            break;
+        case CMD_INACTIVE:
+            for (int i = 0; i < sim->config.chip_count; i++) {
+                sim->chips[i].addressed = false;
+            }
+            break;
+        case CMD_WRITE:
+            if (data_len < 6) {
+                break;
+            }
+            for (int i = 0; i < sim->config.chip_count; i++) {
+                if (all || sim->chips[i].address == data[0]) {
+                    write_register(sim, &sim->chips[i], data[1], load_be32(data + 2));
+                }
+            }
+            break;
+        case CMD_READ:
+            if (data_len < 2) {
+                break;
+            }
+            // every chip answers in chain order
+            for (int i = 0; i < sim->config.chip_count; i++) {
+                if (all || sim->chips[i].address == data[0]) {
+                    emit_register(sim, &sim->chips[i], data[1]);
+                }
+            }
+            break;
+    }
+}
+
+static void handle_packet(bm13xx_sim *sim, const uint8_t *packet, int len)
+{
+    uint8_t header = packet[2];
+
+    if (header & TYPE_JOB) {
+        uint16_t crc = crc16_false((uint8_t *)packet + 2, len - 4);
+        if (crc != ((packet[len - 2] << 8) | packet[len - 1])) {
+            goto crc_error;
+        }
+        load_job(sim, packet + 4, len - 6);
+    } else {
+        if (crc5((uint8_t *)packet + 2, len - 3) != packet[len - 1]) {
+            goto crc_error;
+        }
+        handle_command(sim, header, packet + 4, len - 5);
+    }
+    return;
+
+crc_error:
+    ESP_LOGW(TAG, "CRC mismatch on %s packet", (header & TYPE_JOB) ? "job" : "command");
+    sim->stats.crc_errors++;
+    for (int i = 0; i < sim->config.chip_count; i++) {
+        sim->chips[i].error_count++;
+    }
+}
+
+// Split the input into packets. start_us is when the first of the new bytes
+// (from index new_from on) arrives, a packet takes effect once its last byte is in.
+static void parse_input(bm13xx_sim *sim, int new_from, int64_t start_us)
+{
+    int pos = 0;
+
+    while (sim->in_len - pos >= 4) {
+        const uint8_t *p = sim->in_buf + pos;
+        if (p[0] != 0x55 || p[1] != 0xAA) {
+            sim->stats.framing_errors++;
+            pos++;
+            continue;
+        }
+
+        // job: length = data + 4, command: length = data + 3, both exclude the preamble
+        int len = p[3] + 2;
+        if (len < PACKET_MIN_LEN || len > PACKET_MAX_LEN) {
+            sim->stats.framing_errors++;
+            pos++;
+            continue;
+        }
+        if (sim->in_len - pos < len) {
+            break;
+        }
+
+        int last = pos + len - 1;
+        int64_t arrival_us = sim->in_clock_us;
+        if (last >= new_from) {
+            arrival_us = start_us + wire_time_us(sim, last - new_from + 1);
+        }
+        advance(sim, arrival_us);
+
+        uint32_t errors_before = sim->stats.crc_errors;
+        handle_packet(sim, p, len);
+        // after a CRC error resync one byte later, the length may be what got corrupted
+        pos += sim->stats.crc_errors != errors_before ? 1 : len;
+    }
+
+    memmove(sim->in_buf, sim->in_buf + pos, sim->in_len - pos);
+    sim->in_len -= pos;
+}
+
+bm13xx_sim *BM13XX_SIM_create(const bm13xx_sim_config *config, int64_t now_us)
+{
+    uint8_t frame_len;
+    switch (config->chip_id) {
+        case 0x1366:
+        case 0x1368:
+        case 0x1370:
+            frame_len = 11;
+            break;
+        case 0x1397:
+            frame_len = 9;
+            break;
+        default:
+            ESP_LOGE(TAG, "Unsupported chip 0x%04x", config->chip_id);
+            return NULL;
+    }
+    if (config->chip_count == 0 || config->chip_count > 256 || config->share_bits > 32) {
+        ESP_LOGE(TAG, "Invalid chain configuration");
+        return NULL;
+    }
+
+    bm13xx_sim *sim = calloc(1, sizeof(bm13xx_sim));
+    if (sim == NULL) {
+        return NULL;
+    }
+    sim->chips = calloc(config->chip_count, sizeof(sim_chip));
+    if (sim->chips == NULL) {
+        free(sim);
+        return NULL;
+    }
+
+    sim->config = *config;
+    sim->frame_len = frame_len;
+    sim->ticket_difficulty = config->ticket_difficulty > 0 ? config->ticket_difficulty : 1;
+    // mix the seed, xorshift starts out with tiny values for small seeds
+    uint32_t seed = (config->seed ? config->seed : 0x13701366) * 0x9E3779B9u;
+    sim->rng = (seed ^ (seed >> 16)) | 1;
+    sim->baud = config->baud ? config->baud : 115200;
+    sim->now_us = now_us;
+    sim->in_clock_us = now_us;
+    sim->out_clock_us = now_us;
+    for (int i = 0; i < config->chip_count; i++) {
+        sim->chips[i].next_nonce_us = INT64_MAX;
+    }
+
+    ESP_LOGI(TAG, "Simulating %d x BM%04x at %.1f GH/s", config->chip_count, config->chip_id, config->hashrate_ghs);
+    return sim;
+}
+
+void BM13XX_SIM_free(bm13xx_sim *sim)
+{
+    if (sim != NULL) {
+        free(sim->chips);
+        free(sim);
+    }
+}
+
+void BM13XX_SIM_write(bm13xx_sim *sim, const uint8_t *data, int len, int64_t now_us)
+{
+    advance(sim, now_us);
+    sim->stats.bytes_in += len;
+
+    while (len > 0) {
+        int chunk = INPUT_BUFFER_LEN - sim->in_len;
+        if (chunk > len) {
+            chunk = len;
+        }
+
+        int64_t start_us = sim->in_clock_us > now_us ? sim->in_clock_us : now_us;
+        int new_from = sim->in_len;
+        memcpy(sim->in_buf + sim->in_len, data, chunk);
+        sim->in_len += chunk;
+        sim->in_clock_us = start_us + wire_time_us(sim, chunk);
+
+        parse_input(sim, new_from, start_us);
+
+        data += chunk;
+        len -= chunk;
+        now_us = sim->in_clock_us;
+    }
+}
+
+int BM13XX_SIM_read(bm13xx_sim *sim, uint8_t *buf, int size, int64_t now_us)
+{
+    advance(sim, now_us);
+
+    int copied = 0;
+    while (copied < size && sim->frame_count > 0) {
+        sim_frame *frame = &sim->frames[sim->frame_head];
+        if (frame->ready_us > now_us) {
+            break;
+        }
+
+        int n = frame->len - sim->frame_pos;
+        if (n > size - copied) {
+            n = size - copied;
+        }
+        memcpy(buf + copied, frame->data + sim->frame_pos, n);
+        copied += n;
+        sim->frame_pos += n;
+
+        if (sim->frame_pos == frame->len) {
+            sim->last_emitted_us = frame->emitted_us;
+            sim->frame_head = (sim->frame_head + 1) % BM13XX_SIM_MAX_FRAMES;
+            sim->frame_count--;
+            sim->frame_pos = 0;
+        }
+    }
+
+    sim->stats.bytes_out += copied;
+    return copied;
+}
+
+int64_t BM13XX_SIM_next_event_us(bm13xx_sim *sim, int64_t now_us)
+{
+    advance(sim, now_us);
+
+    if (sim->frame_count > 0) {
+        return sim->frames[sim->frame_head].ready_us;
+    }
+
+    int64_t next_us = INT64_MAX;
+    if (sim->job.valid) {
+        for (int i = 0; i < sim->config.chip_count; i++) {
+            if (sim->chips[i].next_nonce_us < next_us) {
+                next_us = sim->chips[i].next_nonce_us;
+            }
+        }
+        if (next_us != INT64_MAX) {
+            next_us += wire_time_us(sim, sim->frame_len);
+        }
+    }
+    return next_us;
+}
+
+int64_t BM13XX_SIM_last_frame_emitted_us(const bm13xx_sim *sim)
+{
+    return sim->last_emitted_us;
+}
+
+void BM13XX_SIM_flush(bm13xx_sim *sim, int64_t now_us)
+{
+    advance(sim, now_us);
+
+    while (sim->frame_count > 0 && sim->frames[sim->frame_head].ready_us <= now_us) {
+        sim->frame_head = (sim->frame_head + 1) % BM13XX_SIM_MAX_FRAMES;
+        sim->frame_count--;
+    }
+    sim->frame_pos = 0;
+}
+
+void BM13XX_SIM_set_baud(bm13xx_sim *sim, uint32_t baud, int64_t now_us)
+{
+    advance(sim, now_us);
+    if (baud > 0) {
+        sim->baud = baud;
+    }
+}
+
+void BM13XX_SIM_get_stats(const bm13xx_sim *sim, bm13xx_sim_stats *stats)
+{
+    *stats = sim->stats;
+}
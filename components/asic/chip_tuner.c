@@ -0,0 +1,108 @@
+#include <math.h>
+#include <string.h>
+
+#include "chip_tuner.h"
+
+#define EPSILON 0.0001f
+
+void chip_tuner_init(chip_tuner *tuner, int chip_count, float base_frequency, const float *frequencies, int frequency_count)
+{
+    memset(tuner, 0, sizeof(chip_tuner));
+    tuner->base_frequency = base_frequency;
+    tuner->chip_count = chip_count < CHIP_TUNER_MAX_CHIPS ? chip_count : CHIP_TUNER_MAX_CHIPS;
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        tuner->chips[i].frequency = base_frequency;
+    }
+
+    if (frequencies != NULL && frequency_count > 0) {
+        tuner->frequency_count = frequency_count < CHIP_TUNER_MAX_FREQUENCIES ? frequency_count : CHIP_TUNER_MAX_FREQUENCIES;
+        memcpy(tuner->frequencies, frequencies, tuner->frequency_count * sizeof(float));
+    }
+}
+
+// One step up (direction 1) or down (-1) from frequency: on the grid, or the
+// nearest PLL frequency at least a step away. Returns frequency if there is none.
+static float step_frequency(const chip_tuner *tuner, float frequency, int direction)
+{
+    if (tuner->frequency_count == 0) {
+        return frequency + direction * CHIP_TUNER_STEP;
+    }
+
+    if (direction > 0) {
+        for (int i = 0; i < tuner->frequency_count; i++) {
+            if (tuner->frequencies[i] >= frequency + CHIP_TUNER_STEP - EPSILON) {
+                return tuner->frequencies[i];
+            }
+        }
+    } else {
+        for (int i = tuner->frequency_count - 1; i >= 0; i--) {
+            if (tuner->frequencies[i] <= frequency - CHIP_TUNER_STEP + EPSILON) {
+                return tuner->frequencies[i];
+            }
+        }
+    }
+    return frequency;
+}
+
+uint32_t chip_tuner_update(chip_tuner *tuner, const float *error_percentages)
+{
+    float min_frequency = tuner->base_frequency - CHIP_TUNER_MIN_OFFSET;
+    float max_frequency = tuner->base_frequency + CHIP_TUNER_MAX_OFFSET;
+    uint32_t changed = 0;
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        chip_tuner_chip *chip = &tuner->chips[i];
+        float frequency = chip->frequency;
+
+        if (isnan(error_percentages[i])) {
+            continue;
+        }
+
+        if (error_percentages[i] > CHIP_TUNER_ERROR_HIGH) {
+            if (chip->ceiling == 0 || frequency < chip->ceiling) {
+                chip->ceiling = frequency;
+            }
+            frequency = fmaxf(step_frequency(tuner, frequency, -1), min_frequency);
+        } else if (error_percentages[i] < CHIP_TUNER_ERROR_LOW) {
+            float next = step_frequency(tuner, frequency, 1);
+            if (next > frequency + EPSILON && next <= max_frequency + EPSILON && (chip->ceiling == 0 || next < chip->ceiling - EPSILON)) {
+                frequency = next;
+            }
+        }
+
+        if (fabsf(frequency - chip->frequency) > EPSILON) {
+            chip->frequency = frequency;
+            changed |= 1u << i;
+        }
+    }
+
+    return changed;
+}
+
+uint32_t chip_tuner_step_to_base(chip_tuner *tuner)
+{
+    uint32_t changed = 0;
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        chip_tuner_chip *chip = &tuner->chips[i];
+        float diff = tuner->base_frequency - chip->frequency;
+
+        if (fabsf(diff) <= EPSILON) {
+            continue;
+        }
+
+        // a step that would reach or pass the base frequency, or finds no
+        // frequency to go to, ends at the base frequency
+        float step = fabsf(step_frequency(tuner, chip->frequency, diff > 0 ? 1 : -1) - chip->frequency);
+        if (step <= EPSILON || step >= fabsf(diff) - EPSILON) {
+            chip->frequency = tuner->base_frequency;
+        } else {
+            chip->frequency += diff > 0 ? step : -step;
+        }
+        chip->ceiling = 0;
+        changed |= 1u << i;
+    }
+
+    return changed;
+}
@@ -10,45 +10,134 @@
 
 static const char * TAG = "frequency_transition";
 
+// Ramp in progress, stepped by frequency_ramp_tick
+static struct
+{
+    set_hash_frequency_fn set_frequency_fn;
+    float start_frequency;
+    float target_frequency;
+    bool active;
+} ramp;
+
+// Next frequency on the way to the target: the first step lands on the
+// STEP_SIZE grid, the last one on the target itself
+static float next_step(float current_frequency, float target_frequency)
+{
+    if (fabs(target_frequency - current_frequency) < STEP_SIZE) {
+        return target_frequency;
+    }
+
+    if (target_frequency > current_frequency) {
+        float next = (floor(current_frequency / STEP_SIZE) + 1) * STEP_SIZE;
+        return next > target_frequency ? target_frequency : next;
+    }
+
+    float next = (ceil(current_frequency / STEP_SIZE) - 1) * STEP_SIZE;
+    return next < target_frequency ? target_frequency : next;
+}
+
 void do_frequency_transition(void * pvParameters, set_hash_frequency_fn set_frequency_fn)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
     float target_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
     float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
 
+    // a blocking transition takes over from any ramp in progress
+    ramp.active = false;
+
     if (fabs(current_frequency - target_frequency) < EPSILON) {
         return;
     }
 
-    if (fabs(target_frequency - current_frequency) < STEP_SIZE) {
-        current_frequency = target_frequency;
+    bool stepped = fabs(target_frequency - current_frequency) >= STEP_SIZE;
+    if (stepped) {
+        ESP_LOGI(TAG, "Ramping up frequency from %g MHz to %g MHz", current_frequency, target_frequency);
+    }
+
+    while (fabs(current_frequency - target_frequency) > EPSILON) {
+        current_frequency = next_step(current_frequency, target_frequency);
         GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
-        return;
+
+        if (fabs(current_frequency - target_frequency) > EPSILON) {
+            vTaskDelay(100 / portTICK_PERIOD_MS);
+        }
     }
 
-    ESP_LOGI(TAG, "Ramping up frequency from %g MHz to %g MHz", current_frequency, target_frequency);
+    if (stepped) {
+        ESP_LOGI(TAG, "Successfully transitioned to %g MHz", target_frequency);
+    }
+}
 
-    int current_step = (target_frequency > current_frequency) ? (int)floor(current_frequency / STEP_SIZE) : (int)ceil(current_frequency / STEP_SIZE);
-    int target_step = (target_frequency > current_frequency) ? (int)floor(target_frequency / STEP_SIZE) : (int)ceil(target_frequency / STEP_SIZE);
+void frequency_ramp_start(void * pvParameters, set_hash_frequency_fn set_frequency_fn)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
+    float target_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+    float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
 
-    if (current_step != target_step) {
-        int signum = (target_frequency > current_frequency) ? 1 : -1;
-        
-        while ((signum > 0 && current_step < target_step) ||
-               (signum < 0 && current_step > target_step)) {
-            current_step += signum;
+    if (!ramp.active) {
+        ramp.start_frequency = current_frequency;
+    }
+    ramp.set_frequency_fn = set_frequency_fn;
+    ramp.target_frequency = target_frequency;
+    ramp.active = fabs(current_frequency - target_frequency) > EPSILON;
 
-            current_frequency = current_step * STEP_SIZE;
-            GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
-            
-            vTaskDelay(100 / portTICK_PERIOD_MS);
-        }
+    if (ramp.active) {
+        ESP_LOGI(TAG, "Ramping frequency from %g MHz to %g MHz", current_frequency, target_frequency);
     }
-    
-    if (fabs(current_frequency - target_frequency) > EPSILON) {
-        current_frequency = target_frequency;
-        GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = set_frequency_fn(current_frequency);
+}
+
+bool frequency_ramp_tick(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    if (!ramp.active) {
+        return false;
+    }
+
+    float current_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    float next_frequency = next_step(current_frequency, ramp.target_frequency);
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency = ramp.set_frequency_fn(next_frequency);
+
+    if (fabs(next_frequency - ramp.target_frequency) > EPSILON) {
+        return false;
     }
-    
-    ESP_LOGI(TAG, "Successfully transitioned to %g MHz", target_frequency);
+
+    ramp.active = false;
+    ESP_LOGI(TAG, "Successfully transitioned to %g MHz", ramp.target_frequency);
+    return true;
+}
+
+bool frequency_ramp_is_active(void)
+{
+    return ramp.active;
+}
+
+bool frequency_ramp_is_rising(void)
+{
+    return ramp.active && ramp.target_frequency > ramp.start_frequency;
+}
+
+float frequency_ramp_reverse(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    if (!ramp.active) {
+        return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency;
+    }
+
+    ESP_LOGW(TAG, "Reversing frequency ramp at %g MHz, back to %g MHz",
+             GLOBAL_STATE->POWER_MANAGEMENT_MODULE.actual_frequency, ramp.start_frequency);
+
+    // the frequency we came from becomes the target, the one we were heading
+    // to is where a new ramp would start
+    float start_frequency = ramp.start_frequency;
+    ramp.start_frequency = ramp.target_frequency;
+    ramp.target_frequency = start_frequency;
+    GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value = start_frequency;
+    return start_frequency;
+}
+
+void frequency_ramp_cancel(void)
+{
+    ramp.active = false;
 }
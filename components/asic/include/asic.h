@@ -8,11 +8,19 @@
 uint8_t ASIC_init(GlobalState * GLOBAL_STATE);
 task_result * ASIC_process_work(GlobalState * GLOBAL_STATE);
 int ASIC_set_max_baud(GlobalState * GLOBAL_STATE);
-void ASIC_send_work(GlobalState * GLOBAL_STATE, void * next_job);
+bool ASIC_prepare_work(GlobalState * GLOBAL_STATE, asic_job_packet * packet);
+void ASIC_send_job_packet(GlobalState * GLOBAL_STATE, asic_job_packet * packet);
 void ASIC_set_version_mask(GlobalState * GLOBAL_STATE, uint32_t mask);
+void ASIC_set_ticket_difficulty(GlobalState * GLOBAL_STATE, double difficulty);
+double ASIC_get_ticket_difficulty(GlobalState * GLOBAL_STATE);
 void ASIC_set_frequency(GlobalState * GLOBAL_STATE);
+size_t ASIC_get_frequencies(GlobalState * GLOBAL_STATE, float min_freq, float max_freq, float * frequencies, size_t max_count);
+float ASIC_set_chip_frequency(GlobalState * GLOBAL_STATE, uint8_t asic_nr, float frequency);
+void ASIC_start_frequency_ramp(GlobalState * GLOBAL_STATE);
+bool ASIC_frequency_ramp_tick(GlobalState * GLOBAL_STATE);
 void ASIC_set_nonce_space(GlobalState * GLOBAL_STATE);
 double ASIC_get_asic_job_frequency_ms(GlobalState * GLOBAL_STATE);
-void ASIC_read_registers(GlobalState * GLOBAL_STATE);
+float ASIC_get_work_starvation(GlobalState * GLOBAL_STATE);
+uint32_t ASIC_read_registers(GlobalState * GLOBAL_STATE, uint32_t register_mask);
 
 #endif // ASIC_H
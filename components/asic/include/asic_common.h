@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "mining.h"
 
 static const double NONCE_SPACE = 4294967296.0; //  2^32
 
@@ -20,12 +21,20 @@ typedef enum
     REGISTER_PLL_PARAM,      // PLL/clock config readback (BM1370)
 } register_type_t;
 
+#define REGISTER_BIT(type) (1u << (type))
+
+// Registers read in one burst, a driver maps at most this many
+#define REGISTER_READ_BURST_MAX 8
+
 typedef struct
 {
     // -- job result response
     uint8_t job_id;
     uint32_t nonce;
-    uint32_t rolled_version;
+    // the rolled version is rebuilt from the job: version | version_bits,
+    // then rolled midstate_index times within the version mask
+    uint32_t version_bits;
+    uint8_t midstate_index;
     // ---- register response
     register_type_t register_type;
     uint8_t asic_nr;
@@ -36,14 +45,47 @@ typedef struct
     uint64_t timestamp_us;
 } task_result;
 
+// Largest job is a BM1397 job with 4 midstates (152 bytes on the wire)
+#define ASIC_JOB_PACKET_MAX 160
+
+// Fully serialized job packet (preamble, header, length, job, CRC16), ready for SERIAL_send
+typedef struct
+{
+    uint8_t buf[ASIC_JOB_PACKET_MAX];
+    uint8_t len;
+    uint8_t job_id;
+    bool debug;
+    bm_job job;
+    bm_job_midstates midstates; // only filled for ASICs whose job format asks for them
+} asic_job_packet;
+
+// Chips tracked by the receive statistics, longer chains are counted in the last entry
+#define ASIC_RX_MAX_CHIPS 16
+
+// Response stream statistics of one chip, kept by receive_work
+typedef struct
+{
+    uint32_t frames;     // responses that passed the CRC5 check
+    uint32_t crc_errors; // responses claiming to be from this chip that failed the CRC5 check
+    uint32_t resyncs;    // times bytes had to be skipped to find this chip's next response
+} asic_rx_stats;
+
 unsigned char _reverse_bits(unsigned char num);
 int _largest_power_of_two(int num);
 int _next_power_of_two(int num);
 void clear_asic_chain_error(void);
 const char *get_asic_chain_error(void);
 int count_asic_chips(uint16_t asic_count, uint16_t chip_id, int chip_id_response_length);
+void build_job_packet(asic_job_packet *packet, uint8_t header, const uint8_t *data, uint8_t data_len, bool debug);
+uint32_t send_register_reads(uint8_t header, const register_type_t *register_map, int map_size, uint32_t register_mask, bool debug);
 esp_err_t receive_work(uint8_t * buffer, int buffer_size, uint64_t *out_timestamp_us);
+void get_asic_rx_stats(int asic_nr, asic_rx_stats *stats);
+uint32_t get_asic_rx_skipped_bytes(void);
 void get_difficulty_mask(double difficulty, uint8_t *job_difficulty_mask);
+// Difficulty the chips enforce once get_difficulty_mask(difficulty) is written
+double get_ticket_difficulty(double difficulty);
+uint32_t get_result_rolled_version(const bm_job *job, const task_result *result);
 double calculate_bm_timeout_ms(float frequency_mhz, size_t asic_count, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms);
+double calculate_bm_hcn_timeout_ms(uint32_t hcn, size_t small_cores, size_t cores, size_t version_size, float timeout_percent, double default_time_ms);
 
 #endif /* ASIC_COMMON_H_ */
@@ -22,13 +22,16 @@ typedef struct __attribute__((__packed__))
 } BM1368_job;
 
 uint8_t BM1368_init(void * GLOBAL_STATE);
-void BM1368_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
+void BM1368_prepare_work(asic_job_packet * packet);
 void BM1368_set_version_mask(uint32_t version_mask);
+void BM1368_set_ticket_difficulty(double difficulty);
 int BM1368_set_max_baud(void);
 int BM1368_set_default_baud(void);
 float BM1368_send_hash_frequency(float frequency);
+float BM1368_send_chip_hash_frequency(uint8_t asic_nr, float frequency);
+size_t BM1368_get_frequencies(float min_freq, float max_freq, float * frequencies, size_t max_count);
 task_result * BM1368_process_work(void * GLOBAL_STATE);
-void BM1368_read_registers(void);
-void BM1368_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
+uint32_t BM1368_read_registers(uint32_t register_mask);
+uint32_t BM1368_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
 
 #endif /* BM1368_H_ */
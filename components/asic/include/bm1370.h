@@ -22,13 +22,16 @@ typedef struct __attribute__((__packed__))
 } BM1370_job;
 
 uint8_t BM1370_init(void * GLOBAL_STATE);
-void BM1370_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
+void BM1370_prepare_work(asic_job_packet * packet);
 void BM1370_set_version_mask(uint32_t version_mask);
+void BM1370_set_ticket_difficulty(double difficulty);
 int BM1370_set_max_baud(void);
 int BM1370_set_default_baud(void);
 float BM1370_send_hash_frequency(float frequency);
+float BM1370_send_chip_hash_frequency(uint8_t asic_nr, float frequency);
+size_t BM1370_get_frequencies(float min_freq, float max_freq, float * frequencies, size_t max_count);
 task_result * BM1370_process_work(void * GLOBAL_STATE);
-void BM1370_read_registers(void);
-void BM1370_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
+uint32_t BM1370_read_registers(uint32_t register_mask);
+uint32_t BM1370_set_nonce_space(double nonce_percent, float frequency, uint16_t asic_count, uint16_t cores);
 
 #endif /* BM1370_H_ */
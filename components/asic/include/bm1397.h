@@ -24,12 +24,15 @@ typedef struct __attribute__((__packed__))
 } job_packet;
 
 uint8_t BM1397_init(void * GLOBAL_STATE);
-void BM1397_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
+void BM1397_prepare_work(asic_job_packet * packet);
 void BM1397_set_version_mask(uint32_t version_mask);
+void BM1397_set_ticket_difficulty(double difficulty);
 int BM1397_set_max_baud(void);
 int BM1397_set_default_baud(void);
 float BM1397_send_hash_frequency(float frequency);
+float BM1397_send_chip_hash_frequency(uint8_t asic_nr, float frequency);
+size_t BM1397_get_frequencies(float min_freq, float max_freq, float * frequencies, size_t max_count);
 task_result * BM1397_process_work(void * GLOBAL_STATE);
-void BM1397_read_registers(void);
+uint32_t BM1397_read_registers(uint32_t register_mask);
 
 #endif /* BM1397_H_ */
@@ -0,0 +1,74 @@
+#ifndef BM13XX_SIM_H_
+#define BM13XX_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Software model of a chain of BM1366/BM1368/BM1370/BM1397 chips as seen from
+// the UART. It parses the job and command packets the drivers send (checking
+// CRC16/CRC5), answers register reads the way the chips do, including the
+// chip ID enumeration, and returns nonces at the configured hashrate and
+// ticket difficulty.
+//
+// Time is passed in by the caller, so the model runs the same against the
+// wall clock (serial_sim.c) or a virtual clock (host benchmarks). Both UART
+// directions are modelled at the configured baud rate.
+//
+// Returned nonces are real: each one hashes (double SHA-256 of the header,
+// rebuilt from the job packet or resumed from its midstate) below a target
+// with share_bits leading zero bits. The ticket difficulty only sets how
+// often they arrive, brute forcing a real ticket is out of reach in software.
+
+#define BM13XX_SIM_MAX_FRAMES 256
+
+typedef struct
+{
+    uint16_t chip_id;          // 0x1366, 0x1368, 0x1370 or 0x1397
+    uint16_t chip_count;
+    uint8_t core_count;        // reported in the chip ID response
+    double hashrate_ghs;       // whole chain
+    double ticket_difficulty;  // 0 to follow the TICKET_MASK register
+    uint8_t share_bits;        // leading zero bits of every returned hash
+    uint32_t baud;             // initial baud rate of both directions
+    uint32_t seed;
+} bm13xx_sim_config;
+
+typedef struct
+{
+    uint32_t jobs_received;
+    uint32_t commands_received;
+    uint32_t crc_errors;       // packets dropped because of a CRC mismatch
+    uint32_t framing_errors;   // bytes skipped while looking for a preamble
+    uint32_t nonces_returned;
+    uint32_t registers_returned;
+    uint32_t frames_dropped;   // response FIFO overruns
+    uint32_t search_misses;    // nonce searches that did not reach share_bits
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} bm13xx_sim_stats;
+
+typedef struct bm13xx_sim bm13xx_sim;
+
+bm13xx_sim *BM13XX_SIM_create(const bm13xx_sim_config *config, int64_t now_us);
+void BM13XX_SIM_free(bm13xx_sim *sim);
+
+// Host to chain: queue bytes that start arriving at now_us
+void BM13XX_SIM_write(bm13xx_sim *sim, const uint8_t *data, int len, int64_t now_us);
+
+// Chain to host: copy up to size bytes that have fully arrived by now_us
+int BM13XX_SIM_read(bm13xx_sim *sim, uint8_t *buf, int size, int64_t now_us);
+
+// Earliest time at which more bytes can be read, INT64_MAX if nothing is pending
+int64_t BM13XX_SIM_next_event_us(bm13xx_sim *sim, int64_t now_us);
+
+// Time at which the chip emitted the last frame handed out by BM13XX_SIM_read
+int64_t BM13XX_SIM_last_frame_emitted_us(const bm13xx_sim *sim);
+
+// Drop everything that has already arrived, like a UART flush
+void BM13XX_SIM_flush(bm13xx_sim *sim, int64_t now_us);
+
+void BM13XX_SIM_set_baud(bm13xx_sim *sim, uint32_t baud, int64_t now_us);
+
+void BM13XX_SIM_get_stats(const bm13xx_sim *sim, bm13xx_sim_stats *stats);
+
+#endif /* BM13XX_SIM_H_ */
@@ -0,0 +1,51 @@
+#ifndef CHIP_TUNER_H_
+#define CHIP_TUNER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Per-chip frequency search under the shared core voltage. Every chip starts
+// at the chain frequency and moves one step per tuning window: down while its
+// error rate is high, up while it is low. The lowest frequency a chip showed
+// errors at becomes its ceiling, so each chip settles one step below it.
+// With the list of frequencies the PLL reaches, a step goes to the nearest
+// of them at least CHIP_TUNER_STEP away, so the tuner works with the
+// frequency the chip actually runs at.
+#define CHIP_TUNER_MAX_CHIPS 16
+#define CHIP_TUNER_MAX_FREQUENCIES 256 // PLL points between the offsets, ~200 at 300 MHz
+#define CHIP_TUNER_STEP 6.25           // MHz, the ramp grid
+#define CHIP_TUNER_MAX_OFFSET 25.0     // MHz above the chain frequency, inside the job interval margin
+#define CHIP_TUNER_MIN_OFFSET 50.0     // MHz below the chain frequency
+#define CHIP_TUNER_ERROR_HIGH 2.0      // % error rate that sends a chip down
+#define CHIP_TUNER_ERROR_LOW 0.5       // % error rate that lets a chip go up
+
+typedef struct
+{
+    float frequency;
+    float ceiling; // lowest frequency with a high error rate, 0 if none yet
+} chip_tuner_chip;
+
+typedef struct
+{
+    float base_frequency; // the chain frequency the chips are tuned around
+    int chip_count;
+    chip_tuner_chip chips[CHIP_TUNER_MAX_CHIPS];
+    // ascending, between the offsets around base_frequency; without any the
+    // tuner steps on the CHIP_TUNER_STEP grid
+    float frequencies[CHIP_TUNER_MAX_FREQUENCIES];
+    int frequency_count;
+} chip_tuner;
+
+// frequencies (may be NULL) are the ones the PLL reaches between
+// base_frequency - CHIP_TUNER_MIN_OFFSET and base_frequency + CHIP_TUNER_MAX_OFFSET
+void chip_tuner_init(chip_tuner *tuner, int chip_count, float base_frequency, const float *frequencies, int frequency_count);
+
+// Feed the error rate (%) of each chip over the last window, NAN for a chip
+// without data, returns a bit per chip whose frequency changed
+uint32_t chip_tuner_update(chip_tuner *tuner, const float *error_percentages);
+
+// Move every chip one step back towards the chain frequency, returns a bit per
+// chip whose frequency changed, 0 once all chips are there
+uint32_t chip_tuner_step_to_base(chip_tuner *tuner);
+
+#endif /* CHIP_TUNER_H_ */
@@ -26,4 +26,47 @@ typedef float (*set_hash_frequency_fn)(float frequency);
  */
 void do_frequency_transition(void * pvParameters, set_hash_frequency_fn set_frequency_fn);
 
+/**
+ * @brief Start a non-blocking ramp towards the requested frequency
+ * 
+ * The ramp starts from the actual frequency and takes one step per call to
+ * frequency_ramp_tick, so the caller keeps running between steps. Starting
+ * while a ramp is in progress retargets it.
+ * 
+ * @param pvParameters Pointer to the GlobalState structure
+ * @param set_frequency_fn Function pointer to the appropriate ASIC's set_hash_frequency function
+ */
+void frequency_ramp_start(void * pvParameters, set_hash_frequency_fn set_frequency_fn);
+
+/**
+ * @brief Take the next step of the ramp in progress
+ * 
+ * @param pvParameters Pointer to the GlobalState structure
+ * @return true when this step reached the target frequency
+ */
+bool frequency_ramp_tick(void * pvParameters);
+
+/**
+ * @brief Check whether a ramp is in progress
+ */
+bool frequency_ramp_is_active(void);
+
+/**
+ * @brief Check whether a ramp towards a higher frequency is in progress
+ */
+bool frequency_ramp_is_rising(void);
+
+/**
+ * @brief Turn the ramp in progress back to the frequency it started from
+ * 
+ * @param pvParameters Pointer to the GlobalState structure
+ * @return The new target frequency in MHz
+ */
+float frequency_ramp_reverse(void * pvParameters);
+
+/**
+ * @brief Stop the ramp in progress at the frequency reached so far
+ */
+void frequency_ramp_cancel(void);
+
 #endif // FREQUENCY_TRANSITION_H
@@ -0,0 +1,67 @@
+#ifndef JOB_SLOTS_H_
+#define JOB_SLOTS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mining.h"
+
+// The job id sent to the chips is 7 bits and its low bits come back holding
+// the midstate or small core, so every driver steps the id by a multiple of 4.
+// Ids wrap after a few jobs while nonces of the job that last held an id can
+// still sit in the UART FIFO. Each slot therefore keeps the job it held
+// before, and every job is tagged with the notify epoch it was built in so
+// results for jobs superseded by clean_jobs are told apart from garbage.
+#define JOB_SLOTS_ID_ALIGN 4
+#define JOB_SLOTS_COUNT (128 / JOB_SLOTS_ID_ALIGN)
+
+typedef enum
+{
+    JOB_SLOT_EMPTY = 0, // the id has no job, the result is invalid
+    JOB_SLOT_LIVE,      // the job belongs to the current notify epoch
+    JOB_SLOT_STALE,     // the job was built before the last clean_jobs
+} job_slot_state;
+
+typedef struct
+{
+    bm_job job;
+    uint32_t generation; // how many jobs the id had carried when it got this one
+    uint32_t epoch;
+    uint8_t pool; // 0 primary, 1 fallback
+    bool valid;
+} job_slot_entry;
+
+typedef struct
+{
+    uint32_t generation;
+    job_slot_entry current;
+    job_slot_entry previous;
+} job_slot;
+
+typedef struct
+{
+    job_slot slots[JOB_SLOTS_COUNT];
+    uint32_t epoch;
+    uint8_t next_id;
+} job_slots;
+
+void job_slots_init(job_slots *slots);
+
+// Id for the next job, id_step is the distance between two job ids of the driver
+uint8_t job_slots_next_id(job_slots *slots, uint8_t id_step);
+
+// Give a job id to a new job, the job it held so far moves to the previous entry
+void job_slots_assign(job_slots *slots, uint8_t job_id, const bm_job *job, uint8_t pool);
+
+// Start a new notify epoch, every job handed out so far becomes stale
+void job_slots_clean(job_slots *slots);
+
+// A notify arrived. With clean_jobs the jobs handed out so far are stale,
+// even when none of its predecessors were still waiting in the queue.
+void job_slots_notify(job_slots *slots, bool clean_jobs);
+
+// Copy the current (or previous) job of an id with its pool and generation,
+// returns JOB_SLOT_EMPTY without touching the outputs
+job_slot_state job_slots_lookup(const job_slots *slots, uint8_t job_id, bool previous, bm_job *job, uint8_t *pool, uint32_t *generation);
+
+#endif /* JOB_SLOTS_H_ */
@@ -0,0 +1,41 @@
+#ifndef NONCE_FILTER_H_
+#define NONCE_FILTER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Results remembered per job id. A job rarely returns more than a handful of
+// nonces before it is replaced; once a slot is full further results are let
+// through unchecked.
+#define NONCE_FILTER_SLOT_BITS 4
+#define NONCE_FILTER_SLOT_SIZE (1 << NONCE_FILTER_SLOT_BITS)
+#define NONCE_FILTER_JOBS 128
+
+typedef struct
+{
+    uint32_t nonce;
+    uint32_t rolled_version;
+} nonce_filter_entry;
+
+// Open addressing set of the results returned for one job id
+typedef struct
+{
+    uint16_t used; // bit per occupied entry
+    nonce_filter_entry entries[NONCE_FILTER_SLOT_SIZE];
+} nonce_filter_slot;
+
+typedef struct
+{
+    nonce_filter_slot slots[NONCE_FILTER_JOBS];
+    uint32_t overflows; // results let through because their slot was full
+} nonce_filter;
+
+void nonce_filter_init(nonce_filter *filter);
+
+// Forget the results of a job id, called when the id is given to a new job
+void nonce_filter_clear_job(nonce_filter *filter, uint8_t job_id);
+
+// Record a result, returns false if the same nonce and version already came back for this job
+bool nonce_filter_insert(nonce_filter *filter, uint8_t job_id, uint32_t nonce, uint32_t rolled_version);
+
+#endif /* NONCE_FILTER_H_ */
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define FREQ_MULT 25.0 // MHz
 
@@ -10,4 +11,9 @@ void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_
                         uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
                         float *actual_freq);
 
+// Copy the frequencies the PLL reaches between min_freq and max_freq in
+// ascending order, returns how many were written
+size_t pll_get_frequencies(uint16_t fb_divider_min, uint16_t fb_divider_max, float min_freq, float max_freq,
+                           float *frequencies, size_t max_count);
+
 #endif /* PLL_H_ */
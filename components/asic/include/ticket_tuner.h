@@ -0,0 +1,22 @@
+#ifndef TICKET_TUNER_H_
+#define TICKET_TUNER_H_
+
+#include <stdint.h>
+
+// The TICKET_MASK sets how many nonces the chips return: each one stands for
+// ticket difficulty * 2^32 hashes. A low difficulty floods the result path at
+// high hashrates, a high one leaves too few nonces for a steady estimate, so
+// the difficulty is tuned to hold a nonce rate. It only moves in powers of 2,
+// the steps of the mask, and only once the rate is well off target.
+#define TICKET_TUNER_TARGET_RATE 1.0   // nonces per second for the chain
+#define TICKET_TUNER_WINDOW_S 30
+#define TICKET_TUNER_MIN_DIFFICULTY 32
+#define TICKET_TUNER_HYSTERESIS 0.75   // log2 distance from the current difficulty before moving
+
+// Ticket difficulty for the next window from the nonces counted in the last
+// one, kept between TICKET_TUNER_MIN_DIFFICULTY and max_difficulty (the pool
+// difficulty, any share below the ticket would otherwise be lost). A pool
+// difficulty under the minimum caps the ticket below the minimum.
+double ticket_tuner_next_difficulty(double difficulty, uint32_t nonces, double seconds, double max_difficulty);
+
+#endif /* TICKET_TUNER_H_ */
@@ -0,0 +1,53 @@
+#include <string.h>
+
+#include "job_slots.h"
+
+void job_slots_init(job_slots *slots)
+{
+    memset(slots, 0, sizeof(job_slots));
+}
+
+uint8_t job_slots_next_id(job_slots *slots, uint8_t id_step)
+{
+    slots->next_id = (slots->next_id + id_step) % 128;
+    return slots->next_id;
+}
+
+void job_slots_assign(job_slots *slots, uint8_t job_id, const bm_job *job, uint8_t pool)
+{
+    job_slot *slot = &slots->slots[(job_id / JOB_SLOTS_ID_ALIGN) % JOB_SLOTS_COUNT];
+
+    slot->previous = slot->current;
+    slot->current.job = *job;
+    slot->current.generation = ++slot->generation;
+    slot->current.epoch = slots->epoch;
+    slot->current.pool = pool;
+    slot->current.valid = true;
+}
+
+void job_slots_clean(job_slots *slots)
+{
+    slots->epoch++;
+}
+
+void job_slots_notify(job_slots *slots, bool clean_jobs)
+{
+    if (clean_jobs) {
+        job_slots_clean(slots);
+    }
+}
+
+job_slot_state job_slots_lookup(const job_slots *slots, uint8_t job_id, bool previous, bm_job *job, uint8_t *pool, uint32_t *generation)
+{
+    const job_slot *slot = &slots->slots[(job_id / JOB_SLOTS_ID_ALIGN) % JOB_SLOTS_COUNT];
+    const job_slot_entry *entry = previous ? &slot->previous : &slot->current;
+
+    if (!entry->valid) {
+        return JOB_SLOT_EMPTY;
+    }
+
+    *job = entry->job;
+    *pool = entry->pool;
+    *generation = entry->generation;
+    return entry->epoch == slots->epoch ? JOB_SLOT_LIVE : JOB_SLOT_STALE;
+}
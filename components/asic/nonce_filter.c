@@ -0,0 +1,41 @@
+#include <string.h>
+
+#include "nonce_filter.h"
+
+void nonce_filter_init(nonce_filter *filter)
+{
+    memset(filter, 0, sizeof(nonce_filter));
+}
+
+void nonce_filter_clear_job(nonce_filter *filter, uint8_t job_id)
+{
+    filter->slots[job_id % NONCE_FILTER_JOBS].used = 0;
+}
+
+bool nonce_filter_insert(nonce_filter *filter, uint8_t job_id, uint32_t nonce, uint32_t rolled_version)
+{
+    nonce_filter_slot *slot = &filter->slots[job_id % NONCE_FILTER_JOBS];
+
+    // Fibonacci hash of the key, the top bits pick the first entry to probe
+    uint32_t index = ((nonce ^ rolled_version) * 0x9E3779B1u) >> (32 - NONCE_FILTER_SLOT_BITS);
+
+    for (int i = 0; i < NONCE_FILTER_SLOT_SIZE; i++) {
+        nonce_filter_entry *entry = &slot->entries[index];
+
+        if (!(slot->used & (1u << index))) {
+            entry->nonce = nonce;
+            entry->rolled_version = rolled_version;
+            slot->used |= 1u << index;
+            return true;
+        }
+
+        if (entry->nonce == nonce && entry->rolled_version == rolled_version) {
+            return false;
+        }
+
+        index = (index + 1) % NONCE_FILTER_SLOT_SIZE;
+    }
+
+    filter->overflows++;
+    return true;
+}
@@ -1,6 +1,7 @@
 #include <stdbool.h>
-#include <float.h>
+#include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "pll.h"
 
@@ -8,54 +9,196 @@
 
 #define EPSILON 0.0001f
 
+#define REFDIV_MAX 2
+#define POSTDIV_MAX 7
+
 static const char * TAG = "pll";
 
+// A divider tuple packed in two bytes, the frequency is derived from it
+typedef struct
+{
+    uint8_t fb_divider;
+    uint8_t refdiv : 2;
+    uint8_t postdiv1 : 3;
+    uint8_t postdiv2 : 3;
+} pll_entry;
+
+// Every frequency the PLL reaches with the feedback divider bounds of the
+// chip, sorted, with the preferred tuple for each. Built on first use, the
+// chips of a board share one family so there is a single table. The power
+// management task, the HTTP server and the self-test all set frequencies,
+// table_lock covers the build and every lookup.
+static pthread_mutex_t table_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct
+{
+    uint16_t fb_divider_min;
+    uint16_t fb_divider_max;
+    pll_entry * entries;
+    size_t count;
+} table;
+
+static float entry_freq(const pll_entry * entry)
+{
+    return FREQ_MULT * entry->fb_divider / (entry->refdiv * entry->postdiv1 * entry->postdiv2);
+}
+
+static float entry_vco_freq(const pll_entry * entry)
+{
+    return FREQ_MULT * entry->fb_divider / entry->refdiv;
+}
+
+// Preference between tuples at (nearly) the same distance from the target:
+// 1. Lowest VCO frequency
+// 2. Lowest postdiv1 * postdiv2
+// 3. Highest refdiv, then postdiv1, then postdiv2
+static int compare_preference(const pll_entry * a, const pll_entry * b)
+{
+    float vco_a = entry_vco_freq(a), vco_b = entry_vco_freq(b);
+    if (fabs(vco_a - vco_b) >= EPSILON) return vco_a < vco_b ? -1 : 1;
+
+    int postdiv_a = a->postdiv1 * a->postdiv2, postdiv_b = b->postdiv1 * b->postdiv2;
+    if (postdiv_a != postdiv_b) return postdiv_a - postdiv_b;
+
+    if (a->refdiv != b->refdiv) return b->refdiv - a->refdiv;
+    if (a->postdiv1 != b->postdiv1) return b->postdiv1 - a->postdiv1;
+    return b->postdiv2 - a->postdiv2;
+}
+
+static int compare_entries(const void * a, const void * b)
+{
+    float freq_a = entry_freq(a), freq_b = entry_freq(b);
+    if (fabs(freq_a - freq_b) >= EPSILON) return freq_a < freq_b ? -1 : 1;
+    return compare_preference(a, b);
+}
+
+static bool build_table(uint16_t fb_divider_min, uint16_t fb_divider_max)
+{
+    if (table.entries && table.fb_divider_min == fb_divider_min && table.fb_divider_max == fb_divider_max) {
+        return true;
+    }
+
+    free(table.entries);
+    table.entries = NULL;
+    table.count = 0;
+
+    size_t max_count = 0;
+    for (uint8_t postdiv1 = 1; postdiv1 <= POSTDIV_MAX; postdiv1++) {
+        max_count += postdiv1 - 1; // postdiv2 < postdiv1
+    }
+    max_count *= REFDIV_MAX * (fb_divider_max - fb_divider_min + 1);
+
+    pll_entry * entries = malloc(max_count * sizeof(pll_entry));
+    if (entries == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate PLL table");
+        return false;
+    }
+
+    size_t count = 0;
+    for (uint8_t refdiv = 1; refdiv <= REFDIV_MAX; refdiv++) {
+        for (uint8_t postdiv1 = 1; postdiv1 <= POSTDIV_MAX; postdiv1++) {
+            for (uint8_t postdiv2 = 1; postdiv2 < postdiv1; postdiv2++) {
+                for (uint16_t fb_divider = fb_divider_min; fb_divider <= fb_divider_max; fb_divider++) {
+                    entries[count++] = (pll_entry) {
+                        .fb_divider = fb_divider,
+                        .refdiv = refdiv,
+                        .postdiv1 = postdiv1,
+                        .postdiv2 = postdiv2,
+                    };
+                }
+            }
+        }
+    }
+
+    // keep the preferred tuple of each frequency
+    qsort(entries, count, sizeof(pll_entry), compare_entries);
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique == 0 || fabs(entry_freq(&entries[i]) - entry_freq(&entries[unique - 1])) >= EPSILON) {
+            entries[unique++] = entries[i];
+        }
+    }
+
+    pll_entry * shrunk = realloc(entries, unique * sizeof(pll_entry));
+    table.entries = shrunk ? shrunk : entries;
+    table.count = unique;
+    table.fb_divider_min = fb_divider_min;
+    table.fb_divider_max = fb_divider_max;
+
+    ESP_LOGI(TAG, "PLL table: %u frequencies (fb_divider %u..%u)", (unsigned)unique, fb_divider_min, fb_divider_max);
+    return true;
+}
+
+// Index of the first frequency at or above target_freq, table.count if none
+static size_t lower_bound(float target_freq)
+{
+    size_t low = 0, high = table.count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (entry_freq(&table.entries[mid]) < target_freq) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
 void pll_get_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max, 
                         uint8_t *fb_divider, uint8_t *refdiv, uint8_t *postdiv1, uint8_t *postdiv2,
                         float *actual_freq) 
 {
-    float best_freq = 0;
-    uint8_t best_refdiv = 0, best_fb_divider = 0, best_postdiv1 = 0, best_postdiv2 = 0;
-    float min_diff = FLT_MAX;
-    float min_vco_freq = FLT_MAX;
-    uint16_t min_postdiv = UINT16_MAX;
-
-    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
-        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
-            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
-                uint16_t divider = refdiv * postdiv1 * postdiv2;
-                uint16_t fb_divider = round(target_freq / FREQ_MULT * divider);
-                if (postdiv1 > postdiv2 &&
-                    fb_divider >= fb_divider_min && fb_divider <= fb_divider_max) {
-                    float new_freq = FREQ_MULT * fb_divider / divider;
-                    float curr_diff = fabs(target_freq - new_freq);
-                    float vco_freq = FREQ_MULT * fb_divider / refdiv;
-                    // Prioritize: 
-                    // 1. Closest frequency to target
-                    // 2. Lowest VCO frequency
-                    // 3. Lowest postdiv1 * postdiv2
-                    if (curr_diff < min_diff ||
-                       (fabs(curr_diff - min_diff) < EPSILON && vco_freq < min_vco_freq) ||
-                       (fabs(curr_diff - min_diff) < EPSILON && fabs(vco_freq - min_vco_freq) < EPSILON && postdiv1 * postdiv2 < min_postdiv)) {
-                        min_diff = curr_diff;
-                        min_vco_freq = vco_freq;
-                        min_postdiv = postdiv1 * postdiv2;
-                        best_freq = new_freq;
-                        best_refdiv = refdiv;
-                        best_fb_divider = fb_divider;
-                        best_postdiv1 = postdiv1;
-                        best_postdiv2 = postdiv2;
-                    }
-                }
-            }
+    pthread_mutex_lock(&table_lock);
+    if (!build_table(fb_divider_min, fb_divider_max) || table.count == 0) {
+        pthread_mutex_unlock(&table_lock);
+        *actual_freq = 0;
+        *fb_divider = *refdiv = *postdiv1 = *postdiv2 = 0;
+        return;
+    }
+
+    // the nearest frequency is the first one at or above the target or the one before
+    size_t index = lower_bound(target_freq);
+    const pll_entry * best;
+    if (index == table.count) {
+        best = &table.entries[index - 1];
+    } else if (index == 0) {
+        best = &table.entries[0];
+    } else {
+        const pll_entry * above = &table.entries[index];
+        const pll_entry * below = &table.entries[index - 1];
+        float diff_above = entry_freq(above) - target_freq;
+        float diff_below = target_freq - entry_freq(below);
+        if (fabs(diff_above - diff_below) < EPSILON) {
+            best = compare_preference(below, above) <= 0 ? below : above;
+        } else {
+            best = diff_below < diff_above ? below : above;
         }
     }
 
-    ESP_LOGI(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", best_freq, best_fb_divider, best_refdiv, best_postdiv1, best_postdiv2);
+    *actual_freq = entry_freq(best);
+    *fb_divider = best->fb_divider;
+    *refdiv = best->refdiv;
+    *postdiv1 = best->postdiv1;
+    *postdiv2 = best->postdiv2;
+    pthread_mutex_unlock(&table_lock);
 
-    *actual_freq = best_freq;
-    *fb_divider = best_fb_divider;
-    *refdiv = best_refdiv;
-    *postdiv1 = best_postdiv1;
-    *postdiv2 = best_postdiv2;
+    ESP_LOGI(TAG, "Frequency: %g MHz (fb_divider: %d, refdiv: %d, postdiv1: %d, postdiv2: %d)", *actual_freq, *fb_divider, *refdiv, *postdiv1, *postdiv2);
+}
+
+size_t pll_get_frequencies(uint16_t fb_divider_min, uint16_t fb_divider_max, float min_freq, float max_freq,
+                           float *frequencies, size_t max_count)
+{
+    pthread_mutex_lock(&table_lock);
+    if (!build_table(fb_divider_min, fb_divider_max)) {
+        pthread_mutex_unlock(&table_lock);
+        return 0;
+    }
+
+    size_t count = 0;
+    for (size_t index = lower_bound(min_freq); index < table.count && count < max_count; index++) {
+        float freq = entry_freq(&table.entries[index]);
+        if (freq > max_freq) break;
+        frequencies[count++] = freq;
+    }
+    pthread_mutex_unlock(&table_lock);
+    return count;
 }
@@ -91,6 +91,31 @@ int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
     return bytes_read;
 }
 
+/// @brief waits for at least min_size bytes, then also takes whatever else is
+/// already buffered, up to max_size
+/// @return number of bytes read, or -1 on error
+int16_t SERIAL_rx_available(uint8_t *buf, uint16_t min_size, uint16_t max_size, uint16_t timeout_ms)
+{
+    int16_t bytes_read = SERIAL_rx(buf, min_size, timeout_ms);
+    if (bytes_read != min_size || max_size <= min_size) {
+        return bytes_read;
+    }
+
+    size_t buffered = 0;
+    uart_get_buffered_data_len(UART_NUM_1, &buffered);
+    if (buffered > (size_t)(max_size - bytes_read)) {
+        buffered = (size_t)(max_size - bytes_read);
+    }
+    if (buffered > 0) {
+        int extra = uart_read_bytes(UART_NUM_1, buf + bytes_read, buffered, 0);
+        if (extra > 0) {
+            bytes_read += extra;
+        }
+    }
+
+    return bytes_read;
+}
+
 void SERIAL_debug_rx(void)
 {
     int ret;
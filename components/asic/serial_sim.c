@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "bm13xx_sim.h"
+#include "serial.h"
+#include "utils.h"
+
+// SERIAL_* backed by the chain simulator, selected with CONFIG_ASIC_SIMULATOR
+
+static const char *TAG = "serial_sim";
+
+static bm13xx_sim *sim;
+static SemaphoreHandle_t sim_mutex;
+
+esp_err_t SERIAL_init(void)
+{
+    ESP_LOGW(TAG, "Initializing simulated ASIC chain");
+
+    bm13xx_sim_config config = {
+        .chip_id = CONFIG_ASIC_SIMULATOR_CHIP_ID,
+        .chip_count = CONFIG_ASIC_SIMULATOR_CHIP_COUNT,
+        .core_count = CONFIG_ASIC_SIMULATOR_CORE_COUNT,
+        .hashrate_ghs = CONFIG_ASIC_SIMULATOR_HASHRATE,
+        .share_bits = CONFIG_ASIC_SIMULATOR_SHARE_BITS,
+        .baud = UART_FREQ,
+        .seed = (uint32_t)esp_timer_get_time(),
+    };
+
+    sim_mutex = xSemaphoreCreateMutex();
+    if (sim_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    sim = BM13XX_SIM_create(&config, esp_timer_get_time());
+    return sim != NULL ? ESP_OK : ESP_FAIL;
+}
+
+bool SERIAL_is_initialized(void)
+{
+    return sim != NULL;
+}
+
+esp_err_t SERIAL_set_baud(int baud)
+{
+    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    BM13XX_SIM_set_baud(sim, baud, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+
+    return ESP_OK;
+}
+
+int SERIAL_send(uint8_t *data, int len, bool debug)
+{
+    if (debug)
+    {
+        printf("tx: ");
+        prettyHex((unsigned char *)data, len);
+        printf("\n");
+    }
+
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    BM13XX_SIM_write(sim, data, len, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+
+    return len;
+}
+
+/// @brief waits for a response from the simulated chain, like uart_read_bytes
+/// @return number of bytes read
+int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+{
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
+    int16_t bytes_read = 0;
+
+    while (1) {
+        int64_t now_us = esp_timer_get_time();
+
+        xSemaphoreTake(sim_mutex, portMAX_DELAY);
+        bytes_read += BM13XX_SIM_read(sim, buf + bytes_read, size - bytes_read, now_us);
+        int64_t next_us = BM13XX_SIM_next_event_us(sim, now_us);
+        xSemaphoreGive(sim_mutex);
+
+        if (bytes_read == size || now_us >= deadline_us) {
+            return bytes_read;
+        }
+
+        // sleep until the next frame is due, but wake up regularly so a
+        // job sent meanwhile is picked up
+        int64_t wake_us = next_us < deadline_us ? next_us : deadline_us;
+        TickType_t ticks = (wake_us - now_us) / 1000 / portTICK_PERIOD_MS;
+        if (ticks > 10 / portTICK_PERIOD_MS) {
+            ticks = 10 / portTICK_PERIOD_MS;
+        }
+        vTaskDelay(ticks > 0 ? ticks : 1);
+    }
+}
+
+int16_t SERIAL_rx_available(uint8_t *buf, uint16_t min_size, uint16_t max_size, uint16_t timeout_ms)
+{
+    int16_t bytes_read = SERIAL_rx(buf, min_size, timeout_ms);
+    if (bytes_read != min_size || max_size <= min_size) {
+        return bytes_read;
+    }
+
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    bytes_read += BM13XX_SIM_read(sim, buf + bytes_read, max_size - bytes_read, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+
+    return bytes_read;
+}
+
+void SERIAL_debug_rx(void)
+{
+    int ret;
+    uint8_t buf[100];
+
+    ret = SERIAL_rx(buf, 100, 20);
+    if (ret < 0)
+    {
+        fprintf(stderr, "unable to read data\n");
+        return;
+    }
+
+    memset(buf, 0, 100);
+}
+
+void SERIAL_clear_buffer(void)
+{
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    BM13XX_SIM_flush(sim, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+}
@@ -0,0 +1,65 @@
+#include "unity.h"
+
+#include "asic_common.h"
+#include "bm13xx_sim.h"
+#include "crc.h"
+
+#include <string.h>
+
+static void send_command(bm13xx_sim *sim, uint8_t header, const uint8_t *data, uint8_t data_len, int64_t now_us)
+{
+    uint8_t buf[16] = {0x55, 0xAA, header, data_len + 3};
+    memcpy(buf + 4, data, data_len);
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    BM13XX_SIM_write(sim, buf, data_len + 5, now_us);
+}
+
+TEST_CASE("Simulated chain answers the chip ID enumeration", "[bm13xx_sim]")
+{
+    bm13xx_sim_config config = {.chip_id = 0x1370, .chip_count = 3, .core_count = 0x80, .hashrate_ghs = 1000};
+    bm13xx_sim *sim = BM13XX_SIM_create(&config, 0);
+    TEST_ASSERT_NOT_NULL(sim);
+
+    send_command(sim, 0x52, (uint8_t[]){0x00, 0x00}, 2, 0);
+
+    uint8_t frames[3 * 11];
+    TEST_ASSERT_EQUAL_INT(sizeof(frames), BM13XX_SIM_read(sim, frames, sizeof(frames), 1000000));
+
+    for (int i = 0; i < 3; i++) {
+        uint8_t *frame = frames + i * 11;
+        TEST_ASSERT_EQUAL_HEX8(0xAA, frame[0]);
+        TEST_ASSERT_EQUAL_HEX8(0x55, frame[1]);
+        TEST_ASSERT_EQUAL_HEX8(0x13, frame[2]);
+        TEST_ASSERT_EQUAL_HEX8(0x70, frame[3]);
+        TEST_ASSERT_EQUAL_HEX8(0x80, frame[4]);
+        TEST_ASSERT_EQUAL_UINT8(0, crc5(frame + 2, 9));
+    }
+
+    BM13XX_SIM_free(sim);
+}
+
+TEST_CASE("Simulated chain drops packets with a bad CRC", "[bm13xx_sim]")
+{
+    bm13xx_sim_config config = {.chip_id = 0x1366, .chip_count = 1, .core_count = 112, .hashrate_ghs = 500};
+    bm13xx_sim *sim = BM13XX_SIM_create(&config, 0);
+    TEST_ASSERT_NOT_NULL(sim);
+
+    uint8_t bad[] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x4C, 0x00};
+    bad[6] = crc5(bad + 2, 4) ^ 0x01;
+    BM13XX_SIM_write(sim, bad, sizeof(bad), 0);
+
+    // the dropped read gets no answer, the error counter of the chip goes up
+    send_command(sim, 0x52, (uint8_t[]){0x00, 0x4C}, 2, 1000);
+
+    uint8_t frame[11];
+    TEST_ASSERT_EQUAL_INT(sizeof(frame), BM13XX_SIM_read(sim, frame, sizeof(frame), 1000000));
+    TEST_ASSERT_EQUAL_HEX8(0x4C, frame[7]);
+    TEST_ASSERT_EQUAL_UINT32(1, (frame[2] << 24) | (frame[3] << 16) | (frame[4] << 8) | frame[5]);
+    TEST_ASSERT_EQUAL_INT(0, BM13XX_SIM_read(sim, frame, sizeof(frame), 1000000));
+
+    bm13xx_sim_stats stats;
+    BM13XX_SIM_get_stats(sim, &stats);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.crc_errors);
+
+    BM13XX_SIM_free(sim);
+}
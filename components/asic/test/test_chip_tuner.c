@@ -0,0 +1,73 @@
+#include "unity.h"
+
+#include "chip_tuner.h"
+
+TEST_CASE("Chip tuner settles each chip below its own error ceiling", "[chip_tuner]")
+{
+    chip_tuner tuner;
+    chip_tuner_init(&tuner, 2, 500, NULL, 0);
+
+    // chip 0 is clean up to 512.5 MHz, chip 1 already errors at 500 MHz
+    for (int window = 0; window < 20; window++) {
+        float errors[2] = {
+            tuner.chips[0].frequency > 512.5 ? 5.0 : 0.1,
+            tuner.chips[1].frequency > 493.75 ? 5.0 : 0.1,
+        };
+        chip_tuner_update(&tuner, errors);
+    }
+
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 512.5, tuner.chips[0].frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 493.75, tuner.chips[1].frequency);
+}
+
+TEST_CASE("Chip tuner stays inside the offsets", "[chip_tuner]")
+{
+    chip_tuner tuner;
+    chip_tuner_init(&tuner, 2, 500, NULL, 0);
+
+    for (int window = 0; window < 20; window++) {
+        float errors[2] = {0.0, 10.0};
+        chip_tuner_update(&tuner, errors);
+    }
+
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 500 + CHIP_TUNER_MAX_OFFSET, tuner.chips[0].frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 500 - CHIP_TUNER_MIN_OFFSET, tuner.chips[1].frequency);
+
+    // a middling error rate holds the frequency
+    float errors[2] = {1.0, 1.0};
+    TEST_ASSERT_EQUAL_HEX32(0, chip_tuner_update(&tuner, errors));
+
+    int steps = 0;
+    while (chip_tuner_step_to_base(&tuner)) steps++;
+    TEST_ASSERT_EQUAL(8, steps);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 500, tuner.chips[0].frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 500, tuner.chips[1].frequency);
+}
+
+TEST_CASE("Chip tuner steps between PLL frequencies", "[chip_tuner]")
+{
+    // off the 6.25 MHz grid, the way the PLL reaches them
+    static const float frequencies[] = { 450, 456, 462, 469, 475, 481, 487, 493, 500, 504, 508, 513, 518, 525 };
+    chip_tuner tuner;
+    chip_tuner_init(&tuner, 1, 500, frequencies, sizeof(frequencies) / sizeof(frequencies[0]));
+
+    // the chip is clean up to 512 MHz
+    for (int window = 0; window < 20; window++) {
+        float errors[1] = { tuner.chips[0].frequency > 512 ? 5.0 : 0.1 };
+        chip_tuner_update(&tuner, errors);
+
+        bool listed = false;
+        for (size_t i = 0; i < sizeof(frequencies) / sizeof(frequencies[0]); i++) {
+            listed |= tuner.chips[0].frequency == frequencies[i];
+        }
+        TEST_ASSERT_TRUE(listed);
+    }
+
+    // 504 is less than a step above 500, 513 less than a step above 508
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 508, tuner.chips[0].frequency);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 518, tuner.chips[0].ceiling);
+
+    TEST_ASSERT_EQUAL_HEX32(1, chip_tuner_step_to_base(&tuner));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 500, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL_HEX32(0, chip_tuner_step_to_base(&tuner));
+}
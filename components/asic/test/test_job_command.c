@@ -1,201 +1,222 @@
 #include "unity.h"
 
-#include "serial.h"
+#include "bm1366.h"
 #include "bm1397.h"
+#include "crc.h"
 
 #include <string.h>
 
-/*
-static uint8_t uart_initialized = 0;
+#define JOB_HEADER 0x21 // TYPE_JOB | GROUP_SINGLE | CMD_WRITE
 
-TEST_CASE("Check known working midstate + job command", "[bm1397]")
+static const uint8_t work1[146] = {
+    0x18, // job id
+    0x04, // number of midstates
+    0x9B,
+    0x04,
+    0x4C,
+    0x0A, // starting nonce
+    0x3A,
+    0xAE,
+    0x05,
+    0x17, // nbits
+    0xA0,
+    0x84,
+    0x73,
+    0x64, // ntime
+    0x50,
+    0xE3,
+    0x71,
+    0x61, // merkle 4
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x7E,
+    0x02,
+    0x70,
+    0x35,
+    0xB1,
+    0xAC,
+    0xBA,
+    0xF2,
+    0x3E,
+    0xA0,
+    0x1A,
+    0x52,
+    0x73,
+    0x44,
+    0xFA,
+    0xF7,
+    0x6A,
+    0xB4,
+    0x76,
+    0xD3,
+    0x28,
+    0x21,
+    0x61,
+    0x18,
+    0xB7,
+    0x76,
+    0x0F,
+    0x7B,
+    0x1B,
+    0x22,
+    0xD2,
+    0x29,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+    0x00,
+};
+
+static void assert_job_framing(const asic_job_packet *packet, uint8_t data_len)
 {
-    static GlobalState GLOBAL_STATE;
+    TEST_ASSERT_EQUAL_UINT8(data_len + 6, packet->len);
+    TEST_ASSERT_EQUAL_HEX8(0x55, packet->buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, packet->buf[1]);
+    TEST_ASSERT_EQUAL_HEX8(JOB_HEADER, packet->buf[2]);
+    TEST_ASSERT_EQUAL_UINT8(data_len + 4, packet->buf[3]);
 
-    if (!uart_initialized)
-    {
-        SERIAL_init();
-        uart_initialized = 1;
+    uint16_t crc = crc16_false((uint8_t *)packet->buf + 2, data_len + 2);
+    TEST_ASSERT_EQUAL_HEX8(crc >> 8, packet->buf[4 + data_len]);
+    TEST_ASSERT_EQUAL_HEX8(crc & 0xFF, packet->buf[5 + data_len]);
+}
 
-        BM1397_init(425, 1, 256);
+TEST_CASE("Check known working midstate + job command", "[bm1397]")
+{
+    static asic_job_packet packet;
+    memset(&packet, 0, sizeof(packet));
 
-        // read back response
-        SERIAL_debug_rx();
+    packet.job_id = work1[0];
+    packet.midstates.num_midstates = work1[1];
+    memcpy(&packet.job.starting_nonce, work1 + 2, 4);
+    memcpy(&packet.job.target, work1 + 6, 4);
+    memcpy(&packet.job.ntime, work1 + 10, 4);
+    memcpy(packet.job.merkle_root, work1 + 14, 4);
+    for (int i = 0; i < 4; i++) {
+        memcpy(packet.midstates.midstate[i], work1 + 18 + 32 * i, 32);
     }
 
-    uint8_t work1[146] = {
-        0x18, // job id
-        0x04, // number of midstates
-        0x9B,
-        0x04,
-        0x4C,
-        0x0A, // starting nonce
-        0x3A,
-        0xAE,
-        0x05,
-        0x17, // nbits
-        0xA0,
-        0x84,
-        0x73,
-        0x64, // ntime
-        0x50,
-        0xE3,
-        0x71,
-        0x61, // merkle 4
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x7E,
-        0x02,
-        0x70,
-        0x35,
-        0xB1,
-        0xAC,
-        0xBA,
-        0xF2,
-        0x3E,
-        0xA0,
-        0x1A,
-        0x52,
-        0x73,
-        0x44,
-        0xFA,
-        0xF7,
-        0x6A,
-        0xB4,
-        0x76,
-        0xD3,
-        0x28,
-        0x21,
-        0x61,
-        0x18,
-        0xB7,
-        0x76,
-        0x0F,
-        0x7B,
-        0x1B,
-        0x22,
-        0xD2,
-        0x29,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-        0x00,
-    };
-    job_packet test_job;
-    memcpy((uint8_t *)&test_job, work1, 146);
+    BM1397_prepare_work(&packet);
 
-    uint8_t buf[1024];
-    memset(buf, 0, 1024);
+    assert_job_framing(&packet, sizeof(work1));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(work1, packet.buf + 4, sizeof(work1));
+}
 
-    BM1397_send_work(&GLOBAL_STATE, &test_job);
-    uint16_t received = SERIAL_rx(buf, 9, 20);
-    TEST_ASSERT_GREATER_OR_EQUAL_UINT16(sizeof(struct asic_result), received);
+TEST_CASE("BM1366 job command carries the header fields", "[bm1366]")
+{
+    static asic_job_packet packet;
+    memset(&packet, 0, sizeof(packet));
 
-    int i;
-    for (i = 0; i < received - 1; i++)
-    {
-        if (buf[i] == 0xAA && buf[i + 1] == 0x55)
-        {
-            break;
-        }
+    packet.job_id = 0x28;
+    packet.job.starting_nonce = 0x11223344;
+    packet.job.target = 0x1705AE3A;
+    packet.job.ntime = 0x647384A0;
+    packet.job.version = 0x20000000;
+    for (int i = 0; i < 32; i++) {
+        packet.job.merkle_root[i] = i;
+        packet.job.prev_block_hash[i] = 0x80 + i;
     }
 
-    struct asic_result nonce;
-    memcpy((void *)&nonce, buf + i, sizeof(struct asic_result));
-    // expected nonce 9B 04 4C 0A
-    TEST_ASSERT_EQUAL_UINT32(0x0a4c049b, nonce.nonce);
-    TEST_ASSERT_EQUAL_UINT8(0x18, nonce.job_id & 0xfc);
-    TEST_ASSERT_EQUAL_UINT8(2, nonce.job_id & 0x03);
-}
+    BM1366_prepare_work(&packet);
 
-*/
\ No newline at end of file
+    assert_job_framing(&packet, sizeof(BM1366_job));
+
+    const BM1366_job *job = (const BM1366_job *)(packet.buf + 4);
+    TEST_ASSERT_EQUAL_HEX8(0x28, job->job_id);
+    TEST_ASSERT_EQUAL_UINT8(1, job->num_midstates);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&packet.job.starting_nonce, job->starting_nonce, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&packet.job.target, job->nbits, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&packet.job.ntime, job->ntime, 4);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet.job.merkle_root, job->merkle_root, 32);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(packet.job.prev_block_hash, job->prev_block_hash, 32);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(&packet.job.version, job->version, 4);
+}
@@ -0,0 +1,110 @@
+#include "unity.h"
+
+#include "job_slots.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static bm_job make_job(const char *jobid)
+{
+    bm_job job;
+    memset(&job, 0, sizeof(bm_job));
+    strcpy(job.jobid, jobid);
+    return job;
+}
+
+TEST_CASE("Job slots keep the job an id held before", "[job_slots]")
+{
+    job_slots *slots = malloc(sizeof(job_slots));
+    TEST_ASSERT_NOT_NULL(slots);
+    job_slots_init(slots);
+
+    bm_job job;
+    uint8_t pool;
+    uint32_t generation;
+    TEST_ASSERT_EQUAL(JOB_SLOT_EMPTY, job_slots_lookup(slots, 0x18, false, &job, &pool, &generation));
+
+    bm_job first = make_job("first");
+    bm_job second = make_job("second");
+    job_slots_assign(slots, 0x18, &first, 0);
+    job_slots_assign(slots, 0x18, &second, 1);
+
+    TEST_ASSERT_EQUAL(JOB_SLOT_LIVE, job_slots_lookup(slots, 0x18, false, &job, &pool, &generation));
+    TEST_ASSERT_EQUAL_STRING("second", job.jobid);
+    TEST_ASSERT_EQUAL_UINT8(1, pool);
+    TEST_ASSERT_EQUAL_UINT32(2, generation);
+
+    TEST_ASSERT_EQUAL(JOB_SLOT_LIVE, job_slots_lookup(slots, 0x18, true, &job, &pool, &generation));
+    TEST_ASSERT_EQUAL_STRING("first", job.jobid);
+    TEST_ASSERT_EQUAL_UINT8(0, pool);
+    TEST_ASSERT_EQUAL_UINT32(1, generation);
+
+    // other ids are untouched
+    TEST_ASSERT_EQUAL(JOB_SLOT_EMPTY, job_slots_lookup(slots, 0x20, false, &job, &pool, &generation));
+
+    free(slots);
+}
+
+TEST_CASE("Job slots mark jobs from before clean_jobs stale", "[job_slots]")
+{
+    job_slots *slots = malloc(sizeof(job_slots));
+    TEST_ASSERT_NOT_NULL(slots);
+    job_slots_init(slots);
+
+    bm_job old_job = make_job("old");
+    bm_job new_job = make_job("new");
+    job_slots_assign(slots, 0x40, &old_job, 0);
+    job_slots_clean(slots);
+    job_slots_assign(slots, 0x40, &new_job, 0);
+
+    bm_job job;
+    uint8_t pool;
+    uint32_t generation;
+    TEST_ASSERT_EQUAL(JOB_SLOT_LIVE, job_slots_lookup(slots, 0x40, false, &job, &pool, &generation));
+    TEST_ASSERT_EQUAL(JOB_SLOT_STALE, job_slots_lookup(slots, 0x40, true, &job, &pool, &generation));
+    TEST_ASSERT_EQUAL_STRING("old", job.jobid);
+
+    free(slots);
+}
+
+TEST_CASE("Job slots go stale on a clean notify with nothing queued", "[job_slots]")
+{
+    job_slots *slots = malloc(sizeof(job_slots));
+    TEST_ASSERT_NOT_NULL(slots);
+    job_slots_init(slots);
+
+    // the job is already on the chips, no later job is waiting to be flushed
+    bm_job sent = make_job("sent");
+    job_slots_assign(slots, 0x08, &sent, 0);
+
+    bm_job job;
+    uint8_t pool;
+    uint32_t generation;
+    job_slots_notify(slots, false);
+    TEST_ASSERT_EQUAL(JOB_SLOT_LIVE, job_slots_lookup(slots, 0x08, false, &job, &pool, &generation));
+
+    // a nonce for it coming back after the clean notify is stale
+    job_slots_notify(slots, true);
+    TEST_ASSERT_EQUAL(JOB_SLOT_STALE, job_slots_lookup(slots, 0x08, false, &job, &pool, &generation));
+    TEST_ASSERT_EQUAL_STRING("sent", job.jobid);
+
+    free(slots);
+}
+
+TEST_CASE("Job slot ids follow the driver step", "[job_slots]")
+{
+    job_slots *slots = malloc(sizeof(job_slots));
+    TEST_ASSERT_NOT_NULL(slots);
+    job_slots_init(slots);
+
+    // BM1370 ids visit all 16 multiples of 8 before wrapping
+    uint32_t seen = 0;
+    for (int i = 0; i < 16; i++) {
+        uint8_t id = job_slots_next_id(slots, 24);
+        TEST_ASSERT_EQUAL_UINT8(0, id % 8);
+        seen |= 1u << (id / 8);
+    }
+    TEST_ASSERT_EQUAL_HEX32(0xFFFF, seen);
+
+    free(slots);
+}
@@ -0,0 +1,45 @@
+#include "unity.h"
+
+#include "nonce_filter.h"
+
+#include <stdlib.h>
+
+TEST_CASE("Nonce filter drops a repeated result of the same job", "[nonce_filter]")
+{
+    nonce_filter *filter = malloc(sizeof(nonce_filter));
+    TEST_ASSERT_NOT_NULL(filter);
+    nonce_filter_init(filter);
+
+    TEST_ASSERT_TRUE(nonce_filter_insert(filter, 0x18, 0x1234abcd, 0x20000000));
+    TEST_ASSERT_FALSE(nonce_filter_insert(filter, 0x18, 0x1234abcd, 0x20000000));
+
+    // same nonce with another version or for another job is a different result
+    TEST_ASSERT_TRUE(nonce_filter_insert(filter, 0x18, 0x1234abcd, 0x20002000));
+    TEST_ASSERT_TRUE(nonce_filter_insert(filter, 0x30, 0x1234abcd, 0x20000000));
+
+    // a recycled job id starts empty
+    nonce_filter_clear_job(filter, 0x18);
+    TEST_ASSERT_TRUE(nonce_filter_insert(filter, 0x18, 0x1234abcd, 0x20000000));
+
+    free(filter);
+}
+
+TEST_CASE("Nonce filter lets results through once a job slot is full", "[nonce_filter]")
+{
+    nonce_filter *filter = malloc(sizeof(nonce_filter));
+    TEST_ASSERT_NOT_NULL(filter);
+    nonce_filter_init(filter);
+
+    for (uint32_t i = 0; i < NONCE_FILTER_SLOT_SIZE; i++) {
+        TEST_ASSERT_TRUE(nonce_filter_insert(filter, 4, i * 0x01000193, 0x20000000));
+    }
+    for (uint32_t i = 0; i < NONCE_FILTER_SLOT_SIZE; i++) {
+        TEST_ASSERT_FALSE(nonce_filter_insert(filter, 4, i * 0x01000193, 0x20000000));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, filter->overflows);
+
+    TEST_ASSERT_TRUE(nonce_filter_insert(filter, 4, 0xdeadbeef, 0x20000000));
+    TEST_ASSERT_EQUAL_UINT32(1, filter->overflows);
+
+    free(filter);
+}
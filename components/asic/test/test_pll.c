@@ -2,6 +2,10 @@
 
 #include "pll.h"
 
+#include <float.h>
+#include <stdbool.h>
+#include <math.h>
+
 TEST_CASE("Check PLL frequency calculation", "[pll]")
 {
     float frequency = 450.0; // MHz
@@ -16,3 +20,102 @@ TEST_CASE("Check PLL frequency calculation", "[pll]")
     TEST_ASSERT_EQUAL_UINT8(1, postdiv2);
     TEST_ASSERT_FLOAT_WITHIN(0.01, 450.0, actual_freq);
 }
+
+// The exhaustive divider search the table replaces
+static float search_parameters(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max,
+                               uint8_t *best_fb_divider, uint8_t *best_refdiv, uint8_t *best_postdiv1, uint8_t *best_postdiv2)
+{
+    float best_freq = 0;
+    float min_diff = FLT_MAX;
+    float min_vco_freq = FLT_MAX;
+    uint16_t min_postdiv = UINT16_MAX;
+
+    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
+        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
+            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
+                uint16_t divider = refdiv * postdiv1 * postdiv2;
+                uint16_t fb_divider = round(target_freq / FREQ_MULT * divider);
+                if (postdiv1 > postdiv2 &&
+                    fb_divider >= fb_divider_min && fb_divider <= fb_divider_max) {
+                    float new_freq = FREQ_MULT * fb_divider / divider;
+                    float curr_diff = fabs(target_freq - new_freq);
+                    float vco_freq = FREQ_MULT * fb_divider / refdiv;
+                    if (curr_diff < min_diff ||
+                       (fabs(curr_diff - min_diff) < 0.0001f && vco_freq < min_vco_freq) ||
+                       (fabs(curr_diff - min_diff) < 0.0001f && fabs(vco_freq - min_vco_freq) < 0.0001f && postdiv1 * postdiv2 < min_postdiv)) {
+                        min_diff = curr_diff;
+                        min_vco_freq = vco_freq;
+                        min_postdiv = postdiv1 * postdiv2;
+                        best_freq = new_freq;
+                        *best_refdiv = refdiv;
+                        *best_fb_divider = fb_divider;
+                        *best_postdiv1 = postdiv1;
+                        *best_postdiv2 = postdiv2;
+                    }
+                }
+            }
+        }
+    }
+    return best_freq;
+}
+
+static void check_against_search(float target_freq, uint16_t fb_divider_min, uint16_t fb_divider_max)
+{
+    uint8_t fb_divider, refdiv, postdiv1, postdiv2;
+    uint8_t expected_fb_divider, expected_refdiv, expected_postdiv1, expected_postdiv2;
+    float actual_freq;
+
+    pll_get_parameters(target_freq, fb_divider_min, fb_divider_max, &fb_divider, &refdiv, &postdiv1, &postdiv2, &actual_freq);
+    float expected_freq = search_parameters(target_freq, fb_divider_min, fb_divider_max,
+                                            &expected_fb_divider, &expected_refdiv, &expected_postdiv1, &expected_postdiv2);
+
+    // the search skips a divider when the rounded feedback divider falls out
+    // of bounds, so the table may only ever come closer
+    TEST_ASSERT_TRUE(fabs(target_freq - actual_freq) <= fabs(target_freq - expected_freq) + 0.0001f);
+
+    if (fabs(actual_freq - expected_freq) < 0.0001f) {
+        TEST_ASSERT_EQUAL_UINT8(expected_fb_divider, fb_divider);
+        TEST_ASSERT_EQUAL_UINT8(expected_refdiv, refdiv);
+        TEST_ASSERT_EQUAL_UINT8(expected_postdiv1, postdiv1);
+        TEST_ASSERT_EQUAL_UINT8(expected_postdiv2, postdiv2);
+    }
+}
+
+TEST_CASE("Check PLL table matches the divider search", "[pll]")
+{
+    const uint16_t fb_divider_bounds[][2] = {
+        {60, 200},  // BM1397
+        {144, 235}, // BM1366, BM1368
+        {160, 239}, // BM1370
+    };
+
+    for (int i = 0; i < (int)(sizeof(fb_divider_bounds) / sizeof(fb_divider_bounds[0])); i++) {
+        // the 6.25 MHz ramp grid and some targets off it
+        for (float target_freq = 50; target_freq <= 1000; target_freq += 6.25) {
+            check_against_search(target_freq, fb_divider_bounds[i][0], fb_divider_bounds[i][1]);
+            check_against_search(target_freq + 1.7, fb_divider_bounds[i][0], fb_divider_bounds[i][1]);
+        }
+    }
+}
+
+TEST_CASE("Check PLL achievable frequencies", "[pll]")
+{
+    float frequencies[64];
+    size_t count = pll_get_frequencies(160, 239, 500, 530, frequencies, 64);
+
+    TEST_ASSERT_TRUE(count > 1);
+    bool has_default = false;
+    for (size_t i = 0; i < count; i++) {
+        has_default |= fabs(frequencies[i] - 525.0) < 0.0001f;
+
+        TEST_ASSERT_TRUE(frequencies[i] >= 500 && frequencies[i] <= 530);
+        if (i > 0) TEST_ASSERT_TRUE(frequencies[i] > frequencies[i - 1]);
+
+        // every listed frequency is reached exactly
+        uint8_t fb_divider, refdiv, postdiv1, postdiv2;
+        float actual_freq;
+        pll_get_parameters(frequencies[i], 160, 239, &fb_divider, &refdiv, &postdiv1, &postdiv2, &actual_freq);
+        TEST_ASSERT_FLOAT_WITHIN(0.0001, frequencies[i], actual_freq);
+    }
+    TEST_ASSERT_TRUE(has_default);
+}
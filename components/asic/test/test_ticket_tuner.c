@@ -0,0 +1,33 @@
+#include "unity.h"
+
+#include "ticket_tuner.h"
+
+TEST_CASE("Ticket tuner follows the nonce rate in powers of 2", "[ticket_tuner]")
+{
+    // 8 nonces per second at 256 wants 2048 for one per second
+    TEST_ASSERT_EQUAL_DOUBLE(2048, ticket_tuner_next_difficulty(256, 240, 30, 65536));
+
+    // a quarter nonce per second at 256 wants 64
+    TEST_ASSERT_EQUAL_DOUBLE(64, ticket_tuner_next_difficulty(256, 8, 30, 65536));
+
+    // close to the target rate the difficulty holds
+    TEST_ASSERT_EQUAL_DOUBLE(256, ticket_tuner_next_difficulty(256, 45, 30, 65536));
+    TEST_ASSERT_EQUAL_DOUBLE(256, ticket_tuner_next_difficulty(256, 18, 30, 65536));
+
+    // no nonces at all still steps down, never below the minimum
+    TEST_ASSERT_EQUAL_DOUBLE(TICKET_TUNER_MIN_DIFFICULTY, ticket_tuner_next_difficulty(64, 0, 30, 65536));
+}
+
+TEST_CASE("Ticket tuner never exceeds the pool difficulty", "[ticket_tuner]")
+{
+    TEST_ASSERT_EQUAL_DOUBLE(512, ticket_tuner_next_difficulty(256, 3000, 30, 1000));
+
+    // the pool lowered its difficulty under the current ticket
+    TEST_ASSERT_EQUAL_DOUBLE(256, ticket_tuner_next_difficulty(1024, 30, 30, 300));
+
+    // a pool difficulty under the minimum holds the ticket there, in every window
+    TEST_ASSERT_EQUAL_DOUBLE(16, ticket_tuner_next_difficulty(16, 0, 30, 16));
+    TEST_ASSERT_EQUAL_DOUBLE(16, ticket_tuner_next_difficulty(16, 30, 30, 16));
+    TEST_ASSERT_EQUAL_DOUBLE(16, ticket_tuner_next_difficulty(16, 3000, 30, 16));
+    TEST_ASSERT_EQUAL_DOUBLE(8, ticket_tuner_next_difficulty(16, 0, 30, 10));
+}
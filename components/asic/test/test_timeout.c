@@ -79,4 +79,26 @@ TEST_CASE("Check max asic timeout 1x BM1370", "[common]")
     double expected_ms = 305419.897;
 
     TEST_ASSERT_FLOAT_WITHIN(0.01, expected_ms, timeout_ms);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Check asic HCN timeout 1x BM1370", "[common]")
+{
+    uint32_t hcn = 798647; // BM1370_set_nonce_space at 525 MHz
+    size_t small_cores = 2040;
+    size_t cores = 128;
+    size_t version_size = 65536;
+    float timeout_percent = 1.0;
+    float default_timeout_ms = 500;
+
+    double timeout_ms = calculate_bm_hcn_timeout_ms(hcn, small_cores, cores, version_size, timeout_percent, default_timeout_ms);
+    double expected_ms = 130850.324;
+
+    TEST_ASSERT_FLOAT_WITHIN(0.01, expected_ms, timeout_ms);
+
+    // without version rolling the cores still take one HCN period per job
+    timeout_ms = calculate_bm_hcn_timeout_ms(hcn, small_cores, cores, 1, timeout_percent, default_timeout_ms);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, 31.946, timeout_ms);
+
+    timeout_ms = calculate_bm_hcn_timeout_ms(0, small_cores, cores, version_size, timeout_percent, default_timeout_ms);
+    TEST_ASSERT_FLOAT_WITHIN(0.01, default_timeout_ms, timeout_ms);
+}
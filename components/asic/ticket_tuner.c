@@ -0,0 +1,24 @@
+#include <math.h>
+
+#include "ticket_tuner.h"
+#include "asic_common.h"
+
+double ticket_tuner_next_difficulty(double difficulty, uint32_t nonces, double seconds, double max_difficulty)
+{
+    double max_ticket = get_ticket_difficulty(max_difficulty);
+    double next = difficulty;
+
+    if (seconds > 0) {
+        // half a nonce for an empty window still points downwards
+        double rate = fmax(nonces, 0.5) / seconds;
+        double ideal = difficulty * rate / TICKET_TUNER_TARGET_RATE;
+        double distance = log2(ideal / difficulty);
+
+        if (fabs(distance) > TICKET_TUNER_HYSTERESIS) {
+            next = pow(2, round(log2(ideal)));
+        }
+    }
+
+    // the pool difficulty wins over the floor, a ticket above it loses shares
+    return fmin(fmax(next, TICKET_TUNER_MIN_DIFFICULTY), max_ticket);
+}
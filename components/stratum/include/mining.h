@@ -2,6 +2,11 @@
 #define MINING_H_
 
 #include "stratum_api.h"
+#include "mbedtls/sha256.h"
+
+// Inline storage for the share submission fields of a bm_job
+#define BM_JOB_ID_MAX 64
+#define BM_EXTRANONCE2_STR_MAX (MAX_EXTRANONCE_2_LEN * 2 + 1)
 
 typedef struct
 {
@@ -13,17 +18,61 @@ typedef struct
     uint32_t target; // aka difficulty, aka nbits
     uint32_t starting_nonce;
 
-    uint8_t num_midstates;
-    uint8_t midstate[32];
-    uint8_t midstate1[32];
-    uint8_t midstate2[32];
-    uint8_t midstate3[32];
     double pool_diff;
-    char *jobid;
-    char *extranonce2;
+    char jobid[BM_JOB_ID_MAX];
+    char extranonce2[BM_EXTRANONCE2_STR_MAX];
 } bm_job;
 
-void free_bm_job(bm_job *job);
+#define BM_JOB_MAX_MIDSTATES 4
+
+// Fields an ASIC driver derives from a bm_job for its job packet, fixed per
+// ASIC model. Anything not listed here is left uncomputed by the job builders.
+typedef struct
+{
+    // header midstates per job, one per rolled version; 0 when the chip takes
+    // the merkle root and prev hash and rolls the version itself
+    uint8_t max_midstates;
+} bm_job_format;
+
+// SHA-256 midstates of the first 64 header bytes, words reversed for the job packet
+typedef struct
+{
+    uint8_t num_midstates;
+    uint8_t midstate[BM_JOB_MAX_MIDSTATES][32];
+} bm_job_midstates;
+
+// Per-notify coinbase, pre-decoded to binary. The SHA-256 state of every full
+// 64-byte block in front of extranonce_2 is cached, so rolling extranonce_2
+// only hashes the tail of the coinbase.
+typedef struct
+{
+    uint8_t *coinbase;
+    size_t coinbase_len;
+    size_t extranonce_2_offset;
+    size_t extranonce_2_len;
+    size_t prefix_hashed_len; // bytes absorbed by prefix_ctx, multiple of 64
+    mbedtls_sha256_context prefix_ctx;
+    uint8_t (*merkle_branches)[32];
+    int n_merkle_branches;
+} coinbase_template;
+
+#define NONCE_MIDSTATE_CACHE_SIZE 8
+
+// SHA-256 state after the first 64 header bytes, keyed by the job's merkle root
+// and the rolled version, so a nonce check only hashes the 16-byte header tail
+typedef struct
+{
+    bool valid;
+    uint32_t rolled_version;
+    uint8_t merkle_root[32];
+    mbedtls_sha256_context ctx;
+} nonce_midstate_entry;
+
+typedef struct
+{
+    nonce_midstate_entry entries[NONCE_MIDSTATE_CACHE_SIZE];
+    uint8_t next;
+} nonce_midstate_cache;
 
 void calculate_coinbase_tx_hash(const char *coinbase_1, const char *coinbase_2,
                                 const char *extranonce, const char *extranonce_2, uint8_t dest[32]);
@@ -34,12 +83,36 @@ void calculate_coinbase_tx_hash_bin(const uint8_t *prefix, size_t prefix_len,
                                     const uint8_t *suffix, size_t suffix_len,
                                     uint8_t dest[32]);
 
+int coinbase_template_init(coinbase_template *tmpl,
+                           const uint8_t *prefix, size_t prefix_len,
+                           const uint8_t *extranonce_prefix, size_t ep_len,
+                           size_t e2_len,
+                           const uint8_t *suffix, size_t suffix_len,
+                           const uint8_t merkle_branches[][32], int num_merkle_branches);
+
+int coinbase_template_init_hex(coinbase_template *tmpl, const char *coinbase_1, const char *coinbase_2,
+                               const char *extranonce, size_t e2_len,
+                               const uint8_t merkle_branches[][32], int num_merkle_branches);
+
+void coinbase_template_coinbase_hash(const coinbase_template *tmpl, const uint8_t *extranonce_2, uint8_t dest[32]);
+
+void coinbase_template_merkle_root(const coinbase_template *tmpl, const uint8_t *extranonce_2, uint8_t dest[32]);
+
+void coinbase_template_free(coinbase_template *tmpl);
+
 void calculate_merkle_root_hash(const uint8_t coinbase_tx_hash[32], const uint8_t merkle_branches[][32], const int num_merkle_branches, uint8_t dest[32]);
 
 void construct_bm_job(mining_notify *params, const uint8_t merkle_root[32], const uint32_t version_mask, const double difficulty, bm_job* new_job);
 
+void construct_bm_job_midstates(const bm_job *job, const bm_job_format *format, bm_job_midstates *dest);
+
 double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t rolled_version);
 
+double test_nonce_value_cached(nonce_midstate_cache *cache, const bm_job *job, const uint32_t nonce,
+                               const uint32_t rolled_version, const double min_diff);
+
+void nonce_midstate_cache_init(nonce_midstate_cache *cache);
+
 void extranonce_2_generate(uint64_t extranonce_2, uint32_t length, char dest[static length * 2 + 1]);
 
 uint32_t increment_bitmask(const uint32_t value, const uint32_t mask);
@@ -0,0 +1,52 @@
+#ifndef SHARE_STATS_H_
+#define SHARE_STATS_H_
+
+#include <stdint.h>
+
+// Submit to response latency in ms, in fixed memory. Values below
+// LATENCY_SUB_BUCKETS are counted exactly, above that every power of two is
+// split into LATENCY_SUB_BUCKETS / 2 buckets, so percentiles are within ~6%.
+#define LATENCY_SUB_BUCKET_BITS 5
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_MAX_BITS 16 // larger values are counted as 65535 ms
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BUCKET_BITS + 2) * (LATENCY_SUB_BUCKETS / 2))
+
+typedef struct {
+    uint32_t counts[LATENCY_BUCKETS];
+    uint32_t total;
+    uint32_t max_ms;
+} latency_histogram;
+
+void latency_histogram_record(latency_histogram *histogram, uint32_t ms);
+
+// Latency at or below which percentile (0-100) of the responses came, 0 when empty
+uint32_t latency_histogram_percentile(const latency_histogram *histogram, float percentile);
+
+// Share results over the last hour, in one-minute slots. The hour total is
+// kept up to date as slots expire, so adding and reading it is O(1).
+#define SHARE_RATE_SLOTS 60
+
+typedef enum {
+    SHARE_ACCEPTED,
+    SHARE_REJECTED,
+    SHARE_STALE,
+} share_result;
+
+typedef struct {
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t stale;
+} share_counts;
+
+typedef struct {
+    share_counts slots[SHARE_RATE_SLOTS];
+    share_counts total; // sum of the slots
+    uint32_t minute;    // minute of the newest slot
+} share_rate;
+
+void share_rate_add(share_rate *rate, uint32_t minute, share_result result);
+
+// Counts of the last minutes (up to SHARE_RATE_SLOTS), including the current one
+share_counts share_rate_sum(share_rate *rate, uint32_t minute, uint32_t minutes);
+
+#endif /* SHARE_STATS_H_ */
@@ -3,9 +3,12 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <sys/time.h>
 #include <esp_transport.h>
 
+#include "stratum_line_reader.h"
+
 #define MAX_MERKLE_BRANCHES 32
 #define HASH_SIZE 32
 #define COINBASE_SIZE 100
@@ -82,14 +85,28 @@ esp_transport_handle_t STRATUM_V1_transport_init(tls_mode tls, char * cert);
 
 void STRATUM_V1_initialize_buffer();
 
+// Returns the next line from the pool, or NULL on a transport error. The line
+// lives in the receive buffer: it is valid until the next call and must not be freed.
 char *STRATUM_V1_receive_jsonrpc_line(esp_transport_handle_t transport);
 
+// Take over a reader that already holds data received on the connection the
+// next STRATUM_V1_receive_jsonrpc_line calls read from. The reader is left empty.
+void STRATUM_V1_adopt_reader(stratum_line_reader *reader);
+
+void STRATUM_V1_get_reader_stats(uint64_t *bytes_received, uint32_t *lines_parsed);
+
 int STRATUM_V1_subscribe(esp_transport_handle_t transport, int send_uid, const char * model);
 
 bool STRATUM_V1_parse(StratumApiV1Message *message, const char *stratum_json);
 
 void STRATUM_V1_reset_message(StratumApiV1Message *message);
 
+// Allocates a mining_notify with room for the given string lengths (excluding
+// the terminator) and merkle branches in the same block.
+mining_notify *STRATUM_V1_alloc_mining_notify(size_t job_id_len, size_t prev_block_hash_len,
+                                             size_t coinbase_1_len, size_t coinbase_2_len,
+                                             size_t n_merkle_branches);
+
 void STRATUM_V1_free_mining_notify(mining_notify *params);
 
 int STRATUM_V1_authorize(esp_transport_handle_t transport, int send_uid, const char *username, const char *pass);
@@ -104,6 +121,16 @@ int STRATUM_V1_suggest_difficulty(esp_transport_handle_t transport, int send_uid
 
 int STRATUM_V1_extranonce_subscribe(esp_transport_handle_t transport, int send_uid);
 
+// Formats one newline-terminated mining.submit line into buf.
+// Returns its length, or -1 if it does not fit.
+int STRATUM_V1_format_submit(char *buf, size_t size, int send_uid, const char *username, const char *job_id,
+                             const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
+                             const uint32_t version_bits);
+
+// Writes count formatted mining.submit lines in a single transport write.
+int STRATUM_V1_submit_batch(esp_transport_handle_t transport, const char *msgs, size_t len,
+                            const int *send_uids, int count, uint64_t *out_sent_time_us);
+
 int STRATUM_V1_submit_share(esp_transport_handle_t transport, int send_uid, const char *username, const char *job_id,
                             const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
                             const uint32_t version_bits, uint64_t *out_sent_time_us);
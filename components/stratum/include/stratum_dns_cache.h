@@ -0,0 +1,66 @@
+#ifndef STRATUM_DNS_CACHE_H_
+#define STRATUM_DNS_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+
+// Resolved pool addresses, kept so reconnects and heartbeat probes don't go
+// through the router's DNS every time. Addresses that failed to connect are
+// held back for a while so retries try the other records first. Times are
+// passed in by the caller (esp_timer_get_time()).
+
+#define DNS_CACHE_ENTRIES 4
+#define DNS_CACHE_MAX_ADDRS 4
+#define DNS_CACHE_HOSTNAME_LEN 254 // longest DNS name plus NUL
+
+// getaddrinfo doesn't report the record TTL, so entries live for a fixed time
+#define DNS_CACHE_TTL_US (5 * 60 * 1000000LL)
+#define DNS_CACHE_FAILED_HOLD_US (60 * 1000000LL)
+
+typedef struct {
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    int64_t failed_until_us;
+} dns_cache_addr;
+
+typedef struct {
+    char hostname[DNS_CACHE_HOSTNAME_LEN];
+    uint16_t port;
+    int64_t expires_us;
+    int64_t last_used_us;
+    int count;
+    dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+} dns_cache_entry;
+
+typedef struct {
+    dns_cache_entry entries[DNS_CACHE_ENTRIES];
+} dns_cache;
+
+typedef enum {
+    DNS_CACHE_MISS,
+    DNS_CACHE_FRESH,
+    DNS_CACHE_STALE, // past its TTL, only worth using if resolving again fails
+} dns_cache_status;
+
+void dns_cache_init(dns_cache *cache);
+
+// Replace the addresses of hostname:port with the IPv4 and IPv6 records of a
+// getaddrinfo result, IPv4 first. Returns the number of addresses stored.
+// Addresses that are still in the answer keep their failure hold.
+int dns_cache_store(dns_cache *cache, const char *hostname, uint16_t port, const struct addrinfo *res, int64_t now_us);
+
+// Copy up to max_addrs addresses of hostname:port to addrs, the ones without
+// a failure hold first. Addresses on hold are still returned, last, so a pool
+// whose addresses all failed is tried again rather than not at all.
+dns_cache_status dns_cache_lookup(dns_cache *cache, const char *hostname, uint16_t port, int64_t now_us,
+                                  dns_cache_addr *addrs, int max_addrs, int *count);
+
+// Hold back addr (in every entry it appears in) until DNS_CACHE_FAILED_HOLD_US from now
+void dns_cache_mark_failed(dns_cache *cache, const struct sockaddr *addr, int64_t now_us);
+
+// Clear the failure hold of addr
+void dns_cache_mark_ok(dns_cache *cache, const struct sockaddr *addr);
+
+#endif /* STRATUM_DNS_CACHE_H_ */
@@ -0,0 +1,16 @@
+#ifndef STRATUM_JSON_FAST_H_
+#define STRATUM_JSON_FAST_H_
+
+#include <stdbool.h>
+#include "stratum_api.h"
+
+// Single-pass parser for the messages a pool sends all the time: mining.notify,
+// mining.set_difficulty and plain share results. No cJSON tree is built and
+// notify fields are copied straight into one mining_notify allocation.
+//
+// Returns false without touching message for anything it does not handle
+// (other methods, escaped strings, unusual result shapes, malformed input);
+// the caller then falls back to the cJSON parser.
+bool STRATUM_V1_parse_fast(StratumApiV1Message *message, const char *stratum_json);
+
+#endif /* STRATUM_JSON_FAST_H_ */
@@ -0,0 +1,40 @@
+#ifndef STRATUM_LINE_READER_H_
+#define STRATUM_LINE_READER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Newline-delimited reader for the JSON-RPC stream. Received bytes are appended
+// in place and lines are handed out as NUL-terminated slices of the buffer, so
+// nothing is copied per line. Only bytes that arrived since the last call are
+// scanned for a newline.
+typedef struct {
+    char *buf;
+    size_t size;            // allocated bytes
+    size_t start;           // first byte of the next line
+    size_t scan;            // no newline in [start, scan)
+    size_t end;             // one past the last received byte
+
+    uint64_t bytes_received;
+    uint32_t lines_parsed;
+} stratum_line_reader;
+
+bool stratum_line_reader_init(stratum_line_reader *reader);
+void stratum_line_reader_free(stratum_line_reader *reader);
+
+// Drop any buffered data (e.g. after a transport error), keeping the counters.
+void stratum_line_reader_clear(stratum_line_reader *reader);
+
+// Next complete line without its '\n', or NULL if more data is needed. The
+// slice stays valid until the next call to stratum_line_reader_reserve.
+char *stratum_line_reader_next(stratum_line_reader *reader);
+
+// Space to receive into. Consumed lines are dropped first and the buffer grows
+// or shrinks as needed. Returns NULL if it can't be grown.
+char *stratum_line_reader_reserve(stratum_line_reader *reader, size_t *avail);
+
+// Mark len bytes written to the reserved space as received.
+void stratum_line_reader_commit(stratum_line_reader *reader, size_t len);
+
+#endif /* STRATUM_LINE_READER_H_ */
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "esp_err.h"
 #include "esp_transport.h"
+#include "stratum_api.h"
 #include <lwip/sockets.h>
 #include <lwip/netdb.h>
 
@@ -17,11 +18,21 @@ typedef struct {
     char host_ip[INET6_ADDRSTRLEN + 16];  // IPv6 address + zone identifier (e.g., "fe80::1%wlan0")
 } stratum_connection_info_t;
 
-// Resolve a pool hostname:port into conn_info, preferring IPv4 then IPv6 and
-// handling IPv6 link-local scope ids. Returns ESP_OK on success. Used by both
-// the SV1 and SV2 tasks so DNS resolution stays non-blocking (the resolved IP
-// is passed to esp_transport_connect instead of the hostname).
-esp_err_t stratum_socket_resolve(const char *hostname, uint16_t port, stratum_connection_info_t *conn_info);
+// Resolve a pool hostname:port and connect a transport made by
+// STRATUM_V1_transport_init (TLS handshake included) to it, handling IPv6
+// link-local scope ids. The address is resolved here and the transport
+// connects by IP, so a long DNS timeout doesn't stall esp_transport_connect.
+//
+// Answers are cached (see stratum_dns_cache.h), and a stale answer is used if
+// the DNS server doesn't respond. When the pool has more than one address the
+// first two are raced: the second is dialed 250 ms after the first,
+// or as soon as it fails, and the transport that connects first is kept.
+// Addresses that fail are held back so later connects try the others first.
+//
+// Returns ESP_ERR_NOT_FOUND if the name didn't resolve, ESP_FAIL if no
+// address connected within timeout_ms. conn_info holds the address used.
+esp_err_t stratum_socket_connect(const char *hostname, uint16_t port, tls_mode tls, char *cert, int timeout_ms,
+                                 stratum_connection_info_t *conn_info, esp_transport_handle_t *transport);
 
 // Apply the common pool-socket options (timeouts, TCP_NODELAY, keepalive) used
 // by both the SV1 and SV2 stratum tasks.
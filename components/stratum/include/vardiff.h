@@ -0,0 +1,38 @@
+#ifndef VARDIFF_H_
+#define VARDIFF_H_
+
+#include <stdint.h>
+
+// Local difficulty controller. Picks the difficulty to ask the pool for so
+// shares come at a target rate: from the rate the pool accepted shares at its
+// current difficulty once enough of them came in, from the hashrate before
+// that. A new difficulty is only asked for when it is off by more than
+// VARDIFF_HYSTERESIS, and at most once per VARDIFF_INTERVAL_US.
+
+#define VARDIFF_INTERVAL_US (60 * 1000000LL)
+#define VARDIFF_WINDOW_MAX_US (10 * 60 * 1000000LL) // share rate measured over at most this
+#define VARDIFF_MIN_SHARES 8
+#define VARDIFF_HYSTERESIS 1.5
+#define VARDIFF_MIN_DIFFICULTY 1
+
+typedef struct {
+    double shares_per_minute;
+    double suggested;       // last difficulty asked for, 0 before the first
+    double pool_difficulty; // pool difficulty during the measurement window
+    int64_t window_start_us;
+    uint64_t window_start_shares;
+} vardiff;
+
+void vardiff_init(vardiff *controller, double shares_per_minute, int64_t now_us, uint64_t accepted_shares);
+
+// Difficulty that gives shares_per_minute at hashrate_ghs, 0 if the hashrate isn't known
+double vardiff_difficulty_for(double hashrate_ghs, double shares_per_minute);
+
+// Remember a difficulty asked for outside of vardiff_update (e.g. at authorize)
+void vardiff_set_suggested(vardiff *controller, double difficulty);
+
+// Called with the running count of accepted shares. Returns the difficulty to
+// ask the pool for, or 0 to leave it as it is.
+double vardiff_update(vardiff *controller, int64_t now_us, double pool_difficulty, double hashrate_ghs, uint64_t accepted_shares);
+
+#endif /* VARDIFF_H_ */
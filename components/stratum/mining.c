@@ -1,17 +1,14 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdlib.h>
 #include "mining.h"
 #include "utils.h"
 #include "mbedtls/sha256.h"
 #include "esp_log.h"
 
-void free_bm_job(bm_job *job)
-{
-    free(job->jobid);
-    free(job->extranonce2);
-    free(job);
-}
+// truediffone / 2^192: the top 64 hash bits of a difficulty 1 share
+#define TOP64_DIFF_ONE 4294901760.0
 
 void calculate_coinbase_tx_hash(const char *coinbase_1, const char *coinbase_2, const char *extranonce, const char *extranonce_2, uint8_t dest[32])
 {
@@ -53,6 +50,117 @@ void calculate_coinbase_tx_hash_bin(const uint8_t *prefix, size_t prefix_len,
     free(buf);
 }
 
+static int coinbase_template_alloc(coinbase_template *tmpl, size_t coinbase_len, size_t e2_offset, size_t e2_len,
+                                   const uint8_t merkle_branches[][32], int num_merkle_branches)
+{
+    memset(tmpl, 0, sizeof(coinbase_template));
+
+    // coinbase and merkle branches share one allocation
+    size_t branches_len = (size_t)num_merkle_branches * 32;
+    uint8_t *buf = malloc(coinbase_len + branches_len);
+    if (!buf) return -1;
+
+    tmpl->merkle_branches = (uint8_t(*)[32])buf;
+    tmpl->n_merkle_branches = num_merkle_branches;
+    if (branches_len > 0) {
+        memcpy(buf, merkle_branches, branches_len);
+    }
+
+    tmpl->coinbase = buf + branches_len;
+    tmpl->coinbase_len = coinbase_len;
+    tmpl->extranonce_2_offset = e2_offset;
+    tmpl->extranonce_2_len = e2_len;
+    return 0;
+}
+
+// absorb every full block in front of extranonce_2 into the cached context
+static void coinbase_template_hash_prefix(coinbase_template *tmpl)
+{
+    memset(tmpl->coinbase + tmpl->extranonce_2_offset, 0, tmpl->extranonce_2_len);
+
+    tmpl->prefix_hashed_len = tmpl->extranonce_2_offset & ~(size_t)63;
+
+    mbedtls_sha256_init(&tmpl->prefix_ctx);
+    mbedtls_sha256_starts(&tmpl->prefix_ctx, 0);
+    mbedtls_sha256_update(&tmpl->prefix_ctx, tmpl->coinbase, tmpl->prefix_hashed_len);
+}
+
+int coinbase_template_init(coinbase_template *tmpl,
+                           const uint8_t *prefix, size_t prefix_len,
+                           const uint8_t *extranonce_prefix, size_t ep_len,
+                           size_t e2_len,
+                           const uint8_t *suffix, size_t suffix_len,
+                           const uint8_t merkle_branches[][32], int num_merkle_branches)
+{
+    size_t e2_offset = prefix_len + ep_len;
+    if (coinbase_template_alloc(tmpl, e2_offset + e2_len + suffix_len, e2_offset, e2_len,
+                                merkle_branches, num_merkle_branches) != 0) {
+        return -1;
+    }
+
+    memcpy(tmpl->coinbase, prefix, prefix_len);
+    memcpy(tmpl->coinbase + prefix_len, extranonce_prefix, ep_len);
+    memcpy(tmpl->coinbase + e2_offset + e2_len, suffix, suffix_len);
+
+    coinbase_template_hash_prefix(tmpl);
+    return 0;
+}
+
+int coinbase_template_init_hex(coinbase_template *tmpl, const char *coinbase_1, const char *coinbase_2,
+                               const char *extranonce, size_t e2_len,
+                               const uint8_t merkle_branches[][32], int num_merkle_branches)
+{
+    size_t len1 = strlen(coinbase_1) / 2;
+    size_t len2 = strlen(extranonce) / 2;
+    size_t len4 = strlen(coinbase_2) / 2;
+
+    size_t e2_offset = len1 + len2;
+    if (coinbase_template_alloc(tmpl, e2_offset + e2_len + len4, e2_offset, e2_len,
+                                merkle_branches, num_merkle_branches) != 0) {
+        return -1;
+    }
+
+    hex2bin(coinbase_1, tmpl->coinbase, len1);
+    hex2bin(extranonce, tmpl->coinbase + len1, len2);
+    hex2bin(coinbase_2, tmpl->coinbase + e2_offset + e2_len, len4);
+
+    coinbase_template_hash_prefix(tmpl);
+    return 0;
+}
+
+void coinbase_template_coinbase_hash(const coinbase_template *tmpl, const uint8_t *extranonce_2, uint8_t dest[32])
+{
+    size_t tail_offset = tmpl->extranonce_2_offset + tmpl->extranonce_2_len;
+    uint8_t first_hash_output[32];
+
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_clone(&ctx, &tmpl->prefix_ctx);
+    mbedtls_sha256_update(&ctx, tmpl->coinbase + tmpl->prefix_hashed_len, tmpl->extranonce_2_offset - tmpl->prefix_hashed_len);
+    mbedtls_sha256_update(&ctx, extranonce_2, tmpl->extranonce_2_len);
+    mbedtls_sha256_update(&ctx, tmpl->coinbase + tail_offset, tmpl->coinbase_len - tail_offset);
+    mbedtls_sha256_finish(&ctx, first_hash_output);
+    mbedtls_sha256_free(&ctx);
+
+    mbedtls_sha256(first_hash_output, 32, dest, 0);
+}
+
+void coinbase_template_merkle_root(const coinbase_template *tmpl, const uint8_t *extranonce_2, uint8_t dest[32])
+{
+    uint8_t coinbase_tx_hash[32];
+    coinbase_template_coinbase_hash(tmpl, extranonce_2, coinbase_tx_hash);
+    calculate_merkle_root_hash(coinbase_tx_hash, (const uint8_t(*)[32])tmpl->merkle_branches, tmpl->n_merkle_branches, dest);
+}
+
+void coinbase_template_free(coinbase_template *tmpl)
+{
+    if (tmpl->merkle_branches == NULL) return;
+
+    mbedtls_sha256_free(&tmpl->prefix_ctx);
+    free(tmpl->merkle_branches);
+    memset(tmpl, 0, sizeof(coinbase_template));
+}
+
 void calculate_merkle_root_hash(const uint8_t coinbase_tx_hash[32], const uint8_t merkle_branches[][32], const int num_merkle_branches, uint8_t dest[32])
 {
     uint8_t both_merkles[64];
@@ -80,40 +188,7 @@ void construct_bm_job(mining_notify *params, const uint8_t merkle_root[32], cons
     reverse_endianness_per_word(prev_block_hash);
     reverse_32bit_words(prev_block_hash, new_job->prev_block_hash);
 
-    // make the midstate hash
-    uint8_t midstate_data[64];
-
-    // copy 64 bytes header data into midstate (and deal with endianess)
-    memcpy(midstate_data, &new_job->version, 4);      // copy version
-    memcpy(midstate_data + 4, prev_block_hash, 32);   // copy prev_block_hash
-    memcpy(midstate_data + 36, merkle_root, 28);      // copy merkle_root
-
-    uint8_t midstate[32];
-    midstate_sha256_bin(midstate_data, 64, midstate); // make the midstate hash
-    reverse_32bit_words(midstate, new_job->midstate); // reverse the midstate words for the BM job packet
-
-    if (version_mask != 0)
-    {
-        uint32_t rolled_version = increment_bitmask(new_job->version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, new_job->midstate1);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, new_job->midstate2);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, new_job->midstate3);
-        new_job->num_midstates = 4;
-    }
-    else
-    {
-        new_job->num_midstates = 1;
-    }
+    new_job->version_mask = version_mask;
 }
 
 void extranonce_2_generate(uint64_t extranonce_2, uint32_t length, char dest[static length * 2 + 1])
@@ -131,25 +206,58 @@ void extranonce_2_generate(uint64_t extranonce_2, uint32_t length, char dest[sta
     bin2hex(extranonce_2_bytes, length, dest, length * 2 + 1);
 }
 
+// first 64 bytes of the block header: version, prev_block_hash and merkle_root[0:28]
+static void nonce_header_head(const bm_job *job, const uint32_t rolled_version, uint8_t head[64])
+{
+    uint8_t merkle_root[32];
+    reverse_32bit_words(job->merkle_root, merkle_root);
+
+    memcpy(head, &rolled_version, 4);
+    reverse_32bit_words(job->prev_block_hash, head + 4);
+    memcpy(head + 36, merkle_root, 28);
+}
+
+// last 16 bytes of the block header: merkle_root[28:32], ntime, nbits and nonce
+static void nonce_header_tail(const bm_job *job, const uint32_t nonce, uint8_t tail[16])
+{
+    // word 0 of the reversed merkle root is the last header word
+    memcpy(tail, job->merkle_root, 4);
+    memcpy(tail + 4, &job->ntime, 4);
+    memcpy(tail + 8, &job->target, 4);
+    memcpy(tail + 12, &nonce, 4);
+}
+
+// midstates for drivers that send them (BM1397): the base version, then
+// version_mask rolled once per extra midstate
+void construct_bm_job_midstates(const bm_job *job, const bm_job_format *format, bm_job_midstates *dest)
+{
+    uint8_t num_midstates = format->max_midstates;
+    if (num_midstates > 1 && job->version_mask == 0) {
+        num_midstates = 1;
+    }
+
+    uint8_t head[64];
+    uint32_t rolled_version = job->version;
+    for (int i = 0; i < num_midstates; i++) {
+        nonce_header_head(job, rolled_version, head);
+
+        uint8_t midstate[32];
+        midstate_sha256_bin(head, 64, midstate);
+        reverse_32bit_words(midstate, dest->midstate[i]);
+
+        rolled_version = increment_bitmask(rolled_version, job->version_mask);
+    }
+    dest->num_midstates = num_midstates;
+}
+
 ///////cgminer nonce testing
 /* testing a nonce and return the diff - 0 means invalid */
 double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t rolled_version)
 {
     uint8_t header[80];
 
-    // // TODO: use the midstate hash instead of hashing the whole header
-    // uint32_t rolled_version = job->version;
-    // for (int i = 0; i < midstate_index; i++) {
-    //     rolled_version = increment_bitmask(rolled_version, job->version_mask);
-    // }
-
-    // copy data from job to header
-    memcpy(header, &rolled_version, 4);
-    reverse_32bit_words(job->prev_block_hash, header + 4);
-    reverse_32bit_words(job->merkle_root, header + 36);
-    memcpy(header + 68, &job->ntime, 4);
-    memcpy(header + 72, &job->target, 4);
-    memcpy(header + 76, &nonce, 4);
+    nonce_header_head(job, rolled_version, header);
+    nonce_header_tail(job, nonce, header + 64);
 
     uint8_t hash_result[32];
     double_sha256_bin(header, 80, hash_result);
@@ -159,6 +267,74 @@ double test_nonce_value(const bm_job *job, const uint32_t nonce, const uint32_t
     return d64 / s64;
 }
 
+void nonce_midstate_cache_init(nonce_midstate_cache *cache)
+{
+    memset(cache, 0, sizeof(nonce_midstate_cache));
+    for (int i = 0; i < NONCE_MIDSTATE_CACHE_SIZE; i++) {
+        mbedtls_sha256_init(&cache->entries[i].ctx);
+    }
+}
+
+static const mbedtls_sha256_context *nonce_midstate_lookup(nonce_midstate_cache *cache, const bm_job *job, const uint32_t rolled_version)
+{
+    for (int i = 0; i < NONCE_MIDSTATE_CACHE_SIZE; i++) {
+        nonce_midstate_entry *entry = &cache->entries[i];
+        if (entry->valid && entry->rolled_version == rolled_version && memcmp(entry->merkle_root, job->merkle_root, 32) == 0) {
+            return &entry->ctx;
+        }
+    }
+
+    // miss: replace the oldest entry
+    nonce_midstate_entry *entry = &cache->entries[cache->next];
+    cache->next = (cache->next + 1) % NONCE_MIDSTATE_CACHE_SIZE;
+
+    uint8_t head[64];
+    nonce_header_head(job, rolled_version, head);
+
+    mbedtls_sha256_free(&entry->ctx);
+    mbedtls_sha256_init(&entry->ctx);
+    mbedtls_sha256_starts(&entry->ctx, 0);
+    mbedtls_sha256_update(&entry->ctx, head, 64);
+
+    entry->rolled_version = rolled_version;
+    memcpy(entry->merkle_root, job->merkle_root, 32);
+    entry->valid = true;
+    return &entry->ctx;
+}
+
+/* same as test_nonce_value, but resumes from a cached midstate and returns 0
+   without the 256-bit conversion when the hash cannot reach min_diff */
+double test_nonce_value_cached(nonce_midstate_cache *cache, const bm_job *job, const uint32_t nonce,
+                               const uint32_t rolled_version, const double min_diff)
+{
+    uint8_t tail[16];
+    nonce_header_tail(job, nonce, tail);
+
+    uint8_t hash_result[32];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_clone(&ctx, nonce_midstate_lookup(cache, job, rolled_version));
+    mbedtls_sha256_update(&ctx, tail, 16);
+    mbedtls_sha256_finish(&ctx, hash_result);
+    mbedtls_sha256_free(&ctx);
+
+    mbedtls_sha256(hash_result, 32, hash_result, 0);
+
+    // diff >= min_diff needs hash <= truediffone / min_diff; the top 64 bits alone
+    // are enough to reject anything clearly above that
+    if (min_diff > 0) {
+        uint64_t top;
+        memcpy(&top, hash_result + 24, 8);
+        if ((double)top > TOP64_DIFF_ONE / min_diff) {
+            return 0;
+        }
+    }
+
+    double d64 = truediffone;
+    double s64 = le256todouble(hash_result);
+    return d64 / s64;
+}
+
 uint32_t increment_bitmask(const uint32_t value, const uint32_t mask)
 {
     // if mask is zero, just return the original value
@@ -0,0 +1,43 @@
+// mining_notify storage, kept out of stratum_api.c so it builds without cJSON or the transport
+
+#include "stratum_api.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+
+static const char *TAG = "stratum_api";
+
+mining_notify *STRATUM_V1_alloc_mining_notify(size_t job_id_len, size_t prev_block_hash_len,
+                                             size_t coinbase_1_len, size_t coinbase_2_len,
+                                             size_t n_merkle_branches)
+{
+    size_t size = sizeof(mining_notify) + HASH_SIZE * n_merkle_branches +
+                  job_id_len + 1 + prev_block_hash_len + 1 + coinbase_1_len + 1 + coinbase_2_len + 1;
+
+    mining_notify *new_work = calloc(1, size);
+    if (!new_work) {
+        ESP_LOGE(TAG, "Memory allocation failed for mining_notify");
+        return NULL;
+    }
+
+    char *p = (char *)(new_work + 1);
+    new_work->merkle_branches = (uint8_t *)p;
+    p += HASH_SIZE * n_merkle_branches;
+    new_work->job_id = p;
+    p += job_id_len + 1;
+    new_work->prev_block_hash = p;
+    p += prev_block_hash_len + 1;
+    new_work->coinbase_1 = p;
+    p += coinbase_1_len + 1;
+    new_work->coinbase_2 = p;
+    new_work->n_merkle_branches = n_merkle_branches;
+
+    return new_work;
+}
+
+void STRATUM_V1_free_mining_notify(mining_notify * params)
+{
+    // strings and merkle branches share the allocation
+    free(params);
+}
@@ -0,0 +1,120 @@
+#include <math.h>
+#include <string.h>
+
+#include "share_stats.h"
+
+static int latency_bucket(uint32_t ms)
+{
+    if (ms >= (1u << LATENCY_MAX_BITS)) {
+        ms = (1u << LATENCY_MAX_BITS) - 1;
+    }
+    if (ms < LATENCY_SUB_BUCKETS) {
+        return ms;
+    }
+    int shift = (31 - __builtin_clz(ms)) - (LATENCY_SUB_BUCKET_BITS - 1);
+    return shift * (LATENCY_SUB_BUCKETS / 2) + (ms >> shift);
+}
+
+// Middle of the values counted in bucket
+static uint32_t latency_bucket_value(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / (LATENCY_SUB_BUCKETS / 2) - 1;
+    uint32_t lowest = (uint32_t)(bucket - shift * (LATENCY_SUB_BUCKETS / 2)) << shift;
+    return lowest + ((1u << shift) - 1) / 2;
+}
+
+void latency_histogram_record(latency_histogram *histogram, uint32_t ms)
+{
+    histogram->counts[latency_bucket(ms)]++;
+    histogram->total++;
+    if (ms > histogram->max_ms) {
+        histogram->max_ms = ms;
+    }
+}
+
+uint32_t latency_histogram_percentile(const latency_histogram *histogram, float percentile)
+{
+    if (histogram->total == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (uint32_t)ceilf(histogram->total * percentile / 100.0f);
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            uint32_t value = latency_bucket_value(i);
+            return value < histogram->max_ms ? value : histogram->max_ms;
+        }
+    }
+    return histogram->max_ms;
+}
+
+// Move the newest slot up to minute, dropping the slots that fall out of the hour
+static void share_rate_advance(share_rate *rate, uint32_t minute)
+{
+    if (minute <= rate->minute) {
+        return;
+    }
+
+    if (minute - rate->minute >= SHARE_RATE_SLOTS) {
+        memset(rate->slots, 0, sizeof(rate->slots));
+        memset(&rate->total, 0, sizeof(rate->total));
+    } else {
+        for (uint32_t m = rate->minute + 1; m <= minute; m++) {
+            share_counts *slot = &rate->slots[m % SHARE_RATE_SLOTS];
+            rate->total.accepted -= slot->accepted;
+            rate->total.rejected -= slot->rejected;
+            rate->total.stale -= slot->stale;
+            memset(slot, 0, sizeof(share_counts));
+        }
+    }
+    rate->minute = minute;
+}
+
+void share_rate_add(share_rate *rate, uint32_t minute, share_result result)
+{
+    share_rate_advance(rate, minute);
+
+    // A result timestamped before the newest slot (clock raced) goes into it
+    share_counts *slot = &rate->slots[rate->minute % SHARE_RATE_SLOTS];
+    switch (result) {
+        case SHARE_ACCEPTED:
+            slot->accepted++;
+            rate->total.accepted++;
+            break;
+        case SHARE_REJECTED:
+            slot->rejected++;
+            rate->total.rejected++;
+            break;
+        case SHARE_STALE:
+            slot->stale++;
+            rate->total.stale++;
+            break;
+    }
+}
+
+share_counts share_rate_sum(share_rate *rate, uint32_t minute, uint32_t minutes)
+{
+    share_rate_advance(rate, minute);
+
+    if (minutes >= SHARE_RATE_SLOTS) {
+        return rate->total;
+    }
+
+    share_counts sum = { 0 };
+    for (uint32_t i = 0; i < minutes && i <= rate->minute; i++) {
+        const share_counts *slot = &rate->slots[(rate->minute - i) % SHARE_RATE_SLOTS];
+        sum.accepted += slot->accepted;
+        sum.rejected += slot->rejected;
+        sum.stale += slot->stale;
+    }
+    return sum;
+}
@@ -13,6 +13,8 @@
 #include "esp_transport_tcp.h"
 #include "esp_crt_bundle.h"
 #include "utils.h"
+#include "stratum_line_reader.h"
+#include "stratum_json_fast.h"
 #include "esp_timer.h"
 #include "esp_heap_caps.h"
 #include <stdio.h>
@@ -25,8 +27,7 @@
 #define MAX_EXTRANONCE_2_LEN 32
 static const char * TAG = "stratum_api";
 
-static char * json_rpc_buffer = NULL;
-static size_t json_rpc_buffer_size = 0;
+static stratum_line_reader json_rpc_reader;
 
 static RequestTiming *request_timings = NULL;
 
@@ -93,15 +94,12 @@ esp_transport_handle_t STRATUM_V1_transport_init(tls_mode tls, char * cert)
 void STRATUM_V1_initialize_buffer()
 {
     // Free any existing buffer (may be non-NULL if a previous V1 task was running)
-    free(json_rpc_buffer);
+    stratum_line_reader_free(&json_rpc_reader);
 
-    json_rpc_buffer = malloc(BUFFER_SIZE);
-    json_rpc_buffer_size = BUFFER_SIZE;
-    if (json_rpc_buffer == NULL) {
+    if (!stratum_line_reader_init(&json_rpc_reader)) {
         printf("Error: Failed to allocate memory for buffer\n");
         exit(1);
     }
-    memset(json_rpc_buffer, 0, BUFFER_SIZE);
 
     if (request_timings == NULL) {
         request_timings = heap_caps_malloc(sizeof(RequestTiming) * MAX_REQUEST_IDS, MALLOC_CAP_SPIRAM);
@@ -119,52 +117,30 @@ void STRATUM_V1_initialize_buffer()
 
 void cleanup_stratum_buffer()
 {
-    free(json_rpc_buffer);
-    json_rpc_buffer = NULL;
+    stratum_line_reader_free(&json_rpc_reader);
     if (request_timings) {
         free(request_timings);
         request_timings = NULL;
     }
 }
 
-static void realloc_json_buffer(size_t len)
-{
-    size_t old, new;
-
-    old = strlen(json_rpc_buffer);
-    new = old + len + 1;
-
-    if (new < json_rpc_buffer_size) {
-        return;
-    }
-
-    new = new + (BUFFER_SIZE - (new % BUFFER_SIZE));
-    void * new_sockbuf = realloc(json_rpc_buffer, new);
-
-    if (new_sockbuf == NULL) {
-        fprintf(stderr, "Error: realloc failed in recalloc_sock()\n");
-        ESP_LOGI(TAG, "Restarting System because of ERROR: realloc failed in recalloc_sock");
-        vTaskDelay(1000 / portTICK_PERIOD_MS);
-        esp_restart();
-    }
-
-    json_rpc_buffer = new_sockbuf;
-    memset(json_rpc_buffer + old, 0, new - old);
-    json_rpc_buffer_size = new;
-}
-
 char * STRATUM_V1_receive_jsonrpc_line(esp_transport_handle_t transport)
 {
-    if (json_rpc_buffer == NULL) {
+    if (json_rpc_reader.buf == NULL) {
         STRATUM_V1_initialize_buffer();
     }
-    char *line = NULL;
-    char recv_buffer[BUFFER_SIZE];
-    int nbytes;
 
-    while (!strstr(json_rpc_buffer, "\n")) {
-        memset(recv_buffer, 0, BUFFER_SIZE);
-        nbytes = esp_transport_read(transport, recv_buffer, BUFFER_SIZE - 1, TRANSPORT_TIMEOUT_MS);
+    char *line;
+    while ((line = stratum_line_reader_next(&json_rpc_reader)) == NULL) {
+        size_t avail;
+        char *dest = stratum_line_reader_reserve(&json_rpc_reader, &avail);
+        if (dest == NULL) {
+            ESP_LOGI(TAG, "Restarting System because of ERROR: realloc failed for the JSON-RPC buffer");
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            esp_restart();
+        }
+
+        int nbytes = esp_transport_read(transport, dest, avail, TRANSPORT_TIMEOUT_MS);
         if (nbytes < 0) {
             const char *err_str;
             switch(nbytes) {
@@ -182,35 +158,27 @@ char * STRATUM_V1_receive_jsonrpc_line(esp_transport_handle_t transport)
                     break;
             }
             ESP_LOGE(TAG, "Error: transport read failed: %s (code: %d)", err_str, nbytes);
-            if (json_rpc_buffer) {
-                free(json_rpc_buffer);
-                json_rpc_buffer = NULL;
-            }
+            stratum_line_reader_clear(&json_rpc_reader);
             return NULL;
         }
-        if (nbytes > 0) {
-            realloc_json_buffer(nbytes);
-            strncat(json_rpc_buffer, recv_buffer, nbytes);
-        }
-    }
-
-    // Extract the line
-    size_t buflen = strlen(json_rpc_buffer);
-    char *newline_pos = strchr(json_rpc_buffer, '\n');
-    if (newline_pos) {
-        size_t line_len = newline_pos - json_rpc_buffer;
-        line = strndup(json_rpc_buffer, line_len);  // Copy only up to \n
-        size_t remaining_len = buflen - line_len - 1;
-        if (remaining_len > 0) {
-            memmove(json_rpc_buffer, newline_pos + 1, remaining_len);
-            json_rpc_buffer[remaining_len] = '\0';
-        } else {
-            json_rpc_buffer[0] = '\0';
-        }
+        stratum_line_reader_commit(&json_rpc_reader, nbytes);
     }
     return line;
 }
 
+void STRATUM_V1_adopt_reader(stratum_line_reader *reader)
+{
+    stratum_line_reader_free(&json_rpc_reader);
+    json_rpc_reader = *reader;
+    memset(reader, 0, sizeof(*reader));
+}
+
+void STRATUM_V1_get_reader_stats(uint64_t *bytes_received, uint32_t *lines_parsed)
+{
+    *bytes_received = json_rpc_reader.bytes_received;
+    *lines_parsed = json_rpc_reader.lines_parsed;
+}
+
 void STRATUM_V1_reset_message(StratumApiV1Message *message)
 {
     if (message->error_str) {
@@ -277,45 +245,38 @@ static bool parse_mining_notify(cJSON *json, StratumApiV1Message *message)
         return false;
     }
 
-    mining_notify *new_work = calloc(1, sizeof(mining_notify));
-    if (!new_work) {
-        ESP_LOGE(TAG, "Memory allocation failed for mining_notify");
-        return false;
-    }
-
-    cJSON *job_id_item = cJSON_GetArrayItem(params, 0);
-    if (!job_id_item || !cJSON_IsString(job_id_item)) {
-        ESP_LOGE(TAG, "Invalid job_id in mining.notify");
-        free(new_work);
-        return false;
+    const char *fields[4];
+    for (int i = 0; i < 4; i++) {
+        cJSON *item = cJSON_GetArrayItem(params, i);
+        if (!item || !cJSON_IsString(item)) {
+            ESP_LOGE(TAG, "Invalid %s in mining.notify", i == 0 ? "job_id" : "hex field");
+            return false;
+        }
+        fields[i] = item->valuestring;
     }
 
-    new_work->job_id = strdup(job_id_item->valuestring);
-    new_work->prev_block_hash = strdup(cJSON_GetArrayItem(params, 1)->valuestring);
-    new_work->coinbase_1 = strdup(cJSON_GetArrayItem(params, 2)->valuestring);
-    new_work->coinbase_2 = strdup(cJSON_GetArrayItem(params, 3)->valuestring);
-
     cJSON *merkle_branch = cJSON_GetArrayItem(params, 4);
     if (!merkle_branch || !cJSON_IsArray(merkle_branch)) {
         ESP_LOGE(TAG, "Invalid merkle_branch in mining.notify");
-        free(new_work->job_id);
-        free(new_work->prev_block_hash);
-        free(new_work->coinbase_1);
-        free(new_work->coinbase_2);
-        free(new_work);
         return false;
     }
-    new_work->n_merkle_branches = cJSON_GetArraySize(merkle_branch);
-    if (new_work->n_merkle_branches > MAX_MERKLE_BRANCHES) {
-        ESP_LOGE(TAG, "Too many Merkle branches: %zu", new_work->n_merkle_branches);
-        free(new_work->job_id);
-        free(new_work->prev_block_hash);
-        free(new_work->coinbase_1);
-        free(new_work->coinbase_2);
-        free(new_work);
+    size_t n_merkle_branches = cJSON_GetArraySize(merkle_branch);
+    if (n_merkle_branches > MAX_MERKLE_BRANCHES) {
+        ESP_LOGE(TAG, "Too many Merkle branches: %zu", n_merkle_branches);
+        return false;
+    }
+
+    mining_notify *new_work = STRATUM_V1_alloc_mining_notify(strlen(fields[0]), strlen(fields[1]),
+                                                             strlen(fields[2]), strlen(fields[3]),
+                                                             n_merkle_branches);
+    if (!new_work) {
         return false;
     }
-    new_work->merkle_branches = malloc(HASH_SIZE * new_work->n_merkle_branches);
+
+    strcpy(new_work->job_id, fields[0]);
+    strcpy(new_work->prev_block_hash, fields[1]);
+    strcpy(new_work->coinbase_1, fields[2]);
+    strcpy(new_work->coinbase_2, fields[3]);
     for (size_t i = 0; i < new_work->n_merkle_branches; i++) {
         hex2bin(cJSON_GetArrayItem(merkle_branch, i)->valuestring, new_work->merkle_branches + HASH_SIZE * i, HASH_SIZE);
     }
@@ -554,6 +515,10 @@ bool STRATUM_V1_parse(StratumApiV1Message *message, const char *stratum_json)
 
     ESP_LOGI(TAG, "rx: %s", stratum_json); // debug incoming stratum messages
 
+    if (STRATUM_V1_parse_fast(message, stratum_json)) {
+        return true;
+    }
+
     cJSON *json = cJSON_Parse(stratum_json);
     if (!json) {
         ESP_LOGE(TAG, "JSON parse failed: %s", stratum_json);
@@ -614,16 +579,6 @@ bool STRATUM_V1_parse(StratumApiV1Message *message, const char *stratum_json)
     return result;
 }
 
-void STRATUM_V1_free_mining_notify(mining_notify * params)
-{
-    free(params->job_id);
-    free(params->prev_block_hash);
-    free(params->coinbase_1);
-    free(params->coinbase_2);
-    free(params->merkle_branches);
-    free(params);
-}
-
 static void stamp_tx(int request_id, uint64_t timestamp_us)
 {
     if (request_id >= 1) {
@@ -725,29 +680,59 @@ int STRATUM_V1_send_version(esp_transport_handle_t transport, int message_id)
 /// @param nonce The hex-encoded nonce value to use in the block header.
 /// @param version_bits The hex-encoded version bits set by miner (BIP310).
 /// @param out_sent_time_us Pointer to store the time when the share was sent.
-int STRATUM_V1_submit_share(esp_transport_handle_t transport, int send_uid, const char * username, const char * job_id,
-                            const char * extranonce_2, const uint32_t ntime,
-                            const uint32_t nonce, const uint32_t version_bits, uint64_t *out_sent_time_us)
+int STRATUM_V1_format_submit(char * buf, size_t size, int send_uid, const char * username, const char * job_id,
+                             const char * extranonce_2, const uint32_t ntime,
+                             const uint32_t nonce, const uint32_t version_bits)
 {
-    char submit_msg[BUFFER_SIZE];
-    snprintf(submit_msg, sizeof(submit_msg),
+    int len = snprintf(buf, size,
         "{\"id\":%d,\"method\":\"mining.submit\",\"params\":[\"%s\",\"%s\",\"%s\",\"%08lx\",\"%08lx\",\"%08lx\"]}\n",
         send_uid, username, job_id, extranonce_2, ntime, nonce, version_bits);
 
-    int ret = esp_transport_write(transport, submit_msg, strlen(submit_msg), TRANSPORT_TIMEOUT_MS);
+    if (len < 0 || (size_t) len >= size) {
+        return -1;
+    }
+    return len;
+}
+
+int STRATUM_V1_submit_batch(esp_transport_handle_t transport, const char * msgs, size_t len,
+                            const int * send_uids, int count, uint64_t *out_sent_time_us)
+{
+    int ret = esp_transport_write(transport, msgs, len, TRANSPORT_TIMEOUT_MS);
 
     uint64_t now = esp_timer_get_time();
     if (out_sent_time_us) {
         *out_sent_time_us = now;
     }
 
-    debug_stratum_tx(submit_msg);
-    
-    stamp_tx(send_uid, now);
+    const char *line = msgs;
+    for (int i = 0; i < count && line < msgs + len; i++) {
+        debug_stratum_tx(line);
+        stamp_tx(send_uids[i], now);
+
+        const char *newline = memchr(line, '\n', msgs + len - line);
+        if (!newline) {
+            break;
+        }
+        line = newline + 1;
+    }
 
     return ret;
 }
 
+int STRATUM_V1_submit_share(esp_transport_handle_t transport, int send_uid, const char * username, const char * job_id,
+                            const char * extranonce_2, const uint32_t ntime,
+                            const uint32_t nonce, const uint32_t version_bits, uint64_t *out_sent_time_us)
+{
+    char submit_msg[BUFFER_SIZE];
+    int len = STRATUM_V1_format_submit(submit_msg, sizeof(submit_msg), send_uid, username, job_id,
+                                       extranonce_2, ntime, nonce, version_bits);
+    if (len < 0) {
+        return -1;
+    }
+
+    return STRATUM_V1_submit_batch(transport, submit_msg, len, &send_uid, 1, out_sent_time_us);
+}
+
 int STRATUM_V1_configure_version_rolling(esp_transport_handle_t transport, int send_uid, uint32_t * version_mask)
 {
     char configure_msg[BUFFER_SIZE];
@@ -0,0 +1,150 @@
+#include <string.h>
+
+#include "stratum_dns_cache.h"
+
+static bool same_address(const struct sockaddr *a, const struct sockaddr *b)
+{
+    if (a->sa_family != b->sa_family) {
+        return false;
+    }
+    if (a->sa_family == AF_INET) {
+        const struct sockaddr_in *a4 = (const struct sockaddr_in *)a;
+        const struct sockaddr_in *b4 = (const struct sockaddr_in *)b;
+        return a4->sin_port == b4->sin_port &&
+               memcmp(&a4->sin_addr, &b4->sin_addr, sizeof(a4->sin_addr)) == 0;
+    }
+    if (a->sa_family == AF_INET6) {
+        const struct sockaddr_in6 *a6 = (const struct sockaddr_in6 *)a;
+        const struct sockaddr_in6 *b6 = (const struct sockaddr_in6 *)b;
+        return a6->sin6_port == b6->sin6_port &&
+               memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr)) == 0;
+    }
+    return false;
+}
+
+static dns_cache_entry *find_entry(dns_cache *cache, const char *hostname, uint16_t port)
+{
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        dns_cache_entry *entry = &cache->entries[i];
+        if (entry->count > 0 && entry->port == port && strcmp(entry->hostname, hostname) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void dns_cache_init(dns_cache *cache)
+{
+    memset(cache, 0, sizeof(dns_cache));
+}
+
+int dns_cache_store(dns_cache *cache, const char *hostname, uint16_t port, const struct addrinfo *res, int64_t now_us)
+{
+    if (strlen(hostname) >= DNS_CACHE_HOSTNAME_LEN) {
+        return 0;
+    }
+
+    dns_cache_entry *entry = find_entry(cache, hostname, port);
+    if (entry == NULL) {
+        // Take an empty slot, or the least recently used one
+        entry = &cache->entries[0];
+        for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+            if (cache->entries[i].count == 0) {
+                entry = &cache->entries[i];
+                break;
+            }
+            if (cache->entries[i].last_used_us < entry->last_used_us) {
+                entry = &cache->entries[i];
+            }
+        }
+        memset(entry, 0, sizeof(dns_cache_entry));
+    }
+
+    dns_cache_entry previous = *entry;
+
+    entry->count = 0;
+    const int families[] = { AF_INET, AF_INET6 };
+    for (int f = 0; f < 2; f++) {
+        for (const struct addrinfo *p = res; p != NULL && entry->count < DNS_CACHE_MAX_ADDRS; p = p->ai_next) {
+            if (p->ai_family != families[f] || p->ai_addrlen > sizeof(struct sockaddr_storage)) {
+                continue;
+            }
+
+            bool duplicate = false;
+            for (int i = 0; i < entry->count; i++) {
+                duplicate |= same_address((struct sockaddr *)&entry->addrs[i].addr, p->ai_addr);
+            }
+            if (duplicate) {
+                continue;
+            }
+
+            dns_cache_addr *addr = &entry->addrs[entry->count++];
+            memset(addr, 0, sizeof(dns_cache_addr));
+            memcpy(&addr->addr, p->ai_addr, p->ai_addrlen);
+            addr->addrlen = p->ai_addrlen;
+
+            for (int i = 0; i < previous.count; i++) {
+                if (same_address((struct sockaddr *)&previous.addrs[i].addr, p->ai_addr)) {
+                    addr->failed_until_us = previous.addrs[i].failed_until_us;
+                }
+            }
+        }
+    }
+
+    if (entry->count == 0) {
+        memset(entry, 0, sizeof(dns_cache_entry));
+        return 0;
+    }
+
+    strcpy(entry->hostname, hostname);
+    entry->port = port;
+    entry->expires_us = now_us + DNS_CACHE_TTL_US;
+    entry->last_used_us = now_us;
+    return entry->count;
+}
+
+dns_cache_status dns_cache_lookup(dns_cache *cache, const char *hostname, uint16_t port, int64_t now_us,
+                                  dns_cache_addr *addrs, int max_addrs, int *count)
+{
+    *count = 0;
+
+    dns_cache_entry *entry = find_entry(cache, hostname, port);
+    if (entry == NULL) {
+        return DNS_CACHE_MISS;
+    }
+    entry->last_used_us = now_us;
+
+    // Usable addresses in resolver order, then the ones on hold
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < entry->count && *count < max_addrs; i++) {
+            bool on_hold = entry->addrs[i].failed_until_us > now_us;
+            if (on_hold == (pass == 1)) {
+                addrs[(*count)++] = entry->addrs[i];
+            }
+        }
+    }
+
+    return now_us < entry->expires_us ? DNS_CACHE_FRESH : DNS_CACHE_STALE;
+}
+
+static void set_failed_until(dns_cache *cache, const struct sockaddr *addr, int64_t failed_until_us)
+{
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        dns_cache_entry *entry = &cache->entries[i];
+        for (int j = 0; j < entry->count; j++) {
+            if (same_address((struct sockaddr *)&entry->addrs[j].addr, addr)) {
+                entry->addrs[j].failed_until_us = failed_until_us;
+            }
+        }
+    }
+}
+
+void dns_cache_mark_failed(dns_cache *cache, const struct sockaddr *addr, int64_t now_us)
+{
+    set_failed_until(cache, addr, now_us + DNS_CACHE_FAILED_HOLD_US);
+}
+
+void dns_cache_mark_ok(dns_cache *cache, const struct sockaddr *addr)
+{
+    set_failed_until(cache, addr, 0);
+}
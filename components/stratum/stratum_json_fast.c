@@ -0,0 +1,392 @@
+#include "stratum_json_fast.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "esp_log.h"
+#include "utils.h"
+
+static const char *TAG = "stratum_api";
+
+// Nesting allowed while skipping values we don't look at
+#define MAX_SKIP_DEPTH 16
+
+typedef struct
+{
+    const char *start; // first character after the opening quote
+    size_t len;
+    bool escaped;      // contains a backslash escape, left to cJSON to decode
+} json_string;
+
+static const char *skip_ws(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+// p points at the opening quote. Returns the position after the closing quote.
+static const char *parse_string(const char *p, json_string *out)
+{
+    if (*p != '"') return NULL;
+    p++;
+
+    out->start = p;
+    out->escaped = false;
+    while (*p != '"') {
+        if (*p == '\0') return NULL;
+        if (*p == '\\') {
+            out->escaped = true;
+            p++;
+            if (*p == '\0') return NULL;
+        }
+        p++;
+    }
+    out->len = p - out->start;
+    return p + 1;
+}
+
+static bool is_literal(const char *p, const char *literal)
+{
+    return strncmp(p, literal, strlen(literal)) == 0;
+}
+
+static bool is_number_start(const char *p)
+{
+    return (*p >= '0' && *p <= '9') || (*p == '-' && p[1] >= '0' && p[1] <= '9');
+}
+
+// Parses a JSON number; strtod alone would also take hex, inf and nan
+static const char *parse_number(const char *p, double *value)
+{
+    if (!is_number_start(p)) return NULL;
+
+    const char *end = p;
+    while ((*end >= '0' && *end <= '9') || *end == '-' || *end == '+' ||
+           *end == '.' || *end == 'e' || *end == 'E') {
+        end++;
+    }
+
+    char *parsed_end;
+    double parsed = strtod(p, &parsed_end);
+    if (parsed_end != end) return NULL;
+    if (value) *value = parsed;
+    return end;
+}
+
+static const char *skip_value(const char *p, int depth)
+{
+    if (depth > MAX_SKIP_DEPTH) return NULL;
+
+    json_string str;
+    switch (*p) {
+        case '"':
+            return parse_string(p, &str);
+        case '{':
+        case '[': {
+            char close = (*p == '{') ? '}' : ']';
+            p = skip_ws(p + 1);
+            if (*p == close) return p + 1;
+            while (1) {
+                if (close == '}') {
+                    p = parse_string(p, &str);
+                    if (!p) return NULL;
+                    p = skip_ws(p);
+                    if (*p != ':') return NULL;
+                    p = skip_ws(p + 1);
+                }
+                p = skip_value(p, depth + 1);
+                if (!p) return NULL;
+                p = skip_ws(p);
+                if (*p == close) return p + 1;
+                if (*p != ',') return NULL;
+                p = skip_ws(p + 1);
+            }
+        }
+        case 't':
+            return is_literal(p, "true") ? p + 4 : NULL;
+        case 'f':
+            return is_literal(p, "false") ? p + 5 : NULL;
+        case 'n':
+            return is_literal(p, "null") ? p + 4 : NULL;
+        default:
+            return parse_number(p, NULL);
+    }
+}
+
+// Calls back for each element of the array at p. Returns the number of
+// elements, or -1 if the array is malformed or the callback rejects an element.
+typedef bool (*array_element_fn)(const char *value, int index, void *ctx);
+
+static int for_each_element(const char *p, array_element_fn fn, void *ctx)
+{
+    if (*p != '[') return -1;
+    p = skip_ws(p + 1);
+    if (*p == ']') return 0;
+
+    int index = 0;
+    while (1) {
+        if (!fn(p, index, ctx)) return -1;
+        p = skip_value(p, 0);
+        if (!p) return -1;
+        index++;
+        p = skip_ws(p);
+        if (*p == ']') return index;
+        if (*p != ',') return -1;
+        p = skip_ws(p + 1);
+    }
+}
+
+static bool string_equals(const json_string *str, const char *value)
+{
+    return !str->escaped && str->len == strlen(value) && strncmp(str->start, value, str->len) == 0;
+}
+
+static char *copy_string(char *dest, const json_string *str)
+{
+    memcpy(dest, str->start, str->len);
+    dest[str->len] = '\0';
+    return dest;
+}
+
+// Same conversion as cJSON's valueint
+static int number_to_int(double value)
+{
+    if (value >= INT_MAX) return INT_MAX;
+    if (value <= (double)INT_MIN) return INT_MIN;
+    return (int)value;
+}
+
+typedef struct
+{
+    json_string fields[4]; // job_id, prev_block_hash, coinbase_1, coinbase_2
+    const char *merkle_branches[MAX_MERKLE_BRANCHES];
+    int n_merkle_branches;
+    uint32_t words[3];     // version, nbits, ntime
+    bool last_is_true;
+} notify_params;
+
+static bool merkle_branch_element(const char *value, int index, void *ctx)
+{
+    notify_params *params = ctx;
+    json_string str;
+    if (index >= MAX_MERKLE_BRANCHES) return false;
+    if (!parse_string(value, &str) || str.escaped || str.len != HASH_SIZE * 2) return false;
+    params->merkle_branches[index] = str.start;
+    return true;
+}
+
+static bool notify_element(const char *value, int index, void *ctx)
+{
+    notify_params *params = ctx;
+    json_string str;
+
+    params->last_is_true = is_literal(value, "true");
+
+    if (index < 4) {
+        if (!parse_string(value, &params->fields[index]) || params->fields[index].escaped) return false;
+    } else if (index == 4) {
+        int n = for_each_element(value, merkle_branch_element, params);
+        if (n < 0) return false;
+        params->n_merkle_branches = n;
+    } else if (index < 8) {
+        // the closing quote ends strtoul, so the hex word needs no copy
+        if (!parse_string(value, &str) || str.escaped) return false;
+        params->words[index - 5] = strtoul(str.start, NULL, 16);
+    }
+    return true;
+}
+
+static bool parse_notify(const char *params_json, StratumApiV1Message *message)
+{
+    notify_params params = { 0 };
+    if (!params_json || for_each_element(params_json, notify_element, &params) < 8) {
+        return false;
+    }
+
+    mining_notify *new_work = STRATUM_V1_alloc_mining_notify(params.fields[0].len, params.fields[1].len,
+                                                             params.fields[2].len, params.fields[3].len,
+                                                             params.n_merkle_branches);
+    if (!new_work) {
+        return false;
+    }
+
+    copy_string(new_work->job_id, &params.fields[0]);
+    copy_string(new_work->prev_block_hash, &params.fields[1]);
+    copy_string(new_work->coinbase_1, &params.fields[2]);
+    copy_string(new_work->coinbase_2, &params.fields[3]);
+    for (int i = 0; i < params.n_merkle_branches; i++) {
+        hex2bin(params.merkle_branches[i], new_work->merkle_branches + HASH_SIZE * i, HASH_SIZE);
+    }
+    new_work->version = params.words[0];
+    new_work->target = params.words[1];
+    new_work->ntime = params.words[2];
+    new_work->clean_jobs = params.last_is_true;
+
+    message->mining_notification = new_work;
+    ESP_LOGD(TAG, "Parsed mining.notify: job_id=%s, clean_jobs=%d", new_work->job_id, new_work->clean_jobs);
+    return true;
+}
+
+static bool first_number_element(const char *value, int index, void *ctx)
+{
+    if (index == 0 && !parse_number(value, ctx)) {
+        return false;
+    }
+    return true;
+}
+
+static bool parse_difficulty(const char *params_json, StratumApiV1Message *message)
+{
+    double difficulty;
+    if (!params_json || for_each_element(params_json, first_number_element, &difficulty) < 1) {
+        return false;
+    }
+
+    message->new_difficulty = difficulty;
+    ESP_LOGI(TAG, "Set pool difficulty: %.2f", message->new_difficulty);
+    return true;
+}
+
+static bool error_message_element(const char *value, int index, void *ctx)
+{
+    if (index == 1) {
+        json_string *str = ctx;
+        if (!parse_string(value, str) || str->escaped) return false;
+    }
+    return true;
+}
+
+static bool set_error(StratumApiV1Message *message, const json_string *error)
+{
+    char *error_str;
+    if (error) {
+        error_str = malloc(error->len + 1);
+        if (!error_str) return false;
+        copy_string(error_str, error);
+    } else {
+        error_str = strdup("unknown");
+        if (!error_str) return false;
+    }
+
+    message->response_success = false;
+    free(message->error_str);
+    message->error_str = error_str;
+    ESP_LOGI(TAG, "Result failed: %s", message->error_str);
+    return true;
+}
+
+// Share results: boolean result with a null error, or an error given as
+// [code, "message", ...] or as a plain string
+static bool parse_share_result(const char *result, const char *error, const char *reject_reason,
+                               StratumApiV1Message *message)
+{
+    json_string str = {0};
+
+    if (error && *error == '[') {
+        if (for_each_element(error, error_message_element, &str) < 2) return false;
+        return set_error(message, &str);
+    }
+    if (error && *error == '"') {
+        if (!parse_string(error, &str) || str.escaped) return false;
+        return set_error(message, &str);
+    }
+    if (error && !is_literal(error, "null")) {
+        return false;
+    }
+
+    if (!result || !(is_literal(result, "true") || is_literal(result, "false"))) {
+        return false;
+    }
+
+    if (*result == 't') {
+        message->response_success = true;
+        ESP_LOGI(TAG, "Result success");
+        return true;
+    }
+
+    if (reject_reason && *reject_reason == '"') {
+        if (!parse_string(reject_reason, &str) || str.escaped) return false;
+        return set_error(message, &str);
+    }
+    return set_error(message, NULL);
+}
+
+bool STRATUM_V1_parse_fast(StratumApiV1Message *message, const char *stratum_json)
+{
+    const char *id = NULL, *method = NULL, *params = NULL;
+    const char *result = NULL, *error = NULL, *reject_reason = NULL;
+
+    // Record where each member we care about starts; cJSON_GetObjectItem
+    // matches keys case-insensitively and takes the first, so do the same
+    const char *p = skip_ws(stratum_json);
+    if (*p != '{') return false;
+    p = skip_ws(p + 1);
+    if (*p == '}') return false;
+
+    while (1) {
+        json_string key;
+        p = parse_string(p, &key);
+        if (!p || key.escaped) return false;
+        p = skip_ws(p);
+        if (*p != ':') return false;
+        p = skip_ws(p + 1);
+
+        const char *value = p;
+        p = skip_value(p, 0);
+        if (!p) return false;
+
+        const char **slot = NULL;
+        if (key.len == 2 && strncasecmp(key.start, "id", 2) == 0) slot = &id;
+        else if (key.len == 6 && strncasecmp(key.start, "method", 6) == 0) slot = &method;
+        else if (key.len == 6 && strncasecmp(key.start, "params", 6) == 0) slot = &params;
+        else if (key.len == 6 && strncasecmp(key.start, "result", 6) == 0) slot = &result;
+        else if (key.len == 5 && strncasecmp(key.start, "error", 5) == 0) slot = &error;
+        else if (key.len == 13 && strncasecmp(key.start, "reject-reason", 13) == 0) slot = &reject_reason;
+        if (slot && !*slot) *slot = value;
+
+        p = skip_ws(p);
+        if (*p == '}') break;
+        if (*p != ',') return false;
+        p = skip_ws(p + 1);
+    }
+
+    stratum_method parsed_method = STRATUM_RESULT;
+    if (method && *method == '"') {
+        json_string name;
+        if (!parse_string(method, &name)) return false;
+        if (string_equals(&name, "mining.notify")) {
+            parsed_method = MINING_NOTIFY;
+        } else if (string_equals(&name, "mining.set_difficulty")) {
+            parsed_method = MINING_SET_DIFFICULTY;
+        } else {
+            return false;
+        }
+    }
+
+    bool handled;
+    switch (parsed_method) {
+        case MINING_NOTIFY:
+            handled = parse_notify(params, message);
+            break;
+        case MINING_SET_DIFFICULTY:
+            handled = parse_difficulty(params, message);
+            break;
+        default:
+            handled = parse_share_result(result, error, reject_reason, message);
+            break;
+    }
+    if (!handled) {
+        return false;
+    }
+
+    message->method = parsed_method;
+    double id_value;
+    if (id && parse_number(id, &id_value)) {
+        message->message_id = number_to_int(id_value);
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#include "stratum_line_reader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Smallest buffer, and the least free space offered to a single read
+#define LINE_READER_CHUNK 1024
+// Buffers above this size are given back once a burst of large lines is over
+#define LINE_READER_SHRINK_SIZE (4 * LINE_READER_CHUNK)
+
+static size_t round_up_chunk(size_t len)
+{
+    return (len + LINE_READER_CHUNK - 1) / LINE_READER_CHUNK * LINE_READER_CHUNK;
+}
+
+bool stratum_line_reader_init(stratum_line_reader *reader)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->buf = malloc(LINE_READER_CHUNK);
+    if (reader->buf == NULL) {
+        return false;
+    }
+    reader->size = LINE_READER_CHUNK;
+    return true;
+}
+
+void stratum_line_reader_free(stratum_line_reader *reader)
+{
+    free(reader->buf);
+    reader->buf = NULL;
+    reader->size = 0;
+    stratum_line_reader_clear(reader);
+}
+
+void stratum_line_reader_clear(stratum_line_reader *reader)
+{
+    reader->start = 0;
+    reader->scan = 0;
+    reader->end = 0;
+}
+
+char *stratum_line_reader_next(stratum_line_reader *reader)
+{
+    char *newline = memchr(reader->buf + reader->scan, '\n', reader->end - reader->scan);
+    if (newline == NULL) {
+        reader->scan = reader->end;
+        return NULL;
+    }
+
+    *newline = '\0';
+    char *line = reader->buf + reader->start;
+    reader->start = reader->scan = newline - reader->buf + 1;
+    reader->lines_parsed++;
+    return line;
+}
+
+char *stratum_line_reader_reserve(stratum_line_reader *reader, size_t *avail)
+{
+    // Only the unfinished line at the tail is moved, and only once per read
+    if (reader->start > 0) {
+        size_t pending = reader->end - reader->start;
+        memmove(reader->buf, reader->buf + reader->start, pending);
+        reader->scan -= reader->start;
+        reader->end = pending;
+        reader->start = 0;
+    }
+
+    size_t wanted = round_up_chunk(reader->end + LINE_READER_CHUNK);
+
+    if (reader->size - reader->end < LINE_READER_CHUNK) {
+        size_t new_size = reader->size * 2;
+        if (new_size < wanted) {
+            new_size = wanted;
+        }
+        char *new_buf = realloc(reader->buf, new_size);
+        if (new_buf == NULL) {
+            return NULL;
+        }
+        reader->buf = new_buf;
+        reader->size = new_size;
+    } else if (reader->size > LINE_READER_SHRINK_SIZE && wanted <= reader->size / 4) {
+        // Growth doubles and shrinking needs 4x slack, so the size can't oscillate
+        char *new_buf = realloc(reader->buf, wanted);
+        if (new_buf != NULL) {
+            reader->buf = new_buf;
+            reader->size = wanted;
+        }
+    }
+
+    *avail = reader->size - reader->end;
+    return reader->buf + reader->end;
+}
+
+void stratum_line_reader_commit(stratum_line_reader *reader, size_t len)
+{
+    reader->end += len;
+    reader->bytes_received += len;
+}
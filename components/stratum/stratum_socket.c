@@ -1,24 +1,111 @@
 #include "stratum_socket.h"
+#include "stratum_dns_cache.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include "esp_log.h"
 #include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_transport_ssl.h"
 
 #include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <string.h>
 
+// Addresses raced per connect, the head start the first one gets and how
+// often the pending connects are polled
+#define RACE_ADDRS 2
+#define RACE_STAGGER_MS 250
+#define RACE_POLL_MS 10
+
 static const char *TAG = "stratum_socket";
 
-esp_err_t stratum_socket_resolve(const char *hostname, uint16_t port, stratum_connection_info_t *conn_info)
+// Shared by the SV1 and SV2 tasks, the hot standby and the coordinator's probes
+static dns_cache pool_dns_cache;
+static pthread_mutex_t dns_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Link-local IPv6 addresses need the interface they are reachable on
+static void set_ipv6_scope(struct sockaddr_storage *addr)
 {
-    // Input validation
-    if (hostname == NULL || conn_info == NULL) {
-        return ESP_ERR_INVALID_ARG;
+    if (addr->ss_family != AF_INET6) {
+        return;
     }
-    if (port == 0) {
-        ESP_LOGE(TAG, "Invalid port: 0");
-        return ESP_ERR_INVALID_ARG;
+
+    struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)addr;
+    if (!IN6_IS_ADDR_LINKLOCAL(&addr6->sin6_addr) || addr6->sin6_scope_id != 0) {
+        return;
+    }
+
+    ESP_LOGW(TAG, "Link-local IPv6 address without scope ID - attempting to set from WiFi STA interface");
+
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+    if (netif) {
+        int index = esp_netif_get_netif_impl_index(netif);
+        if (index >= 0) {
+            addr6->sin6_scope_id = (uint32_t)index;
+            ESP_LOGI(TAG, "Set IPv6 scope_id to interface index: %lu", (unsigned long)addr6->sin6_scope_id);
+        } else {
+            ESP_LOGW(TAG, "Failed to get valid interface index for WIFI_STA_DEF");
+        }
+    } else {
+        ESP_LOGW(TAG, "Could not get netif handle for WIFI_STA_DEF");
+    }
+}
+
+// Address as text, with the zone id for link-local IPv6
+static void format_address(const struct sockaddr_storage *addr, char *buf, size_t len)
+{
+    int af = addr->ss_family;
+    const void *src_addr;
+
+    if (af == AF_INET) {
+        src_addr = &((const struct sockaddr_in *)addr)->sin_addr;
+    } else {
+        src_addr = &((const struct sockaddr_in6 *)addr)->sin6_addr;
+    }
+
+    if (inet_ntop(af, src_addr, buf, len) == NULL) {
+        ESP_LOGW(TAG, "inet_ntop failed (errno: %d)", errno);
+        snprintf(buf, len, "[invalid %s addr]", (af == AF_INET) ? "IPv4" : "IPv6");
+    } else if (af == AF_INET6) {
+        const struct sockaddr_in6 *addr6 = (const struct sockaddr_in6 *)addr;
+        if (IN6_IS_ADDR_LINKLOCAL(&addr6->sin6_addr) && addr6->sin6_scope_id != 0) {
+            char zone[16];
+            snprintf(zone, sizeof(zone), "%%%" PRIu32, addr6->sin6_scope_id);
+            strncat(buf, zone, len - strlen(buf) - 1);
+            // Ensure null termination
+            buf[len - 1] = '\0';
+        }
+    }
+}
+
+static void mark_failed(const struct sockaddr_storage *addr)
+{
+    pthread_mutex_lock(&dns_cache_lock);
+    dns_cache_mark_failed(&pool_dns_cache, (const struct sockaddr *)addr, esp_timer_get_time());
+    pthread_mutex_unlock(&dns_cache_lock);
+}
+
+static void mark_ok(const struct sockaddr_storage *addr)
+{
+    pthread_mutex_lock(&dns_cache_lock);
+    dns_cache_mark_ok(&pool_dns_cache, (const struct sockaddr *)addr);
+    pthread_mutex_unlock(&dns_cache_lock);
+}
+
+// Up to RACE_ADDRS addresses of hostname:port from the cache, resolving again
+// when the entry is missing or past its TTL. Addresses on hold come last.
+static esp_err_t resolve_addresses(const char *hostname, uint16_t port, dns_cache_addr *addrs, int *count)
+{
+    pthread_mutex_lock(&dns_cache_lock);
+    dns_cache_status status = dns_cache_lookup(&pool_dns_cache, hostname, port, esp_timer_get_time(), addrs, RACE_ADDRS, count);
+    pthread_mutex_unlock(&dns_cache_lock);
+
+    if (status == DNS_CACHE_FRESH) {
+        return ESP_OK;
     }
 
     char port_str[6];
@@ -39,104 +126,166 @@ esp_err_t stratum_socket_resolve(const char *hostname, uint16_t port, stratum_co
     // the default lwip config too (e.g. the unit-test build).
     struct addrinfo *res = NULL;
     int gai_err = getaddrinfo(hostname, port_str, &hints, &res);
-    if (gai_err != 0 || res == NULL) {
+    if (gai_err == 0 && res != NULL) {
+        int64_t now_us = esp_timer_get_time();
+        pthread_mutex_lock(&dns_cache_lock);
+        int stored = dns_cache_store(&pool_dns_cache, hostname, port, res, now_us);
+        dns_cache_lookup(&pool_dns_cache, hostname, port, now_us, addrs, RACE_ADDRS, count);
+        pthread_mutex_unlock(&dns_cache_lock);
+        freeaddrinfo(res);
+
+        if (stored == 0) {
+            ESP_LOGE(TAG, "No supported address family (IPv4 or IPv6) found for %s", hostname);
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+        ESP_LOGI(TAG, "Resolved %s:%u to %d address%s", hostname, port, stored, stored == 1 ? "" : "es");
+    } else if (status == DNS_CACHE_STALE) {
+        // A slow or flaky router DNS shouldn't keep us off a pool we know
+        ESP_LOGW(TAG, "DNS resolution failed for %s:%u (error: %d), using the cached address", hostname, port, gai_err);
+    } else {
         ESP_LOGE(TAG, "DNS resolution failed for %s:%u (error: %d)", hostname, port, gai_err);
         return ESP_ERR_NOT_FOUND;
     }
+    return ESP_OK;
+}
+
+static void fill_conn_info(dns_cache_addr *addr, stratum_connection_info_t *conn_info)
+{
+    set_ipv6_scope(&addr->addr);
 
-    // Initialize connection info
     memset(conn_info, 0, sizeof(*conn_info));
-    conn_info->addr_family = AF_UNSPEC;
+    memcpy(&conn_info->dest_addr, &addr->addr, addr->addrlen);
+    conn_info->addrlen     = addr->addrlen;
+    conn_info->addr_family = addr->addr.ss_family;
+    conn_info->ip_protocol = (conn_info->addr_family == AF_INET) ? IPPROTO_IP : IPPROTO_IPV6;
+
+    // Convert resolved address to string for logging and storage
+    format_address(&conn_info->dest_addr, conn_info->host_ip, sizeof(conn_info->host_ip));
+}
+
+static void close_attempt(esp_transport_handle_t *transport)
+{
+    if (*transport != NULL) {
+        esp_transport_close(*transport);
+        esp_transport_destroy(*transport);
+        *transport = NULL;
+    }
+}
+
+esp_err_t stratum_socket_connect(const char *hostname, uint16_t port, tls_mode tls, char *cert, int timeout_ms,
+                                 stratum_connection_info_t *conn_info, esp_transport_handle_t *transport)
+{
+    // Input validation
+    if (hostname == NULL || conn_info == NULL || transport == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (port == 0) {
+        ESP_LOGE(TAG, "Invalid port: 0");
+        return ESP_ERR_INVALID_ARG;
+    }
+    *transport = NULL;
+
+    dns_cache_addr addrs[RACE_ADDRS];
+    int count;
+    esp_err_t err = resolve_addresses(hostname, port, addrs, &count);
+    if (err != ESP_OK) {
+        return err;
+    }
 
-    // Preferred order: IPv4 first, then IPv6
-    const int preferred_families[] = { AF_INET, AF_INET6 };
-    const size_t num_families = sizeof(preferred_families) / sizeof(preferred_families[0]);
+    stratum_connection_info_t infos[RACE_ADDRS];
+    for (int i = 0; i < count; i++) {
+        fill_conn_info(&addrs[i], &infos[i]);
+    }
+    // Reported when every attempt fails
+    *conn_info = infos[0];
 
-    const struct addrinfo *selected = NULL;
+    // The second address is dialed RACE_STAGGER_MS after the first, or as soon
+    // as the first fails. Both connect without blocking, including the TLS
+    // handshake, and the transport that finishes first is kept. Each address
+    // is dialed once.
+    esp_transport_handle_t attempts[RACE_ADDRS] = { NULL, NULL };
+    int started = 0;
+    int pending = 0;
+    int winner = -1;
+    int64_t start_us = esp_timer_get_time();
+    int64_t stagger_end_us = start_us + RACE_STAGGER_MS * 1000LL;
+    int64_t deadline_us = start_us + timeout_ms * 1000LL;
+    err = ESP_FAIL;
 
-    for (size_t i = 0; i < num_families && selected == NULL; i++) {
-        int family = preferred_families[i];
+    while (winner < 0) {
+        int64_t now_us = esp_timer_get_time();
 
-        for (const struct addrinfo *p = res; p != NULL; p = p->ai_next) {
-            if (p->ai_family == family) {
-                selected = p;
+        if (started < count && (pending == 0 || now_us >= stagger_end_us)) {
+            attempts[started] = STRATUM_V1_transport_init(tls, cert);
+            if (attempts[started] == NULL) {
+                ESP_LOGE(TAG, "Transport initialization failed");
+                err = ESP_ERR_NO_MEM;
                 break;
             }
+            if (tls != DISABLED) {
+                esp_transport_ssl_set_common_name(attempts[started], hostname);
+            }
+            ESP_LOGI(TAG, "Connecting to %s:%u (%s)", hostname, port, infos[started].host_ip);
+            started++;
+            pending++;
+            continue;
         }
-    }
-
-    if (selected == NULL) {
-        ESP_LOGE(TAG, "No supported address family (IPv4 or IPv6) found for %s", hostname);
-        freeaddrinfo(res);
-        return ESP_ERR_NOT_SUPPORTED;
-    }
-
-    // Copy selected address
-    memcpy(&conn_info->dest_addr, selected->ai_addr, selected->ai_addrlen);
-    conn_info->addrlen     = selected->ai_addrlen;
-    conn_info->addr_family = selected->ai_family;
-    conn_info->ip_protocol = (selected->ai_family == AF_INET) ? IPPROTO_IP : IPPROTO_IPV6;
-
-    // Handle IPv6 link-local scope ID if needed
-    if (selected->ai_family == AF_INET6) {
-        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&conn_info->dest_addr;
-
-        if (IN6_IS_ADDR_LINKLOCAL(&addr6->sin6_addr)) {
-            if (addr6->sin6_scope_id == 0) {
-                ESP_LOGW(TAG, "Link-local IPv6 address without scope ID - attempting to set from WiFi STA interface");
-
-                esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
-                if (netif) {
-                    int index = esp_netif_get_netif_impl_index(netif);
-                    if (index >= 0) {
-                        addr6->sin6_scope_id = (uint32_t)index;
-                        ESP_LOGI(TAG, "Set IPv6 scope_id to interface index: %lu", (unsigned long)addr6->sin6_scope_id);
-                    } else {
-                        ESP_LOGW(TAG, "Failed to get valid interface index for WIFI_STA_DEF");
-                    }
-                } else {
-                    ESP_LOGW(TAG, "Could not get netif handle for WIFI_STA_DEF");
+        if (pending == 0) {
+            break;
+        }
+        if (now_us >= deadline_us) {
+            for (int i = 0; i < started; i++) {
+                if (attempts[i] != NULL) {
+                    ESP_LOGW(TAG, "Connect to %s timed out", infos[i].host_ip);
+                    mark_failed(&infos[i].dest_addr);
                 }
-            } else {
-                ESP_LOGI(TAG, "Link-local IPv6 address with existing scope_id: %lu", (unsigned long)addr6->sin6_scope_id);
             }
+            break;
         }
-    }
-
-    const void *src_addr;
-    int af = conn_info->addr_family;
 
-    if (af == AF_INET) {
-        struct sockaddr_in *addr4 = (struct sockaddr_in *)&conn_info->dest_addr;
-        src_addr = &addr4->sin_addr;
-    } else {
-        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&conn_info->dest_addr;
-        src_addr = &addr6->sin6_addr;
+        for (int i = 0; i < started && winner < 0; i++) {
+            if (attempts[i] == NULL) {
+                continue;
+            }
+            int ret = esp_transport_connect_async(attempts[i], infos[i].host_ip, port, timeout_ms);
+            if (ret > 0) {
+                winner = i;
+            } else if (ret < 0) {
+                ESP_LOGW(TAG, "Holding back %s after a failed connect", infos[i].host_ip);
+                mark_failed(&infos[i].dest_addr);
+                close_attempt(&attempts[i]);
+                pending--;
+            }
+        }
+        if (winner < 0) {
+            vTaskDelay(pdMS_TO_TICKS(RACE_POLL_MS));
+        }
     }
 
-    // Convert resolved address to string for logging and storage
-    if (inet_ntop(af, src_addr, conn_info->host_ip, sizeof(conn_info->host_ip)) == NULL) {
-        ESP_LOGW(TAG, "inet_ntop failed (errno: %d)", errno);
-        snprintf(conn_info->host_ip, sizeof(conn_info->host_ip), "[invalid %s addr]",
-                 (af == AF_INET) ? "IPv4" : "IPv6");
-    } else if (af == AF_INET6) {
-        struct sockaddr_in6 *addr6 = (struct sockaddr_in6 *)&conn_info->dest_addr;
-        if (IN6_IS_ADDR_LINKLOCAL(&addr6->sin6_addr) && addr6->sin6_scope_id != 0) {
-            char zone[16];
-            snprintf(zone, sizeof(zone), "%%%" PRIu32, addr6->sin6_scope_id);
-            strncat(conn_info->host_ip, zone,
-                    sizeof(conn_info->host_ip) - strlen(conn_info->host_ip) - 1);
-            // Ensure null termination
-            conn_info->host_ip[sizeof(conn_info->host_ip) - 1] = '\0';
+    for (int i = 0; i < started; i++) {
+        if (i != winner) {
+            close_attempt(&attempts[i]);
         }
     }
+    if (winner < 0) {
+        return err;
+    }
+
+    // The async connect leaves the socket non-blocking, the stratum tasks
+    // rely on the send and receive timeouts of a blocking one
+    int sock = esp_transport_get_socket(attempts[winner]);
+    if (sock >= 0) {
+        fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) & ~O_NONBLOCK);
+    }
+
+    mark_ok(&infos[winner].dest_addr);
+    *conn_info = infos[winner];
+    *transport = attempts[winner];
 
-    ESP_LOGI(TAG, "Resolved %s:%u → %s", hostname, port, conn_info->host_ip);
+    ESP_LOGI(TAG, "Connected to %s:%u → %s", hostname, port, conn_info->host_ip);
 
-    freeaddrinfo(res);
     return ESP_OK;
 }
-
 void stratum_socket_set_options(esp_transport_handle_t transport)
 {
     int sock = esp_transport_get_socket(transport);
@@ -0,0 +1,128 @@
+#include "unity.h"
+
+#include "stratum_dns_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static struct sockaddr_in make_addr(uint8_t last_octet)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(3333);
+    addr.sin_addr.s_addr = htonl(0x0A000000 | last_octet);
+    return addr;
+}
+
+static void make_answer(struct addrinfo *res, struct sockaddr_in *addrs, int count)
+{
+    memset(res, 0, sizeof(struct addrinfo) * count);
+    for (int i = 0; i < count; i++) {
+        res[i].ai_family = AF_INET;
+        res[i].ai_addr = (struct sockaddr *)&addrs[i];
+        res[i].ai_addrlen = sizeof(struct sockaddr_in);
+        res[i].ai_next = i + 1 < count ? &res[i + 1] : NULL;
+    }
+}
+
+static uint8_t last_octet(const dns_cache_addr *addr)
+{
+    return ntohl(((const struct sockaddr_in *)&addr->addr)->sin_addr.s_addr) & 0xFF;
+}
+
+TEST_CASE("DNS cache keeps every address until the TTL passes", "[stratum dns_cache]")
+{
+    dns_cache *cache = malloc(sizeof(dns_cache));
+    TEST_ASSERT_NOT_NULL(cache);
+    dns_cache_init(cache);
+
+    dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    int count;
+    TEST_ASSERT_EQUAL(DNS_CACHE_MISS, dns_cache_lookup(cache, "pool.example", 3333, 0, addrs, DNS_CACHE_MAX_ADDRS, &count));
+    TEST_ASSERT_EQUAL(0, count);
+
+    struct sockaddr_in answer_addrs[3] = { make_addr(1), make_addr(2), make_addr(3) };
+    struct addrinfo answer[3];
+    make_answer(answer, answer_addrs, 3);
+    TEST_ASSERT_EQUAL(3, dns_cache_store(cache, "pool.example", 3333, answer, 0));
+
+    TEST_ASSERT_EQUAL(DNS_CACHE_FRESH, dns_cache_lookup(cache, "pool.example", 3333, 1000, addrs, DNS_CACHE_MAX_ADDRS, &count));
+    TEST_ASSERT_EQUAL(3, count);
+    TEST_ASSERT_EQUAL_UINT8(1, last_octet(&addrs[0]));
+    TEST_ASSERT_EQUAL_UINT8(3, last_octet(&addrs[2]));
+
+    // other ports are separate entries
+    TEST_ASSERT_EQUAL(DNS_CACHE_MISS, dns_cache_lookup(cache, "pool.example", 443, 1000, addrs, DNS_CACHE_MAX_ADDRS, &count));
+
+    TEST_ASSERT_EQUAL(DNS_CACHE_STALE, dns_cache_lookup(cache, "pool.example", 3333, DNS_CACHE_TTL_US, addrs, DNS_CACHE_MAX_ADDRS, &count));
+    TEST_ASSERT_EQUAL(3, count);
+
+    free(cache);
+}
+
+TEST_CASE("DNS cache moves failed addresses to the back", "[stratum dns_cache]")
+{
+    dns_cache *cache = malloc(sizeof(dns_cache));
+    TEST_ASSERT_NOT_NULL(cache);
+    dns_cache_init(cache);
+
+    struct sockaddr_in answer_addrs[2] = { make_addr(1), make_addr(2) };
+    struct addrinfo answer[2];
+    make_answer(answer, answer_addrs, 2);
+    dns_cache_store(cache, "pool.example", 3333, answer, 0);
+
+    dns_cache_mark_failed(cache, (struct sockaddr *)&answer_addrs[0], 0);
+
+    dns_cache_addr addrs[2];
+    int count;
+    dns_cache_lookup(cache, "pool.example", 3333, 1000, addrs, 2, &count);
+    TEST_ASSERT_EQUAL(2, count);
+    TEST_ASSERT_EQUAL_UINT8(2, last_octet(&addrs[0]));
+    TEST_ASSERT_EQUAL_UINT8(1, last_octet(&addrs[1]));
+
+    // a new answer keeps the hold
+    dns_cache_store(cache, "pool.example", 3333, answer, 1000);
+    dns_cache_lookup(cache, "pool.example", 3333, 2000, addrs, 2, &count);
+    TEST_ASSERT_EQUAL_UINT8(2, last_octet(&addrs[0]));
+
+    // the hold runs out
+    dns_cache_lookup(cache, "pool.example", 3333, DNS_CACHE_FAILED_HOLD_US, addrs, 2, &count);
+    TEST_ASSERT_EQUAL_UINT8(1, last_octet(&addrs[0]));
+
+    dns_cache_mark_failed(cache, (struct sockaddr *)&answer_addrs[0], 0);
+    dns_cache_mark_ok(cache, (struct sockaddr *)&answer_addrs[0]);
+    dns_cache_lookup(cache, "pool.example", 3333, 1000, addrs, 2, &count);
+    TEST_ASSERT_EQUAL_UINT8(1, last_octet(&addrs[0]));
+
+    free(cache);
+}
+
+TEST_CASE("DNS cache replaces the least recently used host", "[stratum dns_cache]")
+{
+    dns_cache *cache = malloc(sizeof(dns_cache));
+    TEST_ASSERT_NOT_NULL(cache);
+    dns_cache_init(cache);
+
+    struct sockaddr_in answer_addrs[1] = { make_addr(1) };
+    struct addrinfo answer[1];
+    make_answer(answer, answer_addrs, 1);
+
+    char hostname[16];
+    for (int i = 0; i < DNS_CACHE_ENTRIES; i++) {
+        snprintf(hostname, sizeof(hostname), "pool%d", i);
+        dns_cache_store(cache, hostname, 3333, answer, i);
+    }
+
+    dns_cache_addr addrs[1];
+    int count;
+    TEST_ASSERT_EQUAL(DNS_CACHE_FRESH, dns_cache_lookup(cache, "pool0", 3333, 100, addrs, 1, &count));
+
+    dns_cache_store(cache, "pool.new", 3333, answer, 200);
+    TEST_ASSERT_EQUAL(DNS_CACHE_FRESH, dns_cache_lookup(cache, "pool0", 3333, 300, addrs, 1, &count));
+    TEST_ASSERT_EQUAL(DNS_CACHE_MISS, dns_cache_lookup(cache, "pool1", 3333, 300, addrs, 1, &count));
+    TEST_ASSERT_EQUAL(DNS_CACHE_FRESH, dns_cache_lookup(cache, "pool.new", 3333, 300, addrs, 1, &count));
+
+    free(cache);
+}
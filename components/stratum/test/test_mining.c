@@ -83,6 +83,62 @@ TEST_CASE("Validate another merkle root calculation", "[mining]")
     TEST_ASSERT_EQUAL_STRING("5cc58f5e84aafc740d521b92a7bf72f4e56c4cc3ad1c2159f1d094f97ac34eee", root_hash);
 }
 
+TEST_CASE("Coinbase template matches full coinbase hash", "[mining]")
+{
+    // extranonce_2 lands past the first 64-byte block, so the cached prefix state is used
+    const char *coinbase_1 = "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff2503777d07062f503253482f0405b8c75208f800880e000000000b2f436f696e48756e74722f0000000001";
+    const char *coinbase_2 = "1976a914c633315d376c20a973a758f7422d67f7bfed9c5888ac00000000";
+    const char *extranonce = "603f352a";
+
+    coinbase_template tmpl;
+    TEST_ASSERT_EQUAL(0, coinbase_template_init_hex(&tmpl, coinbase_1, coinbase_2, extranonce, 4, NULL, 0));
+    TEST_ASSERT_EQUAL(64, tmpl.prefix_hashed_len);
+
+    const char *extranonce_2_values[] = { "00000000", "99999999", "01000000", "ffffffff" };
+    for (int i = 0; i < 4; i++) {
+        uint8_t extranonce_2[4];
+        hex2bin(extranonce_2_values[i], extranonce_2, 4);
+
+        uint8_t expected[32];
+        calculate_coinbase_tx_hash(coinbase_1, coinbase_2, extranonce, extranonce_2_values[i], expected);
+
+        uint8_t coinbase_tx_hash[32];
+        coinbase_template_coinbase_hash(&tmpl, extranonce_2, coinbase_tx_hash);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, coinbase_tx_hash, 32);
+    }
+
+    coinbase_template_free(&tmpl);
+}
+
+TEST_CASE("Coinbase template merkle root", "[mining]")
+{
+    const uint8_t prefix[] = { 0x01, 0x00, 0x00, 0x00, 0x01 };
+    const uint8_t extranonce_prefix[] = { 0x60, 0x3f, 0x35, 0x2a };
+    const uint8_t suffix[] = { 0x1e, 0x2f, 0x00, 0x00, 0x00, 0x00 };
+    const uint8_t extranonce_2[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+
+    uint8_t merkles[2][32];
+    hex2bin("f0dbca1ee1a9f6388d07d97c1ab0de0e41acdf2edac4b95780ba0a1ec14103b3", merkles[0], 32);
+    hex2bin("8e43fd2988ac40c5d97702b7e5ccdf5b06d58f0e0d323f74dd5082232c1aedf7", merkles[1], 32);
+
+    coinbase_template tmpl;
+    TEST_ASSERT_EQUAL(0, coinbase_template_init(&tmpl, prefix, sizeof(prefix), extranonce_prefix, sizeof(extranonce_prefix),
+                                                sizeof(extranonce_2), suffix, sizeof(suffix), merkles, 2));
+    TEST_ASSERT_EQUAL(0, tmpl.prefix_hashed_len);
+
+    uint8_t coinbase_tx_hash[32];
+    calculate_coinbase_tx_hash_bin(prefix, sizeof(prefix), extranonce_prefix, sizeof(extranonce_prefix),
+                                   extranonce_2, sizeof(extranonce_2), suffix, sizeof(suffix), coinbase_tx_hash);
+    uint8_t expected[32];
+    calculate_merkle_root_hash(coinbase_tx_hash, merkles, 2, expected);
+
+    uint8_t merkle_root[32];
+    coinbase_template_merkle_root(&tmpl, extranonce_2, merkle_root);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, merkle_root, 32);
+
+    coinbase_template_free(&tmpl);
+}
+
 // Values calculated from esp-miner/components/stratum/test/verifiers/bm1397.py
 TEST_CASE("Validate bm job construction", "[mining]")
 {
@@ -96,13 +152,52 @@ TEST_CASE("Validate bm job construction", "[mining]")
     bm_job job = { 0 };
     construct_bm_job(&notify_message, merkle_root, 0, 1000, &job);
 
+    bm_job_format format = { .max_midstates = 4 };
+    bm_job_midstates midstates;
+    construct_bm_job_midstates(&job, &format, &midstates);
+    TEST_ASSERT_EQUAL_UINT8(1, midstates.num_midstates);
+
     uint8_t expected_midstate_bin[32];
     hex2bin("91DFEA528A9F73683D0D495DD6DD7415E1CA21CB411759E3E05D7D5FF285314D", expected_midstate_bin, 32);
     // bytes are reversed for the midstate on the bm job command packet
     uint8_t expected_midstate_bin_reversed[32];
     reverse_32bit_words(expected_midstate_bin, expected_midstate_bin_reversed);
     reverse_endianness_per_word(expected_midstate_bin_reversed);
-    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin_reversed, job.midstate, 32);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_midstate_bin_reversed, midstates.midstate[0], 32);
+}
+
+TEST_CASE("Job midstates follow the ASIC job format", "[mining]")
+{
+    mining_notify notify_message;
+    notify_message.prev_block_hash = "bf44fd3513dc7b837d60e5c628b572b448d204a8000007490000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705dd01;
+    notify_message.ntime = 0x64658bd8;
+    uint8_t merkle_root[32];
+    hex2bin("cd1be82132ef0d12053dcece1fa0247fcfdb61d4dbd3eb32ea9ef9b4c604a846", merkle_root, 32);
+    bm_job job = { 0 };
+    construct_bm_job(&notify_message, merkle_root, 0x1fffe000, 1000, &job);
+
+    bm_job_midstates midstates;
+    bm_job_format header_only = { .max_midstates = 0 };
+    construct_bm_job_midstates(&job, &header_only, &midstates);
+    TEST_ASSERT_EQUAL_UINT8(0, midstates.num_midstates);
+
+    bm_job_format bm1397 = { .max_midstates = 4 };
+    construct_bm_job_midstates(&job, &bm1397, &midstates);
+    TEST_ASSERT_EQUAL_UINT8(4, midstates.num_midstates);
+
+    // every further midstate is the first one of the job with the version rolled once more
+    bm_job_format single = { .max_midstates = 1 };
+    for (int i = 1; i < 4; i++) {
+        notify_message.version = increment_bitmask(notify_message.version, 0x1fffe000);
+        bm_job rolled = { 0 };
+        construct_bm_job(&notify_message, merkle_root, 0x1fffe000, 1000, &rolled);
+
+        bm_job_midstates expected;
+        construct_bm_job_midstates(&rolled, &single, &expected);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.midstate[0], midstates.midstate[i], 32);
+    }
 }
 
 TEST_CASE("Validate version mask incrementing", "[mining]")
@@ -236,3 +331,35 @@ TEST_CASE("Test nonce diff checking 2", "[mining test_nonce][not-on-qemu]")
     double diff = test_nonce_value(&job, nonce, rolled_version);
     TEST_ASSERT_EQUAL_INT(683, (int)diff);
 }
+
+TEST_CASE("Test nonce diff checking from cached midstate", "[mining test_nonce][not-on-qemu]")
+{
+    mining_notify notify_message;
+    notify_message.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify_message.version = 0x20000004;
+    notify_message.target = 0x1705ae3a;
+    notify_message.ntime = 0x646ff1a9;
+    uint8_t merkle_root[32];
+    hex2bin("6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9", merkle_root, 32);
+    bm_job job = { 0 };
+    construct_bm_job(&notify_message, merkle_root, 0, 1000, &job);
+
+    nonce_midstate_cache cache;
+    nonce_midstate_cache_init(&cache);
+
+    uint32_t nonce = 0x276E8947;
+    uint32_t rolled_version = job.version;
+
+    // miss, then hit on the same (job, version)
+    TEST_ASSERT_EQUAL_INT(18, (int)test_nonce_value_cached(&cache, &job, nonce, rolled_version, 0));
+    TEST_ASSERT_EQUAL_INT(18, (int)test_nonce_value_cached(&cache, &job, nonce, rolled_version, 16));
+
+    // a different nonce or version must match the full header hash
+    TEST_ASSERT_EQUAL_DOUBLE(test_nonce_value(&job, nonce + 1, rolled_version),
+                             test_nonce_value_cached(&cache, &job, nonce + 1, rolled_version, 0));
+    TEST_ASSERT_EQUAL_DOUBLE(test_nonce_value(&job, nonce, rolled_version + 0x2000),
+                             test_nonce_value_cached(&cache, &job, nonce, rolled_version + 0x2000, 0));
+
+    // early reject below min_diff
+    TEST_ASSERT_EQUAL_DOUBLE(0, test_nonce_value_cached(&cache, &job, nonce, rolled_version, 1000));
+}
@@ -0,0 +1,79 @@
+#include "unity.h"
+
+#include "share_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+TEST_CASE("Latency histogram percentiles", "[stratum share_stats]")
+{
+    latency_histogram *histogram = calloc(1, sizeof(latency_histogram));
+    TEST_ASSERT_NOT_NULL(histogram);
+
+    TEST_ASSERT_EQUAL_UINT32(0, latency_histogram_percentile(histogram, 50));
+
+    // 1..1000 ms, once each
+    for (uint32_t ms = 1; ms <= 1000; ms++) {
+        latency_histogram_record(histogram, ms);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1000, histogram->total);
+    TEST_ASSERT_EQUAL_UINT32(1000, histogram->max_ms);
+
+    // within the bucket resolution of the exact values
+    TEST_ASSERT_UINT32_WITHIN(500 / 16, 500, latency_histogram_percentile(histogram, 50));
+    TEST_ASSERT_UINT32_WITHIN(900 / 16, 900, latency_histogram_percentile(histogram, 90));
+    TEST_ASSERT_UINT32_WITHIN(990 / 16, 990, latency_histogram_percentile(histogram, 99));
+    TEST_ASSERT_EQUAL_UINT32(1000, latency_histogram_percentile(histogram, 100));
+
+    // small values are exact
+    TEST_ASSERT_EQUAL_UINT32(10, latency_histogram_percentile(histogram, 1));
+
+    free(histogram);
+}
+
+TEST_CASE("Latency histogram clamps large values", "[stratum share_stats]")
+{
+    latency_histogram *histogram = calloc(1, sizeof(latency_histogram));
+    TEST_ASSERT_NOT_NULL(histogram);
+
+    latency_histogram_record(histogram, 200000);
+    TEST_ASSERT_EQUAL_UINT32(200000, histogram->max_ms);
+    TEST_ASSERT_UINT32_WITHIN(65535 / 16, 65535, latency_histogram_percentile(histogram, 50));
+
+    free(histogram);
+}
+
+TEST_CASE("Share rate counts the last hour", "[stratum share_stats]")
+{
+    share_rate *rate = calloc(1, sizeof(share_rate));
+    TEST_ASSERT_NOT_NULL(rate);
+
+    share_rate_add(rate, 100, SHARE_ACCEPTED);
+    share_rate_add(rate, 100, SHARE_ACCEPTED);
+    share_rate_add(rate, 101, SHARE_REJECTED);
+    share_rate_add(rate, 130, SHARE_STALE);
+
+    share_counts hour = share_rate_sum(rate, 130, SHARE_RATE_SLOTS);
+    TEST_ASSERT_EQUAL_UINT32(2, hour.accepted);
+    TEST_ASSERT_EQUAL_UINT32(1, hour.rejected);
+    TEST_ASSERT_EQUAL_UINT32(1, hour.stale);
+
+    share_counts recent = share_rate_sum(rate, 130, 10);
+    TEST_ASSERT_EQUAL_UINT32(0, recent.accepted);
+    TEST_ASSERT_EQUAL_UINT32(1, recent.stale);
+
+    // minute 100 leaves the window first, then 101
+    hour = share_rate_sum(rate, 160, SHARE_RATE_SLOTS);
+    TEST_ASSERT_EQUAL_UINT32(0, hour.accepted);
+    TEST_ASSERT_EQUAL_UINT32(1, hour.rejected);
+
+    hour = share_rate_sum(rate, 161, SHARE_RATE_SLOTS);
+    TEST_ASSERT_EQUAL_UINT32(0, hour.rejected);
+    TEST_ASSERT_EQUAL_UINT32(1, hour.stale);
+
+    // a long gap clears everything
+    hour = share_rate_sum(rate, 1000, SHARE_RATE_SLOTS);
+    TEST_ASSERT_EQUAL_UINT32(0, hour.stale);
+
+    free(rate);
+}
@@ -1,5 +1,7 @@
+#include <string.h>
 #include "unity.h"
 #include "stratum_api.h"
+#include "stratum_json_fast.h"
 
 TEST_CASE("Parse stratum method", "[stratum]")
 {
@@ -321,3 +323,70 @@ TEST_CASE("Parse stratum configure result", "[stratum]")
     TEST_ASSERT_TRUE(stratum_api_v1_message.response_success);
     TEST_ASSERT_EQUAL_HEX32(0x1fffe000, stratum_api_v1_message.version_mask);
 }
+
+TEST_CASE("Format stratum submit line", "[stratum]")
+{
+    char buf[256];
+    int len = STRATUM_V1_format_submit(buf, sizeof(buf), 7, "bc1qworker.bitaxe", "1b4c3d9041",
+                                       "00000001", 0x64495522, 0x1a2b3c4d, 0x00002000);
+    const char *expected = "{\"id\":7,\"method\":\"mining.submit\",\"params\":"
+                           "[\"bc1qworker.bitaxe\",\"1b4c3d9041\",\"00000001\",\"64495522\",\"1a2b3c4d\",\"00002000\"]}\n";
+    TEST_ASSERT_EQUAL_STRING(expected, buf);
+    TEST_ASSERT_EQUAL(strlen(expected), len);
+
+    // a line that does not fit must not be sent half written
+    TEST_ASSERT_EQUAL(-1, STRATUM_V1_format_submit(buf, 32, 7, "bc1qworker.bitaxe", "1b4c3d9041",
+                                                   "00000001", 0x64495522, 0x1a2b3c4d, 0x00002000));
+}
+
+TEST_CASE("Fast parser decodes notify with merkle branches", "[stratum]")
+{
+    StratumApiV1Message stratum_api_v1_message = {};
+    // members out of the usual order, with whitespace
+    const char *json_string = "{ \"params\" : [\"1d2e0c4d3d\", \"ef4b9a48c7986466de4adc002f7337a6e121bc43000376ea0000000000000000\","
+                              " \"0100\", \"ffff\","
+                              " [\"ae23055e00f0f697cc3640124812d96d4fe8bdfa03484c1c638ce5a1c0e9aa81\","
+                              "  \"980fb87cb61021dd7afd314fcb0dabd096f3d56a7377f6f320684652e7410a21\"],"
+                              " \"20000004\", \"1705c739\", \"64495522\", true],"
+                              " \"id\" : 12, \"method\" : \"mining.notify\" }";
+
+    TEST_ASSERT_TRUE(STRATUM_V1_parse_fast(&stratum_api_v1_message, json_string));
+    TEST_ASSERT_EQUAL(MINING_NOTIFY, stratum_api_v1_message.method);
+    TEST_ASSERT_EQUAL(12, stratum_api_v1_message.message_id);
+
+    mining_notify *notify = stratum_api_v1_message.mining_notification;
+    TEST_ASSERT_EQUAL_STRING("1d2e0c4d3d", notify->job_id);
+    TEST_ASSERT_EQUAL_STRING("0100", notify->coinbase_1);
+    TEST_ASSERT_EQUAL_STRING("ffff", notify->coinbase_2);
+    TEST_ASSERT_EQUAL(2, notify->n_merkle_branches);
+    TEST_ASSERT_EQUAL_HEX8(0xae, notify->merkle_branches[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x81, notify->merkle_branches[31]);
+    TEST_ASSERT_EQUAL_HEX8(0x98, notify->merkle_branches[32]);
+    TEST_ASSERT_EQUAL_HEX8(0x21, notify->merkle_branches[63]);
+    TEST_ASSERT_EQUAL_UINT32(0x64495522, notify->ntime);
+    TEST_ASSERT_TRUE(notify->clean_jobs);
+
+    STRATUM_V1_reset_message(&stratum_api_v1_message);
+}
+
+TEST_CASE("Fast parser leaves other messages to cJSON", "[stratum]")
+{
+    const char *json_strings[] = {
+        "{\"id\":null,\"method\":\"client.show_message\",\"params\":[\"Welcome to the pool!\"]}",
+        "{\"id\":1,\"result\":{\"version-rolling\":true,\"version-rolling.mask\":\"1fffe000\"},\"error\":null}",
+        "{\"result\":[[[\"mining.notify\",\"695482c0\"]],\"4de05269\",8],\"id\":2,\"error\":null}",
+        "{\"id\":3,\"result\":null,\"error\":[21,\"Job \\\"x\\\" not found\",\"\"]}",
+        "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[0x10]}",
+        "{\"id\":null,\"method\":\"mining.notify\",\"params\":[]}",
+        "{\"id\":null,\"params\":[],\"method\":\"mining.notify",
+        "invalid json",
+    };
+
+    for (size_t i = 0; i < sizeof(json_strings) / sizeof(json_strings[0]); i++) {
+        StratumApiV1Message stratum_api_v1_message = {};
+        TEST_ASSERT_FALSE(STRATUM_V1_parse_fast(&stratum_api_v1_message, json_strings[i]));
+        TEST_ASSERT_EQUAL(METHOD_UNKNOWN, stratum_api_v1_message.method);
+        TEST_ASSERT_NULL(stratum_api_v1_message.mining_notification);
+        TEST_ASSERT_NULL(stratum_api_v1_message.error_str);
+    }
+}
@@ -0,0 +1,61 @@
+#include <string.h>
+#include "unity.h"
+#include "stratum_line_reader.h"
+
+static void feed(stratum_line_reader *reader, const char *data)
+{
+    size_t len = strlen(data);
+    size_t avail;
+    char *dest = stratum_line_reader_reserve(reader, &avail);
+    TEST_ASSERT_NOT_NULL(dest);
+    TEST_ASSERT_GREATER_OR_EQUAL(len, avail);
+    memcpy(dest, data, len);
+    stratum_line_reader_commit(reader, len);
+}
+
+TEST_CASE("Line reader splits lines across reads", "[stratum line_reader]")
+{
+    stratum_line_reader reader;
+    TEST_ASSERT_TRUE(stratum_line_reader_init(&reader));
+
+    feed(&reader, "{\"id\":1}\n{\"id\"");
+    TEST_ASSERT_EQUAL_STRING("{\"id\":1}", stratum_line_reader_next(&reader));
+    TEST_ASSERT_NULL(stratum_line_reader_next(&reader));
+
+    feed(&reader, ":2}\n{\"id\":3}\n");
+    TEST_ASSERT_EQUAL_STRING("{\"id\":2}", stratum_line_reader_next(&reader));
+    TEST_ASSERT_EQUAL_STRING("{\"id\":3}", stratum_line_reader_next(&reader));
+    TEST_ASSERT_NULL(stratum_line_reader_next(&reader));
+
+    TEST_ASSERT_EQUAL(27, reader.bytes_received);
+    TEST_ASSERT_EQUAL(3, reader.lines_parsed);
+
+    stratum_line_reader_free(&reader);
+}
+
+TEST_CASE("Line reader grows for long lines and shrinks afterwards", "[stratum line_reader]")
+{
+    stratum_line_reader reader;
+    TEST_ASSERT_TRUE(stratum_line_reader_init(&reader));
+    size_t initial_size = reader.size;
+
+    // a mining.notify with many merkle branches arrives in many small reads
+    static char chunk[513];
+    memset(chunk, 'a', sizeof(chunk) - 1);
+    for (int i = 0; i < 64; i++) {
+        feed(&reader, chunk);
+        TEST_ASSERT_NULL(stratum_line_reader_next(&reader));
+    }
+    feed(&reader, "\n");
+
+    char *line = stratum_line_reader_next(&reader);
+    TEST_ASSERT_NOT_NULL(line);
+    TEST_ASSERT_EQUAL(64 * 512, strlen(line));
+    TEST_ASSERT_GREATER_THAN(initial_size, reader.size);
+
+    feed(&reader, "{\"id\":4}\n");
+    TEST_ASSERT_EQUAL_STRING("{\"id\":4}", stratum_line_reader_next(&reader));
+    TEST_ASSERT_LESS_OR_EQUAL(4 * initial_size, reader.size);
+
+    stratum_line_reader_free(&reader);
+}
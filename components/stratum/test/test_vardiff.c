@@ -0,0 +1,54 @@
+#include "unity.h"
+
+#include "vardiff.h"
+
+#define MINUTE_US (60 * 1000000LL)
+
+TEST_CASE("Vardiff difficulty for a hashrate", "[stratum vardiff]")
+{
+    // 1 TH/s at one share per minute: 1e12 * 60 / 2^32
+    TEST_ASSERT_DOUBLE_WITHIN(1, 13969.8, vardiff_difficulty_for(1000, 1));
+    TEST_ASSERT_DOUBLE_WITHIN(1, 1397.0, vardiff_difficulty_for(1000, 10));
+    TEST_ASSERT_EQUAL(0, vardiff_difficulty_for(0, 10));
+}
+
+TEST_CASE("Vardiff starts from the hashrate", "[stratum vardiff]")
+{
+    vardiff controller;
+    vardiff_init(&controller, 10, 0, 0);
+
+    // first sight of the pool difficulty starts the window
+    TEST_ASSERT_EQUAL(0, vardiff_update(&controller, 0, 512, 6000, 0));
+    // not before the interval
+    TEST_ASSERT_EQUAL(0, vardiff_update(&controller, MINUTE_US / 2, 512, 6000, 2));
+
+    // 6 TH/s at 10 shares per minute, too few shares to measure yet
+    TEST_ASSERT_DOUBLE_WITHIN(1, 8381, vardiff_update(&controller, MINUTE_US, 512, 6000, 3));
+    TEST_ASSERT_DOUBLE_WITHIN(1, 8381, controller.suggested);
+}
+
+TEST_CASE("Vardiff follows the accepted share rate", "[stratum vardiff]")
+{
+    vardiff controller;
+    vardiff_init(&controller, 10, 0, 0);
+    vardiff_update(&controller, 0, 1000, 0, 0);
+
+    // 40 shares per minute at 1000 is four times too many
+    TEST_ASSERT_EQUAL(4000, vardiff_update(&controller, 2 * MINUTE_US, 1000, 0, 80));
+
+    // the pool takes the suggestion, at 4000 shares come at 11 per minute
+    TEST_ASSERT_EQUAL(0, vardiff_update(&controller, 2 * MINUTE_US, 4000, 0, 80));
+    TEST_ASSERT_EQUAL(0, vardiff_update(&controller, 4 * MINUTE_US, 4000, 0, 102));
+}
+
+TEST_CASE("Vardiff doesn't repeat an ignored suggestion", "[stratum vardiff]")
+{
+    vardiff controller;
+    vardiff_init(&controller, 10, 0, 0);
+    vardiff_update(&controller, 0, 1000, 0, 0);
+
+    TEST_ASSERT_EQUAL(4000, vardiff_update(&controller, MINUTE_US, 1000, 0, 40));
+
+    // the pool stays at 1000, the share rate still asks for about 4000
+    TEST_ASSERT_EQUAL(0, vardiff_update(&controller, 2 * MINUTE_US, 1000, 0, 82));
+}
@@ -0,0 +1,83 @@
+#include <math.h>
+
+#include "vardiff.h"
+
+static void vardiff_restart_window(vardiff *controller, int64_t now_us, uint64_t accepted_shares)
+{
+    controller->window_start_us = now_us;
+    controller->window_start_shares = accepted_shares;
+}
+
+void vardiff_init(vardiff *controller, double shares_per_minute, int64_t now_us, uint64_t accepted_shares)
+{
+    controller->shares_per_minute = shares_per_minute;
+    controller->suggested = 0;
+    controller->pool_difficulty = 0;
+    vardiff_restart_window(controller, now_us, accepted_shares);
+}
+
+double vardiff_difficulty_for(double hashrate_ghs, double shares_per_minute)
+{
+    if (!(hashrate_ghs > 0) || shares_per_minute <= 0) {
+        return 0;
+    }
+    // A share at difficulty 1 takes 2^32 hashes on average
+    return hashrate_ghs * 1e9 * 60.0 / (4294967296.0 * shares_per_minute);
+}
+
+void vardiff_set_suggested(vardiff *controller, double difficulty)
+{
+    controller->suggested = difficulty;
+}
+
+double vardiff_update(vardiff *controller, int64_t now_us, double pool_difficulty, double hashrate_ghs, uint64_t accepted_shares)
+{
+    if (controller->shares_per_minute <= 0) {
+        return 0;
+    }
+
+    // Shares counted so far were found at the old difficulty
+    if (pool_difficulty != controller->pool_difficulty) {
+        controller->pool_difficulty = pool_difficulty;
+        vardiff_restart_window(controller, now_us, accepted_shares);
+        return 0;
+    }
+
+    int64_t elapsed_us = now_us - controller->window_start_us;
+    if (elapsed_us < VARDIFF_INTERVAL_US) {
+        return 0;
+    }
+
+    uint64_t shares = accepted_shares - controller->window_start_shares;
+    double estimate;
+    if (shares >= VARDIFF_MIN_SHARES && pool_difficulty > 0) {
+        double shares_per_minute = shares * 60e6 / elapsed_us;
+        estimate = pool_difficulty * shares_per_minute / controller->shares_per_minute;
+    } else {
+        estimate = vardiff_difficulty_for(hashrate_ghs, controller->shares_per_minute);
+        if (estimate <= 0) {
+            return 0;
+        }
+    }
+
+    estimate = floor(estimate);
+    if (estimate < VARDIFF_MIN_DIFFICULTY) {
+        estimate = VARDIFF_MIN_DIFFICULTY;
+    }
+    if (estimate > UINT32_MAX) {
+        estimate = UINT32_MAX;
+    }
+
+    // Compare to what was asked for, so a pool that keeps its own difficulty isn't asked again every minute
+    double reference = controller->suggested > 0 ? controller->suggested : pool_difficulty;
+    if (reference > 0 && estimate < reference * VARDIFF_HYSTERESIS && estimate > reference / VARDIFF_HYSTERESIS) {
+        if (elapsed_us >= VARDIFF_WINDOW_MAX_US) {
+            vardiff_restart_window(controller, now_us, accepted_shares);
+        }
+        return 0;
+    }
+
+    controller->suggested = estimate;
+    vardiff_restart_window(controller, now_us, accepted_shares);
+    return estimate;
+}
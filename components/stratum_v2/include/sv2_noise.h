@@ -21,11 +21,18 @@ int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
                         const uint8_t *authority_pubkey);
 
 // Send an SV2 frame (header + payload) encrypted via Noise.
-// frame points to the complete plaintext frame (header + payload).
+// frame points to the complete plaintext frame (header + payload), frame_len
+// must be the header size plus its msg_length.
 // Returns 0 on success, -1 on error.
 int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
                    const uint8_t *frame, int frame_len);
 
+// Send several plaintext SV2 frames, laid out back to back, in a single
+// transport write. Frame boundaries are taken from each header's msg_length.
+// Returns 0 on success, -1 on error.
+int sv2_noise_send_frames(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                          const uint8_t *frames, int frames_len);
+
 // Receive and decrypt an SV2 frame via Noise.
 // hdr_out receives the 6-byte decrypted frame header.
 // payload_out receives the decrypted payload (up to max_payload_len bytes).
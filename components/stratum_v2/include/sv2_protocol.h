@@ -20,6 +20,8 @@
 #define SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL            0x13
 #define SV2_MSG_OPEN_EXTENDED_MINING_CHANNEL_SUCCESS    0x14
 #define SV2_MSG_NEW_MINING_JOB                          0x15
+#define SV2_MSG_UPDATE_CHANNEL                          0x16
+#define SV2_MSG_UPDATE_CHANNEL_ERROR                    0x17
 #define SV2_MSG_NEW_EXTENDED_MINING_JOB                 0x1f
 #define SV2_MSG_SUBMIT_SHARES_STANDARD                  0x1a
 #define SV2_MSG_SUBMIT_SHARES_EXTENDED                  0x1b
@@ -138,6 +140,10 @@ int sv2_build_submit_shares_standard(uint8_t *buf, size_t buf_len,
                                      uint32_t job_id, uint32_t nonce,
                                      uint32_t ntime, uint32_t version);
 
+int sv2_build_update_channel(uint8_t *buf, size_t buf_len,
+                             uint32_t channel_id, float nominal_hash_rate,
+                             const uint8_t max_target[32]);
+
 // --- Message parsers (return 0 on success, -1 on error) ---
 
 int sv2_parse_setup_connection_success(const uint8_t *payload, uint32_t len,
@@ -200,4 +206,7 @@ void sv2_ext_job_free(sv2_ext_job_t *job);
 // Convert U256 LE target to pool difficulty (pdiff)
 uint32_t sv2_target_to_pdiff(const uint8_t target[32]);
 
+// Convert pool difficulty (pdiff) to a U256 LE target
+void sv2_pdiff_to_target(uint32_t pdiff, uint8_t target[32]);
+
 #endif /* SV2_PROTOCOL_H */
@@ -494,46 +494,55 @@ int sv2_noise_handshake(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
     return 0;
 }
 
-int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
-                   const uint8_t *frame, int frame_len)
+int sv2_noise_send_frames(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                          const uint8_t *frames, int frames_len)
 {
-    if (!ctx || !ctx->handshake_complete || frame_len < SV2_FRAME_HEADER_SIZE) {
+    if (!ctx || !ctx->handshake_complete || frames_len < SV2_FRAME_HEADER_SIZE) {
         return -1;
     }
 
-    int payload_len = frame_len - SV2_FRAME_HEADER_SIZE;
-
-    // Header-only frame: encrypt (6 -> 22 bytes) and send directly off the stack.
-    if (payload_len <= 0) {
-        uint8_t enc_hdr[22];
-        if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                          frame, SV2_FRAME_HEADER_SIZE, enc_hdr) != 0) {
-            return -1;
-        }
-        return noise_send_all(transport, enc_hdr, 22);
+    // Walk the frame headers once to check the boundaries and size the output
+    int total_len = 0;
+    for (int pos = 0; pos < frames_len; ) {
+        if (frames_len - pos < SV2_FRAME_HEADER_SIZE) return -1;
+        sv2_frame_header_t hdr;
+        sv2_parse_frame_header(frames + pos, &hdr);
+        int payload_len = (int)hdr.msg_length;
+        if (payload_len > frames_len - pos - SV2_FRAME_HEADER_SIZE) return -1;
+        total_len += 22 + (payload_len > 0 ? payload_len + 16 : 0);
+        pos += SV2_FRAME_HEADER_SIZE + payload_len;
     }
 
-    // Build the encrypted header and payload contiguously and send them in a
-    // single write, so a frame leaves as one TCP segment instead of a header
-    // segment followed by a payload segment. The two parts use separate Noise
-    // nonces but are just consecutive bytes on the wire, so the receiver, which
-    // reads the 22-byte header first and then the payload, is unaffected.
-    int total_len = 22 + payload_len + 16;
     uint8_t *out = malloc(total_len);
     if (!out) return -1;
 
-    // Encrypt header (nonce N) into out[0..21]
-    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                      frame, SV2_FRAME_HEADER_SIZE, out) != 0) {
-        free(out);
-        return -1;
-    }
+    // Header and payload use separate Noise nonces but are just consecutive
+    // bytes on the wire, so all frames go out contiguously in a single write
+    // (one TCP segment instead of a header segment then a payload segment).
+    // The receiver reads the 22-byte header first and then the payload either way.
+    int out_pos = 0;
+    for (int pos = 0; pos < frames_len; ) {
+        sv2_frame_header_t hdr;
+        sv2_parse_frame_header(frames + pos, &hdr);
+        int payload_len = (int)hdr.msg_length;
 
-    // Encrypt payload (nonce N+1) into out[22..]
-    if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
-                      frame + SV2_FRAME_HEADER_SIZE, payload_len, out + 22) != 0) {
-        free(out);
-        return -1;
+        if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
+                          frames + pos, SV2_FRAME_HEADER_SIZE, out + out_pos) != 0) {
+            free(out);
+            return -1;
+        }
+        out_pos += 22;
+
+        if (payload_len > 0) {
+            if (noise_encrypt(ctx->send_key, ctx->send_nonce++, NULL, 0,
+                              frames + pos + SV2_FRAME_HEADER_SIZE, payload_len, out + out_pos) != 0) {
+                free(out);
+                return -1;
+            }
+            out_pos += payload_len + 16;
+        }
+
+        pos += SV2_FRAME_HEADER_SIZE + payload_len;
     }
 
     int ret = noise_send_all(transport, out, total_len);
@@ -541,6 +550,12 @@ int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
     return ret;
 }
 
+int sv2_noise_send(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
+                   const uint8_t *frame, int frame_len)
+{
+    return sv2_noise_send_frames(ctx, transport, frame, frame_len);
+}
+
 int sv2_noise_recv(sv2_noise_ctx_t *ctx, esp_transport_handle_t transport,
                    uint8_t hdr_out[6], uint8_t *payload_out,
                    int max_payload_len, int *payload_len_out)
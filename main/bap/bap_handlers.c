@@ -312,13 +312,7 @@ void BAP_handle_settings(const char *parameter, const char *value) {
                 
                 //ESP_LOGI(TAG, "Setting ASIC frequency to %.2f MHz", target_frequency);
                 
-                bap_global_state->POWER_MANAGEMENT_MODULE.frequency_value = target_frequency;
-
-                ASIC_set_frequency(bap_global_state);
-                ASIC_set_nonce_space(bap_global_state);
-
-                //ESP_LOGI(TAG, "Frequency successfully set to %.2f MHz", target_frequency);
-
+                // The power management task picks up the new value and ramps to it
                 nvs_config_set_float(NVS_CONFIG_ASIC_FREQUENCY, target_frequency);
 
                 char freq_str[32];
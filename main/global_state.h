@@ -5,11 +5,15 @@
 #include <stdint.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "freertos/portmacro.h"
 #include "power_management_task.h"
 #include "hashrate_monitor_task.h"
 #include "mining.h"
+#include "nonce_filter.h"
+#include "job_slots.h"
 #include "coinbase_decoder.h"
+#include "share_stats.h"
 #include "work_queue.h"
 #include "device_config.h"
 #include "display.h"
@@ -42,6 +46,15 @@ typedef struct {
     uint32_t count;
 } RejectedReasonStat;
 
+// Share statistics are kept per pool (0 primary, 1 fallback) and protocol
+#define SHARE_STATS_POOLS 2
+#define SHARE_STATS_PROTOCOLS 2
+
+typedef struct {
+    latency_histogram latency;
+    share_rate rate;
+} PoolShareStats;
+
 typedef struct
 {
     float current_hashrate;
@@ -52,9 +65,22 @@ typedef struct
     int64_t start_time;
     uint64_t shares_accepted;
     uint64_t shares_rejected;
+    uint64_t duplicate_nonces;
+    // Shares that met the pool difficulty but found the submit queue full
+    uint64_t shares_dropped;
+    // Results for jobs superseded by clean_jobs, per pool (0 primary, 1 fallback)
+    uint64_t stale_nonces[2];
+    uint64_t pool_nonces[2];
     uint64_t work_received;
+    // Pool connection lost with no job since, esp_timer time in us
+    int64_t work_lost_time;
+    bool failover_pending;
+    // Time without pool work during the last failover to another pool
+    uint32_t failover_gap_ms;
     RejectedReasonStat rejected_reason_stats[10];
     int rejected_reason_stats_count;
+    // [pool * SHARE_STATS_PROTOCOLS + protocol], guarded by share_stats_lock
+    PoolShareStats *share_stats;
     int screen_page;
     uint64_t best_nonce_diff;
     char best_diff_string[DIFF_STRING_SIZE];
@@ -80,10 +106,13 @@ typedef struct
     char * fallback_pool_pass;
     uint16_t pool_difficulty;
     uint16_t fallback_pool_difficulty;
+    // Share rate the suggested difficulty is tuned for, 0 to suggest the fixed difficulty
+    uint16_t shares_per_minute;
     bool pool_extranonce_subscribe;
     bool fallback_pool_extranonce_subscribe;
     bool pool_decode_coinbase_tx;
     bool fallback_pool_decode_coinbase_tx;
+    bool fallback_pool_hot_standby;
     float response_time;
     uint16_t response_share_batch;
     float process_time;
@@ -98,6 +127,8 @@ typedef struct
     bool is_using_fallback;
     uint16_t fallback_pool_protocol;
     char pool_connection_info[64];
+    // Connect of the current pool connection: TCP and TLS, or TCP and Noise for SV2
+    float pool_handshake_time;
     bool overheat_mode;
     bool mining_paused;
     bool pools_unavailable;
@@ -139,10 +170,36 @@ typedef struct
 {
     // ASIC may not return the nonce in the same order as the jobs were sent
     // it also may return a previous nonce under some circumstances
-    // so we keep a list of jobs indexed by the job id
-    bm_job **active_jobs;
+    // so we keep the jobs by job id, with the one each id held before (guarded by job_slots_lock)
+    job_slots *job_slots;
+    // Distance between two job ids, set by ASIC_init
+    uint8_t job_id_step;
+    // Results already returned per job id, cleared when the slot is reused (guarded by job_slots_lock)
+    nonce_filter *nonce_filter;
     // Current job to be processed (replaces ASIC_jobs_queue)
     bm_job *current_job;
+    // Derived fields the ASIC driver needs in each job, set by ASIC_init
+    bm_job_format job_format;
+    // Version bits the chips roll and their HCN register, inputs of the job dispatch plan
+    uint32_t version_mask;
+    uint32_t hash_counting_number;
+    // Job dispatch plan, redone when frequency, version mask or HCN change
+    float plan_frequency;
+    uint32_t plan_version_mask;
+    uint32_t plan_hash_counting_number;
+    double work_time_ms;         // time for the chain to run out of work on one job
+    double job_interval_ms;
+    // Work starvation: time the chain returned no results before the next job arrived
+    int64_t last_job_time_us;
+    int64_t last_result_time_us; // ASIC timestamp of the last job result (guarded by job_slots_lock)
+    uint64_t starved_time_us;
+    uint64_t dispatch_time_us;
+    // TICKET_MASK difficulty, the one before it is still accepted for a moment
+    // after a change while older nonces drain from the UART
+    double ticket_difficulty;
+    double previous_ticket_difficulty;
+    int64_t ticket_changed_us;
+    uint32_t ticket_nonces; // nonces at or above the ticket difficulty
     //semaphone
     SemaphoreHandle_t semaphore;
 } AsicTaskModule;
@@ -150,6 +207,7 @@ typedef struct
 typedef struct
 {
     work_queue stratum_queue;
+    QueueHandle_t share_queue; // share_submission, by value
 
     SystemModule SYSTEM_MODULE;
     DeviceConfig DEVICE_CONFIG;
@@ -162,8 +220,8 @@ typedef struct
     char * extranonce_str;
     int extranonce_2_len;
 
-    uint8_t * valid_jobs;
-    pthread_mutex_t valid_jobs_lock;
+    pthread_mutex_t job_slots_lock;
+    pthread_mutex_t share_stats_lock;
 
     double pool_difficulty;
     bool new_set_mining_difficulty_msg;
@@ -87,6 +87,11 @@ export class SystemApiService {
         apEnabled: 0,
         sharesAccepted: 1,
         sharesRejected: 10,
+        duplicateNonces: 0,
+        staleNonces: 0,
+        staleRate: 0,
+        fallbackStaleNonces: 0,
+        fallbackStaleRate: 0,
         sharesRejectedReasons: [
           { message: "Above target", count: 8 },
           { message: "Duplicate share", count: 2 }
@@ -99,6 +104,7 @@ export class SystemApiService {
         stratumPort: 21496,
         stratumUser: "bc1q99n3pu025yyu0jlywpmwzalyhm36tg5u37w20d.bitaxe-U1",
         stratumSuggestedDifficulty: 1000,
+        stratumSharesPerMinute: 0,
         stratumExtranonceSubscribe: !!0,
         stratumTLS: !!0,
         stratumCert: "",
@@ -114,15 +120,27 @@ export class SystemApiService {
         fallbackStratumTLS: !!0,
         fallbackStratumCert: "",
         fallbackStratumDecodeCoinbase: true,
+        fallbackStratumHotStandby: false,
         fallbackStratumV2AuthorityPubkey: "",
         fallbackStratumV2ChannelType: "extended" as const,
         poolDifficulty: 1000,
         responseTime: 10,
+        failoverGap: 0,
         responseShareBatch: 1,
+        stratumQueueDepth: 1,
+        stratumQueueHighWater: 3,
+        stratumQueueDropped: 0,
+        sharesDropped: 0,
+        stratumBytesReceived: 1048576,
+        stratumLinesParsed: 812,
         isUsingFallbackStratum: 0,
         poolConnectionInfo: "IPv4 (TLS)",
+        poolHandshakeTime: 380,
         frequency: 485,
         actualFrequency: 485,
+        jobInterval: 500,
+        workStarvation: 0,
+        ticketDifficulty: 256,
         version: "v2.12.0",
         axeOSVersion: "v2.12.0",
         idfVersion: "v5.5.1",
@@ -135,6 +153,7 @@ export class SystemApiService {
         autofanspeed: 1,
         isPSRAMAvailable: 1,
         overclockEnabled: 1,
+        chipTuning: 0,
         runningPartition: "factory",
         minFanSpeed: 25,
         fanspeed: 50,
@@ -158,6 +177,9 @@ export class SystemApiService {
             total: 441.2579,
             domains: [114.9901, 98.6658, 103.8136, 122.7133],
             errorCount: 4,
+            rxCrcErrors: 0,
+            rxResyncs: 0,
+            frequency: 485,
           }],
           hashrate: 441.2579,
         },
@@ -996,6 +996,29 @@ static esp_err_t GET_system_statistics(httpd_req_t * req)
     return res;
 }
 
+static esp_err_t GET_system_shares(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    cJSON * root = system_api_get_shares_json(GLOBAL_STATE);
+
+    esp_err_t res = HTTP_send_json(req, root, &api_common_prebuffer_len);
+
+    cJSON_Delete(root);
+
+    return res;
+}
+
 static esp_err_t GET_scoreboard(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -1303,6 +1326,14 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &scoreboard_get_uri);
 
+    httpd_uri_t system_shares_get_uri = {
+        .uri = "/api/system/shares",
+        .method = HTTP_GET,
+        .handler = GET_system_shares,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_shares_get_uri);
+
     /* URI handler for WiFi scan */
     httpd_uri_t wifi_scan_get_uri = {
         .uri = "/api/system/wifi/scan",
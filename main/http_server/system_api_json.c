@@ -10,11 +10,20 @@
 #include "vcore.h"
 #include "connect.h"
 #include "hashrate_monitor_task.h"
+#include "asic.h"
 #include "cjson_utils.h"
 #include "statistics_task.h"
 #include "stratum_v2_task.h"
+#include "stratum_api.h"
 
 
+// Percentage of the nonces found for a pool's jobs that came back after the job was replaced
+static float stale_rate(const SystemModule *module, int pool)
+{
+    uint64_t total = module->stale_nonces[pool] + module->pool_nonces[pool];
+    return total > 0 ? 100.0f * module->stale_nonces[pool] / total : 0;
+}
+
 static const char *get_reset_reason_str(esp_reset_reason_t reason)
 {
     switch (reason) {
@@ -51,6 +60,9 @@ static void system_api_add_telemetry(cJSON *root, GlobalState *g) {
     cJSON_AddFloatToObject(root, "coreVoltageActual", g->POWER_MANAGEMENT_MODULE.core_voltage);
     cJSON_AddFloatToObject(root, "actualFrequency", g->POWER_MANAGEMENT_MODULE.actual_frequency);
     cJSON_AddFloatToObject(root, "expectedHashrate", g->POWER_MANAGEMENT_MODULE.expected_hashrate);
+    cJSON_AddFloatToObject(root, "jobInterval", g->ASIC_TASK_MODULE.job_interval_ms);
+    cJSON_AddFloatToObject(root, "workStarvation", ASIC_get_work_starvation(g));
+    cJSON_AddNumberToObject(root, "ticketDifficulty", g->ASIC_TASK_MODULE.ticket_difficulty);
     cJSON_AddNumberToObject(root, "fanspeed", g->POWER_MANAGEMENT_MODULE.fan_perc);
     cJSON_AddNumberToObject(root, "fanrpm", g->POWER_MANAGEMENT_MODULE.fan_rpm);
     cJSON_AddNumberToObject(root, "fan2rpm", g->POWER_MANAGEMENT_MODULE.fan2_rpm);
@@ -63,12 +75,28 @@ static void system_api_add_telemetry(cJSON *root, GlobalState *g) {
     cJSON_AddFloatToObject(root, "errorPercentage", g->SYSTEM_MODULE.error_percentage);
     cJSON_AddNumberToObject(root, "sharesAccepted", g->SYSTEM_MODULE.shares_accepted);
     cJSON_AddNumberToObject(root, "sharesRejected", g->SYSTEM_MODULE.shares_rejected);
+    cJSON_AddNumberToObject(root, "duplicateNonces", g->SYSTEM_MODULE.duplicate_nonces);
+    cJSON_AddNumberToObject(root, "sharesDropped", g->SYSTEM_MODULE.shares_dropped);
+    cJSON_AddNumberToObject(root, "staleNonces", g->SYSTEM_MODULE.stale_nonces[0]);
+    cJSON_AddFloatToObject(root, "staleRate", stale_rate(&g->SYSTEM_MODULE, 0));
+    cJSON_AddNumberToObject(root, "fallbackStaleNonces", g->SYSTEM_MODULE.stale_nonces[1]);
+    cJSON_AddFloatToObject(root, "fallbackStaleRate", stale_rate(&g->SYSTEM_MODULE, 1));
     cJSON_AddNumberToObject(root, "bestDiff", g->SYSTEM_MODULE.best_nonce_diff);
     cJSON_AddNumberToObject(root, "bestSessionDiff", g->SYSTEM_MODULE.best_session_nonce_diff);
     cJSON_AddNumberToObject(root, "poolDifficulty", g->pool_difficulty);
     cJSON_AddFloatToObject(root, "responseTime", g->SYSTEM_MODULE.response_time);
+    cJSON_AddNumberToObject(root, "failoverGap", g->SYSTEM_MODULE.failover_gap_ms);
     cJSON_AddNumberToObject(root, "responseShareBatch", g->SYSTEM_MODULE.response_share_batch);
     cJSON_AddFloatToObject(root, "processTime", g->SYSTEM_MODULE.process_time);
+    cJSON_AddNumberToObject(root, "stratumQueueDepth", queue_count(&g->stratum_queue));
+    cJSON_AddNumberToObject(root, "stratumQueueHighWater", atomic_load(&g->stratum_queue.high_water));
+    cJSON_AddNumberToObject(root, "stratumQueueDropped", atomic_load(&g->stratum_queue.dropped));
+
+    uint64_t stratum_bytes_received;
+    uint32_t stratum_lines_parsed;
+    STRATUM_V1_get_reader_stats(&stratum_bytes_received, &stratum_lines_parsed);
+    cJSON_AddNumberToObject(root, "stratumBytesReceived", stratum_bytes_received);
+    cJSON_AddNumberToObject(root, "stratumLinesParsed", stratum_lines_parsed);
 
     // Dynamic Block Info
     cJSON_AddNumberToObject(root, "blockFound", g->SYSTEM_MODULE.block_found);
@@ -147,6 +175,7 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
 
     // Pool Configuration
     cJSON_AddStringToObject(root, "poolConnectionInfo", g->SYSTEM_MODULE.pool_connection_info);
+    cJSON_AddFloatToObject(root, "poolHandshakeTime", g->SYSTEM_MODULE.pool_handshake_time);
     cJSON_AddNumberToObject(root, "isUsingFallbackStratum", g->SYSTEM_MODULE.is_using_fallback ? 1 : 0);
     
     char *s_url = nvs_config_get_string(NVS_CONFIG_STRATUM_URL);
@@ -157,6 +186,7 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
     cJSON_AddStringToObject(root, "stratumUser", s_user ? s_user : "");
     free(s_user);
     cJSON_AddNumberToObject(root, "stratumSuggestedDifficulty", nvs_config_get_u16(NVS_CONFIG_STRATUM_DIFFICULTY));
+    cJSON_AddNumberToObject(root, "stratumSharesPerMinute", nvs_config_get_u16(NVS_CONFIG_STRATUM_SHARES_PER_MINUTE));
     cJSON_AddBoolToObject(root, "stratumExtranonceSubscribe", nvs_config_get_bool(NVS_CONFIG_STRATUM_EXTRANONCE_SUBSCRIBE));
     cJSON_AddNumberToObject(root, "stratumTLS", nvs_config_get_u16(NVS_CONFIG_STRATUM_TLS));
     char *s_cert = nvs_config_get_string(NVS_CONFIG_STRATUM_CERT);
@@ -178,6 +208,7 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
     cJSON_AddStringToObject(root, "fallbackStratumCert", f_cert ? f_cert : "");
     free(f_cert);
     cJSON_AddBoolToObject(root, "fallbackStratumDecodeCoinbase", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_DECODE_COINBASE_TX));
+    cJSON_AddBoolToObject(root, "fallbackStratumHotStandby", nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_HOT_STANDBY));
 
     char *stratum_proto = nvs_config_get_string(NVS_CONFIG_STRATUM_PROTOCOL);
     cJSON_AddStringToObject(root, "stratumProtocol", stratum_proto ? stratum_proto : STRATUM_V1);
@@ -205,6 +236,7 @@ static void system_api_add_config(cJSON *root, GlobalState *g) {
 
     // User Preferences
     cJSON_AddNumberToObject(root, "overclockEnabled", nvs_config_get_bool(NVS_CONFIG_OVERCLOCK_ENABLED) ? 1 : 0);
+    cJSON_AddNumberToObject(root, "chipTuning", nvs_config_get_bool(NVS_CONFIG_CHIP_TUNING) ? 1 : 0);
     char *disp_name = nvs_config_get_string(NVS_CONFIG_DISPLAY);
     cJSON_AddStringToObject(root, "display", disp_name ? disp_name : "");
     free(disp_name);
@@ -239,6 +271,14 @@ static void system_api_add_hashrate_monitor(cJSON *root, GlobalState *g) {
         
         cJSON_AddNumberToObject(asic, "total", g->HASHRATE_MONITOR_MODULE.total_measurement[i].hashrate);
         cJSON_AddNumberToObject(asic, "errorCount", g->HASHRATE_MONITOR_MODULE.error_measurement[i].value);
+
+        asic_rx_stats rx_stats;
+        get_asic_rx_stats(i, &rx_stats);
+        cJSON_AddNumberToObject(asic, "rxCrcErrors", rx_stats.crc_errors);
+        cJSON_AddNumberToObject(asic, "rxResyncs", rx_stats.resyncs);
+
+        const chip_tuner *tuner = &g->POWER_MANAGEMENT_MODULE.chip_tuner;
+        cJSON_AddNumberToObject(asic, "frequency", i < tuner->chip_count ? tuner->chips[i].frequency : g->POWER_MANAGEMENT_MODULE.actual_frequency);
         
         cJSON *domains = cJSON_CreateArray();
         cJSON_AddItemToObject(asic, "domains", domains);
@@ -304,3 +344,64 @@ cJSON* system_api_get_full_json(GlobalState *g) {
 
     return root;
 }
+
+static void system_api_add_share_counts(cJSON *pool, const char *name, share_counts counts) {
+    cJSON *obj = cJSON_CreateObject();
+    if (!obj) return;
+
+    uint32_t total = counts.accepted + counts.rejected + counts.stale;
+    cJSON_AddNumberToObject(obj, "accepted", counts.accepted);
+    cJSON_AddNumberToObject(obj, "rejected", counts.rejected);
+    cJSON_AddNumberToObject(obj, "stale", counts.stale);
+    cJSON_AddItemToObject(obj, "rejectedPercent",
+                          cJSON_CreateFloat(total > 0 ? (counts.rejected + counts.stale) * 100.0f / total : 0.0f));
+    cJSON_AddItemToObject(pool, name, obj);
+}
+
+cJSON* system_api_get_shares_json(GlobalState *g) {
+    if (!g) return NULL;
+    cJSON *root = cJSON_CreateObject();
+    if (root == NULL) return NULL;
+
+    cJSON *pools = cJSON_CreateArray();
+    if (!pools) return root;
+    cJSON_AddItemToObject(root, "pools", pools);
+
+    if (g->SYSTEM_MODULE.share_stats == NULL) return root;
+
+    uint32_t minute = esp_timer_get_time() / (60 * 1000000LL);
+
+    pthread_mutex_lock(&g->share_stats_lock);
+    for (int pool = 0; pool < SHARE_STATS_POOLS; pool++) {
+        for (int protocol = 0; protocol < SHARE_STATS_PROTOCOLS; protocol++) {
+            PoolShareStats *stats = &g->SYSTEM_MODULE.share_stats[pool * SHARE_STATS_PROTOCOLS + protocol];
+            share_counts hour = share_rate_sum(&stats->rate, minute, SHARE_RATE_SLOTS);
+            if (stats->latency.total == 0 && hour.accepted + hour.rejected + hour.stale == 0) {
+                continue;
+            }
+
+            cJSON *obj = cJSON_CreateObject();
+            if (!obj) continue;
+            cJSON_AddStringToObject(obj, "pool", pool == 0 ? "primary" : "fallback");
+            cJSON_AddStringToObject(obj, "protocol", protocol == 0 ? STRATUM_V1 : STRATUM_V2);
+
+            cJSON *latency = cJSON_CreateObject();
+            if (latency) {
+                cJSON_AddNumberToObject(latency, "count", stats->latency.total);
+                cJSON_AddNumberToObject(latency, "p50", latency_histogram_percentile(&stats->latency, 50));
+                cJSON_AddNumberToObject(latency, "p90", latency_histogram_percentile(&stats->latency, 90));
+                cJSON_AddNumberToObject(latency, "p99", latency_histogram_percentile(&stats->latency, 99));
+                cJSON_AddNumberToObject(latency, "max", stats->latency.max_ms);
+                cJSON_AddItemToObject(obj, "latency", latency);
+            }
+
+            system_api_add_share_counts(obj, "last10m", share_rate_sum(&stats->rate, minute, 10));
+            system_api_add_share_counts(obj, "last1h", hour);
+
+            cJSON_AddItemToArray(pools, obj);
+        }
+    }
+    pthread_mutex_unlock(&g->share_stats_lock);
+
+    return root;
+}
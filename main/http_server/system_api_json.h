@@ -14,6 +14,15 @@
  */
 cJSON* system_api_get_full_json(GlobalState *g);
 
+/**
+ * @brief Generates the share statistics JSON object: submit latency percentiles
+ * and accepted/rejected/stale counts per pool and protocol.
+ *
+ * @param g Pointer to the GlobalState structure.
+ * @return cJSON* The root JSON object. Caller is responsible for cJSON_Delete().
+ */
+cJSON* system_api_get_shares_json(GlobalState *g);
+
 /**
  * @brief Custom helper to create a JSON number from a float with fixed decimal precision.
  */
@@ -8,6 +8,7 @@
 
 #include "asic_result_task.h"
 #include "create_jobs_task.h"
+#include "share_submit_task.h"
 #include "hashrate_monitor_task.h"
 #include "fan_controller_task.h"
 #include "statistics_task.h"
@@ -166,7 +167,11 @@ void app_main(void)
         vTaskDelay(100 / portTICK_PERIOD_MS);
     }
 
-    queue_init(&GLOBAL_STATE.stratum_queue);
+    queue_init(&GLOBAL_STATE.stratum_queue, QUEUE_SIZE);
+    GLOBAL_STATE.share_queue = xQueueCreateWithCaps(SHARE_QUEUE_SIZE, sizeof(share_submission), MALLOC_CAP_SPIRAM);
+    if (GLOBAL_STATE.share_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate the share queue");
+    }
 
     if (system_init_ret == ESP_OK) {
         if (asic_initialize(&GLOBAL_STATE, ASIC_INIT_COLD_BOOT, 0) == 0) {
@@ -183,6 +188,9 @@ void app_main(void)
             if (xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL) != pdPASS) {
                 ESP_LOGE(TAG, "Error creating asic result task");
             }
+            if (xTaskCreate(share_submit_task, "share submit", 8192, (void *) &GLOBAL_STATE, 10, NULL) != pdPASS) {
+                ESP_LOGE(TAG, "Error creating share submit task");
+            }
 
             if (xTaskCreateWithCaps(hashrate_monitor_task, "hashrate monitor", 8192, (void *) &GLOBAL_STATE, 5, NULL, MALLOC_CAP_SPIRAM) != pdPASS) {
                 ESP_LOGE(TAG, "Error creating hashrate monitor task");
@@ -16,6 +16,7 @@ typedef enum {
     NVS_CONFIG_STRATUM_USER,
     NVS_CONFIG_STRATUM_PASS,
     NVS_CONFIG_STRATUM_DIFFICULTY,
+    NVS_CONFIG_STRATUM_SHARES_PER_MINUTE,
     NVS_CONFIG_STRATUM_EXTRANONCE_SUBSCRIBE,
     NVS_CONFIG_STRATUM_TLS,
     NVS_CONFIG_STRATUM_CERT,
@@ -34,11 +35,13 @@ typedef enum {
     NVS_CONFIG_FALLBACK_SV2_CHANNEL_TYPE,
     NVS_CONFIG_FALLBACK_SV2_AUTHORITY_PUBKEY,
     NVS_CONFIG_FALLBACK_STRATUM_DECODE_COINBASE_TX,
+    NVS_CONFIG_FALLBACK_STRATUM_HOT_STANDBY,
     NVS_CONFIG_USE_FALLBACK_STRATUM,
     
     NVS_CONFIG_ASIC_FREQUENCY,
     NVS_CONFIG_ASIC_VOLTAGE,
     NVS_CONFIG_OVERCLOCK_ENABLED,
+    NVS_CONFIG_CHIP_TUNING,
     
     NVS_CONFIG_DISPLAY,
     NVS_CONFIG_ROTATION,
@@ -14,6 +14,7 @@
 #include "nvs_config.h"
 #include "global_state.h"
 #include "asic_reset.h"
+#include "asic.h"
 #include "device_config.h"
 #include "hashrate_monitor_task.h"
 #include "PID.h"
@@ -268,7 +269,8 @@ void self_test_record_nonce(void * pvParameters, double nonce_diff)
 {
     GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
     SelfTestNonceMeasurement * measurement = &GLOBAL_STATE->SELF_TEST_MODULE.nonce_measurement;
-    double ticket_diff = GLOBAL_STATE->DEVICE_CONFIG.family.asic.difficulty;
+    // the ticket tuner is off during the test, this is the configured difficulty
+    double ticket_diff = ASIC_get_ticket_difficulty(GLOBAL_STATE);
 
     pthread_mutex_lock(&measurement->lock);
     if (measurement->is_active) {
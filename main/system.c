@@ -1,3 +1,4 @@
+#include <ctype.h>
 #include <inttypes.h>
 #include <math.h>
 #include <stdint.h>
@@ -11,6 +12,7 @@
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "esp_heap_caps.h"
 
 #include "driver/gpio.h"
 #include "esp_app_desc.h"
@@ -34,6 +36,7 @@
 #include "filesystem.h"
 #include "work_queue.h"
 #include "hashrate_monitor_task.h"
+#include "vardiff.h"
 
 static const char * TAG = "system";
 
@@ -86,6 +89,7 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     // set the pool difficulty
     module->pool_difficulty = nvs_config_get_u16(NVS_CONFIG_STRATUM_DIFFICULTY);
     module->fallback_pool_difficulty = nvs_config_get_u16(NVS_CONFIG_FALLBACK_STRATUM_DIFFICULTY);
+    module->shares_per_minute = nvs_config_get_u16(NVS_CONFIG_STRATUM_SHARES_PER_MINUTE);
 
     // set the pool extranonce subscribe
     module->pool_extranonce_subscribe = nvs_config_get_bool(NVS_CONFIG_STRATUM_EXTRANONCE_SUBSCRIBE);
@@ -95,6 +99,9 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     module->pool_decode_coinbase_tx = nvs_config_get_bool(NVS_CONFIG_STRATUM_DECODE_COINBASE_TX);
     module->fallback_pool_decode_coinbase_tx = nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_DECODE_COINBASE_TX);
 
+    // keep the fallback pool connected next to the primary
+    module->fallback_pool_hot_standby = nvs_config_get_bool(NVS_CONFIG_FALLBACK_STRATUM_HOT_STANDBY);
+
     // use fallback stratum
     module->use_fallback_stratum = nvs_config_get_bool(NVS_CONFIG_USE_FALLBACK_STRATUM);
 
@@ -141,8 +148,14 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     free(proto_str);
     GLOBAL_STATE->sv2_conn = NULL;
 
+    module->share_stats = heap_caps_calloc(SHARE_STATS_POOLS * SHARE_STATS_PROTOCOLS, sizeof(PoolShareStats), MALLOC_CAP_SPIRAM);
+    if (module->share_stats == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate share statistics");
+    }
+
     // Initialize mutexes
-    pthread_mutex_init(&GLOBAL_STATE->valid_jobs_lock, NULL);
+    pthread_mutex_init(&GLOBAL_STATE->job_slots_lock, NULL);
+    pthread_mutex_init(&GLOBAL_STATE->share_stats_lock, NULL);
     GLOBAL_STATE->stratum_mux = (portMUX_TYPE)portMUX_INITIALIZER_UNLOCKED;
 }
 
@@ -275,38 +288,80 @@ void SYSTEM_clean_jobs_queue(GlobalState * GLOBAL_STATE)
     ESP_LOGI(TAG, "Clean Jobs: clearing queue");
     queue_clear(&GLOBAL_STATE->stratum_queue);
 
-    pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    for (int i = 0; i < 128; i = i + 4) {
-        GLOBAL_STATE->valid_jobs[i] = 0;
-    }
-    pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+    // Results still coming back for the jobs sent so far are stale from now on
+    pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+    job_slots_clean(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots);
+    pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
 
     // Reset hashrate measurements to prevent a spike on reconnection
     hashrate_monitor_reset_measurements(GLOBAL_STATE);
 }
 
-void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE)
+// Stats of the pool in use over protocol, NULL if they couldn't be allocated
+static PoolShareStats * share_stats_for(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    module->shares_accepted++;
+    if (module->share_stats == NULL) {
+        return NULL;
+    }
+    int pool = module->is_using_fallback ? 1 : 0;
+    int protocol_index = protocol == STRATUM_PROTOCOL_V2 ? 1 : 0;
+    return &module->share_stats[pool * SHARE_STATS_PROTOCOLS + protocol_index];
+}
+
+static void record_share_result(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol, share_result result)
+{
+    uint32_t minute = esp_timer_get_time() / (60 * 1000000LL);
+
+    pthread_mutex_lock(&GLOBAL_STATE->share_stats_lock);
+    PoolShareStats * stats = share_stats_for(GLOBAL_STATE, protocol);
+    if (stats != NULL) {
+        share_rate_add(&stats->rate, minute, result);
+    }
+    pthread_mutex_unlock(&GLOBAL_STATE->share_stats_lock);
+}
+
+// Pools word stale rejects differently: "Stale share", "stale-share" (SV2),
+// "Job not found" for a job the pool already dropped
+static bool is_stale_reason(const char * error_msg)
+{
+    char lower[64];
+    size_t i;
+    for (i = 0; i < sizeof(lower) - 1 && error_msg[i] != '\0'; i++) {
+        lower[i] = tolower((unsigned char)error_msg[i]);
+    }
+    lower[i] = '\0';
+
+    return strstr(lower, "stale") != NULL || strstr(lower, "job not found") != NULL;
 }
 
-static int compare_rejected_reason_stats(const void *a, const void *b) {
-    const RejectedReasonStat *ea = a;
-    const RejectedReasonStat *eb = b;
-    return (eb->count > ea->count) - (ea->count > eb->count);
+void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    module->shares_accepted++;
+    record_share_result(GLOBAL_STATE, protocol, SHARE_ACCEPTED);
 }
 
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg)
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol, char * error_msg)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
     module->shares_rejected++;
+    record_share_result(GLOBAL_STATE, protocol, is_stale_reason(error_msg) ? SHARE_STALE : SHARE_REJECTED);
 
     for (int i = 0; i < module->rejected_reason_stats_count; i++) {
         if (strncmp(module->rejected_reason_stats[i].message, error_msg, sizeof(module->rejected_reason_stats[i].message) - 1) == 0) {
             module->rejected_reason_stats[i].count++;
+
+            // Keep the list sorted by count, the entry moves up past the ones it overtook
+            while (i > 0 && module->rejected_reason_stats[i].count > module->rejected_reason_stats[i - 1].count) {
+                RejectedReasonStat tmp = module->rejected_reason_stats[i - 1];
+                module->rejected_reason_stats[i - 1] = module->rejected_reason_stats[i];
+                module->rejected_reason_stats[i] = tmp;
+                i--;
+            }
             return;
         }
     }
@@ -319,11 +374,40 @@ void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg)
         module->rejected_reason_stats[module->rejected_reason_stats_count].count = 1;
         module->rejected_reason_stats_count++;
     }
+}
+
+void SYSTEM_notify_share_response_time(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol, float response_time_ms)
+{
+    pthread_mutex_lock(&GLOBAL_STATE->share_stats_lock);
+    PoolShareStats * stats = share_stats_for(GLOBAL_STATE, protocol);
+    if (stats != NULL) {
+        latency_histogram_record(&stats->latency, (uint32_t)(response_time_ms + 0.5f));
+    }
+    pthread_mutex_unlock(&GLOBAL_STATE->share_stats_lock);
+}
+
+float SYSTEM_hashrate_estimate(GlobalState * GLOBAL_STATE)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    if (module->rejected_reason_stats_count > 1) {
-        qsort(module->rejected_reason_stats, module->rejected_reason_stats_count, 
-            sizeof(module->rejected_reason_stats[0]), compare_rejected_reason_stats);
-    }    
+    if (module->hashrate_10m > 0) {
+        return module->hashrate_10m;
+    }
+    if (module->hashrate_1m > 0) {
+        return module->hashrate_1m;
+    }
+    return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.expected_hashrate;
+}
+
+uint32_t SYSTEM_suggested_difficulty(GlobalState * GLOBAL_STATE, bool fallback)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    double difficulty = vardiff_difficulty_for(SYSTEM_hashrate_estimate(GLOBAL_STATE), module->shares_per_minute);
+    if (difficulty >= VARDIFF_MIN_DIFFICULTY) {
+        return difficulty < UINT32_MAX ? (uint32_t)difficulty : UINT32_MAX;
+    }
+    return fallback ? module->fallback_pool_difficulty : module->pool_difficulty;
 }
 
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
@@ -342,7 +426,38 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
     settimeofday(&tv, NULL);
 }
 
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
+void SYSTEM_notify_new_work(GlobalState * GLOBAL_STATE, bool clean_jobs)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    module->work_received++;
+
+    // Jobs are sent as soon as they are built, so the queue is mostly empty
+    // by now; results for the jobs already on the chips are stale either way
+    pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+    job_slots_notify(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots, clean_jobs);
+    pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
+
+    // First job from the pool the coordinator failed over to
+    if (module->failover_pending) {
+        module->failover_pending = false;
+        module->failover_gap_ms = (esp_timer_get_time() - module->work_lost_time) / 1000;
+        ESP_LOGI(TAG, "Failover gap: %lu ms", module->failover_gap_ms);
+    }
+    module->work_lost_time = 0;
+}
+
+void SYSTEM_notify_work_lost(GlobalState * GLOBAL_STATE)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    // Keep the first loss, retries until the next job all count as one gap
+    if (module->work_lost_time == 0) {
+        module->work_lost_time = esp_timer_get_time();
+    }
+}
+
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint32_t target)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
@@ -351,7 +466,7 @@ void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t
         suffixString((uint64_t) diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
     }
 
-    double network_diff = networkDifficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
+    double network_diff = networkDifficulty(target);
     if (diff >= network_diff) {
         module->block_found++;
         module->show_new_block = true;
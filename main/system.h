@@ -14,10 +14,19 @@ esp_err_t SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE);
 // Shared by the SV1 and SV2 tasks.
 void SYSTEM_clean_jobs_queue(GlobalState * GLOBAL_STATE);
 
-void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE);
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, char * error_msg);
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
+void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol);
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol, char * error_msg);
+// Time from share submit to pool response, accepted or rejected
+void SYSTEM_notify_share_response_time(GlobalState * GLOBAL_STATE, stratum_protocol_t protocol, float response_time_ms);
+// Best known hashrate in GH/s: measured if there is a measurement, expected otherwise
+float SYSTEM_hashrate_estimate(GlobalState * GLOBAL_STATE);
+// Difficulty to suggest to the pool: tuned for the configured share rate, or
+// the fixed (fallback) pool difficulty when that is off
+uint32_t SYSTEM_suggested_difficulty(GlobalState * GLOBAL_STATE, bool fallback);
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double diff, uint32_t target);
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime);
+void SYSTEM_notify_new_work(GlobalState * GLOBAL_STATE, bool clean_jobs);
+void SYSTEM_notify_work_lost(GlobalState * GLOBAL_STATE);
 
 stratum_protocol_t stratum_protocol_from_string(const char *s);
 sv2_channel_type_t sv2_channel_type_from_string(const char *s);
@@ -7,13 +7,12 @@
 #include "esp_log.h"
 #include "nvs_config.h"
 #include "utils.h"
-#include "stratum_v2_task.h"
-#include "sv2_protocol.h"
 #include "hashrate_monitor_task.h"
 #include "asic.h"
 #include "freertos/task.h"
 #include "scoreboard.h"
 #include "self_test.h"
+#include "share_submit_task.h"
 
 static const char *TAG = "asic_result";
 
@@ -21,6 +20,10 @@ void ASIC_result_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
+    // Nonces of one job mostly share a rolled version, so its header midstate is reused
+    static nonce_midstate_cache midstate_cache;
+    nonce_midstate_cache_init(&midstate_cache);
+
     while (1)
     {
         // Check if ASIC is initialized before trying to process work
@@ -43,95 +46,112 @@ void ASIC_result_task(void *pvParameters)
 
         uint8_t job_id = asic_result->job_id;
 
-        pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-        bool valid = (GLOBAL_STATE->valid_jobs[job_id] != 0);
-        bm_job *active_job = valid ? GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id] : NULL;
-        pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
+        // Work on a copy: the slot is reused once the job id wraps around
+        bm_job job;
+        uint8_t pool;
+        uint32_t generation;
+        uint32_t rolled_version = 0;
+        bool duplicate = false;
+        pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+        GLOBAL_STATE->ASIC_TASK_MODULE.last_result_time_us = asic_result->timestamp_us;
+        job_slot_state state = job_slots_lookup(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots, job_id, false, &job, &pool, &generation);
+        if (state != JOB_SLOT_EMPTY) {
+            rolled_version = get_result_rolled_version(&job, asic_result);
+            duplicate = !nonce_filter_insert(GLOBAL_STATE->ASIC_TASK_MODULE.nonce_filter, job_id, asic_result->nonce, rolled_version);
+        }
+        pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
+        const bm_job *active_job = &job;
 
-        if (!valid || active_job == NULL)
+        if (state == JOB_SLOT_EMPTY)
         {
             ESP_LOGW(TAG, "Invalid job nonce found, 0x%02X", job_id);
             continue;
         }
-        // check the nonce difficulty
-        double nonce_diff = test_nonce_value(active_job, asic_result->nonce, asic_result->rolled_version);
+
+        // The chips can return the same nonce twice, the pool would reject the second one
+        if (duplicate)
+        {
+            GLOBAL_STATE->SYSTEM_MODULE.duplicate_nonces++;
+            ESP_LOGW(TAG, "Duplicate nonce %08" PRIX32 " dropped (job 0x%02X, ver %08" PRIX32 ")", asic_result->nonce, job_id, rolled_version);
+            continue;
+        }
+        // check the nonce difficulty, anything below the ASIC ticket difficulty comes back as 0
+        double ticket_diff = ASIC_get_ticket_difficulty(GLOBAL_STATE);
+        double nonce_diff = test_nonce_value_cached(&midstate_cache, active_job, asic_result->nonce, rolled_version, ticket_diff);
+
+        // The id may have gone to a new job while this nonce was still in the
+        // UART FIFO, check it against the job the id held before
+        if (nonce_diff == 0) {
+            bm_job previous_job;
+            uint8_t previous_pool;
+            uint32_t previous_generation;
+            pthread_mutex_lock(&GLOBAL_STATE->job_slots_lock);
+            job_slot_state previous_state = job_slots_lookup(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots, job_id, true, &previous_job, &previous_pool, &previous_generation);
+            pthread_mutex_unlock(&GLOBAL_STATE->job_slots_lock);
+
+            // skip it if the id moved on again since the first lookup
+            if (previous_state != JOB_SLOT_EMPTY && previous_generation + 1 == generation) {
+                uint32_t previous_rolled_version = get_result_rolled_version(&previous_job, asic_result);
+                double previous_diff = test_nonce_value_cached(&midstate_cache, &previous_job, asic_result->nonce, previous_rolled_version, ticket_diff);
+                if (previous_diff > 0) {
+                    ESP_LOGI(TAG, "Late nonce %08" PRIX32 " for the previous job of id 0x%02X (generation %" PRIu32 ")", asic_result->nonce, job_id, previous_generation);
+                    job = previous_job;
+                    pool = previous_pool;
+                    state = previous_state;
+                    rolled_version = previous_rolled_version;
+                    nonce_diff = previous_diff;
+                }
+            }
+        }
+
+        // the nonce rate the ticket difficulty is tuned on
+        if (nonce_diff > 0) {
+            GLOBAL_STATE->ASIC_TASK_MODULE.ticket_nonces++;
+        }
 
         if (GLOBAL_STATE->SELF_TEST_MODULE.is_active) {
             self_test_record_nonce(GLOBAL_STATE, nonce_diff);
             continue;
         }
 
-        uint32_t version_bits = asic_result->rolled_version ^ active_job->version;
+        if (nonce_diff == 0) {
+            ESP_LOGW(TAG, "Nonce %08" PRIX32 " below ticket difficulty (job 0x%02X, ver %08" PRIX32 ")", asic_result->nonce, job_id, rolled_version);
+            continue;
+        }
+
+        // Real work, but for a job the pool has replaced since: it would only be rejected
+        if (state == JOB_SLOT_STALE) {
+            GLOBAL_STATE->SYSTEM_MODULE.stale_nonces[pool]++;
+            ESP_LOGW(TAG, "Stale nonce %08" PRIX32 " dropped (job %s, id 0x%02X)", asic_result->nonce, active_job->jobid, job_id);
+            continue;
+        }
+        GLOBAL_STATE->SYSTEM_MODULE.pool_nonces[pool]++;
+
+        uint32_t version_bits = rolled_version ^ active_job->version;
         if (nonce_diff >= active_job->pool_diff)
         {
-            if (GLOBAL_STATE->stratum_protocol == STRATUM_PROTOCOL_V2) {
-                // SV2: submit with binary protocol
-                int ret;
-                uint32_t sv2_job_id = (uint32_t)strtoul(active_job->jobid, NULL, 10);
-
-                if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                    sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-                    // SV2 spec: extranonce_size is the miner's rollable portion.
-                    // The pool prepends its extranonce_prefix separately.
-                    uint8_t en2_len = conn->extranonce_size;
-                    uint8_t extranonce_2[32];
-                    hex2bin(active_job->extranonce2, extranonce_2, en2_len);
-                    ret = stratum_v2_submit_share_extended(GLOBAL_STATE, sv2_job_id,
-                                                           asic_result->nonce,
-                                                           active_job->ntime,
-                                                           asic_result->rolled_version,
-                                                           extranonce_2, en2_len);
-                } else {
-                    ret = stratum_v2_submit_share(GLOBAL_STATE, sv2_job_id,
-                                                   asic_result->nonce,
-                                                   active_job->ntime,
-                                                   asic_result->rolled_version);
-                }
-
-                if (ret < 0) {
-                    ESP_LOGW(TAG, "Failed to submit SV2 share (ret=%d, errno=%d: %s)",
-                             ret, errno, strerror(errno));
-                }
-            } else {
-                // V1: submit with JSON-RPC
-                char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
-
-                taskENTER_CRITICAL(&GLOBAL_STATE->stratum_mux);
-                esp_transport_handle_t transport = GLOBAL_STATE->transport;
-                int uid = GLOBAL_STATE->send_uid++;
-                taskEXIT_CRITICAL(&GLOBAL_STATE->stratum_mux);
-
-                if (transport == NULL) {
-                    ESP_LOGW(TAG, "No stratum connection, dropping share (job 0x%02X)", job_id);
-                } else {
-                    uint64_t sent_time_us = 0;
-                    int ret = STRATUM_V1_submit_share(
-                        transport,
-                        uid,
-                        user,
-                        active_job->jobid,
-                        active_job->extranonce2,
-                        active_job->ntime,
-                        asic_result->nonce,
-                        version_bits,
-                        &sent_time_us);
-
-                    if (ret < 0) {
-                        ESP_LOGW(TAG, "Unable to write share to socket (ret: %d, errno %d: %s)", ret, errno, strerror(errno));
-                        // stratum_task recv loop will detect a broken connection on its next read and handle reconnection
-                    }
-
-                    float process_time = (sent_time_us - asic_result->timestamp_us) / 1000.0f;
-                    GLOBAL_STATE->SYSTEM_MODULE.process_time = process_time;
-                    ESP_LOGI(TAG, "Processing time: %0.1f ms", process_time);
-                }
+            // The socket write happens in the submit task so a slow pool never stalls UART reads
+            share_submission share;
+            strcpy(share.jobid, active_job->jobid);
+            strcpy(share.extranonce2, active_job->extranonce2);
+            share.ntime = active_job->ntime;
+            share.nonce = asic_result->nonce;
+            share.rolled_version = rolled_version;
+            share.version_bits = version_bits;
+            share.asic_job_id = job_id;
+            share.found_time_us = asic_result->timestamp_us;
+
+            // a full queue holds the UART reads back briefly rather than losing the share
+            if (xQueueSend(GLOBAL_STATE->share_queue, &share, pdMS_TO_TICKS(SHARE_QUEUE_WAIT_MS)) != pdTRUE) {
+                GLOBAL_STATE->SYSTEM_MODULE.shares_dropped++;
+                ESP_LOGE(TAG, "Share queue full, dropped share (job %s, nonce %08" PRIX32 ")", active_job->jobid, asic_result->nonce);
             }
         }
 
         //log the ASIC response
-        ESP_LOGI(TAG, "ID: %s, ASIC nr: %d, Core: %d/%d, ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %g.", active_job->jobid, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id, asic_result->rolled_version, asic_result->nonce, nonce_diff, active_job->pool_diff);
+        ESP_LOGI(TAG, "ID: %s, ASIC nr: %d, Core: %d/%d, ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %g.", active_job->jobid, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id, rolled_version, asic_result->nonce, nonce_diff, active_job->pool_diff);
 
-        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, job_id);
+        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, active_job->target);
 
         scoreboard_add(&GLOBAL_STATE->SYSTEM_MODULE.scoreboard, nonce_diff, active_job->jobid, active_job->extranonce2, active_job->ntime, asic_result->nonce, version_bits);
     }
@@ -20,16 +20,39 @@
 static const char *TAG = "create_jobs_task";
 
 #define MAX_EXTRANONCE2_LEN 32
-#define MAX_EXTRANONCE2_STR (MAX_EXTRANONCE2_LEN * 2 + 1)
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty);
+// Coinbase of current_work with the SHA-256 prefix state cached; freed together with it
+static coinbase_template coinbase_tmpl;
+
+// Number of serialized jobs kept ready ahead of the send deadline
+#define JOB_RING_SIZE 4
+
+static bool generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty, bm_job *next_job);
 static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *job, double difficulty);
-static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *job, double difficulty, uint64_t extranonce_2_counter);
+static bool generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *job, double difficulty, uint64_t extranonce_2_counter, bm_job *next_job);
+
+// Jobs for current_work and the upcoming extranonce_2 values, already serialized
+// with job id and CRC16 so the send path only has to write them to the UART
+static asic_job_packet job_ring[JOB_RING_SIZE];
+static int job_ring_head = 0;
+static int job_ring_count = 0;
+
+// Jobs built on the spot (empty ring, SV2 standard channel) are assembled here.
+// Together with the ring and the job slots this keeps job creation off the heap.
+static asic_job_packet direct_packet;
+
+static void job_ring_flush(void)
+{
+    job_ring_head = 0;
+    job_ring_count = 0;
+}
 
 // Free a work item using the correct free function for the protocol it was created under
 static void free_work_item(GlobalState *GLOBAL_STATE, void *work, stratum_protocol_t protocol)
 {
     if (!work) return;
+    job_ring_flush();
+    coinbase_template_free(&coinbase_tmpl);
     if (protocol == STRATUM_PROTOCOL_V2) {
         if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
             sv2_ext_job_free((sv2_ext_job_t *)work);
@@ -41,17 +64,90 @@ static void free_work_item(GlobalState *GLOBAL_STATE, void *work, stratum_protoc
     }
 }
 
+// V1 and SV2 extended channels roll extranonce_2, so every job is unique and can be built ahead
+static bool work_is_rollable(GlobalState *GLOBAL_STATE, stratum_protocol_t protocol)
+{
+    return protocol != STRATUM_PROTOCOL_V2 || stratum_v2_is_extended_channel(GLOBAL_STATE);
+}
+
+// Fill in the derived fields the ASIC's job format asks for; nothing for header-only chips
+static void generate_job_midstates(GlobalState *GLOBAL_STATE, asic_job_packet *packet)
+{
+    construct_bm_job_midstates(&packet->job, &GLOBAL_STATE->ASIC_TASK_MODULE.job_format, &packet->midstates);
+}
+
+static bool generate_next_work(GlobalState *GLOBAL_STATE, void *work, stratum_protocol_t protocol,
+                               double difficulty, uint64_t *extranonce_2, asic_job_packet *packet)
+{
+    bool ok;
+    if (protocol == STRATUM_PROTOCOL_V2) {
+        ok = generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)work, difficulty, *extranonce_2, &packet->job);
+    } else {
+        ok = generate_work(GLOBAL_STATE, (mining_notify *)work, *extranonce_2, difficulty, &packet->job);
+    }
+    (*extranonce_2)++;
+    if (ok) {
+        generate_job_midstates(GLOBAL_STATE, packet);
+    }
+    return ok;
+}
+
+static void job_ring_fill(GlobalState *GLOBAL_STATE, void *work, stratum_protocol_t protocol,
+                          double difficulty, uint64_t *extranonce_2)
+{
+    if (!GLOBAL_STATE->ASIC_initalized) {
+        return;
+    }
+
+    while (job_ring_count < JOB_RING_SIZE) {
+        asic_job_packet *packet = &job_ring[(job_ring_head + job_ring_count) % JOB_RING_SIZE];
+        if (!generate_next_work(GLOBAL_STATE, work, protocol, difficulty, extranonce_2, packet)) {
+            return;
+        }
+        if (!ASIC_prepare_work(GLOBAL_STATE, packet)) {
+            return;
+        }
+        job_ring_count++;
+    }
+}
+
+static void send_next_job(GlobalState *GLOBAL_STATE, void *work, stratum_protocol_t protocol,
+                          double difficulty, uint64_t *extranonce_2)
+{
+    if (!GLOBAL_STATE->ASIC_initalized) {
+        ESP_LOGW(TAG, "ASIC not initialized, skipping job send");
+        return;
+    }
+
+    if (job_ring_count > 0) {
+        ASIC_send_job_packet(GLOBAL_STATE, &job_ring[job_ring_head]);
+        job_ring_head = (job_ring_head + 1) % JOB_RING_SIZE;
+        job_ring_count--;
+        return;
+    }
+
+    // Ring ran dry (new work or clean_jobs): build this one on the spot
+    if (generate_next_work(GLOBAL_STATE, work, protocol, difficulty, extranonce_2, &direct_packet) &&
+        ASIC_prepare_work(GLOBAL_STATE, &direct_packet)) {
+        ASIC_send_job_packet(GLOBAL_STATE, &direct_packet);
+    }
+}
+
 void create_jobs_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
 
     // Initialize ASIC task module (moved from ASIC_task)
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = heap_caps_malloc(sizeof(bm_job *) * 128, MALLOC_CAP_SPIRAM);
-    GLOBAL_STATE->valid_jobs = heap_caps_malloc(sizeof(uint8_t) * 128, MALLOC_CAP_SPIRAM);
-    for (int i = 0; i < 128; i++) {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
+    // The job slots are allocated once; jobs are copied into the slot matching their job id
+    GLOBAL_STATE->ASIC_TASK_MODULE.job_slots = heap_caps_malloc(sizeof(job_slots), MALLOC_CAP_SPIRAM);
+    GLOBAL_STATE->ASIC_TASK_MODULE.nonce_filter = heap_caps_malloc(sizeof(nonce_filter), MALLOC_CAP_SPIRAM);
+    if (GLOBAL_STATE->ASIC_TASK_MODULE.job_slots == NULL || GLOBAL_STATE->ASIC_TASK_MODULE.nonce_filter == NULL) {
+        ESP_LOGE(TAG, "Failed to allocate job pool");
+        vTaskDelete(NULL);
+        return;
     }
+    job_slots_init(GLOBAL_STATE->ASIC_TASK_MODULE.job_slots);
+    nonce_filter_init(GLOBAL_STATE->ASIC_TASK_MODULE.nonce_filter);
 
     double difficulty = GLOBAL_STATE->pool_difficulty;
     void *current_work = NULL;
@@ -95,8 +191,8 @@ void create_jobs_task(void *pvParameters)
                 // Protocol switched during our blocking dequeue.
                 // The dequeued item may be from either the old or new protocol —
                 // we cannot safely determine which type it is, so discard it.
-                // free() is safe for both sv2_job_t (flat) and mining_notify (malloc'd;
-                // internal strings leak but this is a rare protocol-switch event).
+                // free() is safe for both: sv2_job_t is flat and mining_notify is a
+                // single allocation (sv2_ext_job_t's own buffers leak, but this is rare).
                 ESP_LOGW(TAG, "Protocol switch detected during dequeue, discarding stale item");
                 free(new_work);
                 current_work_protocol = active_protocol;
@@ -129,22 +225,9 @@ void create_jobs_task(void *pvParameters)
                 GLOBAL_STATE->new_stratum_version_rolling_msg = false;
             }
 
+            // A new template goes to the chips right away, clean_jobs or not,
+            // rather than waiting for the current job's interval to run out
             extranonce_2 = 0;
-
-            // Check clean_jobs flag
-            bool clean;
-            if (current_work_protocol == STRATUM_PROTOCOL_V2) {
-                if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                    clean = ((sv2_ext_job_t *)current_work)->clean_jobs;
-                } else {
-                    clean = ((sv2_job_t *)current_work)->clean_jobs;
-                }
-            } else {
-                clean = ((mining_notify *)current_work)->clean_jobs;
-            }
-            if (!clean) {
-                continue;
-            }
         } else {
             if (current_work == NULL) {
                 vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -172,62 +255,101 @@ void create_jobs_task(void *pvParameters)
             continue;
         }
 
-        // Generate and send job
-        if (active_protocol == STRATUM_PROTOCOL_V2) {
-            if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
-                generate_work_sv2_ext(GLOBAL_STATE, (sv2_ext_job_t *)current_work, difficulty, extranonce_2);
-                extranonce_2++;
-            } else {
-                generate_work_sv2(GLOBAL_STATE, (sv2_job_t *)current_work, difficulty);
-            }
-        } else {
-            generate_work(GLOBAL_STATE, (mining_notify *)current_work, extranonce_2, difficulty);
-            extranonce_2++;
+        // Send the next job, then refill the ring off the critical path
+        if (!work_is_rollable(GLOBAL_STATE, active_protocol)) {
+            generate_work_sv2(GLOBAL_STATE, (sv2_job_t *)current_work, difficulty);
+            timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
+            continue;
+        }
+
+        send_next_job(GLOBAL_STATE, current_work, active_protocol, difficulty, &extranonce_2);
+        uint64_t send_time = esp_timer_get_time();
+        job_ring_fill(GLOBAL_STATE, current_work, active_protocol, difficulty, &extranonce_2);
+
+        timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE) - (esp_timer_get_time() - send_time) / 1000;
+        if (timeout_ms < 0) {
+            timeout_ms = 0;
         }
-        timeout_ms = ASIC_get_asic_job_frequency_ms(GLOBAL_STATE);
     }
 }
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty)
+// The template is built once per work item and only rebuilt if the extranonce
+// it was built with changes (e.g. mining.set_extranonce mid-job).
+static bool coinbase_template_matches(const uint8_t *extranonce, size_t extranonce_len, size_t prefix_len, size_t extranonce_2_len)
 {
-    if (GLOBAL_STATE->extranonce_2_len > MAX_EXTRANONCE2_LEN) {
-        ESP_LOGE(TAG, "extranonce_2_len %d exceeds maximum %d, skipping job", GLOBAL_STATE->extranonce_2_len, MAX_EXTRANONCE2_LEN);
-        return;
+    return coinbase_tmpl.coinbase != NULL &&
+           coinbase_tmpl.extranonce_2_offset == prefix_len + extranonce_len &&
+           coinbase_tmpl.extranonce_2_len == extranonce_2_len &&
+           memcmp(coinbase_tmpl.coinbase + prefix_len, extranonce, extranonce_len) == 0;
+}
+
+static bool prepare_coinbase_template(GlobalState *GLOBAL_STATE, mining_notify *notification)
+{
+    size_t extranonce_len = strlen(GLOBAL_STATE->extranonce_str) / 2;
+    uint8_t extranonce[extranonce_len + 1];
+    hex2bin(GLOBAL_STATE->extranonce_str, extranonce, extranonce_len);
+
+    if (coinbase_template_matches(extranonce, extranonce_len, strlen(notification->coinbase_1) / 2, GLOBAL_STATE->extranonce_2_len)) {
+        return true;
     }
-    char extranonce_2_str[MAX_EXTRANONCE2_STR];
-    extranonce_2_generate(extranonce_2, GLOBAL_STATE->extranonce_2_len, extranonce_2_str);
 
-    uint8_t coinbase_tx_hash[32];
-    calculate_coinbase_tx_hash(notification->coinbase_1, notification->coinbase_2, GLOBAL_STATE->extranonce_str, extranonce_2_str, coinbase_tx_hash);
+    coinbase_template_free(&coinbase_tmpl);
+    if (coinbase_template_init_hex(&coinbase_tmpl, notification->coinbase_1, notification->coinbase_2,
+                                   GLOBAL_STATE->extranonce_str, GLOBAL_STATE->extranonce_2_len,
+                                   (const uint8_t(*)[32])notification->merkle_branches, notification->n_merkle_branches) != 0) {
+        ESP_LOGE(TAG, "Failed to allocate coinbase template");
+        return false;
+    }
+    return true;
+}
 
-    uint8_t merkle_root[32];
-    calculate_merkle_root_hash(coinbase_tx_hash, (uint8_t(*)[32])notification->merkle_branches, notification->n_merkle_branches, merkle_root);
+static bool prepare_coinbase_template_sv2_ext(sv2_conn_t *conn, sv2_ext_job_t *ext_job)
+{
+    if (coinbase_template_matches(conn->extranonce_prefix, conn->extranonce_prefix_len, ext_job->coinbase_prefix_len, conn->extranonce_size)) {
+        return true;
+    }
 
-    bm_job *next_job = malloc(sizeof(bm_job));
+    coinbase_template_free(&coinbase_tmpl);
+    if (coinbase_template_init(&coinbase_tmpl,
+                               ext_job->coinbase_prefix, ext_job->coinbase_prefix_len,
+                               conn->extranonce_prefix, conn->extranonce_prefix_len,
+                               conn->extranonce_size,
+                               ext_job->coinbase_suffix, ext_job->coinbase_suffix_len,
+                               (const uint8_t(*)[32])ext_job->merkle_path, ext_job->merkle_path_count) != 0) {
+        ESP_LOGE(TAG, "Failed to allocate SV2 coinbase template");
+        return false;
+    }
+    return true;
+}
 
-    if (next_job == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for new job");
-        return;
+static bool generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint64_t extranonce_2, double difficulty, bm_job *next_job)
+{
+    if (GLOBAL_STATE->extranonce_2_len > MAX_EXTRANONCE2_LEN) {
+        ESP_LOGE(TAG, "extranonce_2_len %d exceeds maximum %d, skipping job", GLOBAL_STATE->extranonce_2_len, MAX_EXTRANONCE2_LEN);
+        return false;
+    }
+    if (strlen(notification->job_id) >= BM_JOB_ID_MAX) {
+        ESP_LOGE(TAG, "Job id %s exceeds maximum length %d, skipping job", notification->job_id, BM_JOB_ID_MAX - 1);
+        return false;
+    }
+    if (!prepare_coinbase_template(GLOBAL_STATE, notification)) {
+        return false;
     }
 
-    construct_bm_job(notification, merkle_root, GLOBAL_STATE->version_mask, difficulty, next_job);
+    // Same byte layout as extranonce_2_generate: little-endian counter, zero padded
+    uint8_t extranonce_2_bin[MAX_EXTRANONCE2_LEN] = { 0 };
+    size_t copy_len = GLOBAL_STATE->extranonce_2_len < (int)sizeof(uint64_t) ? (size_t)GLOBAL_STATE->extranonce_2_len : sizeof(uint64_t);
+    memcpy(extranonce_2_bin, &extranonce_2, copy_len);
 
-    next_job->extranonce2 = strdup(extranonce_2_str);
-    next_job->jobid = strdup(notification->job_id);
-    next_job->version_mask = GLOBAL_STATE->version_mask;
+    uint8_t merkle_root[32];
+    coinbase_template_merkle_root(&coinbase_tmpl, extranonce_2_bin, merkle_root);
 
-    // Check if ASIC is initialized before trying to send work
-    if (!GLOBAL_STATE->ASIC_initalized) {
-        // Clean up the job since we're not sending it
-        // Note: This job was never stored in active_jobs, so it's safe to free
-        ESP_LOGW(TAG, "ASIC not initialized, skipping job send");
-        free(next_job->jobid);
-        free(next_job->extranonce2);
-        free(next_job);
-        return;
-    }
+    construct_bm_job(notification, merkle_root, GLOBAL_STATE->version_mask, difficulty, next_job);
+
+    bin2hex(extranonce_2_bin, GLOBAL_STATE->extranonce_2_len, next_job->extranonce2, sizeof(next_job->extranonce2));
+    strcpy(next_job->jobid, notification->job_id);
 
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    return true;
 }
 
 // Construct bm_job directly from SV2 fields (no coinbase/merkle computation needed).
@@ -235,13 +357,12 @@ static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification
 // version bits using version_mask, giving different midstates per nonce search space.
 static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, double difficulty)
 {
-    bm_job *next_job = malloc(sizeof(bm_job));
-    if (next_job == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for new SV2 job");
+    if (!GLOBAL_STATE->ASIC_initalized) {
+        ESP_LOGW(TAG, "ASIC not initialized, skipping SV2 job send");
         return;
     }
 
-    uint32_t version_mask = GLOBAL_STATE->version_mask;
+    bm_job *next_job = &direct_packet.job;
 
     next_job->version = sv2_job->version;
     next_job->target = sv2_job->nbits;
@@ -254,69 +375,26 @@ static void generate_work_sv2(GlobalState *GLOBAL_STATE, sv2_job_t *sv2_job, dou
     reverse_32bit_words(sv2_job->merkle_root, next_job->merkle_root);
     reverse_32bit_words(sv2_job->prev_hash, next_job->prev_block_hash);
 
-    // Compute midstate(s) using the same logic as construct_bm_job.
-    // Midstate covers bytes 0-63 of block header: version(4B) + prev_hash(32B) + merkle_root[0:28](28B).
-    uint8_t midstate_data[64];
-    uint32_t base_version = sv2_job->version;
-    memcpy(midstate_data, &base_version, 4);
-    memcpy(midstate_data + 4, sv2_job->prev_hash, 32);
-    memcpy(midstate_data + 36, sv2_job->merkle_root, 28);
-
-    uint8_t midstate[32];
-    midstate_sha256_bin(midstate_data, 64, midstate);
-    reverse_32bit_words(midstate, next_job->midstate);
-
-    if (version_mask != 0) {
-        uint32_t rolled_version = increment_bitmask(base_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate1);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate2);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate3);
-        next_job->num_midstates = 4;
-    } else {
-        next_job->num_midstates = 1;
-    }
-
     // SV2 job metadata
-    char jobid_str[16];
-    snprintf(jobid_str, sizeof(jobid_str), "%" PRIu32, sv2_job->job_id);
-    next_job->jobid = strdup(jobid_str);
-    next_job->extranonce2 = strdup(""); // unused in SV2 standard
-    next_job->version_mask = version_mask;
+    snprintf(next_job->jobid, sizeof(next_job->jobid), "%" PRIu32, sv2_job->job_id);
+    next_job->extranonce2[0] = '\0'; // unused in SV2 standard
+    next_job->version_mask = GLOBAL_STATE->version_mask;
 
-    if (!GLOBAL_STATE->ASIC_initalized) {
-        ESP_LOGW(TAG, "ASIC not initialized, skipping SV2 job send");
-        free(next_job->jobid);
-        free(next_job->extranonce2);
-        free(next_job);
-        return;
-    }
+    generate_job_midstates(GLOBAL_STATE, &direct_packet);
 
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    if (ASIC_prepare_work(GLOBAL_STATE, &direct_packet)) {
+        ASIC_send_job_packet(GLOBAL_STATE, &direct_packet);
+    }
 }
 
 // Extended channel work generation: compute coinbase hash from prefix+extranonce+suffix,
 // then merkle root from merkle path, then midstates. extranonce_2 provides unique work.
-static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_job,
-                                   double difficulty, uint64_t extranonce_2_counter)
+static bool generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_job,
+                                  double difficulty, uint64_t extranonce_2_counter, bm_job *next_job)
 {
     sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-    if (!conn) return;
-
-    bm_job *next_job = malloc(sizeof(bm_job));
-    if (!next_job) {
-        ESP_LOGE(TAG, "Failed to allocate memory for SV2 ext job");
-        return;
-    }
+    if (!conn) return false;
+    if (!prepare_coinbase_template_sv2_ext(conn, ext_job)) return false;
 
     uint32_t version_mask = GLOBAL_STATE->version_mask;
 
@@ -331,20 +409,10 @@ static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_
         extranonce_2_counter >>= 8;
     }
 
-    // Compute coinbase tx hash: prefix + extranonce_prefix + extranonce_2 + suffix
-    uint8_t coinbase_tx_hash[32];
-    calculate_coinbase_tx_hash_bin(
-        ext_job->coinbase_prefix, ext_job->coinbase_prefix_len,
-        conn->extranonce_prefix, conn->extranonce_prefix_len,
-        extranonce_2, extranonce_2_len,
-        ext_job->coinbase_suffix, ext_job->coinbase_suffix_len,
-        coinbase_tx_hash);
-
-    // Compute merkle root
+    // Coinbase is prefix + extranonce_prefix + extranonce_2 + suffix; only the
+    // blocks from extranonce_2 onwards are hashed per roll
     uint8_t merkle_root[32];
-    calculate_merkle_root_hash(coinbase_tx_hash,
-                               (const uint8_t (*)[32])ext_job->merkle_path,
-                               ext_job->merkle_path_count, merkle_root);
+    coinbase_template_merkle_root(&coinbase_tmpl, extranonce_2, merkle_root);
 
     // Fill bm_job fields
     next_job->version = ext_job->version;
@@ -357,55 +425,12 @@ static void generate_work_sv2_ext(GlobalState *GLOBAL_STATE, sv2_ext_job_t *ext_
     reverse_32bit_words(merkle_root, next_job->merkle_root);
     reverse_32bit_words(ext_job->prev_hash, next_job->prev_block_hash);
 
-    // Compute midstate(s)
-    uint8_t midstate_data[64];
-    uint32_t base_version = ext_job->version;
-    memcpy(midstate_data, &base_version, 4);
-    memcpy(midstate_data + 4, ext_job->prev_hash, 32);
-    memcpy(midstate_data + 36, merkle_root, 28);
-
-    uint8_t midstate[32];
-    midstate_sha256_bin(midstate_data, 64, midstate);
-    reverse_32bit_words(midstate, next_job->midstate);
-
-    if (version_mask != 0) {
-        uint32_t rolled_version = increment_bitmask(base_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate1);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate2);
-
-        rolled_version = increment_bitmask(rolled_version, version_mask);
-        memcpy(midstate_data, &rolled_version, 4);
-        midstate_sha256_bin(midstate_data, 64, midstate);
-        reverse_32bit_words(midstate, next_job->midstate3);
-        next_job->num_midstates = 4;
-    } else {
-        next_job->num_midstates = 1;
-    }
-
     // Job metadata
-    char jobid_str[16];
-    snprintf(jobid_str, sizeof(jobid_str), "%" PRIu32, ext_job->job_id);
-    next_job->jobid = strdup(jobid_str);
+    snprintf(next_job->jobid, sizeof(next_job->jobid), "%" PRIu32, ext_job->job_id);
 
     // Store extranonce_2 as hex for share submission
-    char en2_hex[65];
-    bin2hex(extranonce_2, extranonce_2_len, en2_hex, sizeof(en2_hex));
-    next_job->extranonce2 = strdup(en2_hex);
+    bin2hex(extranonce_2, extranonce_2_len, next_job->extranonce2, sizeof(next_job->extranonce2));
     next_job->version_mask = version_mask;
 
-    if (!GLOBAL_STATE->ASIC_initalized) {
-        ESP_LOGW(TAG, "ASIC not initialized, skipping SV2 ext job send");
-        free(next_job->jobid);
-        free(next_job->extranonce2);
-        free(next_job);
-        return;
-    }
-
-    ASIC_send_work(GLOBAL_STATE, next_job);
+    return true;
 }
@@ -7,6 +7,7 @@
 #include "system.h"
 #include "asic_common.h"
 #include "asic.h"
+#include "ticket_tuner.h"
 #include "utils.h"
 
 #define EPSILON 0.0001f
@@ -14,6 +15,7 @@
 #define HASHRATE_UNIT 0x100000uLL // Hashrate register unit (2^24 hashes)
 
 #define POLL_RATE 1000
+#define REGISTER_POLL_TIMEOUT_MS 100
 #define HASHRATE_1M_SIZE (60000 / POLL_RATE)  // 12
 #define HASHRATE_10M_SIZE 10
 #define HASHRATE_1H_SIZE 6
@@ -27,6 +29,24 @@ static float hashrate_10m[HASHRATE_10M_SIZE];
 static float hashrate_1h_prev;
 static float hashrate_1h[HASHRATE_1H_SIZE];
 
+// Polls between two reads of a register. The hashrate and error rate are
+// updated every poll, the domain counters only feed the per-domain view.
+static const uint8_t REGISTER_POLL_DIVIDER[] = {
+    [REGISTER_HASHRATE] = 1,
+    [REGISTER_TOTAL_COUNT] = 1,
+    [REGISTER_DOMAIN_0_COUNT] = 10,
+    [REGISTER_DOMAIN_1_COUNT] = 10,
+    [REGISTER_DOMAIN_2_COUNT] = 10,
+    [REGISTER_DOMAIN_3_COUNT] = 10,
+    [REGISTER_ERROR_COUNT] = 1,
+};
+
+static unsigned long register_poll_count = 0;
+
+// Nonce count at the start of the current ticket tuning window
+static uint32_t ticket_window_nonces;
+static int64_t ticket_window_start_us;
+
 static const char *TAG = "hashrate_monitor";
 
 static float sum_hashrates(measurement_t * measurement, int asic_count)
@@ -87,6 +107,88 @@ void update_hash_counter(measurement_t * measurement, uint32_t value, uint64_t t
     measurement->time_us = time_us;
 }
 
+static uint32_t registers_due(void)
+{
+    uint32_t register_mask = 0;
+    for (int type = 0; type < (int)sizeof(REGISTER_POLL_DIVIDER); type++) {
+        if (REGISTER_POLL_DIVIDER[type] != 0 && register_poll_count % REGISTER_POLL_DIVIDER[type] == 0) {
+            register_mask |= REGISTER_BIT(type);
+        }
+    }
+    register_poll_count++;
+    return register_mask;
+}
+
+static void start_register_poll(GlobalState * GLOBAL_STATE, uint32_t register_mask)
+{
+    HashrateMonitorModule * HASHRATE_MONITOR_MODULE = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+    int asic_count = GLOBAL_STATE->DEVICE_CONFIG.family.asic_count;
+
+    // a late answer to the previous poll may have given it
+    xSemaphoreTake(HASHRATE_MONITOR_MODULE->poll_done, 0);
+
+    // expect the answers before the reads go out, the first ones arrive right away
+    pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
+    for (int asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        HASHRATE_MONITOR_MODULE->pending_registers[asic_nr] = register_mask;
+    }
+    pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
+
+    uint32_t sent_mask = ASIC_read_registers(GLOBAL_STATE, register_mask);
+
+    // drop the registers this chip does not have
+    pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
+    bool done = true;
+    for (int asic_nr = 0; asic_nr < asic_count; asic_nr++) {
+        HASHRATE_MONITOR_MODULE->pending_registers[asic_nr] &= sent_mask;
+        done &= HASHRATE_MONITOR_MODULE->pending_registers[asic_nr] == 0;
+    }
+    if (done) {
+        xSemaphoreGive(HASHRATE_MONITOR_MODULE->poll_done);
+    }
+    pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
+}
+
+static void start_ticket_window(GlobalState * GLOBAL_STATE)
+{
+    ticket_window_nonces = GLOBAL_STATE->ASIC_TASK_MODULE.ticket_nonces;
+    ticket_window_start_us = esp_timer_get_time();
+}
+
+static void tune_ticket_difficulty(GlobalState * GLOBAL_STATE)
+{
+    AsicTaskModule * ASIC_TASK_MODULE = &GLOBAL_STATE->ASIC_TASK_MODULE;
+
+    // the self-test counts hashes at the configured difficulty
+    if (GLOBAL_STATE->SELF_TEST_MODULE.is_active) {
+        start_ticket_window(GLOBAL_STATE);
+        return;
+    }
+
+    double max_difficulty = GLOBAL_STATE->pool_difficulty > 0 ? GLOBAL_STATE->pool_difficulty : ASIC_TASK_MODULE->ticket_difficulty;
+
+    // shares between a lowered pool difficulty and the ticket would be lost, don't wait for the window
+    if (ASIC_TASK_MODULE->ticket_difficulty > get_ticket_difficulty(max_difficulty)) {
+        ASIC_set_ticket_difficulty(GLOBAL_STATE, max_difficulty);
+        start_ticket_window(GLOBAL_STATE);
+        return;
+    }
+
+    double seconds = (esp_timer_get_time() - ticket_window_start_us) / 1e6;
+    if (seconds < TICKET_TUNER_WINDOW_S) {
+        return;
+    }
+
+    uint32_t nonces = ASIC_TASK_MODULE->ticket_nonces - ticket_window_nonces;
+    start_ticket_window(GLOBAL_STATE);
+
+    double difficulty = ticket_tuner_next_difficulty(ASIC_TASK_MODULE->ticket_difficulty, nonces, seconds, max_difficulty);
+    if (difficulty != ASIC_TASK_MODULE->ticket_difficulty) {
+        ESP_LOGI(TAG, "%" PRIu32 " nonces in %.0f s", nonces, seconds);
+        ASIC_set_ticket_difficulty(GLOBAL_STATE, difficulty);
+    }
+}
+
 static void init_averages()
 {
     float nan_val = nanf("");
@@ -157,6 +259,8 @@ void hashrate_monitor_task(void *pvParameters)
         HASHRATE_MONITOR_MODULE->domain_measurements[asic_nr] = data + (asic_nr * hash_domains);
     }
     HASHRATE_MONITOR_MODULE->error_measurement = heap_caps_malloc(asic_count * sizeof(measurement_t), MALLOC_CAP_SPIRAM);
+    HASHRATE_MONITOR_MODULE->pending_registers = heap_caps_calloc(asic_count, sizeof(uint32_t), MALLOC_CAP_SPIRAM);
+    HASHRATE_MONITOR_MODULE->poll_done = xSemaphoreCreateBinary();
 
     pthread_mutex_init(&HASHRATE_MONITOR_MODULE->lock, NULL);
     HASHRATE_MONITOR_MODULE->is_initialized = true;
@@ -180,8 +284,10 @@ void hashrate_monitor_task(void *pvParameters)
         was_asic_initialized = is_asic_initialized;
 
         if (is_asic_initialized) {
-            ASIC_read_registers(GLOBAL_STATE);
-            vTaskDelay(100 / portTICK_PERIOD_MS);
+            // the reads go out in one burst, the sum is taken as soon as the
+            // last chip answered (or after the timeout if a response got lost)
+            start_register_poll(GLOBAL_STATE, registers_due());
+            xSemaphoreTake(HASHRATE_MONITOR_MODULE->poll_done, REGISTER_POLL_TIMEOUT_MS / portTICK_PERIOD_MS);
 
             pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
             float current_hashrate = sum_hashrates(HASHRATE_MONITOR_MODULE->total_measurement, asic_count);
@@ -192,8 +298,11 @@ void hashrate_monitor_task(void *pvParameters)
             SYSTEM_MODULE->error_percentage = current_hashrate > 0 ? error_hashrate / current_hashrate * 100.f : 0;
 
             if (current_hashrate > 0.0f) update_hashrate_averages(SYSTEM_MODULE);
+
+            tune_ticket_difficulty(GLOBAL_STATE);
         } else {
             SYSTEM_MODULE->current_hashrate = 0;
+            start_ticket_window(GLOBAL_STATE);
         }
 
         vTaskDelayUntil(&taskWakeTime, POLL_RATE / portTICK_PERIOD_MS);
@@ -214,6 +323,19 @@ void hashrate_monitor_register_read(void *pvParameters, register_type_t register
 
     pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
 
+    // answers are matched to the poll by chip and register
+    uint32_t *pending = &HASHRATE_MONITOR_MODULE->pending_registers[asic_nr];
+    if (*pending & REGISTER_BIT(register_type)) {
+        *pending &= ~REGISTER_BIT(register_type);
+        bool done = true;
+        for (int i = 0; i < asic_count; i++) {
+            done &= HASHRATE_MONITOR_MODULE->pending_registers[i] == 0;
+        }
+        if (done) {
+            xSemaphoreGive(HASHRATE_MONITOR_MODULE->poll_done);
+        }
+    }
+
     switch(register_type) {
         case REGISTER_HASHRATE:
             update_hashrate(&HASHRATE_MONITOR_MODULE->total_measurement[asic_nr], value);
@@ -3,6 +3,8 @@
 
 #include "asic_common.h"
 #include <pthread.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 
 typedef struct {
     uint32_t value;
@@ -15,6 +17,11 @@ typedef struct {
     measurement_t** domain_measurements;
     measurement_t* error_measurement;
 
+    // Register poll in flight: bit per register type still expected from each
+    // chip, poll_done is given once the last one is in
+    uint32_t* pending_registers;
+    SemaphoreHandle_t poll_done;
+
     pthread_mutex_t lock;
     bool is_initialized;
 } HashrateMonitorModule;
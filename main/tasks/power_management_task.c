@@ -7,15 +7,19 @@
 #include "thermal.h"
 #include "power.h"
 #include "asic.h"
+#include "frequency_transition_bmXX.h"
 #include "utils.h"
 #include "asic_init.h"
 #include "asic_reset.h"
 #include "driver/uart.h"
+#include "esp_timer.h"
+#include <math.h>
 
 #define POLL_RATE 100
 #define MAX_TEMP 90.0
 #define THROTTLE_TEMP 75.0
 #define SAFE_TEMP 45.0
+#define RAMP_TEMP_MARGIN 5.0
 
 #define VOLTAGE_START_THROTTLE 4900
 #define VOLTAGE_MIN_THROTTLE 3500
@@ -26,6 +30,8 @@
 
 #define ASIC_REDUCTION 100.0
 
+#define CHIP_TUNING_WINDOW_MS 60000
+
 static const char * TAG = "power_management";
 
 static void mining_stop(GlobalState * GLOBAL_STATE)
@@ -87,6 +93,91 @@ static uint8_t mining_start(GlobalState * GLOBAL_STATE)
     return chip_count;
 }
 
+// Counters at the start of the current chip tuning window
+static int64_t chip_tuning_window_start_us;
+static uint32_t chip_tuning_total[CHIP_TUNER_MAX_CHIPS];
+static uint32_t chip_tuning_errors[CHIP_TUNER_MAX_CHIPS];
+
+static void set_chip_frequencies(GlobalState * GLOBAL_STATE, uint32_t changed)
+{
+    chip_tuner * tuner = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_tuner;
+
+    for (int asic_nr = 0; asic_nr < tuner->chip_count; asic_nr++) {
+        if (changed & (1u << asic_nr)) {
+            ASIC_set_chip_frequency(GLOBAL_STATE, asic_nr, tuner->chips[asic_nr].frequency);
+        }
+    }
+}
+
+// Error rate of each chip since the window started, NAN without new hashes
+static void read_chip_errors(GlobalState * GLOBAL_STATE, float * error_percentages)
+{
+    HashrateMonitorModule * HASHRATE_MONITOR_MODULE = &GLOBAL_STATE->HASHRATE_MONITOR_MODULE;
+    chip_tuner * tuner = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_tuner;
+
+    pthread_mutex_lock(&HASHRATE_MONITOR_MODULE->lock);
+    for (int asic_nr = 0; asic_nr < tuner->chip_count; asic_nr++) {
+        uint32_t total = HASHRATE_MONITOR_MODULE->total_measurement[asic_nr].value;
+        uint32_t errors = HASHRATE_MONITOR_MODULE->error_measurement[asic_nr].value;
+        uint32_t total_diff = total - chip_tuning_total[asic_nr];
+        uint32_t error_diff = errors - chip_tuning_errors[asic_nr];
+
+        if (error_percentages) {
+            error_percentages[asic_nr] = total_diff > 0 ? (float)error_diff / total_diff * 100.f : NAN;
+        }
+        chip_tuning_total[asic_nr] = total;
+        chip_tuning_errors[asic_nr] = errors;
+    }
+    pthread_mutex_unlock(&HASHRATE_MONITOR_MODULE->lock);
+
+    chip_tuning_window_start_us = esp_timer_get_time();
+}
+
+static void chip_tuning_tick(GlobalState * GLOBAL_STATE)
+{
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    chip_tuner * tuner = &power_management->chip_tuner;
+
+    // A chain-wide ramp writes every chip and a restart resets them, the
+    // per-chip search starts over from the new chain frequency
+    if (frequency_ramp_is_active() || !GLOBAL_STATE->ASIC_initalized || !GLOBAL_STATE->HASHRATE_MONITOR_MODULE.is_initialized) {
+        tuner->chip_count = 0;
+        return;
+    }
+
+    bool enabled = nvs_config_get_bool(NVS_CONFIG_CHIP_TUNING) && !GLOBAL_STATE->SELF_TEST_MODULE.is_active;
+
+    if (!enabled) {
+        // walk tuned chips back to the chain frequency, one step per loop
+        uint32_t changed = chip_tuner_step_to_base(tuner);
+        set_chip_frequencies(GLOBAL_STATE, changed);
+        if (!changed) {
+            tuner->chip_count = 0;
+        }
+        return;
+    }
+
+    if (tuner->chip_count == 0 || fabs(tuner->base_frequency - power_management->actual_frequency) > 0.0001f) {
+        float base_frequency = power_management->actual_frequency;
+        // the chips can only run at what the PLL reaches, the tuner steps between those
+        static float frequencies[CHIP_TUNER_MAX_FREQUENCIES];
+        size_t frequency_count = ASIC_get_frequencies(GLOBAL_STATE, base_frequency - CHIP_TUNER_MIN_OFFSET, base_frequency + CHIP_TUNER_MAX_OFFSET,
+                                                      frequencies, CHIP_TUNER_MAX_FREQUENCIES);
+        ESP_LOGI(TAG, "Per-chip tuning around %g MHz (%u PLL frequencies)", base_frequency, (unsigned)frequency_count);
+        chip_tuner_init(tuner, GLOBAL_STATE->DEVICE_CONFIG.family.asic_count, base_frequency, frequencies, frequency_count);
+        read_chip_errors(GLOBAL_STATE, NULL);
+        return;
+    }
+
+    if (esp_timer_get_time() - chip_tuning_window_start_us < CHIP_TUNING_WINDOW_MS * 1000LL) {
+        return;
+    }
+
+    float error_percentages[CHIP_TUNER_MAX_CHIPS];
+    read_chip_errors(GLOBAL_STATE, error_percentages);
+    set_chip_frequencies(GLOBAL_STATE, chip_tuner_update(tuner, error_percentages));
+}
+
 static float expected_hashrate(GlobalState * GLOBAL_STATE)
 {
     return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * GLOBAL_STATE->DEVICE_CONFIG.family.asic.small_core_count * GLOBAL_STATE->DEVICE_CONFIG.family.asic_count / 1000.0;
@@ -244,12 +335,22 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             power_management->frequency_value = asic_frequency;
             power_management->expected_hashrate = expected_hashrate(GLOBAL_STATE);
 
-            ASIC_set_frequency(GLOBAL_STATE);
-            ASIC_set_nonce_space(GLOBAL_STATE);
+            // Stepped once per loop below, so temperatures and VR faults keep being checked
+            ASIC_start_frequency_ramp(GLOBAL_STATE);
             
             last_asic_frequency = asic_frequency;
         }
 
+        // Head back down before a rising ramp pushes the chips into throttling
+        bool asic_near_throttle =
+            power_management->chip_temp_avg > THROTTLE_TEMP - RAMP_TEMP_MARGIN
+            || power_management->chip_temp2_avg > THROTTLE_TEMP - RAMP_TEMP_MARGIN;
+
+        if (asic_near_throttle && frequency_ramp_is_rising()) {
+            frequency_ramp_reverse(GLOBAL_STATE);
+            power_management->expected_hashrate = expected_hashrate(GLOBAL_STATE);
+        }
+
         // Check for changing of overheat mode
         bool new_overheat_mode = nvs_config_get_bool(NVS_CONFIG_OVERHEAT_MODE);
         
@@ -260,6 +361,11 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         VCORE_check_fault(GLOBAL_STATE);
 
+        if (!sys_module->hardware_fault) {
+            ASIC_frequency_ramp_tick(GLOBAL_STATE);
+            chip_tuning_tick(GLOBAL_STATE);
+        }
+
         // looper:
         vTaskDelay(POLL_RATE / portTICK_PERIOD_MS);
     }
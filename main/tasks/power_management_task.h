@@ -1,6 +1,8 @@
 #ifndef POWER_MANAGEMENT_TASK_H_
 #define POWER_MANAGEMENT_TASK_H_
 
+#include "chip_tuner.h"
+
 typedef struct
 {
     float fan_perc;
@@ -16,6 +18,7 @@ typedef struct
     float power;
     float current;
     float core_voltage;
+    chip_tuner chip_tuner; // per-chip frequencies, chip_count is 0 while not tuning
 } PowerManagementModule;
 
 void POWER_MANAGEMENT_init_frequency(void * pvParameters);
@@ -8,7 +8,9 @@
 
 #include "protocol_coordinator.h"
 #include "stratum_v1_task.h"
+#include "stratum_v1_standby.h"
 #include "stratum_v2_task.h"
+#include "stratum_socket.h"
 #include "connect.h"
 #include "system.h"
 #include "nvs_config.h"
@@ -137,6 +139,33 @@ static bool has_fallback_pool(GlobalState *gs)
             gs->SYSTEM_MODULE.fallback_pool_url[0] != '\0');
 }
 
+// The fallback pool is kept connected next to the primary when it speaks SV1
+// and the user asked for it. Not while the fallback was chosen as the pool.
+static bool hot_standby_enabled(GlobalState *gs)
+{
+    return gs->SYSTEM_MODULE.fallback_pool_hot_standby &&
+           has_fallback_pool(gs) &&
+           s_fallback_protocol == STRATUM_PROTOCOL_V1 &&
+           !gs->SYSTEM_MODULE.use_fallback_stratum;
+}
+
+static void start_hot_standby(GlobalState *gs)
+{
+    if (hot_standby_enabled(gs)) {
+        stratum_v1_standby_start(gs);
+    }
+}
+
+// The next job counts as the end of a failover gap, which started when the
+// failed pool lost its connection
+static void mark_failover(GlobalState *gs)
+{
+    if (gs->SYSTEM_MODULE.work_lost_time == 0) {
+        gs->SYSTEM_MODULE.work_lost_time = esp_timer_get_time();
+    }
+    gs->SYSTEM_MODULE.failover_pending = true;
+}
+
 // Start the V1 stratum task (for primary V1 or fallback)
 static void start_v1_task(GlobalState *gs)
 {
@@ -228,14 +257,14 @@ static bool probe_pool_sv2(const char *url, uint16_t port)
 {
     if (url == NULL || url[0] == '\0' || port == 0) return false;
 
-    esp_transport_handle_t probe = esp_transport_tcp_init();
-    if (!probe) return false;
+    // Resolve through the shared DNS cache, same as the protocol tasks
+    stratum_connection_info_t conn_info;
+    esp_transport_handle_t probe;
+    if (stratum_socket_connect(url, port, DISABLED, NULL, TRANSPORT_TIMEOUT_MS, &conn_info, &probe) != ESP_OK) return false;
 
-    esp_err_t err = esp_transport_connect(probe, url, port, TRANSPORT_TIMEOUT_MS);
     esp_transport_close(probe);
     esp_transport_destroy(probe);
-
-    return (err == ESP_OK);
+    return true;
 }
 
 // Subscribe/authorize probe for V1 — succeeds only if the pool responds with
@@ -245,15 +274,9 @@ static bool probe_pool_v1(GlobalState *gs, const char *url, uint16_t port,
 {
     if (url == NULL || url[0] == '\0' || port == 0) return false;
 
-    esp_transport_handle_t transport = STRATUM_V1_transport_init(tls, cert);
-    if (!transport) return false;
-
-    esp_err_t err = esp_transport_connect(transport, url, port, TRANSPORT_TIMEOUT_MS);
-    if (err != ESP_OK) {
-        esp_transport_close(transport);
-        esp_transport_destroy(transport);
-        return false;
-    }
+    stratum_connection_info_t conn_info;
+    esp_transport_handle_t transport;
+    if (stratum_socket_connect(url, port, tls, cert, TRANSPORT_TIMEOUT_MS, &conn_info, &transport) != ESP_OK) return false;
 
     int send_uid = 1;
     STRATUM_V1_subscribe(transport, send_uid++, gs->DEVICE_CONFIG.family.asic.name);
@@ -291,7 +314,11 @@ static bool probe_pool(GlobalState *gs, bool use_fallback)
 // The failed task has already exited (it sent PROTOCOL_FAILED then deleted itself).
 static void switch_to_fallback(GlobalState *gs)
 {
+    // The V1 task takes over a standby connection that already has a job
+    bool promoted = stratum_v1_standby_promote();
+
     queue_clear(&gs->stratum_queue);
+    xQueueReset(gs->share_queue);
     reset_share_stats(gs);
 
     gs->SYSTEM_MODULE.is_using_fallback = true;
@@ -299,8 +326,11 @@ static void switch_to_fallback(GlobalState *gs)
     s_running_protocol = s_fallback_protocol;
     s_state = COORD_STATE_RUNNING_FALLBACK;
 
-    ESP_LOGI(TAG, "Switching to fallback pool (%s)",
-             s_fallback_protocol == STRATUM_PROTOCOL_V2 ? STRATUM_V2 : STRATUM_V1);
+    ESP_LOGI(TAG, "Switching to fallback pool (%s%s)",
+             s_fallback_protocol == STRATUM_PROTOCOL_V2 ? STRATUM_V2 : STRATUM_V1,
+             promoted ? ", hot standby" : "");
+
+    mark_failover(gs);
 
     start_protocol_task(gs, s_fallback_protocol);
 
@@ -317,6 +347,7 @@ static void switch_to_primary(GlobalState *gs)
     stop_running_task(gs);
 
     queue_clear(&gs->stratum_queue);
+    xQueueReset(gs->share_queue);
     reset_share_stats(gs);
 
     gs->SYSTEM_MODULE.is_using_fallback = false;
@@ -325,6 +356,7 @@ static void switch_to_primary(GlobalState *gs)
     s_state = COORD_STATE_RUNNING_PRIMARY;
 
     start_protocol_task(gs, s_primary_protocol);
+    start_hot_standby(gs);
 
     s_heartbeat_enabled = false;
 }
@@ -365,6 +397,7 @@ static void enter_paused_state(GlobalState *gs)
 {
     s_state = COORD_STATE_PAUSED;
     gs->SYSTEM_MODULE.pools_unavailable = true;
+    stratum_v1_standby_stop();
     s_heartbeat_enabled = false;
     ESP_LOGW(TAG, "All configured pools unreachable, pausing mining to conserve power.");
 }
@@ -384,6 +417,7 @@ static void resume_on_pool(GlobalState *gs, bool use_fallback)
     s_state = use_fallback ? COORD_STATE_RUNNING_FALLBACK : COORD_STATE_RUNNING_PRIMARY;
 
     queue_clear(&gs->stratum_queue);
+    xQueueReset(gs->share_queue);
     reset_share_stats(gs);
 
     ESP_LOGI(TAG, "Pool recovery: %s pool reachable, resuming mining (%s)",
@@ -391,6 +425,9 @@ static void resume_on_pool(GlobalState *gs, bool use_fallback)
              proto == STRATUM_PROTOCOL_V2 ? STRATUM_V2 : STRATUM_V1);
 
     start_protocol_task(gs, proto);
+    if (!use_fallback) {
+        start_hot_standby(gs);
+    }
 
     // Only run the auto-switch-back heartbeat for *automatic* failovers
     // (user did not explicitly choose the fallback pool).
@@ -456,12 +493,15 @@ static void handle_event(GlobalState *gs, coordinator_event_t evt)
             } else if (s_state == COORD_STATE_RUNNING_FALLBACK) {
                 ESP_LOGI(TAG, "Fallback failed, trying primary");
                 queue_clear(&gs->stratum_queue);
+                xQueueReset(gs->share_queue);
                 reset_share_stats(gs);
                 gs->SYSTEM_MODULE.is_using_fallback = false;
                 gs->stratum_protocol = s_primary_protocol;
                 s_running_protocol = s_primary_protocol;
                 s_state = COORD_STATE_RUNNING_PRIMARY;
+                mark_failover(gs);
                 start_protocol_task(gs, s_primary_protocol);
+                start_hot_standby(gs);
                 s_heartbeat_enabled = false;
             }
             break;
@@ -507,6 +547,7 @@ void protocol_coordinator_task(void *pvParameters)
         s_running_protocol = s_primary_protocol;
         s_state = COORD_STATE_RUNNING_PRIMARY;
         start_protocol_task(gs, s_primary_protocol);
+        start_hot_standby(gs);
     }
 
     ESP_LOGI(TAG, "Protocol coordinator started (primary: %s, fallback: %s, state: %d)",
@@ -0,0 +1,147 @@
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "share_submit_task.h"
+#include "global_state.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "stratum_api.h"
+#include "stratum_v2_task.h"
+#include "sv2_protocol.h"
+#include "utils.h"
+
+static const char *TAG = "share_submit";
+
+// Shares that queued up while the previous write was in flight go out together
+#define SHARE_BATCH_MAX 8
+#define SHARE_LINE_MAX 512
+#define SV2_SHARE_FRAME_MAX (SV2_FRAME_HEADER_SIZE + 24 + 1 + 32)
+
+static void report_process_time(GlobalState *GLOBAL_STATE, share_submission *shares, int count, uint64_t sent_time_us)
+{
+    // the oldest share waited longest, so it carries the queue latency of the batch
+    float process_time = (sent_time_us - shares[0].found_time_us) / 1000.0f;
+    GLOBAL_STATE->SYSTEM_MODULE.process_time = process_time;
+    ESP_LOGI(TAG, "Processing time: %0.1f ms (%d share%s)", process_time, count, count == 1 ? "" : "s");
+}
+
+static void submit_v1(GlobalState *GLOBAL_STATE, share_submission *shares, int count)
+{
+    static char msgs[SHARE_BATCH_MAX * SHARE_LINE_MAX];
+    int uids[SHARE_BATCH_MAX];
+
+    char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
+
+    taskENTER_CRITICAL(&GLOBAL_STATE->stratum_mux);
+    esp_transport_handle_t transport = GLOBAL_STATE->transport;
+    int first_uid = GLOBAL_STATE->send_uid;
+    GLOBAL_STATE->send_uid += count;
+    taskEXIT_CRITICAL(&GLOBAL_STATE->stratum_mux);
+
+    if (transport == NULL) {
+        ESP_LOGW(TAG, "No stratum connection, dropping %d share(s)", count);
+        return;
+    }
+
+    size_t len = 0;
+    int lines = 0;
+    for (int i = 0; i < count; i++) {
+        share_submission *share = &shares[i];
+        int line_len = STRATUM_V1_format_submit(msgs + len, sizeof(msgs) - len, first_uid + i, user,
+                                                share->jobid, share->extranonce2, share->ntime,
+                                                share->nonce, share->version_bits);
+        if (line_len < 0) {
+            ESP_LOGW(TAG, "Share too long to submit (job 0x%02X)", share->asic_job_id);
+            continue;
+        }
+        len += line_len;
+        uids[lines++] = first_uid + i;
+    }
+
+    if (lines == 0) {
+        return;
+    }
+
+    uint64_t sent_time_us = 0;
+    int ret = STRATUM_V1_submit_batch(transport, msgs, len, uids, lines, &sent_time_us);
+    if (ret < 0) {
+        ESP_LOGW(TAG, "Unable to write share to socket (ret: %d, errno %d: %s)", ret, errno, strerror(errno));
+        // stratum_task recv loop will detect a broken connection on its next read and handle reconnection
+    }
+
+    report_process_time(GLOBAL_STATE, shares, count, sent_time_us);
+}
+
+static void submit_v2(GlobalState *GLOBAL_STATE, share_submission *shares, int count)
+{
+    static uint8_t frames[SHARE_BATCH_MAX * SV2_SHARE_FRAME_MAX];
+
+    bool extended = stratum_v2_is_extended_channel(GLOBAL_STATE);
+
+    int len = 0;
+    for (int i = 0; i < count; i++) {
+        share_submission *share = &shares[i];
+        uint32_t sv2_job_id = (uint32_t)strtoul(share->jobid, NULL, 10);
+
+        // SV2 spec: extranonce_size is the miner's rollable portion.
+        // The pool prepends its extranonce_prefix separately.
+        uint8_t extranonce_2[32];
+        uint8_t en2_len = 0;
+        if (extended) {
+            en2_len = GLOBAL_STATE->sv2_conn->extranonce_size;
+            if (en2_len > sizeof(extranonce_2)) {
+                ESP_LOGW(TAG, "Extranonce size %u not supported", en2_len);
+                continue;
+            }
+            hex2bin(share->extranonce2, extranonce_2, en2_len);
+        }
+
+        int frame_len = stratum_v2_build_share(GLOBAL_STATE, frames + len, sizeof(frames) - len,
+                                               sv2_job_id, share->nonce, share->ntime,
+                                               share->rolled_version, extranonce_2, en2_len);
+        if (frame_len < 0) {
+            ESP_LOGW(TAG, "Failed to build SV2 share (job 0x%02X)", share->asic_job_id);
+            continue;
+        }
+        len += frame_len;
+    }
+
+    if (len == 0) {
+        return;
+    }
+
+    int ret = stratum_v2_send_frames(GLOBAL_STATE, frames, len);
+    if (ret < 0) {
+        ESP_LOGW(TAG, "Failed to submit SV2 share (ret=%d, errno=%d: %s)",
+                 ret, errno, strerror(errno));
+    }
+
+    report_process_time(GLOBAL_STATE, shares, count, esp_timer_get_time());
+}
+
+void share_submit_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    static share_submission batch[SHARE_BATCH_MAX];
+
+    while (1)
+    {
+        if (xQueueReceive(GLOBAL_STATE->share_queue, &batch[0], pdMS_TO_TICKS(1000)) != pdTRUE) {
+            continue;
+        }
+
+        int count = 1;
+        while (count < SHARE_BATCH_MAX &&
+               xQueueReceive(GLOBAL_STATE->share_queue, &batch[count], 0) == pdTRUE) {
+            count++;
+        }
+
+        if (GLOBAL_STATE->stratum_protocol == STRATUM_PROTOCOL_V2) {
+            submit_v2(GLOBAL_STATE, batch, count);
+        } else {
+            submit_v1(GLOBAL_STATE, batch, count);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef SHARE_SUBMIT_TASK_H_
+#define SHARE_SUBMIT_TASK_H_
+
+#include <stdint.h>
+#include "mining.h"
+
+// Room for the shares found while a slow pool write is in flight
+#define SHARE_QUEUE_SIZE 64
+// How long the result task waits for room before a share is dropped
+#define SHARE_QUEUE_WAIT_MS 50
+
+// A share that met the pool difficulty, handed from the result task to the submit task
+typedef struct
+{
+    char jobid[BM_JOB_ID_MAX];
+    char extranonce2[BM_EXTRANONCE2_STR_MAX];
+    uint32_t ntime;
+    uint32_t nonce;
+    uint32_t rolled_version;
+    uint32_t version_bits;
+    uint8_t asic_job_id;
+    uint64_t found_time_us; // when the ASIC result was read, for process_time
+} share_submission;
+
+void share_submit_task(void *pvParameters);
+
+#endif /* SHARE_SUBMIT_TASK_H_ */
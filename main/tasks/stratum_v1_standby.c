@@ -0,0 +1,349 @@
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_transport.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "stratum_v1_standby.h"
+#include "stratum_api.h"
+#include "stratum_line_reader.h"
+#include "stratum_socket.h"
+#include "system.h"
+#include "connect.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRANSPORT_TIMEOUT_MS 5000
+// How often the receive loop looks at the stop request
+#define STANDBY_POLL_MS 100
+#define STANDBY_RETRY_DELAY_MS 10000
+// Covers a connect or a write that is blocked on its transport timeout
+#define STANDBY_EXIT_TIMEOUT_MS 12000
+
+static const char *TAG = "stratum_v1_standby";
+
+static SemaphoreHandle_t s_exited = NULL;
+static volatile bool s_running = false;
+static volatile bool s_should_stop = false;
+static volatile bool s_keep_connection = false;
+static volatile bool s_ready = false;
+static bool s_promoted = false;
+
+// Connection state, only touched by the standby task while it runs
+static esp_transport_handle_t s_transport = NULL;
+static stratum_line_reader s_reader;
+static StratumApiV1Message s_message = {};
+static char s_connection_info[64];
+static int s_send_uid = 1;
+static int s_authorize_id = -1;
+static bool s_authorized = false;
+static mining_notify *s_notify = NULL;
+static char *s_extranonce_str = NULL;
+static int s_extranonce_2_len = 0;
+static double s_difficulty = 0;
+static uint32_t s_version_mask = 0;
+static bool s_version_mask_set = false;
+
+static void standby_close(void)
+{
+    s_ready = false;
+    if (s_transport != NULL) {
+        esp_transport_close(s_transport);
+        esp_transport_destroy(s_transport);
+        s_transport = NULL;
+    }
+    stratum_line_reader_free(&s_reader);
+    STRATUM_V1_reset_message(&s_message);
+    if (s_notify != NULL) {
+        STRATUM_V1_free_mining_notify(s_notify);
+        s_notify = NULL;
+    }
+    free(s_extranonce_str);
+    s_extranonce_str = NULL;
+    s_extranonce_2_len = 0;
+    s_difficulty = 0;
+    s_version_mask_set = false;
+    s_authorized = false;
+}
+
+static void standby_delay(int delay_ms)
+{
+    for (int waited = 0; waited < delay_ms && !s_should_stop; waited += STANDBY_POLL_MS) {
+        vTaskDelay(pdMS_TO_TICKS(STANDBY_POLL_MS));
+    }
+}
+
+static bool standby_connect(GlobalState *GLOBAL_STATE)
+{
+    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
+    const char *url = module->fallback_pool_url;
+    uint16_t port = module->fallback_pool_port;
+    tls_mode tls = module->fallback_pool_tls;
+
+    stratum_connection_info_t conn_info;
+    if (stratum_socket_connect(url, port, tls, module->fallback_pool_cert, TRANSPORT_TIMEOUT_MS, &conn_info, &s_transport) != ESP_OK) {
+        ESP_LOGW(TAG, "Unable to connect to %s:%d", url, port);
+        return false;
+    }
+    stratum_socket_set_options(s_transport);
+
+    if (!stratum_line_reader_init(&s_reader)) {
+        ESP_LOGE(TAG, "Failed to allocate the receive buffer");
+        standby_close();
+        return false;
+    }
+
+    snprintf(s_connection_info, sizeof(s_connection_info), "%s%s",
+             conn_info.addr_family == AF_INET6 ? "IPv6" : "IPv4",
+             tls == BUNDLED_CRT ? " (TLS)" : tls == CUSTOM_CRT ? " (TLS Cert)" : "");
+
+    ESP_LOGI(TAG, "Connected to fallback pool %s:%d (%s), subscribing", url, port, conn_info.host_ip);
+
+    s_send_uid = 1;
+    STRATUM_V1_configure_version_rolling(s_transport, s_send_uid++, &s_version_mask);
+    STRATUM_V1_subscribe(s_transport, s_send_uid++, GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
+    s_authorize_id = s_send_uid++;
+    STRATUM_V1_authorize(s_transport, s_authorize_id, module->fallback_pool_user, module->fallback_pool_pass);
+    return true;
+}
+
+// Returns false when the connection has to be reopened
+static bool standby_handle_message(GlobalState *GLOBAL_STATE, StratumApiV1Message *message)
+{
+    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
+
+    switch (message->method) {
+        case MINING_NOTIFY:
+            if (s_notify != NULL) {
+                STRATUM_V1_free_mining_notify(s_notify);
+            }
+            s_notify = message->mining_notification;
+            message->mining_notification = NULL;
+            break;
+
+        case MINING_SET_DIFFICULTY:
+            s_difficulty = message->new_difficulty;
+            break;
+
+        case STRATUM_RESULT_CONFIGURE:
+            if (!message->response_success) {
+                break;
+            }
+            // fall through
+        case MINING_SET_VERSION_MASK:
+            s_version_mask = message->version_mask;
+            s_version_mask_set = true;
+            break;
+
+        case MINING_SET_EXTRANONCE:
+        case STRATUM_RESULT_SUBSCRIBE:
+            if (message->extranonce_2_len > MAX_EXTRANONCE_2_LEN) {
+                message->extranonce_2_len = MAX_EXTRANONCE_2_LEN;
+            }
+            free(s_extranonce_str);
+            s_extranonce_str = message->extranonce_str;
+            message->extranonce_str = NULL;
+            s_extranonce_2_len = message->extranonce_2_len;
+            break;
+
+        case MINING_PING:
+            STRATUM_V1_pong(s_transport, message->message_id);
+            break;
+
+        case CLIENT_GET_VERSION:
+            STRATUM_V1_send_version(s_transport, message->message_id);
+            break;
+
+        case CLIENT_RECONNECT:
+            ESP_LOGW(TAG, "Fallback pool requested client reconnect");
+            return false;
+
+        case STRATUM_RESULT:
+            if (message->message_id != s_authorize_id) {
+                break;
+            }
+            if (!message->response_success) {
+                ESP_LOGE(TAG, "Fallback pool rejected authorization: %s", message->error_str);
+                return false;
+            }
+            s_authorized = true;
+            uint32_t difficulty = SYSTEM_suggested_difficulty(GLOBAL_STATE, true);
+            if (difficulty > 0) {
+                STRATUM_V1_suggest_difficulty(s_transport, s_send_uid++, difficulty);
+            }
+            if (module->fallback_pool_extranonce_subscribe) {
+                STRATUM_V1_extranonce_subscribe(s_transport, s_send_uid++);
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    bool ready = s_authorized && s_notify != NULL && s_extranonce_str != NULL;
+    if (ready && !s_ready) {
+        ESP_LOGI(TAG, "Fallback pool is on hot standby");
+    }
+    s_ready = ready;
+    return true;
+}
+
+// Read and handle lines until the connection fails or a stop is requested.
+// Lines still in the reader on a stop are left for the V1 task to take over.
+static void standby_receive(GlobalState *GLOBAL_STATE)
+{
+    while (!s_should_stop) {
+        char *line = stratum_line_reader_next(&s_reader);
+        if (line == NULL) {
+            int readable = esp_transport_poll_read(s_transport, STANDBY_POLL_MS);
+            if (readable == 0) {
+                continue;
+            }
+            size_t avail;
+            char *dest = stratum_line_reader_reserve(&s_reader, &avail);
+            int nbytes = (readable > 0 && dest != NULL) ? esp_transport_read(s_transport, dest, avail, TRANSPORT_TIMEOUT_MS) : -1;
+            if (nbytes < 0) {
+                ESP_LOGW(TAG, "Lost connection to the fallback pool");
+                return;
+            }
+            stratum_line_reader_commit(&s_reader, nbytes);
+            continue;
+        }
+
+        if (!STRATUM_V1_parse(&s_message, line)) {
+            STRATUM_V1_reset_message(&s_message);
+            continue;
+        }
+        bool keep = standby_handle_message(GLOBAL_STATE, &s_message);
+        STRATUM_V1_reset_message(&s_message);
+        if (!keep) {
+            return;
+        }
+    }
+}
+
+static void stratum_v1_standby_task(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    while (!s_should_stop) {
+        if (!GLOBAL_STATE->ASIC_initalized || !wifi_is_connected()) {
+            standby_delay(1000);
+            continue;
+        }
+
+        if (standby_connect(GLOBAL_STATE)) {
+            standby_receive(GLOBAL_STATE);
+            if (s_should_stop) {
+                break;
+            }
+            standby_close();
+        }
+        standby_delay(STANDBY_RETRY_DELAY_MS);
+    }
+
+    s_promoted = s_keep_connection && s_ready;
+    if (!s_promoted) {
+        standby_close();
+    }
+
+    s_running = false;
+    xSemaphoreGive(s_exited);
+    vTaskDelete(NULL);
+}
+
+void stratum_v1_standby_start(GlobalState *GLOBAL_STATE)
+{
+    if (s_running) {
+        return;
+    }
+    if (s_exited == NULL) {
+        s_exited = xSemaphoreCreateBinary();
+    }
+    // Drop the exit of a task that outlived its stop timeout
+    xSemaphoreTake(s_exited, 0);
+
+    // A promoted connection nobody took over
+    if (s_promoted) {
+        s_promoted = false;
+        standby_close();
+    }
+
+    s_should_stop = false;
+    s_keep_connection = false;
+    s_running = true;
+    if (xTaskCreateWithCaps(stratum_v1_standby_task, "stratum standby", 8192, (void *)GLOBAL_STATE, 5, NULL, MALLOC_CAP_SPIRAM) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create standby task");
+        s_running = false;
+    }
+}
+
+static void standby_stop_task(bool keep_connection)
+{
+    if (!s_running) {
+        return;
+    }
+    s_keep_connection = keep_connection;
+    s_should_stop = true;
+    if (xSemaphoreTake(s_exited, pdMS_TO_TICKS(STANDBY_EXIT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "Standby task did not exit within timeout");
+    }
+}
+
+void stratum_v1_standby_stop(void)
+{
+    standby_stop_task(false);
+}
+
+bool stratum_v1_standby_is_ready(void)
+{
+    return s_running && s_ready;
+}
+
+bool stratum_v1_standby_promote(void)
+{
+    standby_stop_task(true);
+    return s_promoted;
+}
+
+mining_notify *stratum_v1_standby_adopt(GlobalState *GLOBAL_STATE)
+{
+    if (!s_promoted) {
+        return NULL;
+    }
+    s_promoted = false;
+
+    GLOBAL_STATE->transport = s_transport;
+    s_transport = NULL;
+    STRATUM_V1_adopt_reader(&s_reader);
+
+    char *old_extranonce_str = GLOBAL_STATE->extranonce_str;
+    GLOBAL_STATE->extranonce_str = s_extranonce_str;
+    s_extranonce_str = NULL;
+    GLOBAL_STATE->extranonce_2_len = s_extranonce_2_len;
+    free(old_extranonce_str);
+
+    if (s_version_mask_set) {
+        GLOBAL_STATE->version_mask = s_version_mask;
+        GLOBAL_STATE->new_stratum_version_rolling_msg = true;
+    }
+    if (s_difficulty > 0) {
+        GLOBAL_STATE->pool_difficulty = s_difficulty;
+        GLOBAL_STATE->new_set_mining_difficulty_msg = true;
+    }
+
+    taskENTER_CRITICAL(&GLOBAL_STATE->stratum_mux);
+    GLOBAL_STATE->send_uid = s_send_uid;
+    taskEXIT_CRITICAL(&GLOBAL_STATE->stratum_mux);
+
+    strncpy(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info, s_connection_info,
+            sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info) - 1);
+    GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info[sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info) - 1] = '\0';
+
+    mining_notify *notify = s_notify;
+    s_notify = NULL;
+    standby_close();
+    return notify;
+}
@@ -0,0 +1,28 @@
+#ifndef STRATUM_V1_STANDBY_H_
+#define STRATUM_V1_STANDBY_H_
+
+#include "global_state.h"
+
+// Hot standby for an SV1 fallback pool: while the primary pool is mining, a
+// second connection to the fallback stays subscribed and authorized and keeps
+// the latest mining.notify, so a failover starts hashing without connecting.
+
+// Start the standby task, does nothing if it is already running
+void stratum_v1_standby_start(GlobalState *GLOBAL_STATE);
+
+// Stop the standby task and close its connection
+void stratum_v1_standby_stop(void);
+
+// True once the standby is authorized and holds a job
+bool stratum_v1_standby_is_ready(void);
+
+// Stop the standby task but keep its connection for the next V1 task.
+// Returns false, with the connection closed, if the standby had no job yet.
+bool stratum_v1_standby_promote(void);
+
+// Called by the V1 task on start: installs a promoted standby connection
+// (transport, extranonce, version mask, difficulty) and returns its latest
+// job, or NULL when there is nothing to take over.
+mining_notify *stratum_v1_standby_adopt(GlobalState *GLOBAL_STATE);
+
+#endif // STRATUM_V1_STANDBY_H_
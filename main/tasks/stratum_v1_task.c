@@ -4,6 +4,7 @@
 #include "global_state.h"
 #include <lwip/tcpip.h>
 #include "stratum_v1_task.h"
+#include "stratum_v1_standby.h"
 #include "stratum_socket.h"
 #include "protocol_coordinator.h"
 #include "connect.h"
@@ -16,12 +17,12 @@
 #include <string.h>
 #include "utils.h"
 #include "coinbase_decoder.h"
+#include "vardiff.h"
 #include <esp_heap_caps.h>
 #include "esp_transport_ssl.h"
 #include "freertos/task.h"
 
 #define MAX_RETRY_ATTEMPTS 3
-#define MAX_CRITICAL_RETRY_ATTEMPTS 5
 #define MAX_EXTRANONCE_2_LEN 32
 
 #define PORT CONFIG_STRATUM_PORT
@@ -39,6 +40,7 @@
 #define STRATUM_DIFFICULTY CONFIG_STRATUM_DIFFICULTY
 
 #define TRANSPORT_TIMEOUT_MS 5000
+#define RECONNECT_BACKOFF_MS 1000
 
 #define BUFFER_SIZE 1024
 
@@ -46,6 +48,13 @@ static const char *TAG = "stratum_v1_task";
 
 static StratumApiV1Message stratum_api_v1_message = {};
 
+// Connection opened during the reconnect backoff, taken by the next connect
+static esp_transport_handle_t warm_transport = NULL;
+static stratum_connection_info_t warm_conn_info;
+static float warm_connect_time_ms;
+
+static vardiff v1_vardiff;
+
 static int stratum_get_next_uid(GlobalState * GLOBAL_STATE)
 {
     taskENTER_CRITICAL(&GLOBAL_STATE->stratum_mux);
@@ -63,9 +72,8 @@ static void stratum_v1_reset_uid(GlobalState *GLOBAL_STATE)
     taskEXIT_CRITICAL(&GLOBAL_STATE->stratum_mux);
 }
 
-void stratum_v1_close_connection(GlobalState *GLOBAL_STATE)
+static void stratum_v1_close_transport(GlobalState *GLOBAL_STATE)
 {
-    ESP_LOGE(TAG, "Shutting down socket and restarting...");
     taskENTER_CRITICAL(&GLOBAL_STATE->stratum_mux);
     esp_transport_handle_t transport = GLOBAL_STATE->transport;
     GLOBAL_STATE->transport = NULL;
@@ -74,10 +82,36 @@ void stratum_v1_close_connection(GlobalState *GLOBAL_STATE)
     if (transport != NULL) {
         esp_transport_close(transport);
     }
+    SYSTEM_notify_work_lost(GLOBAL_STATE);
     SYSTEM_clean_jobs_queue(GLOBAL_STATE);
+}
+
+void stratum_v1_close_connection(GlobalState *GLOBAL_STATE)
+{
+    ESP_LOGE(TAG, "Shutting down socket and restarting...");
+    stratum_v1_close_transport(GLOBAL_STATE);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
 
+static void stratum_v1_vardiff_start(GlobalState *GLOBAL_STATE)
+{
+    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
+    vardiff_init(&v1_vardiff, module->shares_per_minute, esp_timer_get_time(), module->shares_accepted);
+}
+
+// Ask the pool for a new difficulty when the share rate drifted away from the target
+static void stratum_v1_vardiff_tick(GlobalState *GLOBAL_STATE)
+{
+    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
+    double difficulty = vardiff_update(&v1_vardiff, esp_timer_get_time(), GLOBAL_STATE->pool_difficulty,
+                                       SYSTEM_hashrate_estimate(GLOBAL_STATE), module->shares_accepted);
+    if (difficulty > 0) {
+        ESP_LOGI(TAG, "Suggesting difficulty %.0f for %u shares/min (pool difficulty %.2f)",
+                 difficulty, module->shares_per_minute, GLOBAL_STATE->pool_difficulty);
+        STRATUM_V1_suggest_difficulty(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), (uint32_t)difficulty);
+    }
+}
+
 static void decode_mining_notification(GlobalState * GLOBAL_STATE, const mining_notify *mining_notification)
 {
     mining_notification_result_t *result = heap_caps_malloc(sizeof(mining_notification_result_t), MALLOC_CAP_SPIRAM);
@@ -167,6 +201,138 @@ static void decode_mining_notification(GlobalState * GLOBAL_STATE, const mining_
     free(result);
 }
 
+static void stratum_v1_queue_notify(GlobalState * GLOBAL_STATE, mining_notify *notify, bool clean_jobs)
+{
+    SYSTEM_notify_new_work(GLOBAL_STATE, notify->clean_jobs);
+    SYSTEM_notify_new_ntime(GLOBAL_STATE, notify->ntime);
+    if (clean_jobs) {
+        SYSTEM_clean_jobs_queue(GLOBAL_STATE);
+    }
+    // a full queue drops its oldest notify on its own
+    bool queued = queue_enqueue(&GLOBAL_STATE->stratum_queue, notify);
+    decode_mining_notification(GLOBAL_STATE, notify);
+    if (!queued) {
+        STRATUM_V1_free_mining_notify(notify);
+    }
+}
+
+// Resolve the pool and connect, which includes the TLS handshake. The time
+// the connect took, with any DNS lookup the cache couldn't answer, goes to
+// connect_time_ms.
+static esp_err_t stratum_v1_open_transport(GlobalState *GLOBAL_STATE, esp_transport_handle_t *transport,
+                                           stratum_connection_info_t *conn_info, float *connect_time_ms)
+{
+    char *stratum_url = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url : GLOBAL_STATE->SYSTEM_MODULE.pool_url;
+    uint16_t port = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_port : GLOBAL_STATE->SYSTEM_MODULE.pool_port;
+
+    tls_mode tls = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_tls : GLOBAL_STATE->SYSTEM_MODULE.pool_tls;
+    char * cert = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_cert : GLOBAL_STATE->SYSTEM_MODULE.pool_cert;
+
+    ESP_LOGI(TAG, "Connecting to: stratum+tcp://%s:%d", stratum_url, port);
+
+    esp_transport_handle_t handle;
+    int64_t connect_start_us = esp_timer_get_time();
+    esp_err_t ret = stratum_socket_connect(stratum_url, port, tls, cert, TRANSPORT_TIMEOUT_MS, conn_info, &handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Transport unable to connect to %s:%d (err %d)", stratum_url, port, ret);
+        *transport = NULL;
+        return ret;
+    }
+    *connect_time_ms = (esp_timer_get_time() - connect_start_us) / 1000.0f;
+    ESP_LOGI(TAG, "Connected in %.0f ms", *connect_time_ms);
+
+    stratum_socket_set_options(handle);
+    *transport = handle;
+    return ESP_OK;
+}
+
+static void stratum_v1_drop_warm_transport(void)
+{
+    if (warm_transport != NULL) {
+        esp_transport_close(warm_transport);
+        esp_transport_destroy(warm_transport);
+        warm_transport = NULL;
+    }
+}
+
+// Reconnect backoff. The next connection is resolved and handshaken while
+// waiting, so the reconnect itself only has to subscribe. A failed attempt
+// counts as a retry.
+static void stratum_v1_reconnect_backoff(GlobalState *GLOBAL_STATE, int *retry_attempts)
+{
+    int64_t backoff_end_us = esp_timer_get_time() + RECONNECT_BACKOFF_MS * 1000LL;
+
+    if (warm_transport == NULL && GLOBAL_STATE->ASIC_initalized && wifi_is_connected() &&
+        stratum_v1_open_transport(GLOBAL_STATE, &warm_transport, &warm_conn_info, &warm_connect_time_ms) != ESP_OK) {
+        (*retry_attempts)++;
+    }
+
+    int64_t remaining_ms = (backoff_end_us - esp_timer_get_time()) / 1000;
+    if (remaining_ms > 0) {
+        vTaskDelay(pdMS_TO_TICKS(remaining_ms));
+    }
+}
+
+// Connect to the pool and send the setup messages. Returns false, after the
+// retry delay, when no connection could be made.
+static bool stratum_v1_connect(GlobalState *GLOBAL_STATE, bool use_fallback, int *retry_attempts, int *authorize_message_id)
+{
+    esp_transport_handle_t transport = warm_transport;
+    stratum_connection_info_t conn_info = warm_conn_info;
+    float connect_time_ms = warm_connect_time_ms;
+    warm_transport = NULL;
+
+    if (transport != NULL) {
+        ESP_LOGI(TAG, "Using the connection opened during the backoff (%s)", conn_info.host_ip);
+    } else {
+        esp_err_t ret = stratum_v1_open_transport(GLOBAL_STATE, &transport, &conn_info, &connect_time_ms);
+        if (ret != ESP_OK) {
+            (*retry_attempts)++;
+            ESP_LOGE(TAG, "Unable to open a connection. Attempt: %d", *retry_attempts);
+            // a failed lookup is retried sooner than a failed connect
+            vTaskDelay((ret == ESP_ERR_NOT_FOUND ? 1000 : 5000) / portTICK_PERIOD_MS);
+            return false;
+        }
+    }
+
+    GLOBAL_STATE->transport = transport;
+    GLOBAL_STATE->SYSTEM_MODULE.pool_handshake_time = connect_time_ms;
+
+    tls_mode tls = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_tls : GLOBAL_STATE->SYSTEM_MODULE.pool_tls;
+    const char *protocol = (conn_info.addr_family == AF_INET6) ? "IPv6" : "IPv4";
+    const char *tls_status;
+
+    switch (tls) {
+        case DISABLED:     tls_status = ""; break;
+        case BUNDLED_CRT:  tls_status = " (TLS)"; break;
+        case CUSTOM_CRT:   tls_status = " (TLS Cert)"; break;
+        default:           tls_status = ""; break;
+    }
+
+    snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
+             sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info),
+             "%s%s", protocol, tls_status);
+
+    stratum_v1_reset_uid(GLOBAL_STATE);
+    SYSTEM_clean_jobs_queue(GLOBAL_STATE);
+
+    ///// Start Stratum Action
+    // mining.configure - ID: 1
+    STRATUM_V1_configure_version_rolling(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), &GLOBAL_STATE->version_mask);
+
+    // mining.subscribe - ID: 2
+    STRATUM_V1_subscribe(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
+
+    char *username = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
+    char *password = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_pass : GLOBAL_STATE->SYSTEM_MODULE.pool_pass;
+
+    *authorize_message_id = stratum_get_next_uid(GLOBAL_STATE);
+
+    //mining.authorize - ID: 3
+    STRATUM_V1_authorize(GLOBAL_STATE->transport, *authorize_message_id, username, password);
+    return true;
+}
+
 void stratum_v1_task(void *pvParameters)
 {
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
@@ -179,25 +345,29 @@ void stratum_v1_task(void *pvParameters)
     GLOBAL_STATE->stratum_queue.free_fn = (void (*)(void *))STRATUM_V1_free_mining_notify;
 
     STRATUM_V1_initialize_buffer();
+    mining_notify *standby_notify = stratum_v1_standby_adopt(GLOBAL_STATE);
     int retry_attempts = 0;
-    int retry_critical_attempts = 0;
+    int authorize_message_id = -1;
 
     ESP_LOGI(TAG, "Opening connection to pool: %s:%d", stratum_url, port);
     while (1) {
         // Check if coordinator wants us to shut down
         if (protocol_coordinator_v1_should_shutdown()) {
             ESP_LOGI(TAG, "Coordinator requested shutdown, exiting");
+            stratum_v1_drop_warm_transport();
             protocol_coordinator_v1_exited();
             vTaskDelete(NULL);
         }
 
         if (!GLOBAL_STATE->ASIC_initalized) {
+            stratum_v1_drop_warm_transport();
             vTaskDelay(1000 / portTICK_PERIOD_MS);
             continue;
         }
 
         if (!wifi_is_connected()) {
             ESP_LOGI(TAG, "WiFi disconnected, attempting to reconnect...");
+            stratum_v1_drop_warm_transport();
             vTaskDelay(10000 / portTICK_PERIOD_MS);
             continue;
         }
@@ -208,96 +378,27 @@ void stratum_v1_task(void *pvParameters)
             // "all pools unreachable" decision, pool swapping, and power-pause
             // recovery — see protocol_coordinator.c.
             ESP_LOGW(TAG, "Max V1 retry attempts reached (%d), notifying coordinator", retry_attempts);
+            stratum_v1_drop_warm_transport();
             stratum_v1_close_connection(GLOBAL_STATE);
             protocol_coordinator_notify_failure();
             vTaskDelete(NULL);
             return;
         }
 
-        stratum_url = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_url : GLOBAL_STATE->SYSTEM_MODULE.pool_url;
-        port = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_port : GLOBAL_STATE->SYSTEM_MODULE.pool_port;
-
-        stratum_connection_info_t conn_info;
-        if (stratum_socket_resolve(stratum_url, port, &conn_info) != ESP_OK) {
-            ESP_LOGE(TAG, "Address resolution failed for %s", stratum_url);
-            retry_attempts++;
-            vTaskDelay(1000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-        ESP_LOGI(TAG, "Connecting to: stratum+tcp://%s:%d (%s)", stratum_url, port, conn_info.host_ip);
-
-        tls_mode tls = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_tls : GLOBAL_STATE->SYSTEM_MODULE.pool_tls;
-        char * cert = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_cert : GLOBAL_STATE->SYSTEM_MODULE.pool_cert;
-        retry_critical_attempts = 0;
-
-        GLOBAL_STATE->transport = STRATUM_V1_transport_init(tls, cert);
-        // Check if transport was initialized
-        if (GLOBAL_STATE->transport == NULL) {
-            ESP_LOGE(TAG, "Transport initialization failed.");
-            if (++retry_critical_attempts > MAX_CRITICAL_RETRY_ATTEMPTS) {
-                ESP_LOGE(TAG, "Max retry attempts reached, restarting...");
-                esp_restart();
-            }
-            retry_attempts++;
-            vTaskDelay(5000 / portTICK_PERIOD_MS);
-            continue;
-        }
-        retry_critical_attempts = 0;
-
-        // Use the already-resolved IP to avoid a second DNS lookup inside esp_transport_connect.
-        // This prevents long DNS timeouts from blocking the lwIP stack and starving the HTTP server.
-        if (tls != DISABLED) {
-            esp_transport_ssl_set_common_name(GLOBAL_STATE->transport, stratum_url);
-        }
-        ESP_LOGI(TAG, "Transport initialized, connecting to %s:%d (%s)", stratum_url, port, conn_info.host_ip);
-        esp_err_t ret = esp_transport_connect(GLOBAL_STATE->transport, conn_info.host_ip, port, TRANSPORT_TIMEOUT_MS);
-        if (ret != ESP_OK) {
-            retry_attempts++;
-            ESP_LOGE(TAG, "Transport unable to connect to %s:%d (errno %d). Attempt: %d", stratum_url, port, ret, retry_attempts);
-            // close the transport
-            esp_transport_close(GLOBAL_STATE->transport);
-            esp_transport_destroy(GLOBAL_STATE->transport);
-            GLOBAL_STATE->transport = NULL;
-            // instead of restarting, retry this every 5 seconds
-            vTaskDelay(5000 / portTICK_PERIOD_MS);
+        if (standby_notify != NULL) {
+            // A promoted hot standby connection is already subscribed and authorized
+            stratum_v1_queue_notify(GLOBAL_STATE, standby_notify, true);
+            standby_notify = NULL;
+            protocol_coordinator_notify_success();
+            stratum_v1_vardiff_start(GLOBAL_STATE);
+            // the standby suggested this at authorize
+            vardiff_set_suggested(&v1_vardiff, SYSTEM_suggested_difficulty(GLOBAL_STATE, true));
+        } else if (!stratum_v1_connect(GLOBAL_STATE, use_fallback, &retry_attempts, &authorize_message_id)) {
             continue;
+        } else {
+            stratum_v1_vardiff_start(GLOBAL_STATE);
         }
 
-        stratum_socket_set_options(GLOBAL_STATE->transport);
-
-        const char *protocol = (conn_info.addr_family == AF_INET6) ? "IPv6" : "IPv4";
-        const char *tls_status;
-
-        switch (tls) {
-            case DISABLED:     tls_status = ""; break;
-            case BUNDLED_CRT:  tls_status = " (TLS)"; break;
-            case CUSTOM_CRT:   tls_status = " (TLS Cert)"; break;
-            default:           tls_status = ""; break;
-        }
-
-        snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
-                 sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info),
-                 "%s%s", protocol, tls_status);
-
-        stratum_v1_reset_uid(GLOBAL_STATE);
-        SYSTEM_clean_jobs_queue(GLOBAL_STATE);
-
-        ///// Start Stratum Action
-        // mining.configure - ID: 1
-        STRATUM_V1_configure_version_rolling(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), &GLOBAL_STATE->version_mask);
-
-        // mining.subscribe - ID: 2
-        STRATUM_V1_subscribe(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), GLOBAL_STATE->DEVICE_CONFIG.family.asic.name);
-
-        char *username = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
-        char *password = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_pass : GLOBAL_STATE->SYSTEM_MODULE.pool_pass;
-
-        int authorize_message_id = stratum_get_next_uid(GLOBAL_STATE);
-
-        //mining.authorize - ID: 3
-        STRATUM_V1_authorize(GLOBAL_STATE->transport, authorize_message_id, username, password);
-
         while (1) {
             // Check if coordinator wants us to shut down
             if (protocol_coordinator_v1_should_shutdown()) {
@@ -308,15 +409,25 @@ void stratum_v1_task(void *pvParameters)
             }
 
             char *line = STRATUM_V1_receive_jsonrpc_line(GLOBAL_STATE->transport);
+            if (!line && stratum_v1_standby_is_ready()) {
+                // The fallback pool already has work waiting, don't retry this one first
+                ESP_LOGW(TAG, "Connection lost, failing over to the hot standby pool");
+                stratum_v1_close_transport(GLOBAL_STATE);
+                protocol_coordinator_notify_failure();
+                vTaskDelete(NULL);
+                return;
+            }
             if (!line) {
                 ESP_LOGE(TAG, "Failed to receive JSON-RPC line, reconnecting...");
                 retry_attempts++;
-                stratum_v1_close_connection(GLOBAL_STATE);
+                stratum_v1_close_transport(GLOBAL_STATE);
+                if (retry_attempts < MAX_RETRY_ATTEMPTS) {
+                    stratum_v1_reconnect_backoff(GLOBAL_STATE, &retry_attempts);
+                }
                 break;
             }
 
             if (!GLOBAL_STATE->ASIC_initalized) {
-                free(line);
                 ESP_LOGI(TAG, "Mining paused, disconnecting from pool");
                 retry_attempts = 0;
                 stratum_v1_close_connection(GLOBAL_STATE);
@@ -329,10 +440,8 @@ void stratum_v1_task(void *pvParameters)
             if (!STRATUM_V1_parse(&stratum_api_v1_message, line)) {
                 ESP_LOGE(TAG, "Failed to parse Stratum message, ignoring");
                 STRATUM_V1_reset_message(&stratum_api_v1_message);
-                free(line);
                 continue;
             }
-            free(line);
 
             switch (stratum_api_v1_message.method) {
                 case METHOD_UNKNOWN:
@@ -340,18 +449,9 @@ void stratum_v1_task(void *pvParameters)
                     break;
 
                 case MINING_NOTIFY:
-                    GLOBAL_STATE->SYSTEM_MODULE.work_received++;
-                    SYSTEM_notify_new_ntime(GLOBAL_STATE, stratum_api_v1_message.mining_notification->ntime);
-                    if (stratum_api_v1_message.mining_notification->clean_jobs &&
-                        (GLOBAL_STATE->stratum_queue.count > 0)) {
-                        SYSTEM_clean_jobs_queue(GLOBAL_STATE);
-                    }
-                    if (GLOBAL_STATE->stratum_queue.count == QUEUE_SIZE) {
-                        mining_notify *next_notify_json_str = (mining_notify *) queue_dequeue(&GLOBAL_STATE->stratum_queue);
-                        STRATUM_V1_free_mining_notify(next_notify_json_str);
-                    }
-                    queue_enqueue(&GLOBAL_STATE->stratum_queue, stratum_api_v1_message.mining_notification);
-                    decode_mining_notification(GLOBAL_STATE, stratum_api_v1_message.mining_notification);
+                    stratum_v1_queue_notify(GLOBAL_STATE, stratum_api_v1_message.mining_notification,
+                                            stratum_api_v1_message.mining_notification->clean_jobs &&
+                                            (queue_count(&GLOBAL_STATE->stratum_queue) > 0));
                     stratum_api_v1_message.mining_notification = NULL;
                     break;
 
@@ -402,7 +502,8 @@ void stratum_v1_task(void *pvParameters)
 
                 case CLIENT_RECONNECT:
                     ESP_LOGE(TAG, "Pool requested client reconnect...");
-                    stratum_v1_close_connection(GLOBAL_STATE);
+                    stratum_v1_close_transport(GLOBAL_STATE);
+                    stratum_v1_reconnect_backoff(GLOBAL_STATE, &retry_attempts);
                     reconnect_requested = true;
                     break;
 
@@ -415,14 +516,15 @@ void stratum_v1_task(void *pvParameters)
                     {
                         float response_time_ms = STRATUM_V1_get_response_time_ms(stratum_api_v1_message.message_id, receive_time_us);
                         if (response_time_ms >= 0) {
+                            SYSTEM_notify_share_response_time(GLOBAL_STATE, STRATUM_PROTOCOL_V1, response_time_ms);
                             if (stratum_api_v1_message.response_success) {
                                 ESP_LOGI(TAG, "message result accepted");
                                 ESP_LOGI(TAG, "Stratum response time: %.1f ms", response_time_ms);
                                 GLOBAL_STATE->SYSTEM_MODULE.response_time = response_time_ms;
-                                SYSTEM_notify_accepted_share(GLOBAL_STATE);
+                                SYSTEM_notify_accepted_share(GLOBAL_STATE, STRATUM_PROTOCOL_V1);
                             } else {
                                 ESP_LOGW(TAG, "message result rejected: %s", stratum_api_v1_message.error_str);
-                                SYSTEM_notify_rejected_share(GLOBAL_STATE, stratum_api_v1_message.error_str);
+                                SYSTEM_notify_rejected_share(GLOBAL_STATE, STRATUM_PROTOCOL_V1, stratum_api_v1_message.error_str);
                             }
                         } else {
                             // Reset retry attempts after successfully receiving data.
@@ -433,9 +535,10 @@ void stratum_v1_task(void *pvParameters)
                             if (stratum_api_v1_message.response_success) {
                                 ESP_LOGI(TAG, "setup message accepted");
                                 if (stratum_api_v1_message.message_id == authorize_message_id) {
-                                    uint16_t difficulty = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_difficulty : GLOBAL_STATE->SYSTEM_MODULE.pool_difficulty;
+                                    uint32_t difficulty = SYSTEM_suggested_difficulty(GLOBAL_STATE, GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback);
                                     if (difficulty > 0) {
                                         STRATUM_V1_suggest_difficulty(GLOBAL_STATE->transport, stratum_get_next_uid(GLOBAL_STATE), difficulty);
+                                        vardiff_set_suggested(&v1_vardiff, difficulty);
                                     }
                                     bool extranonce_subscribe = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_extranonce_subscribe : GLOBAL_STATE->SYSTEM_MODULE.pool_extranonce_subscribe;
                                     if (extranonce_subscribe) {
@@ -453,6 +556,7 @@ void stratum_v1_task(void *pvParameters)
             if (reconnect_requested) {
                 break;
             }
+            stratum_v1_vardiff_tick(GLOBAL_STATE);
         }
     }
     vTaskDelete(NULL);
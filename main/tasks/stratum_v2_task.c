@@ -18,7 +18,9 @@
 #include "device_config.h"
 #include "coinbase_decoder.h"
 #include "esp_heap_caps.h"
+#include "vardiff.h"
 
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -105,6 +107,7 @@ void stratum_v2_close_connection(GlobalState *GLOBAL_STATE)
         esp_transport_destroy(GLOBAL_STATE->transport);
         GLOBAL_STATE->transport = NULL;
     }
+    SYSTEM_notify_work_lost(GLOBAL_STATE);
     SYSTEM_clean_jobs_queue(GLOBAL_STATE);
     vTaskDelay(1000 / portTICK_PERIOD_MS);
 }
@@ -122,48 +125,86 @@ static inline void stratum_v2_record_submit_time(uint32_t sequence_number)
     stratum_v2_submit_time_us[sequence_number % SV2_SUBMIT_TIMING_SLOTS] = esp_timer_get_time();
 }
 
-int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t job_id, uint32_t nonce,
-                            uint32_t ntime, uint32_t version)
+int stratum_v2_build_share(GlobalState *GLOBAL_STATE, uint8_t *buf, int size,
+                           uint32_t job_id, uint32_t nonce, uint32_t ntime, uint32_t version,
+                           const uint8_t *extranonce, uint8_t extranonce_len)
 {
-    if (!GLOBAL_STATE->transport || !GLOBAL_STATE->sv2_conn || !GLOBAL_STATE->sv2_noise_ctx) {
+    if (!GLOBAL_STATE->sv2_conn) {
         return -1;
     }
 
     sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-    uint8_t buf[SV2_FRAME_HEADER_SIZE + 24];
-
-    uint32_t sequence_number = conn->sequence_number++;
-    int len = sv2_build_submit_shares_standard(buf, sizeof(buf),
-                                                conn->channel_id,
-                                                sequence_number,
-                                                job_id, nonce, ntime, version);
+    int len;
+
+    uint32_t sequence_number = conn->sequence_number;
+    if (stratum_v2_is_extended_channel(GLOBAL_STATE)) {
+        len = sv2_build_submit_shares_extended(buf, size,
+                                               conn->channel_id,
+                                               sequence_number,
+                                               job_id, nonce, ntime, version,
+                                               extranonce, extranonce_len);
+    } else {
+        len = sv2_build_submit_shares_standard(buf, size,
+                                               conn->channel_id,
+                                               sequence_number,
+                                               job_id, nonce, ntime, version);
+    }
     if (len < 0) return -1;
 
+    conn->sequence_number++;
     stratum_v2_record_submit_time(sequence_number);
-    return sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, buf, len);
+    return len;
 }
 
-int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
-                                     uint32_t nonce, uint32_t ntime, uint32_t version,
-                                     const uint8_t *extranonce, uint8_t extranonce_len)
+// Shares are sent from the share submit task, channel updates from this one;
+// both advance the same Noise send cipher
+static pthread_mutex_t sv2_send_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int stratum_v2_send_frames(GlobalState *GLOBAL_STATE, const uint8_t *frames, int frames_len)
 {
-    if (!GLOBAL_STATE->transport || !GLOBAL_STATE->sv2_conn || !GLOBAL_STATE->sv2_noise_ctx) {
+    if (!GLOBAL_STATE->transport || !GLOBAL_STATE->sv2_noise_ctx) {
         return -1;
     }
 
-    sv2_conn_t *conn = GLOBAL_STATE->sv2_conn;
-    uint8_t buf[SV2_FRAME_HEADER_SIZE + 24 + 1 + 32];
-
-    uint32_t sequence_number = conn->sequence_number++;
-    int len = sv2_build_submit_shares_extended(buf, sizeof(buf),
-                                                conn->channel_id,
-                                                sequence_number,
-                                                job_id, nonce, ntime, version,
-                                                extranonce, extranonce_len);
-    if (len < 0) return -1;
+    pthread_mutex_lock(&sv2_send_lock);
+    int ret = sv2_noise_send_frames(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, frames, frames_len);
+    pthread_mutex_unlock(&sv2_send_lock);
+    return ret;
+}
 
-    stratum_v2_record_submit_time(sequence_number);
-    return sv2_noise_send(GLOBAL_STATE->sv2_noise_ctx, GLOBAL_STATE->transport, buf, len);
+// Nominal hashrate in H/s to report to the pool
+static float stratum_v2_nominal_hash_rate(GlobalState *GLOBAL_STATE)
+{
+    float hashrate_ghs = SYSTEM_hashrate_estimate(GLOBAL_STATE);
+    return hashrate_ghs > 0 ? hashrate_ghs * 1e9f : 1e12f;
+}
+
+static vardiff v2_vardiff;
+
+// SV2 has no way to ask for a difficulty. Report the measured hashrate and
+// cap the target at the one for the wanted difficulty, so the pool can't go
+// easier than that.
+static void stratum_v2_vardiff_tick(GlobalState *GLOBAL_STATE, sv2_conn_t *conn)
+{
+    SystemModule *module = &GLOBAL_STATE->SYSTEM_MODULE;
+    double difficulty = vardiff_update(&v2_vardiff, esp_timer_get_time(), GLOBAL_STATE->pool_difficulty,
+                                       SYSTEM_hashrate_estimate(GLOBAL_STATE), module->shares_accepted);
+    if (difficulty <= 0) {
+        return;
+    }
+
+    uint8_t max_target[32];
+    sv2_pdiff_to_target((uint32_t)difficulty, max_target);
+    float hash_rate = stratum_v2_nominal_hash_rate(GLOBAL_STATE);
+
+    uint8_t frame_buf[64];
+    int frame_len = sv2_build_update_channel(frame_buf, sizeof(frame_buf), conn->channel_id, hash_rate, max_target);
+    if (frame_len < 0 || stratum_v2_send_frames(GLOBAL_STATE, frame_buf, frame_len) < 0) {
+        ESP_LOGW(TAG, "Failed to send UpdateChannel");
+        return;
+    }
+    ESP_LOGI(TAG, "UpdateChannel: %.0f GH/s, difficulty %.0f for %u shares/min (pool difficulty %.2f)",
+             hash_rate / 1e9f, difficulty, module->shares_per_minute, GLOBAL_STATE->pool_difficulty);
 }
 
 bool stratum_v2_is_extended_channel(GlobalState *GLOBAL_STATE)
@@ -192,40 +233,34 @@ static void stratum_v2_enqueue_job(GlobalState *GLOBAL_STATE, sv2_conn_t *conn,
     job->nbits = nbits;
     job->clean_jobs = clean_jobs;
 
-    GLOBAL_STATE->SYSTEM_MODULE.work_received++;
+    SYSTEM_notify_new_work(GLOBAL_STATE, clean_jobs);
 
     SYSTEM_notify_new_ntime(GLOBAL_STATE, ntime);
 
-    if (clean_jobs && (GLOBAL_STATE->stratum_queue.count > 0)) {
+    if (clean_jobs && (queue_count(&GLOBAL_STATE->stratum_queue) > 0)) {
         SYSTEM_clean_jobs_queue(GLOBAL_STATE);
     }
 
-    if (GLOBAL_STATE->stratum_queue.count == QUEUE_SIZE) {
-        void *old = queue_dequeue(&GLOBAL_STATE->stratum_queue);
-        free(old);
+    if (!queue_enqueue(&GLOBAL_STATE->stratum_queue, job)) {
+        free(job);
     }
-
-    queue_enqueue(&GLOBAL_STATE->stratum_queue, job);
 }
 
 // Enqueue an sv2_ext_job_t onto the stratum queue (extended channels)
 static void stratum_v2_enqueue_ext_job(GlobalState *GLOBAL_STATE, sv2_conn_t *conn,
                                         sv2_ext_job_t *job)
 {
-    GLOBAL_STATE->SYSTEM_MODULE.work_received++;
+    SYSTEM_notify_new_work(GLOBAL_STATE, job->clean_jobs);
 
     SYSTEM_notify_new_ntime(GLOBAL_STATE, job->ntime);
 
-    if (job->clean_jobs && (GLOBAL_STATE->stratum_queue.count > 0)) {
+    if (job->clean_jobs && (queue_count(&GLOBAL_STATE->stratum_queue) > 0)) {
         SYSTEM_clean_jobs_queue(GLOBAL_STATE);
     }
 
-    if (GLOBAL_STATE->stratum_queue.count == QUEUE_SIZE) {
-        void *old = queue_dequeue(&GLOBAL_STATE->stratum_queue);
-        sv2_ext_job_free((sv2_ext_job_t *)old);
+    if (!queue_enqueue(&GLOBAL_STATE->stratum_queue, job)) {
+        sv2_ext_job_free(job);
     }
-
-    queue_enqueue(&GLOBAL_STATE->stratum_queue, job);
 }
 
 // Decode coinbase from extended job prefix/suffix by converting to hex and reusing V1 decoder
@@ -626,40 +661,19 @@ void stratum_v2_task(void *pvParameters)
 
         ESP_LOGI(TAG, "Connecting to stratum+sv2://%s:%d (attempt %d)", stratum_url, port, retry_attempts + 1);
 
-        // Create plain TCP transport
-        esp_transport_handle_t transport = esp_transport_tcp_init();
-        if (!transport) {
-            ESP_LOGE(TAG, "Failed to init TCP transport");
-            snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
-                     sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "SV2: Internal error");
-            retry_attempts++;
-            vTaskDelay(5000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
-        // Resolve up front and connect by IP so DNS stays non-blocking (a long
-        // DNS timeout otherwise stalls the lwIP stack and starves the HTTP server).
+        // Plain TCP, resolved up front and connected by IP so DNS stays
+        // non-blocking (a long DNS timeout otherwise stalls the lwIP stack and
+        // starves the HTTP server).
+        esp_transport_handle_t transport;
         stratum_connection_info_t conn_info;
-        if (stratum_socket_resolve(stratum_url, port, &conn_info) != ESP_OK) {
-            ESP_LOGE(TAG, "Address resolution failed for %s", stratum_url);
-            snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
-                     sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "SV2: Pool unreachable");
-            esp_transport_close(transport);
-            esp_transport_destroy(transport);
-            retry_attempts++;
-            vTaskDelay(5000 / portTICK_PERIOD_MS);
-            continue;
-        }
-
         int64_t connect_start_us = esp_timer_get_time();
 
-        esp_err_t ret = esp_transport_connect(transport, conn_info.host_ip, port, TRANSPORT_TIMEOUT_MS);
+        esp_err_t ret = stratum_socket_connect(stratum_url, port, DISABLED, NULL, TRANSPORT_TIMEOUT_MS, &conn_info, &transport);
         if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "TCP connect failed to %s:%d (%s) (err %d)", stratum_url, port, conn_info.host_ip, ret);
+            ESP_LOGE(TAG, "TCP connect failed to %s:%d (err %d)", stratum_url, port, ret);
             snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
-                     sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "SV2: Pool unreachable");
-            esp_transport_close(transport);
-            esp_transport_destroy(transport);
+                     sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info),
+                     ret == ESP_ERR_NO_MEM ? "SV2: Internal error" : "SV2: Pool unreachable");
             retry_attempts++;
             vTaskDelay(5000 / portTICK_PERIOD_MS);
             continue;
@@ -718,6 +732,7 @@ void stratum_v2_task(void *pvParameters)
         }
         snprintf(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info,
                  sizeof(GLOBAL_STATE->SYSTEM_MODULE.pool_connection_info), "%s", ip_protocol);
+        GLOBAL_STATE->SYSTEM_MODULE.pool_handshake_time = (esp_timer_get_time() - connect_start_us) / 1000.0f;
 
         ESP_LOGI(TAG, "Encrypted channel established (ChaCha20-Poly1305) (free heap: %lu)",
                  (unsigned long)esp_get_free_heap_size());
@@ -791,7 +806,7 @@ void stratum_v2_task(void *pvParameters)
         {
             char *user = use_fallback ? GLOBAL_STATE->SYSTEM_MODULE.fallback_pool_user
                                       : GLOBAL_STATE->SYSTEM_MODULE.pool_user;
-            float hash_rate = 1e12;
+            float hash_rate = stratum_v2_nominal_hash_rate(GLOBAL_STATE);
             int frame_len;
 
             if (channel_type == SV2_CHANNEL_EXTENDED) {
@@ -893,6 +908,9 @@ void stratum_v2_task(void *pvParameters)
                      channel_id, group_channel_id,
                      channel_type == SV2_CHANNEL_EXTENDED ? SV2_CHANNEL_TYPE_EXTENDED : SV2_CHANNEL_TYPE_STANDARD);
             ESP_LOGI(TAG, "Set pool difficulty: %lu", pdiff);
+
+            vardiff_init(&v2_vardiff, GLOBAL_STATE->SYSTEM_MODULE.shares_per_minute,
+                         esp_timer_get_time(), GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
         }
 
         // Connection successful, reset retry counter
@@ -950,11 +968,12 @@ void stratum_v2_task(void *pvParameters)
                             GLOBAL_STATE->SYSTEM_MODULE.response_time = response_time_ms;
                             GLOBAL_STATE->SYSTEM_MODULE.response_share_batch = (uint16_t)accepted_count;
                             stratum_v2_submit_time_us[slot] = 0;
+                            SYSTEM_notify_share_response_time(GLOBAL_STATE, STRATUM_PROTOCOL_V2, response_time_ms);
                         } else {
                             ESP_LOGI(TAG, "Shares accepted: %lu", accepted_count);
                         }
                         for (uint32_t i = 0; i < accepted_count; i++) {
-                            SYSTEM_notify_accepted_share(GLOBAL_STATE);
+                            SYSTEM_notify_accepted_share(GLOBAL_STATE, STRATUM_PROTOCOL_V2);
                         }
                     }
                     break;
@@ -967,15 +986,27 @@ void stratum_v2_task(void *pvParameters)
                                                       &channel_id, &seq_num,
                                                       error_code, sizeof(error_code)) == 0) {
                         ESP_LOGW(TAG, "Share rejected: %s", error_code);
-                        SYSTEM_notify_rejected_share(GLOBAL_STATE, error_code);
+                        int slot = seq_num % SV2_SUBMIT_TIMING_SLOTS;
+                        if (stratum_v2_submit_time_us[slot] > 0) {
+                            float response_time_ms = (float)(esp_timer_get_time() - stratum_v2_submit_time_us[slot]) / 1000.0f;
+                            SYSTEM_notify_share_response_time(GLOBAL_STATE, STRATUM_PROTOCOL_V2, response_time_ms);
+                            stratum_v2_submit_time_us[slot] = 0;
+                        }
+                        SYSTEM_notify_rejected_share(GLOBAL_STATE, STRATUM_PROTOCOL_V2, error_code);
                     }
                     break;
                 }
 
+                case SV2_MSG_UPDATE_CHANNEL_ERROR:
+                    ESP_LOGW(TAG, "Pool rejected UpdateChannel");
+                    break;
+
                 default:
                     ESP_LOGW(TAG, "Unknown SV2 message type: 0x%02x (len=%lu)", hdr.msg_type, hdr.msg_length);
                     break;
             }
+
+            stratum_v2_vardiff_tick(GLOBAL_STATE, conn);
         }
     }
 
@@ -6,11 +6,13 @@
 
 void stratum_v2_task(void *pvParameters);
 void stratum_v2_close_connection(GlobalState *GLOBAL_STATE);
-int stratum_v2_submit_share(GlobalState *GLOBAL_STATE, uint32_t job_id, uint32_t nonce,
-                            uint32_t ntime, uint32_t version);
-int stratum_v2_submit_share_extended(GlobalState *GLOBAL_STATE, uint32_t job_id,
-                                     uint32_t nonce, uint32_t ntime, uint32_t version,
-                                     const uint8_t *extranonce, uint8_t extranonce_len);
+// Append a SubmitShares frame for the current channel type to buf.
+// Returns the frame length, or -1 if there is no channel or buf is too small.
+int stratum_v2_build_share(GlobalState *GLOBAL_STATE, uint8_t *buf, int size,
+                           uint32_t job_id, uint32_t nonce, uint32_t ntime, uint32_t version,
+                           const uint8_t *extranonce, uint8_t extranonce_len);
+// Send frames built by stratum_v2_build_share in one Noise write.
+int stratum_v2_send_frames(GlobalState *GLOBAL_STATE, const uint8_t *frames, int frames_len);
 bool stratum_v2_is_extended_channel(GlobalState *GLOBAL_STATE);
 
 #endif // STRATUM_V2_TASK_H
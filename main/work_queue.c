@@ -1,109 +1,164 @@
 #include "work_queue.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <stdlib.h>
-#include <time.h>
-#include <errno.h>
 
-void queue_init(work_queue *queue)
+static const char *TAG = "work_queue";
+
+// index comparison that survives the 32-bit wrap
+static inline bool index_before(uint32_t a, uint32_t b)
 {
-    queue->head = 0;
-    queue->tail = 0;
-    queue->count = 0;
-    queue->free_fn = NULL;
-    pthread_mutex_init(&queue->lock, NULL);
-    pthread_cond_init(&queue->not_empty, NULL);
-    pthread_cond_init(&queue->not_full, NULL);
+    return (int32_t)(a - b) < 0;
 }
 
-void queue_enqueue(work_queue *queue, void *new_work)
+static void free_slot(work_queue_slot *slot)
 {
-    pthread_mutex_lock(&queue->lock);
-
-    while (queue->count == QUEUE_SIZE)
+    if (slot->free_fn)
     {
-        pthread_cond_wait(&queue->not_full, &queue->lock);
+        slot->free_fn(slot->item);
     }
+    else
+    {
+        free(slot->item);
+    }
+    slot->item = NULL;
+}
 
-    queue->buffer[queue->tail] = new_work;
-    queue->tail = (queue->tail + 1) % QUEUE_SIZE;
-    queue->count++;
+static void advance_clear_to(work_queue *queue, uint32_t index)
+{
+    uint32_t current = atomic_load_explicit(&queue->clear_to, memory_order_relaxed);
+    while (index_before(current, index) &&
+           !atomic_compare_exchange_weak_explicit(&queue->clear_to, &current, index,
+                                                  memory_order_release, memory_order_relaxed))
+    {
+    }
+}
 
-    pthread_cond_signal(&queue->not_empty);
-    pthread_mutex_unlock(&queue->lock);
+static void notify_consumer(work_queue *queue)
+{
+    TaskHandle_t consumer = queue->consumer;
+    if (consumer != NULL)
+    {
+        xTaskNotifyGive(consumer);
+    }
 }
 
-void *queue_dequeue(work_queue *queue)
+void queue_init(work_queue *queue, uint32_t capacity)
 {
-    pthread_mutex_lock(&queue->lock);
+    queue->capacity = capacity;
+    queue->size = capacity * 2;
+    queue->buffer = calloc(queue->size, sizeof(work_queue_slot));
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->clear_to, 0);
+    atomic_init(&queue->high_water, 0);
+    atomic_init(&queue->dropped, 0);
+    queue->consumer = NULL;
+    queue->free_fn = NULL;
 
-    while (queue->count == 0)
+    if (queue->buffer == NULL)
     {
-        pthread_cond_wait(&queue->not_empty, &queue->lock);
+        ESP_LOGE(TAG, "Failed to allocate queue of %lu items", (unsigned long)capacity);
     }
+}
 
-    void *next_work = queue->buffer[queue->head];
-    queue->head = (queue->head + 1) % QUEUE_SIZE;
-    queue->count--;
-
-    pthread_cond_signal(&queue->not_full);
-    pthread_mutex_unlock(&queue->lock);
+uint32_t queue_count(work_queue *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    uint32_t clear_to = atomic_load_explicit(&queue->clear_to, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
 
-    return next_work;
+    uint32_t start = index_before(head, clear_to) ? clear_to : head;
+    return index_before(start, tail) ? tail - start : 0;
 }
 
-void *queue_dequeue_timeout(work_queue *queue, int timeout_ms)
+// Producer side. When more than capacity items are pending the oldest one is dropped.
+// Returns false if the item was not queued, in which case the caller still owns it.
+bool queue_enqueue(work_queue *queue, void *new_work)
 {
-    pthread_mutex_lock(&queue->lock);
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
 
-    while (queue->count == 0)
+    if (queue->buffer == NULL || tail - head >= queue->size)
     {
-        struct timespec timeout_time;
-        clock_gettime(CLOCK_REALTIME, &timeout_time);
-
-        // Add timeout_ms milliseconds to current time
-        timeout_time.tv_sec += timeout_ms / 1000;
-        timeout_time.tv_nsec += (timeout_ms % 1000) * 1000000;
+        // consumer has not drained a whole ring, nothing left to overwrite safely
+        ESP_LOGW(TAG, "Queue full, rejecting new item");
+        atomic_fetch_add(&queue->dropped, 1);
+        return false;
+    }
 
-        // Handle nanosecond overflow
-        if (timeout_time.tv_nsec >= 1000000000) {
-            timeout_time.tv_sec += 1;
-            timeout_time.tv_nsec -= 1000000000;
-        }
+    queue->buffer[tail % queue->size].item = new_work;
+    queue->buffer[tail % queue->size].free_fn = queue->free_fn;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
 
-        int result = pthread_cond_timedwait(&queue->not_empty, &queue->lock, &timeout_time);
-        if (result == ETIMEDOUT) {
-            // Timeout occurred, return NULL
-            pthread_mutex_unlock(&queue->lock);
-            return NULL;
-        }
+    uint32_t depth = queue_count(queue);
+    if (depth > queue->capacity)
+    {
+        advance_clear_to(queue, tail + 1 - queue->capacity);
+        atomic_fetch_add(&queue->dropped, 1);
+        depth = queue->capacity;
+    }
+    if (depth > atomic_load_explicit(&queue->high_water, memory_order_relaxed))
+    {
+        atomic_store_explicit(&queue->high_water, depth, memory_order_relaxed);
     }
 
-    void *next_work = queue->buffer[queue->head];
-    queue->head = (queue->head + 1) % QUEUE_SIZE;
-    queue->count--;
+    notify_consumer(queue);
+    return true;
+}
 
-    pthread_cond_signal(&queue->not_full);
-    pthread_mutex_unlock(&queue->lock);
+// Consumer side: free everything that was cleared or dropped
+static void drop_stale(work_queue *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    uint32_t clear_to = atomic_load_explicit(&queue->clear_to, memory_order_acquire);
 
-    return next_work;
+    while (index_before(head, clear_to))
+    {
+        free_slot(&queue->buffer[head % queue->size]);
+        head++;
+        atomic_store_explicit(&queue->head, head, memory_order_release);
+    }
 }
 
-void queue_clear(work_queue *queue)
+void *queue_dequeue_timeout(work_queue *queue, int timeout_ms)
 {
-    pthread_mutex_lock(&queue->lock);
+    if (queue->consumer == NULL)
+    {
+        queue->consumer = xTaskGetCurrentTaskHandle();
+    }
+
+    // esp_timer is monotonic, unlike the CLOCK_REALTIME deadline SNTP can move
+    int64_t deadline_us = esp_timer_get_time() + (int64_t)timeout_ms * 1000;
 
-    while (queue->count > 0)
+    while (1)
     {
-        void *next_work = queue->buffer[queue->head];
-        if (queue->free_fn) {
-            queue->free_fn(next_work);
-        } else {
-            free(next_work);
+        drop_stale(queue);
+
+        uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        if (head != atomic_load_explicit(&queue->tail, memory_order_acquire))
+        {
+            void *next_work = queue->buffer[head % queue->size].item;
+            queue->buffer[head % queue->size].item = NULL;
+            atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+            return next_work;
+        }
+
+        int64_t remaining_us = deadline_us - esp_timer_get_time();
+        if (remaining_us <= 0)
+        {
+            return NULL;
         }
-        queue->head = (queue->head + 1) % QUEUE_SIZE;
-        queue->count--;
+
+        // round up so a sub-tick remainder still blocks instead of spinning
+        TickType_t ticks = (remaining_us / 1000 + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        ulTaskNotifyTake(pdTRUE, ticks > 0 ? ticks : 1);
     }
+}
 
-    pthread_cond_signal(&queue->not_full);
-    pthread_mutex_unlock(&queue->lock);
+// Safe to call from any task; the consumer frees the cleared items
+void queue_clear(work_queue *queue)
+{
+    advance_clear_to(queue, atomic_load_explicit(&queue->tail, memory_order_acquire));
+    notify_consumer(queue);
 }
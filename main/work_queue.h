@@ -1,26 +1,45 @@
 #ifndef WORK_QUEUE_H
 #define WORK_QUEUE_H
 
-#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 
 #define QUEUE_SIZE 12
 
 typedef struct
 {
-    void *buffer[QUEUE_SIZE];
-    int head;
-    int tail;
-    int count;
-    pthread_mutex_t lock;
-    pthread_cond_t not_empty;
-    pthread_cond_t not_full;
+    void *item;
+    void (*free_fn)(void *); // free function captured at enqueue time
+} work_queue_slot;
+
+// Single-producer/single-consumer ring. Only the producer writes tail and only
+// the consumer writes head, so no lock is needed. Everything that removes items
+// (drop-oldest, clear) is requested by moving clear_to and carried out by the
+// consumer. The ring holds twice the capacity so the producer never has to wait
+// for a trim; the consumer wakes up through a task notification.
+typedef struct
+{
+    work_queue_slot *buffer;
+    uint32_t capacity;     // items visible to the consumer, older ones are dropped
+    uint32_t size;         // physical slots
+    atomic_uint head;      // next index to read, consumer only
+    atomic_uint tail;      // next index to write, producer only
+    atomic_uint clear_to;  // items below this index are stale
+    TaskHandle_t consumer; // notified on enqueue and clear
     void (*free_fn)(void *); // Protocol-specific free function for queue items
+
+    // statistics
+    atomic_uint high_water;
+    atomic_uint dropped;
 } work_queue;
 
-void queue_init(work_queue *queue);
-void queue_enqueue(work_queue *queue, void *new_work);
-void *queue_dequeue(work_queue *queue);
+void queue_init(work_queue *queue, uint32_t capacity);
+bool queue_enqueue(work_queue *queue, void *new_work);
 void *queue_dequeue_timeout(work_queue *queue, int timeout_ms);
 void queue_clear(work_queue *queue);
+uint32_t queue_count(work_queue *queue);
 
 #endif // WORK_QUEUE_H
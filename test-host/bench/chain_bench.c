@@ -0,0 +1,703 @@
+// End-to-end job pipeline benchmark against the simulated BM13xx chain.
+//
+// SERIAL_* is implemented here on top of bm13xx_sim with a virtual clock: the
+// clock jumps over idle waits and advances by the CPU time the host side
+// spends, so a minute of mining runs in a few seconds while UART transfer
+// times and host processing still show up in the latencies.
+//
+// The host side does what the firmware does: enumerate the chain with
+// count_asic_chips, build jobs with construct_bm_job and the driver packet
+// layouts, read results with receive_work and verify every nonce.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "asic_common.h"
+#include "bm1366.h"
+#include "bm1397.h"
+#include "bm13xx_sim.h"
+#include "crc.h"
+#include "mining.h"
+#include "serial.h"
+#include "utils.h"
+
+#define TYPE_CMD 0x40
+#define TYPE_JOB 0x20
+#define GROUP_ALL 0x10
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define VERSION_MASK 0x1fffe000
+#define MAX_LATENCY_SAMPLES (1 << 20)
+
+// ---------------------------------------------------------------------------
+// SERIAL_* on a virtual clock
+
+static bm13xx_sim *sim;
+static int64_t virtual_us;
+static int64_t wall_mark_ns;
+static int64_t rx_deadline_us = INT64_MAX; // SERIAL_rx returns early at the next dispatch
+
+// line noise on the response stream: one bit flipped every rx_noise_every bytes
+static uint32_t rx_noise_every;
+static uint64_t rx_noise_bytes;
+static uint64_t rx_noise_count;
+
+static int64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// charge the host work done since the last call to the virtual clock
+static void clock_sync(void)
+{
+    int64_t now_ns = wall_ns();
+    virtual_us += (now_ns - wall_mark_ns) / 1000;
+    wall_mark_ns = now_ns;
+}
+
+// time spent inside the simulator is chip time, not host time
+static void clock_resume(void)
+{
+    wall_mark_ns = wall_ns();
+}
+
+esp_err_t SERIAL_init(void)
+{
+    return ESP_OK;
+}
+
+bool SERIAL_is_initialized(void)
+{
+    return sim != NULL;
+}
+
+esp_err_t SERIAL_set_baud(int baud)
+{
+    clock_sync();
+    BM13XX_SIM_set_baud(sim, baud, virtual_us);
+    clock_resume();
+    return ESP_OK;
+}
+
+int SERIAL_send(uint8_t *data, int len, bool debug)
+{
+    (void)debug;
+    clock_sync();
+    BM13XX_SIM_write(sim, data, len, virtual_us);
+    clock_resume();
+    return len;
+}
+
+static void apply_rx_noise(uint8_t *buf, int len)
+{
+    if (rx_noise_every == 0) {
+        return;
+    }
+    for (int i = 0; i < len; i++) {
+        if (++rx_noise_bytes % rx_noise_every == 0) {
+            buf[i] ^= 1 << (rx_noise_bytes / rx_noise_every % 8);
+            rx_noise_count++;
+        }
+    }
+}
+
+int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+{
+    clock_sync();
+
+    int64_t timeout_us = virtual_us + (int64_t)timeout_ms * 1000;
+    int64_t deadline_us = timeout_us;
+    if (deadline_us > rx_deadline_us) {
+        deadline_us = rx_deadline_us > virtual_us ? rx_deadline_us : virtual_us;
+    }
+
+    int16_t bytes_read = 0;
+    while (1) {
+        bytes_read += BM13XX_SIM_read(sim, buf + bytes_read, size - bytes_read, virtual_us);
+        if (bytes_read == size || virtual_us >= timeout_us) {
+            break;
+        }
+        // never cut a frame that is already on the wire
+        if (virtual_us >= deadline_us) {
+            if (bytes_read == 0) {
+                break;
+            }
+            deadline_us = timeout_us;
+        }
+        int64_t next_us = BM13XX_SIM_next_event_us(sim, virtual_us);
+        virtual_us = next_us < deadline_us ? next_us : deadline_us;
+    }
+
+    apply_rx_noise(buf, bytes_read);
+    clock_resume();
+    return bytes_read;
+}
+
+int16_t SERIAL_rx_available(uint8_t *buf, uint16_t min_size, uint16_t max_size, uint16_t timeout_ms)
+{
+    int16_t bytes_read = SERIAL_rx(buf, min_size, timeout_ms);
+    if (bytes_read != min_size || max_size <= min_size) {
+        return bytes_read;
+    }
+
+    clock_sync();
+    int extra = BM13XX_SIM_read(sim, buf + bytes_read, max_size - bytes_read, virtual_us);
+    apply_rx_noise(buf + bytes_read, extra);
+    clock_resume();
+    return bytes_read + extra;
+}
+
+void SERIAL_clear_buffer(void)
+{
+    clock_sync();
+    BM13XX_SIM_flush(sim, virtual_us);
+    clock_resume();
+}
+
+void SERIAL_debug_rx(void)
+{
+}
+
+// ---------------------------------------------------------------------------
+// Chain control, as the drivers do it
+
+typedef struct
+{
+    uint16_t chip_id;
+    uint16_t chip_count;
+    uint8_t core_count;
+    double hashrate_ghs;
+    double ticket_difficulty;
+    uint8_t share_bits;
+    uint32_t baud;
+    double job_interval_ms;
+    double duration_s;
+    uint32_t corrupt_every;
+    uint32_t rx_noise_every;
+    uint32_t seed;
+    const char *json_path;
+} bench_options;
+
+static void send_command(uint8_t header, const uint8_t *data, uint8_t data_len)
+{
+    uint8_t buf[16];
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+    buf[2] = header;
+    buf[3] = data_len + 3;
+    memcpy(buf + 4, data, data_len);
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    SERIAL_send(buf, data_len + 5, false);
+}
+
+static bool is_bm1397(const bench_options *options)
+{
+    return options->chip_id == 0x1397;
+}
+
+static int response_length(const bench_options *options)
+{
+    return is_bm1397(options) ? 9 : 11;
+}
+
+static uint8_t next_job_id(const bench_options *options, uint8_t id)
+{
+    switch (options->chip_id) {
+        case 0x1397: return (id + 4) % 128;
+        case 0x1366: return (id + 8) % 128;
+        default:     return (id + 24) % 128;
+    }
+}
+
+static void prepare_job(const bench_options *options, const bm_job *job, uint8_t job_id, asic_job_packet *packet)
+{
+    if (is_bm1397(options)) {
+        static const bm_job_format bm1397 = { .max_midstates = BM_JOB_MAX_MIDSTATES };
+        construct_bm_job_midstates(job, &bm1397, &packet->midstates);
+
+        job_packet data;
+        data.job_id = job_id;
+        data.num_midstates = packet->midstates.num_midstates;
+        memcpy(data.starting_nonce, &job->starting_nonce, 4);
+        memcpy(data.nbits, &job->target, 4);
+        memcpy(data.ntime, &job->ntime, 4);
+        memcpy(data.merkle4, job->merkle_root, 4);
+        memcpy(data.midstate, packet->midstates.midstate[0], 32);
+        memcpy(data.midstate1, packet->midstates.midstate[1], 32);
+        memcpy(data.midstate2, packet->midstates.midstate[2], 32);
+        memcpy(data.midstate3, packet->midstates.midstate[3], 32);
+        int data_len = data.num_midstates == 4 ? sizeof(job_packet) : sizeof(job_packet) - 96;
+        build_job_packet(packet, TYPE_JOB | CMD_WRITE, (uint8_t *)&data, data_len, false);
+    } else {
+        BM1366_job data;
+        data.job_id = job_id;
+        data.num_midstates = 0x01;
+        memcpy(data.starting_nonce, &job->starting_nonce, 4);
+        memcpy(data.nbits, &job->target, 4);
+        memcpy(data.ntime, &job->ntime, 4);
+        memcpy(data.merkle_root, job->merkle_root, 32);
+        memcpy(data.prev_block_hash, job->prev_block_hash, 32);
+        memcpy(data.version, &job->version, 4);
+        build_job_packet(packet, TYPE_JOB | CMD_WRITE, (uint8_t *)&data, sizeof(BM1366_job), false);
+    }
+    packet->job_id = job_id;
+}
+
+static void read_counters(const bench_options *options)
+{
+    if (is_bm1397(options)) {
+        send_command(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x04}, 2);
+    } else {
+        send_command(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x8C}, 2);
+    }
+    send_command(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x4C}, 2);
+}
+
+// ---------------------------------------------------------------------------
+// Results
+
+typedef struct
+{
+    uint64_t jobs_sent;
+    uint64_t nonces;
+    uint64_t nonces_valid;
+    uint64_t nonces_stale;       // for a job that has since been replaced
+    uint64_t nonces_invalid_job; // job id never sent
+    uint64_t nonces_bad_hash;    // hash does not reach the share target
+    uint64_t register_reads;
+    uint64_t rx_errors;
+    uint32_t chain_errors;       // sum of the chips' error counters
+    double counter_ghs;          // hashrate from the chip counters
+
+    int64_t host_job_ns;         // building and sending jobs
+    int64_t host_nonce_ns;       // decoding and verifying results
+
+    int64_t *latency_us;
+    size_t latency_count;
+} bench_results;
+
+static int compare_int64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int64_t percentile(const bench_results *results, double p)
+{
+    if (results->latency_count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(p * (results->latency_count - 1));
+    return results->latency_us[index];
+}
+
+static void handle_register(const bench_options *options, const uint8_t *frame, bench_results *results,
+                            uint32_t *first_count, int64_t *first_time_us)
+{
+    uint32_t value = ((uint32_t)frame[2] << 24) | ((uint32_t)frame[3] << 16) | ((uint32_t)frame[4] << 8) | frame[5];
+    uint8_t reg = frame[7];
+    results->register_reads++;
+
+    switch (reg) {
+        case 0x04:
+            results->counter_ghs = (value & 0x7FFFFFFF) * (double)0x100000 * options->chip_count / 1e9;
+            break;
+        case 0x8C:
+            // only chip 0 is tracked, the model hashes evenly
+            if (frame[6] != 0) {
+                break;
+            }
+            if (*first_time_us == 0) {
+                *first_count = value;
+                *first_time_us = virtual_us;
+            } else if (virtual_us > *first_time_us) {
+                double seconds = (virtual_us - *first_time_us) / 1e6;
+                results->counter_ghs = (uint32_t)(value - *first_count) * 4294967296.0 / seconds / 1e9 * options->chip_count;
+            }
+            break;
+        case 0x4C:
+            if (frame[6] == 0) {
+                results->chain_errors = 0;
+            }
+            results->chain_errors += value;
+            break;
+    }
+}
+
+static void handle_nonce(const bench_options *options, const uint8_t *frame, const bm_job *jobs, const bool *sent,
+                         uint8_t current_job_id, bench_results *results)
+{
+    uint8_t id = frame[7];
+    uint8_t job_id;
+    uint8_t midstate_index = 0;
+    uint32_t version_bits = 0;
+
+    if (is_bm1397(options)) {
+        job_id = id & 0xfc;
+        midstate_index = id & 0x03;
+    } else {
+        job_id = options->chip_id == 0x1366 ? (id & 0xf8) : ((id & 0xf0) >> 1);
+        version_bits = ((frame[8] << 8) | frame[9]) << 13;
+    }
+
+    results->nonces++;
+    if (!sent[job_id]) {
+        results->nonces_invalid_job++;
+        return;
+    }
+
+    const bm_job *job = &jobs[job_id];
+    uint32_t rolled_version = job->version | version_bits;
+    for (int i = 0; i < midstate_index; i++) {
+        rolled_version = increment_bitmask(rolled_version, job->version_mask);
+    }
+
+    uint32_t nonce;
+    memcpy(&nonce, frame + 2, 4);
+    double diff = test_nonce_value(job, nonce, rolled_version);
+    // a hash with n leading zero bits is worth at least about 2^(n-32)
+    if (diff < ldexp(0.999, options->share_bits - 32)) {
+        results->nonces_bad_hash++;
+    } else if (job_id != current_job_id) {
+        results->nonces_stale++;
+    } else {
+        results->nonces_valid++;
+    }
+}
+
+static int run(const bench_options *options, bench_results *results)
+{
+    bm13xx_sim_config config = {
+        .chip_id = options->chip_id,
+        .chip_count = options->chip_count,
+        .core_count = options->core_count,
+        .hashrate_ghs = options->hashrate_ghs,
+        .share_bits = options->share_bits,
+        .baud = 115200,
+        .seed = options->seed,
+    };
+    virtual_us = 0;
+    clock_resume();
+    sim = BM13XX_SIM_create(&config, 0);
+    if (sim == NULL) {
+        return 1;
+    }
+
+    // enumerate like the drivers: read the chip ID register on every chip
+    send_command(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x00}, 2);
+    int chip_counter = count_asic_chips(options->chip_count, options->chip_id, response_length(options));
+    if (chip_counter != options->chip_count) {
+        fprintf(stderr, "enumeration found %d of %d chips\n", chip_counter, options->chip_count);
+        return 1;
+    }
+
+    send_command(TYPE_CMD | GROUP_ALL | CMD_INACTIVE, (uint8_t[]){0x00, 0x00}, 2);
+    int address_interval = 256 / chip_counter;
+    for (int i = 0; i < chip_counter; i++) {
+        send_command(TYPE_CMD | CMD_SETADDRESS, (uint8_t[]){i * address_interval, 0x00}, 2);
+    }
+
+    uint16_t versions_to_roll = VERSION_MASK >> 13;
+    send_command(TYPE_CMD | GROUP_ALL | CMD_WRITE,
+                 (uint8_t[]){0x00, 0xA4, 0x90, 0x00, versions_to_roll >> 8, versions_to_roll & 0xFF}, 6);
+
+    uint8_t difficulty_mask[6];
+    get_difficulty_mask(options->ticket_difficulty, difficulty_mask);
+    send_command(TYPE_CMD | GROUP_ALL | CMD_WRITE, difficulty_mask, 6);
+
+    SERIAL_set_baud(options->baud);
+    rx_noise_every = options->rx_noise_every;
+
+    // job source: one notify, extranonce_2 rolled per job
+    uint8_t merkle_branches[12][32];
+    for (int i = 0; i < 12; i++) {
+        for (int j = 0; j < 32; j++) {
+            merkle_branches[i][j] = (uint8_t)(i * 32 + j);
+        }
+    }
+    coinbase_template tmpl;
+    coinbase_template_init_hex(&tmpl,
+        "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b0389130cfabe6d6d5cbab26a2599e92916edec5657a94a0708ddb970f5c45b5d12905085617eff8e",
+        "31650707758de07b010000000000001cfd7038212f736c7573682f000000000379ad0c2a000000001976a9147c154ed1dc59609e3d26abb2df2ea3d587cd8c4188ac00000000000000002c6a4c2952534b424c4f434b3ae725d3994b811572c1f345deb98b56b465ef8e153ecbbd27fa37bf1b005161380000000000000000266a24aa21a9ed63b06a7946b190a3fda1d76165b25c9b883bcc6621b040773050ee2a1bb18f1800000000",
+        "01000000", 8, (const uint8_t (*)[32])merkle_branches, 12);
+
+    mining_notify notify = {
+        .job_id = "1b4c3d9041",
+        .prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000",
+        .version = 0x20000004,
+        .target = 0x1705ae3a,
+        .ntime = 0x646ff1a9,
+    };
+
+    static bm_job jobs[128];
+    static bool sent[128];
+    uint8_t job_id = 0;
+    uint64_t extranonce_2 = 0;
+
+    uint32_t first_count = 0;
+    int64_t first_count_us = 0;
+    int64_t start_us = virtual_us;
+    int64_t end_us = start_us + (int64_t)(options->duration_s * 1e6);
+    int64_t job_interval_us = (int64_t)(options->job_interval_ms * 1000);
+    int64_t next_job_us = start_us;
+    int64_t next_poll_us = start_us + 1000000;
+    int frame_len = response_length(options);
+
+    clock_resume();
+    while (1) {
+        clock_sync();
+        if (virtual_us >= end_us) {
+            break;
+        }
+
+        if (virtual_us >= next_job_us) {
+            int64_t t0 = wall_ns();
+            job_id = next_job_id(options, job_id);
+
+            uint8_t merkle_root[32];
+            coinbase_template_merkle_root(&tmpl, (const uint8_t *)&extranonce_2, merkle_root);
+            extranonce_2++;
+
+            construct_bm_job(&notify, merkle_root, VERSION_MASK, 1000, &jobs[job_id]);
+            sent[job_id] = true;
+
+            asic_job_packet packet;
+            prepare_job(options, &jobs[job_id], job_id, &packet);
+            if (options->corrupt_every && (results->jobs_sent + 1) % options->corrupt_every == 0) {
+                packet.buf[packet.len / 2] ^= 0x01;
+            }
+            results->host_job_ns += wall_ns() - t0;
+
+            SERIAL_send(packet.buf, packet.len, false);
+            results->jobs_sent++;
+            next_job_us += job_interval_us;
+            if (next_job_us < virtual_us) {
+                next_job_us = virtual_us + job_interval_us;
+            }
+            continue;
+        }
+
+        if (virtual_us >= next_poll_us) {
+            read_counters(options);
+            next_poll_us += 1000000;
+            continue;
+        }
+
+        rx_deadline_us = next_job_us < next_poll_us ? next_job_us : next_poll_us;
+        if (rx_deadline_us > end_us) {
+            rx_deadline_us = end_us;
+        }
+
+        uint8_t frame[11];
+        if (receive_work(frame, frame_len, NULL) != ESP_OK) {
+            // a timeout at the deadline is expected, anything else is not
+            if (virtual_us < rx_deadline_us) {
+                results->rx_errors++;
+            }
+            continue;
+        }
+
+        int64_t t0 = wall_ns();
+        if (frame[frame_len - 1] & 0x80) {
+            int64_t latency_us = virtual_us - BM13XX_SIM_last_frame_emitted_us(sim);
+            if (results->latency_count < MAX_LATENCY_SAMPLES) {
+                results->latency_us[results->latency_count++] = latency_us;
+            }
+            handle_nonce(options, frame, jobs, sent, job_id, results);
+        } else {
+            handle_register(options, frame, results, &first_count, &first_count_us);
+        }
+        results->host_nonce_ns += wall_ns() - t0;
+    }
+    rx_deadline_us = INT64_MAX;
+
+    coinbase_template_free(&tmpl);
+    return 0;
+}
+
+static bool write_json(const char *path, const bench_options *options, const bench_results *results,
+                       const bm13xx_sim_stats *stats, double seconds)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"chip_id\": \"%04x\",\n  \"chip_count\": %d,\n  \"hashrate_ghs\": %.1f,\n",
+            options->chip_id, options->chip_count, options->hashrate_ghs);
+    fprintf(f, "  \"ticket_difficulty\": %.0f,\n  \"baud\": %u,\n  \"job_interval_ms\": %.3f,\n",
+            options->ticket_difficulty, options->baud, options->job_interval_ms);
+    fprintf(f, "  \"simulated_seconds\": %.3f,\n", seconds);
+    fprintf(f, "  \"jobs_sent\": %llu,\n  \"jobs_per_second\": %.2f,\n",
+            (unsigned long long)results->jobs_sent, results->jobs_sent / seconds);
+    fprintf(f, "  \"nonces\": %llu,\n  \"nonces_per_second\": %.2f,\n",
+            (unsigned long long)results->nonces, results->nonces / seconds);
+    fprintf(f, "  \"nonces_valid\": %llu,\n  \"nonces_stale\": %llu,\n  \"nonces_invalid_job\": %llu,\n  \"nonces_bad_hash\": %llu,\n",
+            (unsigned long long)results->nonces_valid, (unsigned long long)results->nonces_stale,
+            (unsigned long long)results->nonces_invalid_job, (unsigned long long)results->nonces_bad_hash);
+    fprintf(f, "  \"latency_us_p50\": %lld,\n  \"latency_us_p99\": %lld,\n  \"latency_us_max\": %lld,\n",
+            (long long)percentile(results, 0.5), (long long)percentile(results, 0.99),
+            (long long)percentile(results, 1.0));
+    fprintf(f, "  \"counter_hashrate_ghs\": %.1f,\n  \"chain_error_count\": %u,\n",
+            results->counter_ghs, results->chain_errors);
+    fprintf(f, "  \"host_ns_per_job\": %.1f,\n  \"host_ns_per_result\": %.1f,\n",
+            results->jobs_sent ? (double)results->host_job_ns / results->jobs_sent : 0.0,
+            (results->nonces + results->register_reads) ? (double)results->host_nonce_ns / (results->nonces + results->register_reads) : 0.0);
+    fprintf(f, "  \"rx_errors\": %llu,\n  \"sim_crc_errors\": %u,\n  \"sim_frames_dropped\": %u,\n  \"sim_search_misses\": %u\n",
+            (unsigned long long)results->rx_errors, stats->crc_errors, stats->frames_dropped, stats->search_misses);
+    fprintf(f, "}\n");
+    return fclose(f) == 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--chip 1366|1368|1370|1397] [--chips <n>] [--cores <n>] [--hashrate <GH/s>]\n"
+            "          [--ticket <difficulty>] [--share-bits <n>] [--baud <n>] [--job-interval <ms>]\n"
+            "          [--duration <s>] [--corrupt-every <n>] [--rx-noise <n>] [--seed <n>] [--json <file>]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    bench_options options = {
+        .chip_id = 0x1370,
+        .chip_count = 1,
+        .core_count = 128,
+        .hashrate_ghs = 1000,
+        .ticket_difficulty = 256,
+        .share_bits = 8,
+        .baud = 1000000,
+        .job_interval_ms = 500,
+        .duration_s = 60,
+        .seed = 1,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+
+        if (strcmp(arg, "--chip") == 0) {
+            options.chip_id = (uint16_t)strtoul(value, NULL, 16);
+        } else if (strcmp(arg, "--chips") == 0) {
+            options.chip_count = atoi(value);
+        } else if (strcmp(arg, "--cores") == 0) {
+            options.core_count = atoi(value);
+        } else if (strcmp(arg, "--hashrate") == 0) {
+            options.hashrate_ghs = atof(value);
+        } else if (strcmp(arg, "--ticket") == 0) {
+            options.ticket_difficulty = atof(value);
+        } else if (strcmp(arg, "--share-bits") == 0) {
+            options.share_bits = atoi(value);
+        } else if (strcmp(arg, "--baud") == 0) {
+            options.baud = strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--job-interval") == 0) {
+            options.job_interval_ms = atof(value);
+        } else if (strcmp(arg, "--duration") == 0) {
+            options.duration_s = atof(value);
+        } else if (strcmp(arg, "--corrupt-every") == 0) {
+            options.corrupt_every = strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--rx-noise") == 0) {
+            options.rx_noise_every = strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            options.seed = strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--json") == 0) {
+            options.json_path = value;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (options.job_interval_ms <= 0 || options.duration_s <= 0 || options.baud == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    bench_results results = {0};
+    results.latency_us = malloc(sizeof(int64_t) * MAX_LATENCY_SAMPLES);
+    if (results.latency_us == NULL) {
+        return 1;
+    }
+
+    int64_t wall_start_ns = wall_ns();
+    int ret = run(&options, &results);
+    double wall_s = (wall_ns() - wall_start_ns) / 1e9;
+    if (ret != 0) {
+        BM13XX_SIM_free(sim);
+        free(results.latency_us);
+        return ret;
+    }
+
+    bm13xx_sim_stats stats;
+    BM13XX_SIM_get_stats(sim, &stats);
+    qsort(results.latency_us, results.latency_count, sizeof(int64_t), compare_int64);
+
+    double seconds = options.duration_s;
+    printf("BM%04x x%d, %.0f GH/s, ticket %.0f, %u baud, job every %.1f ms, %.0f s simulated in %.2f s\n",
+           options.chip_id, options.chip_count, options.hashrate_ghs, options.ticket_difficulty, options.baud,
+           options.job_interval_ms, seconds, wall_s);
+    printf("jobs:      %llu (%.1f/s), %.0f ns host time each\n", (unsigned long long)results.jobs_sent,
+           results.jobs_sent / seconds, results.jobs_sent ? (double)results.host_job_ns / results.jobs_sent : 0.0);
+    printf("nonces:    %llu (%.1f/s): %llu valid, %llu stale, %llu invalid job, %llu bad hash\n",
+           (unsigned long long)results.nonces, results.nonces / seconds, (unsigned long long)results.nonces_valid,
+           (unsigned long long)results.nonces_stale, (unsigned long long)results.nonces_invalid_job,
+           (unsigned long long)results.nonces_bad_hash);
+    printf("latency:   p50 %lld us, p99 %lld us, max %lld us (chip to host)\n",
+           (long long)percentile(&results, 0.5), (long long)percentile(&results, 0.99),
+           (long long)percentile(&results, 1.0));
+    printf("counters:  %.1f GH/s, %u chain errors, %llu register reads\n", results.counter_ghs,
+           results.chain_errors, (unsigned long long)results.register_reads);
+    printf("sim:       %u nonces, %u jobs, %u commands, %u CRC errors, %u frames dropped, %u search misses, %llu rx errors\n",
+           stats.nonces_returned, stats.jobs_received, stats.commands_received, stats.crc_errors, stats.frames_dropped,
+           stats.search_misses, (unsigned long long)results.rx_errors);
+
+
+    // frames handed to the host that receive_work did not return; the chip ID
+    // responses are read by count_asic_chips
+    uint32_t decoder_crc_errors = 0, decoder_resyncs = 0;
+    for (int i = 0; i < ASIC_RX_MAX_CHIPS; i++) {
+        asic_rx_stats rx;
+        get_asic_rx_stats(i, &rx);
+        decoder_crc_errors += rx.crc_errors;
+        decoder_resyncs += rx.resyncs;
+    }
+    int64_t frames_lost = (int64_t)(stats.bytes_out / response_length(&options)) - options.chip_count -
+                          (int64_t)(results.nonces + results.register_reads);
+    printf("decoder:   %u CRC errors, %u resyncs, %u bytes skipped, %lld frames lost to %llu noise bits\n",
+           decoder_crc_errors, decoder_resyncs, get_asic_rx_skipped_bytes(), (long long)frames_lost,
+           (unsigned long long)rx_noise_count);
+
+    if (options.json_path != NULL && !write_json(options.json_path, &options, &results, &stats, seconds)) {
+        ret = 1;
+    }
+
+    // without injected corruption every nonce has to check out, with line
+    // noise a flipped bit may cost the frame it lands in but nothing more
+    if (results.nonces_bad_hash > 0 || results.nonces_invalid_job > 0 ||
+        (options.corrupt_every == 0 && (stats.crc_errors > 0 || results.rx_errors > 0)) ||
+        frames_lost > (int64_t)rx_noise_count) {
+        fprintf(stderr, "pipeline errors detected\n");
+        ret = 1;
+    }
+
+    BM13XX_SIM_free(sim);
+    free(results.latency_us);
+    return ret;
+}
@@ -0,0 +1,428 @@
+// Host microbenchmarks for the mining hot path.
+//
+// Every benchmark is run for at least --min-time ms per repetition, the best
+// and median ns/op over the repetitions are reported together with the heap
+// allocations the code under test made per op. --json writes the same numbers
+// in a machine-readable form so runs can be compared.
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc.h"
+#include "mining.h"
+#include "stratum_api.h"
+#include "stratum_json_fast.h"
+#include "utils.h"
+
+#define REPETITIONS_MAX 32
+
+// Allocation counting. The stratum sources are linked with --wrap so only their
+// allocations are counted, not the ones made by libc or the harness itself.
+static uint64_t alloc_count;
+static uint64_t alloc_bytes;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+#endif
+
+// Results are folded in here so the compiler cannot drop the work
+static volatile uint32_t sink;
+
+static void consume(const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    uint32_t acc = 0;
+    for (size_t i = 0; i < len; i++) {
+        acc = acc * 31 + p[i];
+    }
+    sink += acc;
+}
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// ---------------------------------------------------------------------------
+// Fixtures, taken from the stratum unit tests
+
+static const char *NOTIFY_JSON =
+    "{\"id\":null,\"method\":\"mining.notify\",\"params\":"
+    "[\"1b4c3d9041\","
+    "\"ef4b9a48c7986466de4adc002f7337a6e121bc43000376ea0000000000000000\","
+    "\"01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b03a5020cfabe6d6d379ae882651f6469f2ed6b8b40a4f9a4b41fd838a3ad6de8cba775f4e8f1d3080100000000000000\","
+    "\"41903d4c1b2f736c7573682f0000000003ca890d27000000001976a9147c154ed1dc59609e3d26abb2df2ea3d587cd8c4188ac00000000000000002c6a4c2952534b424c4f434b3a4cb4cb2ddfc37c41baf5ef6b6b4899e3253a8f1dfc7e5dd68a5b5b27005014ef0000000000000000266a24aa21a9ed5caa249f1af9fbf71c986fea8e076ca34ae3514fb2f86400561b28c7b15949bf00000000\","
+    "[\"ae23055e00f0f697cc3640124812d96d4fe8bdfa03484c1c638ce5a1c0e9aa81\",\"980fb87cb61021dd7afd314fcb0dabd096f3d56a7377f6f320684652e7410a21\","
+    "\"a52e9868343c55ce405be8971ff340f562ae9ab6353f07140d01666180e19b52\",\"7435bdfa004e603953b2ed39f118803934d9cf17b06d979ceb682f2251bafac2\","
+    "\"2a91f061a22d27cb8f44eea79938fb241ebeb359891aa907f05ffde7ed44e52e\",\"302401f80eb5e958155135e25200bb8ea181ad2d05e804a531c7314d86403cdc\","
+    "\"318ecb6161eb9b4cfd802bd730e2d36c167ddf102e70aa7b4158e2870dd47392\",\"1114332a9858e0cf84b2425bb1e59eaabf91dd102d114aa443d57fc1b3beb0c9\","
+    "\"f43f38095c810613ed795a44d9fab02ff25269706f454885db9be05cdf9c06e1\",\"3e2fc26b27fddc39668b59099cd9635761bb72ed92404204e12bdff08b16fb75\","
+    "\"463c19427286342120039a83218fa87ce45448e246895abac11fff0036076758\",\"03d287f655813e540ddb9c4e7aeb922478662b0f5d8e9d0cbd564b20146bab76\"],"
+    "\"20000004\",\"1705c739\",\"64495522\",false]}";
+
+static const char *SET_DIFFICULTY_JSON = "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[4096]}";
+static const char *SHARE_RESULT_JSON = "{\"id\":42,\"result\":true,\"error\":null}";
+
+static const char *HASH_HEX = "6d0359c451434605c52a5a9ce074340be47c2c63840731f9edf1db3f26b1cdd9";
+
+static uint8_t header[80];
+static uint8_t hash_bin[32];
+static char hash_hex[65];
+static uint8_t job_packet[86];
+static uint8_t merkle_branches[12][32];
+static coinbase_template tmpl;
+static mining_notify notify;
+static bm_job job;
+static nonce_midstate_cache nonce_cache;
+static uint32_t nonce;
+static uint64_t extranonce_2;
+
+static void setup_fixtures(void)
+{
+    for (size_t i = 0; i < sizeof(header); i++) {
+        header[i] = (uint8_t)(i * 7 + 3);
+    }
+    for (size_t i = 0; i < sizeof(job_packet); i++) {
+        job_packet[i] = (uint8_t)(i * 13 + 1);
+    }
+    for (int i = 0; i < 12; i++) {
+        for (int j = 0; j < 32; j++) {
+            merkle_branches[i][j] = (uint8_t)(i * 32 + j);
+        }
+    }
+    hex2bin(HASH_HEX, hash_bin, 32);
+
+    coinbase_template_init_hex(&tmpl,
+        "01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff4b0389130cfabe6d6d5cbab26a2599e92916edec5657a94a0708ddb970f5c45b5d12905085617eff8e",
+        "31650707758de07b010000000000001cfd7038212f736c7573682f000000000379ad0c2a000000001976a9147c154ed1dc59609e3d26abb2df2ea3d587cd8c4188ac00000000000000002c6a4c2952534b424c4f434b3ae725d3994b811572c1f345deb98b56b465ef8e153ecbbd27fa37bf1b005161380000000000000000266a24aa21a9ed63b06a7946b190a3fda1d76165b25c9b883bcc6621b040773050ee2a1bb18f1800000000",
+        "01000000", 8, (const uint8_t (*)[32])merkle_branches, 12);
+
+    notify.prev_block_hash = "d02b10fc0d4711eae1a805af50a8a83312a2215e00017f2b0000000000000000";
+    notify.version = 0x20000004;
+    notify.target = 0x1705ae3a;
+    notify.ntime = 0x646ff1a9;
+    notify.job_id = "1b4c3d9041";
+    construct_bm_job(&notify, hash_bin, 0x1fffe000, 1000, &job);
+    nonce_midstate_cache_init(&nonce_cache);
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+
+static void bench_double_sha256_bin(void)
+{
+    header[76] = (uint8_t)nonce++;
+    double_sha256_bin(header, sizeof(header), hash_bin);
+    consume(hash_bin, 4);
+}
+
+static void bench_midstate_sha256_bin(void)
+{
+    header[0] = (uint8_t)nonce++;
+    midstate_sha256_bin(header, 64, hash_bin);
+    consume(hash_bin, 4);
+}
+
+static void bench_calculate_merkle_root_hash(void)
+{
+    uint8_t root[32];
+    hash_bin[0] = (uint8_t)nonce++;
+    calculate_merkle_root_hash(hash_bin, (const uint8_t (*)[32])merkle_branches, 12, root);
+    consume(root, 4);
+}
+
+static void bench_coinbase_template_merkle_root(void)
+{
+    uint8_t root[32];
+    uint64_t en2 = extranonce_2++;
+    coinbase_template_merkle_root(&tmpl, (const uint8_t *)&en2, root);
+    consume(root, 4);
+}
+
+static void bench_construct_bm_job(void)
+{
+    bm_job new_job;
+    notify.ntime++;
+    construct_bm_job(&notify, hash_bin, 0x1fffe000, 1000, &new_job);
+    consume(new_job.prev_block_hash, 4);
+}
+
+static void bench_construct_bm_job_midstates(void)
+{
+    static const bm_job_format bm1397 = { .max_midstates = BM_JOB_MAX_MIDSTATES };
+    bm_job_midstates midstates;
+    construct_bm_job_midstates(&job, &bm1397, &midstates);
+    consume(midstates.midstate[3], 4);
+}
+
+static void bench_test_nonce_value(void)
+{
+    double diff = test_nonce_value(&job, nonce++, job.version);
+    consume(&diff, sizeof(diff));
+}
+
+static void bench_test_nonce_value_cached(void)
+{
+    double diff = test_nonce_value_cached(&nonce_cache, &job, nonce++, job.version, 1000);
+    consume(&diff, sizeof(diff));
+}
+
+static void bench_hex2bin(void)
+{
+    hex2bin(HASH_HEX, hash_bin, 32);
+    consume(hash_bin, 4);
+}
+
+static void bench_bin2hex(void)
+{
+    hash_bin[0] = (uint8_t)nonce++;
+    bin2hex(hash_bin, 32, hash_hex, sizeof(hash_hex));
+    consume(hash_hex, 4);
+}
+
+static void bench_crc16_false(void)
+{
+    job_packet[0] = (uint8_t)nonce++;
+    uint16_t crc = crc16_false(job_packet, sizeof(job_packet));
+    consume(&crc, sizeof(crc));
+}
+
+static void bench_crc5(void)
+{
+    uint8_t cmd[4] = { 0x52, 0x05, 0x00, (uint8_t)nonce++ };
+    uint8_t crc = crc5(cmd, 4);
+    consume(&crc, sizeof(crc));
+}
+
+static void bench_parse_notify(void)
+{
+    StratumApiV1Message message = { 0 };
+    if (STRATUM_V1_parse_fast(&message, NOTIFY_JSON)) {
+        consume(message.mining_notification->merkle_branches, 4);
+        STRATUM_V1_free_mining_notify(message.mining_notification);
+    }
+}
+
+static void bench_parse_set_difficulty(void)
+{
+    StratumApiV1Message message = { 0 };
+    STRATUM_V1_parse_fast(&message, SET_DIFFICULTY_JSON);
+    consume(&message.new_difficulty, sizeof(message.new_difficulty));
+}
+
+static void bench_parse_share_result(void)
+{
+    StratumApiV1Message message = { 0 };
+    STRATUM_V1_parse_fast(&message, SHARE_RESULT_JSON);
+    consume(&message.response_success, sizeof(message.response_success));
+}
+
+typedef struct
+{
+    const char *name;
+    void (*fn)(void);
+} benchmark;
+
+static const benchmark benchmarks[] = {
+    { "double_sha256_bin/80", bench_double_sha256_bin },
+    { "midstate_sha256_bin/64", bench_midstate_sha256_bin },
+    { "calculate_merkle_root_hash/12", bench_calculate_merkle_root_hash },
+    { "coinbase_template_merkle_root/12", bench_coinbase_template_merkle_root },
+    { "construct_bm_job", bench_construct_bm_job },
+    { "construct_bm_job_midstates/4", bench_construct_bm_job_midstates },
+    { "test_nonce_value", bench_test_nonce_value },
+    { "test_nonce_value_cached", bench_test_nonce_value_cached },
+    { "hex2bin/32", bench_hex2bin },
+    { "bin2hex/32", bench_bin2hex },
+    { "crc16_false/86", bench_crc16_false },
+    { "crc5/4", bench_crc5 },
+    { "STRATUM_V1_parse/mining.notify", bench_parse_notify },
+    { "STRATUM_V1_parse/mining.set_difficulty", bench_parse_set_difficulty },
+    { "STRATUM_V1_parse/result", bench_parse_share_result },
+};
+
+#define BENCHMARK_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+// ---------------------------------------------------------------------------
+// Runner
+
+typedef struct
+{
+    const char *name;
+    uint64_t iterations;
+    double ns_per_op_min;
+    double ns_per_op_median;
+    double allocs_per_op;
+    double bytes_per_op;
+} bench_result;
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int64_t time_iterations(void (*fn)(void), uint64_t iterations)
+{
+    int64_t start = now_ns();
+    for (uint64_t i = 0; i < iterations; i++) {
+        fn();
+    }
+    return now_ns() - start;
+}
+
+static bench_result run_benchmark(const benchmark *b, int64_t min_time_ns, int repetitions)
+{
+    bench_result result = { .name = b->name };
+
+    // grow the iteration count until one repetition takes at least min_time
+    uint64_t iterations = 1;
+    while (1) {
+        int64_t elapsed = time_iterations(b->fn, iterations);
+        if (elapsed >= min_time_ns || iterations >= (1ULL << 40)) {
+            break;
+        }
+        uint64_t next = elapsed > 0 ? (uint64_t)((double)iterations * min_time_ns * 1.2 / elapsed) : iterations * 100;
+        if (next > iterations * 100) {
+            next = iterations * 100;
+        }
+        iterations = next > iterations ? next : iterations + 1;
+    }
+
+    double samples[REPETITIONS_MAX];
+    uint64_t allocs_before = alloc_count;
+    uint64_t bytes_before = alloc_bytes;
+    for (int r = 0; r < repetitions; r++) {
+        samples[r] = (double)time_iterations(b->fn, iterations) / (double)iterations;
+    }
+    uint64_t total_ops = iterations * (uint64_t)repetitions;
+
+    qsort(samples, repetitions, sizeof(samples[0]), compare_double);
+    result.iterations = iterations;
+    result.ns_per_op_min = samples[0];
+    result.ns_per_op_median = samples[repetitions / 2];
+    result.allocs_per_op = (double)(alloc_count - allocs_before) / (double)total_ops;
+    result.bytes_per_op = (double)(alloc_bytes - bytes_before) / (double)total_ops;
+    return result;
+}
+
+static bool write_json(const char *path, const bench_result *results, size_t count)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "{\n  \"allocs_counted\": %s,\n  \"benchmarks\": [\n",
+#ifdef BENCH_COUNT_ALLOCS
+            "true"
+#else
+            "false"
+#endif
+    );
+    for (size_t i = 0; i < count; i++) {
+        fprintf(f,
+                "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.2f, \"ns_per_op_median\": %.2f, "
+                "\"allocs_per_op\": %.3f, \"bytes_per_op\": %.1f}%s\n",
+                results[i].name, (unsigned long long)results[i].iterations, results[i].ns_per_op_min,
+                results[i].ns_per_op_median, results[i].allocs_per_op, results[i].bytes_per_op,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--filter <substring>] [--min-time <ms>] [--repetitions <n>] [--json <file>] [--quick] [--list]\n",
+            argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *json_path = NULL;
+    int64_t min_time_ms = 100;
+    int repetitions = 5;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time_ms = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            repetitions = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            min_time_ms = 1;
+            repetitions = 1;
+        } else if (strcmp(argv[i], "--list") == 0) {
+            for (size_t b = 0; b < BENCHMARK_COUNT; b++) {
+                printf("%s\n", benchmarks[b].name);
+            }
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (repetitions < 1 || repetitions > REPETITIONS_MAX || min_time_ms < 1) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    setup_fixtures();
+
+    bench_result results[BENCHMARK_COUNT];
+    size_t count = 0;
+
+    printf("%-40s %14s %12s %12s %10s %10s\n", "benchmark", "iterations", "ns/op", "median", "allocs/op", "B/op");
+    for (size_t b = 0; b < BENCHMARK_COUNT; b++) {
+        if (filter != NULL && strstr(benchmarks[b].name, filter) == NULL) {
+            continue;
+        }
+        bench_result r = run_benchmark(&benchmarks[b], min_time_ms * 1000000, repetitions);
+        printf("%-40s %14llu %12.1f %12.1f %10.2f %10.1f\n", r.name, (unsigned long long)r.iterations,
+               r.ns_per_op_min, r.ns_per_op_median, r.allocs_per_op, r.bytes_per_op);
+        results[count++] = r;
+    }
+
+    coinbase_template_free(&tmpl);
+
+    if (json_path != NULL && !write_json(json_path, results, count)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef HOST_SHIM_ESP_HEAP_CAPS_H
+#define HOST_SHIM_ESP_HEAP_CAPS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_8BIT   (1 << 2)
+
+static inline void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+    (void)caps;
+    return calloc(n, size);
+}
+
+#endif // HOST_SHIM_ESP_HEAP_CAPS_H
@@ -0,0 +1,16 @@
+#ifndef HOST_SHIM_ESP_LOG_H
+#define HOST_SHIM_ESP_LOG_H
+
+#include <stdio.h>
+
+// Errors and warnings go to stderr, everything else is compiled out so it
+// does not show up in benchmark timings.
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) do { (void)(tag); } while (0)
+#define ESP_LOGD(tag, format, ...) do { (void)(tag); } while (0)
+#define ESP_LOGV(tag, format, ...) do { (void)(tag); } while (0)
+
+#define ESP_LOG_BUFFER_HEX(tag, buffer, len) do { (void)(tag); (void)(buffer); (void)(len); } while (0)
+
+#endif // HOST_SHIM_ESP_LOG_H
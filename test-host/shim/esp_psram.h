@@ -0,0 +1,11 @@
+#ifndef HOST_SHIM_ESP_PSRAM_H
+#define HOST_SHIM_ESP_PSRAM_H
+
+#include <stdbool.h>
+
+static inline bool esp_psram_is_initialized(void)
+{
+    return false;
+}
+
+#endif // HOST_SHIM_ESP_PSRAM_H
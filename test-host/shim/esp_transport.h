@@ -0,0 +1,7 @@
+#ifndef HOST_SHIM_ESP_TRANSPORT_H
+#define HOST_SHIM_ESP_TRANSPORT_H
+
+// stratum_api.h only needs the handle type; nothing in the host build talks to a pool
+typedef struct esp_transport_item_t *esp_transport_handle_t;
+
+#endif // HOST_SHIM_ESP_TRANSPORT_H
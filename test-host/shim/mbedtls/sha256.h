@@ -0,0 +1,26 @@
+#ifndef HOST_SHIM_MBEDTLS_SHA256_H
+#define HOST_SHIM_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Portable stand-in for the subset of the mbedtls 3.x SHA-256 API used by the
+// stratum component. The context layout matches mbedtls so code that reads
+// the raw state (midstate_sha256_bin) sees the same words as on the ESP32.
+typedef struct
+{
+    uint32_t total[2];
+    uint32_t state[8];
+    unsigned char buffer[64];
+    int is224;
+} mbedtls_sha256_context;
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_clone(mbedtls_sha256_context *dst, const mbedtls_sha256_context *src);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char output[32]);
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char output[32], int is224);
+
+#endif // HOST_SHIM_MBEDTLS_SHA256_H